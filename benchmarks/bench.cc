@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Runs all registered benchmarks (sorted by name) and writes the results
+ * to stdout as JSON, one object per benchmark with the median, minimum and
+ * maximum nanoseconds per iteration over all repetitions:
+ *
+ *     xapiand_bench [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>]
+ */
+
+#include "bench.h"
+
+#include <algorithm>   // for sort
+#include <exception>   // for exception
+#include <stdio.h>     // for printf, fprintf, stderr
+#include <stdlib.h>    // for strtod, strtoul
+#include <string.h>    // for strncmp, strlen
+#include <xapian.h>    // for Error
+
+#include "config.h"         // for PACKAGE_STRING
+#include "../src/logger.h"  // for Log
+
+
+#define BENCHMARK_MIN_TIME 0.5      // Seconds each repetition should last at least
+#define BENCHMARK_REPETITIONS 5
+
+
+std::vector<Benchmark>&
+Benchmark::registry()
+{
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+
+static std::string
+json_string(const std::string& str)
+{
+	std::string result("\"");
+	for (auto c : str) {
+		switch (c) {
+			case '"':
+				result += "\\\"";
+				break;
+			case '\\':
+				result += "\\\\";
+				break;
+			default:
+				result.push_back(c);
+				break;
+		}
+	}
+	result.push_back('"');
+	return result;
+}
+
+
+static void
+run_benchmark(const Benchmark& benchmark, double min_time, size_t repetitions, bool first)
+{
+	// Find the number of iterations needed to last at least min_time
+	size_t iterations = 1;
+	double elapsed;
+	while (true) {
+		BenchmarkState state(iterations);
+		benchmark.function(state);
+		elapsed = state.elapsed();
+		if (elapsed >= min_time * 1e9 || iterations >= 1000000000) {
+			break;
+		}
+		auto multiplier = elapsed > 0 ? (min_time * 1e9 * 1.4) / elapsed : 10.0;
+		iterations = static_cast<size_t>(iterations * std::min(std::max(multiplier, 2.0), 10.0));
+	}
+
+	std::vector<double> samples;
+	size_t bytes = 0, items = 0;
+	for (size_t r = 0; r < repetitions; ++r) {
+		BenchmarkState state(iterations);
+		benchmark.function(state);
+		samples.push_back(state.elapsed() / iterations);
+		bytes = state.bytes;
+		items = state.items;
+	}
+	std::sort(samples.begin(), samples.end());
+	auto median = samples[samples.size() / 2];
+
+	printf("%s\n    {\n", first ? "" : ",");
+	printf("      \"name\": %s,\n", json_string(benchmark.name).c_str());
+	printf("      \"iterations\": %zu,\n", iterations);
+	printf("      \"repetitions\": %zu,\n", repetitions);
+	printf("      \"ns_per_op\": %.1f,\n", median);
+	printf("      \"ns_per_op_min\": %.1f,\n", samples.front());
+	printf("      \"ns_per_op_max\": %.1f", samples.back());
+	if (bytes) {
+		printf(",\n      \"bytes_per_second\": %.0f", bytes * 1e9 / median);
+	}
+	if (items) {
+		printf(",\n      \"items_per_second\": %.0f", items * 1e9 / median);
+	}
+	printf("\n    }");
+	fflush(stdout);
+}
+
+
+int
+main(int argc, char **argv)
+{
+	std::string filter;
+	double min_time = BENCHMARK_MIN_TIME;
+	size_t repetitions = BENCHMARK_REPETITIONS;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+			min_time = strtod(argv[i] + 11, nullptr);
+		} else if (strncmp(argv[i], "--repetitions=", 14) == 0) {
+			repetitions = strtoul(argv[i] + 14, nullptr, 10);
+		} else {
+			fprintf(stderr, "usage: %s [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (repetitions == 0) {
+		repetitions = 1;
+	}
+
+	auto benchmarks = Benchmark::registry();
+	std::sort(benchmarks.begin(), benchmarks.end(), [](const Benchmark& a, const Benchmark& b) {
+		return a.name < b.name;
+	});
+
+	printf("{\n");
+	printf("  \"context\": {\n");
+	printf("    \"package\": %s,\n", json_string(PACKAGE_STRING).c_str());
+	printf("    \"min_time\": %.3f,\n", min_time);
+	printf("    \"repetitions\": %zu\n", repetitions);
+	printf("  },\n");
+	printf("  \"benchmarks\": [");
+
+	int errors = 0;
+	bool first = true;
+	for (const auto& benchmark : benchmarks) {
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		try {
+			run_benchmark(benchmark, min_time, repetitions, first);
+			first = false;
+		} catch (const Xapian::Error& exc) {
+			fprintf(stderr, "%s: %s\n", benchmark.name.c_str(), exc.get_msg().c_str());
+			++errors;
+		} catch (const std::exception& exc) {
+			fprintf(stderr, "%s: %s\n", benchmark.name.c_str(), exc.what());
+			++errors;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	Log::finish();
+	return errors;
+}
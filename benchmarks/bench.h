@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>      // for steady_clock
+#include <cstddef>     // for size_t
+#include <functional>  // for function
+#include <string>      // for string
+#include <vector>      // for vector
+
+
+/*
+ * Minimal benchmark harness. Each benchmark is a function receiving a
+ * BenchmarkState, it does its setup and then loops while keep_running()
+ * returns true; only the loop is timed:
+ *
+ *     BENCHMARK(msgpack, serialise) {
+ *         MsgPack obj = ...;
+ *         while (state.keep_running()) {
+ *             do_not_optimize(obj.serialise());
+ *         }
+ *     }
+ */
+class BenchmarkState {
+	size_t _iterations;
+	size_t _remaining;
+	bool _started;
+	std::chrono::steady_clock::time_point _start;
+	std::chrono::steady_clock::time_point _stop;
+
+public:
+	size_t bytes;  // Bytes processed per iteration (optional)
+	size_t items;  // Items processed per iteration (optional)
+
+	BenchmarkState(size_t iterations)
+		: _iterations(iterations),
+		  _remaining(iterations),
+		  _started(false),
+		  bytes(0),
+		  items(0) { }
+
+	bool keep_running() {
+		if (!_started) {
+			_started = true;
+			_start = std::chrono::steady_clock::now();
+		}
+		if (_remaining) {
+			--_remaining;
+			return true;
+		}
+		_stop = std::chrono::steady_clock::now();
+		return false;
+	}
+
+	size_t iterations() const {
+		return _iterations;
+	}
+
+	double elapsed() const {
+		return std::chrono::duration<double, std::nano>(_stop - _start).count();
+	}
+};
+
+
+struct Benchmark {
+	using function_t = std::function<void(BenchmarkState&)>;
+
+	std::string name;
+	function_t function;
+
+	static std::vector<Benchmark>& registry();
+
+	Benchmark(const std::string& name_, function_t function_)
+		: name(name_),
+		  function(function_) { }
+};
+
+
+struct BenchmarkRegister {
+	BenchmarkRegister(const std::string& name, Benchmark::function_t function) {
+		Benchmark::registry().emplace_back(name, function);
+	}
+};
+
+
+// Keeps the compiler from optimizing away values computed by the benchmark
+template <typename T>
+inline void do_not_optimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+#define BENCHMARK(group, name) \
+	static void bench_##group##_##name(BenchmarkState& state); \
+	static BenchmarkRegister bench_register_##group##_##name(#group "." #name, bench_##group##_##name); \
+	static void bench_##group##_##name(BenchmarkState& state)
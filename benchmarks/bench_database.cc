@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmarks over a synthetic index (BENCH_DATABASE_DOCS small documents),
+ * created on first use in the current directory and removed at exit.
+ * Database only opens indexes through on-disk endpoints, so this isn't an
+ * in-memory backend, but the index is small enough to stay in the page
+ * cache once built.
+ */
+
+#include "bench.h"
+
+#include <memory>                          // for shared_ptr
+#include <string>                          // for string
+#include <vector>                          // for vector
+
+#include "../src/database.h"               // for Database, DatabaseWAL
+#include "../src/database_handler.h"       // for lock_database
+#include "../src/multivalue/aggregation.h" // for AggregationMatchSpy
+#include "../src/query_dsl.h"              // for QueryDSL
+#include "../src/schema.h"                 // for Schema
+#include "../tests/utils.h"                // for DB_Test
+
+
+#define BENCH_DATABASE_DOCS 5000
+
+
+static MsgPack
+make_document(size_t i)
+{
+	static const char* colors[] = { "red", "green", "blue", "yellow", "black" };
+	static const char* words[] = { "search", "storage", "xapiand", "index", "document", "query", "term", "value", "schema", "field" };
+	std::string description;
+	for (size_t w = 0; w < 12; ++w) {
+		description.append(words[(i * 7 + w * 3) % 10]).push_back(' ');
+	}
+	return {
+		{ "name", "User " + std::to_string(i) },
+		{ "age", static_cast<int>(i % 90) },
+		{ "color", colors[i % 5] },
+		{ "score", static_cast<double>((i * 37) % 1000) / 10.0 },
+		{ "active", i % 3 == 0 },
+		{ "description", description },
+	};
+}
+
+
+static DB_Test&
+bench_db()
+{
+	static DB_Test db(".bench_database.db", std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+	static bool indexed = [&]() {
+		for (size_t i = 0; i < BENCH_DATABASE_DOCS; ++i) {
+			db.db_handler.index(std::to_string(i + 1), false, make_document(i), false, JSON_CONTENT_TYPE);
+		}
+		db.db_handler.commit();
+		return true;
+	}();
+	(void)indexed;
+	return db;
+}
+
+
+static query_field_t
+make_query(const std::string& query_string)
+{
+	query_field_t query;
+	query.query.push_back(query_string);
+	query.offset = 0;
+	query.limit = 10;
+	query.check_at_least = BENCH_DATABASE_DOCS;
+	query.spelling = false;
+	query.synonyms = false;
+	return query;
+}
+
+
+BENCHMARK(schema, index) {
+	auto& db = bench_db();
+	auto schema = db.db_handler.get_schema();
+	auto obj = make_document(0);
+	while (state.keep_running()) {
+		Xapian::Document doc;
+		do_not_optimize(schema->index(obj, doc));
+	}
+}
+
+
+BENCHMARK(query_dsl, make_dsl_query) {
+	auto& db = bench_db();
+	QueryDSL query_object(db.db_handler.get_schema());
+	while (state.keep_running()) {
+		do_not_optimize(query_object.make_dsl_query("color:red AND age:20..40 OR description:xapiand"));
+	}
+}
+
+
+BENCHMARK(query_dsl, get_query) {
+	auto& db = bench_db();
+	QueryDSL query_object(db.db_handler.get_schema());
+	auto dsl = query_object.make_dsl_query("color:red AND age:20..40 OR description:xapiand");
+	while (state.keep_running()) {
+		do_not_optimize(query_object.get_query(dsl));
+	}
+}
+
+
+BENCHMARK(search, term) {
+	auto& db = bench_db();
+	auto query = make_query("color:red");
+	std::vector<std::string> suggestions;
+	while (state.keep_running()) {
+		do_not_optimize(db.db_handler.get_mset(query, nullptr, nullptr, suggestions));
+	}
+}
+
+
+BENCHMARK(search, range) {
+	auto& db = bench_db();
+	auto query = make_query("age:20..40");
+	std::vector<std::string> suggestions;
+	while (state.keep_running()) {
+		do_not_optimize(db.db_handler.get_mset(query, nullptr, nullptr, suggestions));
+	}
+}
+
+
+BENCHMARK(aggregation, metrics_and_buckets) {
+	auto& db = bench_db();
+	auto schema = db.db_handler.get_schema();
+	auto query = make_query("*");
+	MsgPack aggs = {
+		{ AGGREGATION_AGGS, {
+			{ "avg_age", {{ AGGREGATION_AVG, {{ AGGREGATION_FIELD, "age" }} }} },
+			{ "score_stats", {{ AGGREGATION_EXT_STATS, {{ AGGREGATION_FIELD, "score" }} }} },
+			{ "colors", {{ AGGREGATION_VALUE, {{ AGGREGATION_FIELD, "color" }} }} },
+			{ "ages", {{ AGGREGATION_HISTOGRAM, {{ AGGREGATION_FIELD, "age" }, { AGGREGATION_INTERVAL, 10 }} }} },
+		}},
+	};
+	state.items = BENCH_DATABASE_DOCS;
+	std::vector<std::string> suggestions;
+	while (state.keep_running()) {
+		AggregationMatchSpy spy(aggs, schema);
+		db.db_handler.get_mset(query, nullptr, &spy, suggestions);
+		do_not_optimize(spy.get_aggregation());
+	}
+}
+
+
+#if XAPIAND_DATABASE_WAL
+BENCHMARK(wal, write_line) {
+	static DB_Test db(".bench_wal.db", std::vector<std::string>(), DB_WRITABLE | DB_SPAWN);
+	lock_database lk_db(&db.db_handler);
+	auto database = db.db_handler.get_database();
+	auto document = make_document(0);
+	Xapian::Document doc;
+	doc.set_data(document.serialise());
+	auto data = doc.serialise();
+	state.bytes = data.size();
+	while (state.keep_running()) {
+		database->wal->write_line(DatabaseWAL::Type::ADD_DOCUMENT, data);
+	}
+}
+#endif
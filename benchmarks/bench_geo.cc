@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <string>                  // for string
+
+#include "../src/geo/ewkt.h"       // for EWKT
+#include "../src/geo/htm.h"        // for HTM_MIN_ERROR, HTM_MAX_ERROR
+
+
+static const std::string point("POINT (46.84516443029276 -100.78857421875)");
+static const std::string circle("CIRCLE (19.4326 -99.1332, 50000)");
+static const std::string polygon("POLYGON ((48.574789910928864 -103.53515625, 48.864714761802794 -97.2509765625, 45.89000815866182 -96.6357421875, 45.89000815866182 -103.974609375, 48.574789910928864 -103.53515625))");
+static const std::string multipolygon("MULTIPOLYGON (((48.574789910928864 -103.53515625, 48.864714761802794 -97.2509765625, 45.89000815866182 -96.6357421875, 45.89000815866182 -103.974609375, 48.574789910928864 -103.53515625)), ((45.89000815866182 -103.974609375, 45.89000815866182 -96.6357421875, 42.779275360241904 -96.6796875, 43.03677585761058 -103.9306640625)))");
+
+
+BENCHMARK(htm, parse_polygon) {
+	while (state.keep_running()) {
+		do_not_optimize(EWKT(polygon).getGeometry());
+	}
+}
+
+
+BENCHMARK(htm, trixels_point) {
+	auto geometry = EWKT(point).getGeometry();
+	while (state.keep_running()) {
+		do_not_optimize(geometry->getTrixels(true, HTM_MIN_ERROR));
+	}
+}
+
+
+BENCHMARK(htm, trixels_circle) {
+	auto geometry = EWKT(circle).getGeometry();
+	while (state.keep_running()) {
+		do_not_optimize(geometry->getTrixels(true, HTM_MIN_ERROR));
+	}
+}
+
+
+BENCHMARK(htm, trixels_polygon) {
+	auto geometry = EWKT(polygon).getGeometry();
+	while (state.keep_running()) {
+		do_not_optimize(geometry->getTrixels(true, HTM_MIN_ERROR));
+	}
+}
+
+
+BENCHMARK(htm, trixels_polygon_coarse) {
+	auto geometry = EWKT(polygon).getGeometry();
+	while (state.keep_running()) {
+		do_not_optimize(geometry->getTrixels(true, HTM_MAX_ERROR));
+	}
+}
+
+
+BENCHMARK(htm, ranges_circle) {
+	auto geometry = EWKT(circle).getGeometry();
+	while (state.keep_running()) {
+		do_not_optimize(geometry->getRanges(true, HTM_MIN_ERROR));
+	}
+}
+
+
+BENCHMARK(htm, ranges_multipolygon) {
+	auto geometry = EWKT(multipolygon).getGeometry();
+	while (state.keep_running()) {
+		do_not_optimize(geometry->getRanges(true, HTM_MIN_ERROR));
+	}
+}
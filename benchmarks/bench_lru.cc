@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <atomic>                   // for atomic_bool
+#include <memory>                   // for shared_ptr, make_shared
+#include <mutex>                    // for mutex, lock_guard
+#include <string>                   // for string
+#include <thread>                   // for thread
+#include <vector>                   // for vector
+
+#include "../src/concurrent_lru.h"  // for ConcurrentLRU
+#include "../src/lru.h"             // for LRU
+
+
+#define BENCH_LRU_KEYS 1024
+
+
+/*
+ * Hits from num_threads threads (the one being timed plus num_threads - 1
+ * running in the background for the whole measurement).
+ */
+template <typename Get>
+static void
+bench_hits(BenchmarkState& state, size_t num_threads, Get&& get)
+{
+	std::atomic_bool running(true);
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < num_threads; ++t) {
+		threads.emplace_back([&, t]() {
+			size_t i = t;
+			while (running.load(std::memory_order_relaxed)) {
+				do_not_optimize(get(i++ % BENCH_LRU_KEYS));
+			}
+		});
+	}
+	size_t i = 0;
+	while (state.keep_running()) {
+		do_not_optimize(get(i++ % BENCH_LRU_KEYS));
+	}
+	running = false;
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+
+static void
+bench_lru_hits(BenchmarkState& state, size_t num_threads)
+{
+	lru::LRU<size_t, std::shared_ptr<std::string>> cache(BENCH_LRU_KEYS);
+	std::mutex mtx;
+	for (size_t i = 0; i < BENCH_LRU_KEYS; ++i) {
+		cache.insert(std::make_pair(i, std::make_shared<std::string>(std::to_string(i))));
+	}
+	bench_hits(state, num_threads, [&](size_t key) {
+		std::lock_guard<std::mutex> lk(mtx);
+		return cache.at(key);
+	});
+}
+
+
+static void
+bench_concurrent_lru_hits(BenchmarkState& state, size_t num_threads)
+{
+	lru::ConcurrentLRU<size_t, std::shared_ptr<std::string>> cache(BENCH_LRU_KEYS);
+	for (size_t i = 0; i < BENCH_LRU_KEYS; ++i) {
+		cache.insert(i, std::make_shared<std::string>(std::to_string(i)));
+	}
+	bench_hits(state, num_threads, [&](size_t key) {
+		std::shared_ptr<std::string> value;
+		cache.find(key, value);
+		return value;
+	});
+}
+
+
+BENCHMARK(lru, hits_1_thread) {
+	bench_lru_hits(state, 1);
+}
+
+
+BENCHMARK(lru, hits_4_threads) {
+	bench_lru_hits(state, 4);
+}
+
+
+BENCHMARK(concurrent_lru, hits_1_thread) {
+	bench_concurrent_lru_hits(state, 1);
+}
+
+
+BENCHMARK(concurrent_lru, hits_4_threads) {
+	bench_concurrent_lru_hits(state, 4);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <string>                   // for string
+
+#include "../src/database_utils.h"  // for json_load
+#include "../src/msgpack.h"         // for MsgPack
+#include "../src/rapidjson/document.h"  // for Document
+
+
+static const std::string json_document(R"({
+	"_id": 12345,
+	"name": "Xapiand",
+	"description": "Xapiand is a highly scalable, distributed, RESTful search and storage server",
+	"version": { "major": 1, "minor": 0, "patch": 0 },
+	"tags": [ "search", "storage", "distributed", "restful", "json", "msgpack" ],
+	"price": 12.75,
+	"active": true,
+	"created": "2017-04-12T10:30:15.123",
+	"location": { "city": "Mexico City", "latitude": 19.4326, "longitude": -99.1332 },
+	"contributors": [
+		{ "name": "German", "commits": 2500 },
+		{ "name": "Jose", "commits": 1900 },
+		{ "name": "Eduardo", "commits": 800 }
+	]
+})");
+
+
+static MsgPack
+make_document()
+{
+	rapidjson::Document rdoc;
+	json_load(rdoc, json_document);
+	return MsgPack(rdoc);
+}
+
+
+BENCHMARK(msgpack, parse_json) {
+	state.bytes = json_document.size();
+	while (state.keep_running()) {
+		do_not_optimize(make_document());
+	}
+}
+
+
+BENCHMARK(msgpack, serialise) {
+	auto obj = make_document();
+	state.bytes = obj.serialise().size();
+	while (state.keep_running()) {
+		do_not_optimize(obj.serialise());
+	}
+}
+
+
+BENCHMARK(msgpack, unserialise) {
+	auto serialised = make_document().serialise();
+	state.bytes = serialised.size();
+	while (state.keep_running()) {
+		do_not_optimize(MsgPack::unserialise(serialised));
+	}
+}
+
+
+BENCHMARK(msgpack, to_string) {
+	auto obj = make_document();
+	while (state.keep_running()) {
+		do_not_optimize(obj.to_string());
+	}
+}
+
+
+BENCHMARK(msgpack, lookup) {
+	const auto obj = make_document();
+	state.items = 4;
+	while (state.keep_running()) {
+		do_not_optimize(obj.at("name"));
+		do_not_optimize(obj.at("version").at("minor"));
+		do_not_optimize(obj.at("location").at("longitude"));
+		do_not_optimize(obj.at("contributors").at(2).at("commits"));
+	}
+}
+
+
+BENCHMARK(msgpack, build) {
+	while (state.keep_running()) {
+		MsgPack obj;
+		obj["name"] = "Xapiand";
+		obj["version"]["major"] = 1;
+		obj["version"]["minor"] = 0;
+		auto& tags = obj["tags"];
+		for (int i = 0; i < 8; ++i) {
+			tags.push_back(i);
+		}
+		do_not_optimize(obj);
+	}
+}
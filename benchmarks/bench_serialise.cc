@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <cstdint>                // for int64_t, uint64_t
+#include <string>                 // for string
+
+#include "../src/geo/cartesian.h" // for Cartesian
+#include "../src/serialise.h"     // for Serialise, Unserialise
+
+
+BENCHMARK(serialise, integer) {
+	int64_t value = -1000000;
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::integer(value++));
+	}
+}
+
+
+BENCHMARK(serialise, positive) {
+	uint64_t value = 1000000;
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::positive(value++));
+	}
+}
+
+
+BENCHMARK(serialise, float) {
+	double value = -1000.5;
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::_float(value));
+		value += 0.25;
+	}
+}
+
+
+BENCHMARK(serialise, date) {
+	const std::string date("2017-04-12T10:30:15.123");
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::date(date));
+	}
+}
+
+
+BENCHMARK(serialise, cartesian) {
+	Cartesian c(20.0, -100.0, 0.0, Cartesian::Units::DEGREES);
+	c.normalize();
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::cartesian(c));
+	}
+}
+
+
+BENCHMARK(serialise, trixel_id) {
+	uint64_t id = 0x2AAAAAAAAAULL;
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::trixel_id(id++));
+	}
+}
+
+
+BENCHMARK(serialise, geospatial) {
+	const std::string ewkt("POLYGON ((48.574789910928864 -103.53515625, 48.864714761802794 -97.2509765625, 45.89000815866182 -96.6357421875, 45.89000815866182 -103.974609375, 48.574789910928864 -103.53515625))");
+	while (state.keep_running()) {
+		do_not_optimize(Serialise::geospatial(ewkt));
+	}
+}
+
+
+BENCHMARK(unserialise, integer) {
+	const auto serialised = Serialise::integer(-123456789);
+	while (state.keep_running()) {
+		do_not_optimize(Unserialise::integer(serialised));
+	}
+}
+
+
+BENCHMARK(unserialise, positive) {
+	const auto serialised = Serialise::positive(123456789);
+	while (state.keep_running()) {
+		do_not_optimize(Unserialise::positive(serialised));
+	}
+}
+
+
+BENCHMARK(unserialise, float) {
+	const auto serialised = Serialise::_float(-1234.5678);
+	while (state.keep_running()) {
+		do_not_optimize(Unserialise::_float(serialised));
+	}
+}
+
+
+BENCHMARK(unserialise, date) {
+	const auto serialised = Serialise::date(std::string("2017-04-12T10:30:15.123"));
+	while (state.keep_running()) {
+		do_not_optimize(Unserialise::date(serialised));
+	}
+}
+
+
+BENCHMARK(unserialise, cartesian) {
+	Cartesian c(20.0, -100.0, 0.0, Cartesian::Units::DEGREES);
+	c.normalize();
+	const auto serialised = Serialise::cartesian(c);
+	while (state.keep_running()) {
+		do_not_optimize(Unserialise::cartesian(serialised));
+	}
+}
+
+
+BENCHMARK(unserialise, trixel_id) {
+	const auto serialised = Serialise::trixel_id(0x2AAAAAAAAAULL);
+	while (state.keep_running()) {
+		do_not_optimize(Unserialise::trixel_id(serialised));
+	}
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <string>              // for string
+#include <unistd.h>            // for unlink
+#include <vector>              // for vector
+
+#include "../src/storage.h"    // for Storage, STORAGE_*
+
+
+#define BENCH_STORAGE_VOLUME ".bench_storage.0"
+#define BENCH_STORAGE_RESET 4096  // Writes before starting over with an empty volume
+
+
+using BenchStorage = Storage<StorageHeader, StorageBinHeader, StorageBinFooter>;
+
+
+// Mostly text, so compression has something to do
+static std::string
+make_payload(size_t size)
+{
+	static const std::string words[] = { "search ", "storage ", "xapiand ", "index ", "document ", "query ", "term ", "value " };
+	std::string payload;
+	for (size_t i = 0; payload.size() < size; ++i) {
+		payload.append(words[(i * 7 + i / 3) % 8]);
+	}
+	payload.resize(size);
+	return payload;
+}
+
+
+static void
+bench_write(BenchmarkState& state, size_t size, int flags)
+{
+	auto payload = make_payload(size);
+	state.bytes = payload.size();
+
+	unlink(BENCH_STORAGE_VOLUME);
+	BenchStorage storage("", nullptr);
+	storage.open(BENCH_STORAGE_VOLUME, STORAGE_CREATE_OR_OPEN | STORAGE_NO_SYNC | flags);
+	size_t writes = 0;
+	while (state.keep_running()) {
+		if (++writes == BENCH_STORAGE_RESET) {
+			writes = 0;
+			storage.close();
+			unlink(BENCH_STORAGE_VOLUME);
+			storage.open(BENCH_STORAGE_VOLUME, STORAGE_CREATE_OR_OPEN | STORAGE_NO_SYNC | flags);
+		}
+		do_not_optimize(storage.write(payload));
+	}
+	storage.close();
+	unlink(BENCH_STORAGE_VOLUME);
+}
+
+
+static void
+bench_read(BenchmarkState& state, size_t size, int flags)
+{
+	auto payload = make_payload(size);
+	state.bytes = payload.size();
+
+	unlink(BENCH_STORAGE_VOLUME);
+	BenchStorage storage("", nullptr);
+	storage.open(BENCH_STORAGE_VOLUME, STORAGE_CREATE_OR_OPEN | STORAGE_NO_SYNC | flags);
+	std::vector<uint32_t> offsets;
+	for (size_t i = 0; i < 256; ++i) {
+		offsets.push_back(storage.write(payload));
+	}
+	size_t i = 0;
+	while (state.keep_running()) {
+		storage.seek(offsets[i++ % offsets.size()]);
+		do_not_optimize(storage.read());
+	}
+	storage.close();
+	unlink(BENCH_STORAGE_VOLUME);
+}
+
+
+BENCHMARK(storage, write_1k) {
+	bench_write(state, 1024, 0);
+}
+
+
+BENCHMARK(storage, write_1k_lz4) {
+	bench_write(state, 1024, STORAGE_COMPRESS);
+}
+
+
+BENCHMARK(storage, write_64k) {
+	bench_write(state, 64 * 1024, 0);
+}
+
+
+BENCHMARK(storage, write_64k_lz4) {
+	bench_write(state, 64 * 1024, STORAGE_COMPRESS);
+}
+
+
+BENCHMARK(storage, read_1k) {
+	bench_read(state, 1024, 0);
+}
+
+
+BENCHMARK(storage, read_1k_lz4) {
+	bench_read(state, 1024, STORAGE_COMPRESS);
+}
+
+
+BENCHMARK(storage, read_64k) {
+	bench_read(state, 64 * 1024, 0);
+}
+
+
+BENCHMARK(storage, read_64k_lz4) {
+	bench_read(state, 64 * 1024, STORAGE_COMPRESS);
+}
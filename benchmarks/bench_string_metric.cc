@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+
+#include <string>                   // for string
+
+#include "../src/phonetic.h"        // for SoundexEnglish
+#include "../src/string_metric.h"   // for Levenshtein, Jaro, Jaro_Winkler...
+
+
+static const std::string str1("Xapiand Project - Release: Beta");
+static const std::string str2("Xapiand Beta");
+
+
+template <typename Metric>
+static void
+bench_distance(BenchmarkState& state, Metric&& metric)
+{
+	while (state.keep_running()) {
+		do_not_optimize(metric.distance(str1, str2));
+	}
+}
+
+
+template <typename Metric>
+static void
+bench_distance_prepared(BenchmarkState& state, Metric&& metric)
+{
+	while (state.keep_running()) {
+		do_not_optimize(metric.distance(str2));
+	}
+}
+
+
+BENCHMARK(string_metric, levenshtein) {
+	bench_distance(state, Levenshtein());
+}
+
+
+BENCHMARK(string_metric, levenshtein_prepared) {
+	bench_distance_prepared(state, Levenshtein(str1));
+}
+
+
+BENCHMARK(string_metric, jaro) {
+	bench_distance(state, Jaro());
+}
+
+
+BENCHMARK(string_metric, jaro_winkler) {
+	bench_distance(state, Jaro_Winkler());
+}
+
+
+BENCHMARK(string_metric, sorensen_dice) {
+	bench_distance(state, Sorensen_Dice());
+}
+
+
+BENCHMARK(string_metric, jaccard) {
+	bench_distance(state, Jaccard());
+}
+
+
+BENCHMARK(string_metric, lcsubstr) {
+	bench_distance(state, LCSubstr());
+}
+
+
+BENCHMARK(string_metric, lcsubsequence) {
+	bench_distance(state, LCSubsequence());
+}
+
+
+BENCHMARK(string_metric, soundex) {
+	bench_distance(state, SoundexMetric<SoundexEnglish, Jaro>());
+}
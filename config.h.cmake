@@ -135,6 +135,9 @@
 /* Define to 1 if you have the <sys/socket.h> header file. */
 #cmakedefine HAVE_SYS_SOCKET_H @HAVE_SYS_SOCKET_H@
 
+/* Define to 1 if you have the <sys/sendfile.h> header file. */
+#cmakedefine HAVE_SYS_SENDFILE_H @HAVE_SYS_SENDFILE_H@
+
 /* Define to 1 if you have the <sys/time.h> header file. */
 #cmakedefine HAVE_SYS_TIME_H @HAVE_SYS_TIME_H@
 
@@ -221,6 +224,9 @@
 /* Define to 1 if you have the `signalfd' function. */
 #cmakedefine HAVE_SIGNALFD @HAVE_SIGNALFD@
 
+/* Define to 1 if you have the `sendfile' function. */
+#cmakedefine HAVE_SENDFILE @HAVE_SENDFILE@
+
 /* Define to 1 if you have the `socket' function. */
 #cmakedefine HAVE_SOCKET @HAVE_SOCKET@
 
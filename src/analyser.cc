@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "analyser.h"
+
+#include <memory>         // for unique_ptr, make_unique
+#include <unordered_map>  // for unordered_map
+
+#include "utils.h"        // for toUType
+
+
+/*
+ * Stemmer wrapper remembering the stems of recently seen words.
+ * Instances are only ever used by the thread that created them.
+ */
+class MemoStem : public Xapian::StemImplementation {
+	Xapian::Stem stemmer;
+	std::unordered_map<std::string, std::string> stems;
+
+public:
+	explicit MemoStem(const std::string& language)
+		: stemmer(language) { }
+
+	std::string operator()(const std::string& word) override {
+		auto it = stems.find(word);
+		if (it != stems.end()) {
+			return it->second;
+		}
+		if (stems.size() >= ANALYSER_STEM_CACHE_SIZE) {
+			stems.clear();
+		}
+		auto stem = stemmer(word);
+		stems.emplace(word, stem);
+		return stem;
+	}
+
+	std::string get_description() const override {
+		return stemmer.get_description();
+	}
+
+	bool is_none() const {
+		return stemmer.is_none();
+	}
+};
+
+
+static const Xapian::Stem&
+get_stemmer(const std::string& stem_language)
+{
+	static thread_local std::unordered_map<std::string, Xapian::Stem> stemmers;
+	auto it = stemmers.find(stem_language);
+	if (it == stemmers.end()) {
+		auto memo = std::make_unique<MemoStem>(stem_language);
+		if (memo->is_none()) {
+			it = stemmers.emplace(stem_language, Xapian::Stem()).first;
+		} else {
+			// Xapian::Stem takes ownership of the implementation.
+			it = stemmers.emplace(stem_language, Xapian::Stem(memo.release())).first;
+		}
+	}
+	return it->second;
+}
+
+
+Xapian::TermGenerator&
+Analyser::text_generator(const std::string& language, const std::string& stem_language, StopStrategy stop_strategy, StemStrategy stem_strategy)
+{
+	static thread_local std::unordered_map<std::string, std::unique_ptr<Xapian::TermGenerator>> generators;
+	auto key = language + '\0' + stem_language + '\0' + char(toUType(stop_strategy)) + char(toUType(stem_strategy));
+	auto& term_generator = generators[key];
+	if (!term_generator) {
+		term_generator = std::make_unique<Xapian::TermGenerator>();
+		term_generator->set_stopper(getStopper(language).get());
+		term_generator->set_stopper_strategy(getGeneratorStopStrategy(stop_strategy));
+		term_generator->set_stemmer(get_stemmer(stem_language));
+		term_generator->set_stemming_strategy(getGeneratorStemStrategy(stem_strategy));
+	}
+	return *term_generator;
+}
+
+
+Xapian::TermGenerator&
+Analyser::string_generator()
+{
+	static thread_local Xapian::TermGenerator term_generator;
+	return term_generator;
+}
+
+
+static Xapian::QueryParser&
+get_parser(const std::string& key, bool& created)
+{
+	static thread_local std::unordered_map<std::string, std::unique_ptr<Xapian::QueryParser>> parsers;
+	auto it = parsers.find(key);
+	if (it != parsers.end()) {
+		created = false;
+		return *it->second;
+	}
+	if (parsers.size() >= ANALYSER_MAX_PARSERS) {
+		parsers.clear();
+	}
+	created = true;
+	auto& parser = parsers[key];
+	parser = std::make_unique<Xapian::QueryParser>();
+	return *parser;
+}
+
+
+static void
+set_prefix(Xapian::QueryParser& parser, const std::string& prefix, bool bool_term)
+{
+	if (bool_term) {
+		parser.add_boolean_prefix("_", prefix);
+	} else {
+		parser.add_prefix("_", prefix);
+	}
+}
+
+
+Xapian::QueryParser&
+Analyser::text_parser(const std::string& prefix, bool bool_term, const std::string& language, const std::string& stem_language, StemStrategy stem_strategy)
+{
+	bool created;
+	auto& parser = get_parser(prefix + '\0' + char(bool_term) + language + '\0' + stem_language + '\0' + char(toUType(stem_strategy)), created);
+	if (created) {
+		set_prefix(parser, prefix, bool_term);
+		parser.set_stopper(getStopper(language).get());
+		parser.set_stemming_strategy(getQueryParserStemStrategy(stem_strategy));
+		parser.set_stemmer(get_stemmer(stem_language));
+	}
+	return parser;
+}
+
+
+Xapian::QueryParser&
+Analyser::string_parser(const std::string& prefix, bool bool_term)
+{
+	bool created;
+	auto& parser = get_parser(prefix + '\0' + char(bool_term), created);
+	if (created) {
+		set_prefix(parser, prefix, bool_term);
+	}
+	return parser;
+}
+
+
+void
+Analyser::index_text(Xapian::TermGenerator& term_generator, Xapian::Document& doc, const std::string& text, Xapian::termcount wdf_inc, const std::string& prefix, bool positions)
+{
+	// Setting the document also resets the term position, the cached
+	// generator lets go of doc once done so it isn't kept alive.
+	struct DocumentGuard {
+		Xapian::TermGenerator& term_generator;
+		~DocumentGuard() {
+			term_generator.set_document(Xapian::Document());
+		}
+	} guard{ term_generator };
+
+	term_generator.set_document(doc);
+	if (positions) {
+		term_generator.index_text(text, wdf_inc, prefix);
+	} else {
+		term_generator.index_text_without_positions(text, wdf_inc, prefix);
+	}
+}
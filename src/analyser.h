@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <string>      // for string
+#include <xapian.h>    // for TermGenerator, QueryParser, Stem
+
+#include "schema.h"    // for StopStrategy, StemStrategy
+
+
+#define ANALYSER_STEM_CACHE_SIZE  4096  /* Stemmed words memoised per language and thread */
+#define ANALYSER_MAX_PARSERS      256   /* Query parsers kept per thread */
+
+
+/*
+ * Per-thread cache of configured text analysers.
+ *
+ * TermGenerators and QueryParsers are built once per thread for each
+ * language, stemmer and strategy combination (and prefix, for parsers)
+ * and reused from then on; their stemmers memoise the most recently
+ * stemmed words.
+ */
+class Analyser {
+public:
+	static Xapian::TermGenerator& text_generator(const std::string& language, const std::string& stem_language, StopStrategy stop_strategy, StemStrategy stem_strategy);
+	static Xapian::TermGenerator& string_generator();
+
+	static Xapian::QueryParser& text_parser(const std::string& prefix, bool bool_term, const std::string& language, const std::string& stem_language, StemStrategy stem_strategy);
+	static Xapian::QueryParser& string_parser(const std::string& prefix, bool bool_term);
+
+	// Indexes text into doc using a cached term_generator
+	static void index_text(Xapian::TermGenerator& term_generator, Xapian::Document& doc, const std::string& text, Xapian::termcount wdf_inc, const std::string& prefix, bool positions);
+};
@@ -29,9 +29,13 @@
 #include <ratio>                 // for ratio
 #include <stdio.h>               // for SEEK_SET
 #include <sys/errno.h>           // for __error, errno, ECONNRESET
-#include <sys/socket.h>          // for shutdown, SHUT_RDWR
+#include <sys/mman.h>            // for mmap, munmap, madvise, MAP_FAILED
+#include <sys/socket.h>          // for shutdown, sendmsg, SHUT_RDWR
+#include <sys/stat.h>            // for fstat
+#include <sys/uio.h>             // for iovec, writev
 #include <sysexits.h>            // for EX_SOFTWARE
 #include <type_traits>           // for remove_reference<>::type
+#include <vector>                // for vector
 #include <xapian.h>              // for SerialisationError
 
 #include "ev/ev++.h"             // for ::EV_ERROR, ::EV_READ, ::EV_WRITE
@@ -46,6 +50,7 @@
 #include "utils.h"               // for readable_revents, ignored_errorno, repr
 
 #define BUF_SIZE 4096
+#define SENDFILE_BLOCK_SIZE (64 * 1024)
 
 #define NO_COMPRESSOR "\01"
 #define LZ4_COMPRESSOR "\02"
@@ -97,7 +102,11 @@ ClientLZ4Compressor::compress()
 		auto it = begin();
 		while (it) {
 			std::string length(serialise_length(it.size()));
-			if (!client->write(length) || !client->write(it->data(), it.size())) {
+			struct iovec iov[2] = {
+				{ const_cast<char*>(length.data()), length.size() },
+				{ const_cast<char*>(it->data()), it.size() },
+			};
+			if (!client->writev(iov, 2)) {
 				L_ERR(this, "Write failed!");
 				return -1;
 			}
@@ -108,7 +117,8 @@ ClientLZ4Compressor::compress()
 		return -1;
 	}
 
-	if (!client->write(serialise_length(0)) || !client->write(serialise_length(get_digest()))) {
+	std::string footer(serialise_length(0) + serialise_length(get_digest()));
+	if (!client->write(footer)) {
 		L_ERR(this, "Write Footer failed!");
 		return -1;
 	}
@@ -117,27 +127,240 @@ ClientLZ4Compressor::compress()
 }
 
 
+//
+//   SendFile class - file descriptor (duplicated) of a file being sent, shared
+//         by all its blocks still waiting in the write queue, and the
+//         checksum of the bytes sent so far
+//
+
+class SendFile {
+	const char* map;
+	off_t map_offset;
+	size_t map_size;
+	XXH32_state_t* xxh_state;
+
+public:
+	int fd;
+
+	SendFile(int fd_)
+		: map(nullptr),
+		  map_offset(0),
+		  map_size(0),
+		  xxh_state(XXH32_createState()),
+		  fd(::dup(fd_)) {
+		XXH32_reset(xxh_state, CMP_SEED);
+	}
+
+	~SendFile() {
+		if (map) {
+			::munmap(const_cast<char*>(map), map_size);
+		}
+		XXH32_freeState(xxh_state);
+		if (fd != -1) {
+			io::close(fd);
+		}
+	}
+
+	// Maps the [offset, offset + size) region of the file to be sent
+	void mmap(off_t offset, size_t size);
+
+	// Adds the bytes of the file in [offset, offset + size), just sent, to the checksum
+	bool update_digest(off_t offset, size_t size);
+
+	uint32_t digest() const {
+		return XXH32_digest(xxh_state);
+	}
+};
+
+
+void
+SendFile::mmap(off_t offset, size_t size)
+{
+	if (!size) {
+		return;
+	}
+	// Mappings must start at a page boundary
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+	map_offset = offset - offset % page_size;
+	map_size = size + (offset - map_offset);
+	void* addr = ::mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, map_offset);
+	if (addr != MAP_FAILED) {
+		::madvise(addr, map_size, MADV_SEQUENTIAL);
+		map = static_cast<const char*>(addr);
+	}
+	io::fadvise(fd, offset, size, POSIX_FADV_SEQUENTIAL);
+}
+
+
+bool
+SendFile::update_digest(off_t offset, size_t size)
+{
+	if (map && offset >= map_offset && offset - map_offset + size <= map_size) {
+		XXH32_update(xxh_state, map + (offset - map_offset), size);
+		return true;
+	}
+
+	// Fallback for files that cannot be mapped
+	char buffer[LZ4_BLOCK_SIZE];
+	while (size) {
+		ssize_t r = io::pread(fd, buffer, std::min(size, sizeof(buffer)), offset);
+		if (r <= 0) {
+			return false;
+		}
+		XXH32_update(xxh_state, buffer, r);
+		offset += r;
+		size -= r;
+	}
+	return true;
+}
+
+
+//
+//   FileBuffer class - a block's length followed by the block itself, which
+//         is never copied to user space but sent by the kernel straight from
+//         the file (sendfile) when the socket is writable
+//
+
+class FileBuffer : public Buffer {
+	std::shared_ptr<SendFile> file;
+	off_t offset;
+	size_t size;
+
+public:
+	FileBuffer(const std::string& length, const std::shared_ptr<SendFile>& file_, off_t offset_, size_t size_)
+		: Buffer('\0', length.data(), length.size()),
+		  file(file_),
+		  offset(offset_),
+		  size(size_) { }
+
+	size_t nbytes() override {
+		return len + size - pos;
+	}
+
+	ssize_t send(int fd) override;
+
+	std::string repr(size_t nbytes) override;
+};
+
+
+ssize_t
+FileBuffer::send(int fd)
+{
+	if (pos < len) {
+		// Block length, the block itself follows right after
+#if defined(MSG_NOSIGNAL) && defined(MSG_MORE)
+		return ::send(fd, dpos(), len - pos, MSG_NOSIGNAL | MSG_MORE);
+#elif defined(MSG_NOSIGNAL)
+		return ::send(fd, dpos(), len - pos, MSG_NOSIGNAL);
+#else
+		return io::write(fd, dpos(), len - pos);
+#endif
+	}
+
+	off_t file_offset = offset + (pos - len);
+	size_t file_size = len + size - pos;
+
+	ssize_t sent = io::sendfile(fd, file->fd, file_offset, file_size);
+	if (sent < 0 && (errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP || errno == ENOTSOCK)) {
+		// No sendfile for this file or socket, copy it through user space instead
+		char buffer[BUF_SIZE];
+		ssize_t r = io::pread(file->fd, buffer, std::min(file_size, sizeof(buffer)), file_offset);
+		if (r > 0) {
+#ifdef MSG_NOSIGNAL
+			sent = ::send(fd, buffer, r, MSG_NOSIGNAL);
+#else
+			sent = io::write(fd, buffer, r);
+#endif
+		} else {
+			sent = r;
+		}
+	}
+
+	if (sent == 0) {
+		errno = EIO;  // File was truncated while being sent
+		return -1;
+	}
+	if (sent > 0 && !file->update_digest(file_offset, sent)) {
+		errno = EIO;
+		return -1;
+	}
+	return sent;
+}
+
+
+std::string
+FileBuffer::repr(size_t nbytes)
+{
+	if (pos < len) {
+		return Buffer::repr(nbytes);
+	}
+	return "<file>";
+}
+
+
+//
+//   FileFooterBuffer class - the footer of a file sent with FileBuffers, its
+//         checksum taken once all the blocks before it have been sent
+//
+
+class FileFooterBuffer : public Buffer {
+	std::shared_ptr<SendFile> file;
+
+	void fill() {
+		if (file) {
+			std::string footer(serialise_length(0) + serialise_length(file->digest()));
+			delete [] data;
+			len = footer.size();
+			data = new char [len];
+			memcpy(data, footer.data(), len);
+			file.reset();
+		}
+	}
+
+public:
+	FileFooterBuffer(const std::shared_ptr<SendFile>& file_)
+		: Buffer('\0', "", 0),
+		  file(file_) { }
+
+	size_t nbytes() override {
+		fill();
+		return Buffer::nbytes();
+	}
+
+	ssize_t send(int fd) override {
+		fill();
+		return Buffer::send(fd);
+	}
+
+	std::string repr(size_t nbytes) override {
+		fill();
+		return Buffer::repr(nbytes);
+	}
+};
+
+
 class ClientNoCompressor {
 	BaseClient *client;
 	int fd;
 	size_t offset;
-	XXH32_state_t* xxh_state;
 
 public:
 	ClientNoCompressor(BaseClient *client_, int fd_, size_t offset_=0)
 		: client(client_),
 		  fd(fd_),
-		  offset(offset_),
-		  xxh_state(XXH32_createState()) { }
-
-	~ClientNoCompressor() {
-		XXH32_freeState(xxh_state);
-	}
+		  offset(offset_) { }
 
 	ssize_t compress();
 };
 
 
+/*
+ * Sends the file in blocks of SENDFILE_BLOCK_SIZE bytes, each one queued as
+ * a FileBuffer so the data goes from the page cache to the socket without
+ * being copied. The checksum is taken from a mapping of the file as each
+ * piece is handed to sendfile, so it covers the bytes actually sent, and
+ * the footer carrying it is filled in when its turn to be sent comes.
+ */
 ssize_t
 ClientNoCompressor::compress()
 {
@@ -146,32 +369,33 @@ ClientNoCompressor::compress()
 		return -1;
 	}
 
-	if unlikely(io::lseek(fd, offset, SEEK_SET) != static_cast<off_t>(offset)) {
-		L_ERR(this, "IO error: lseek");
+	auto file = std::make_shared<SendFile>(fd);
+	if unlikely(file->fd == -1) {
+		L_ERR(this, "IO error: dup");
 		return -1;
 	}
 
-	char buffer[LZ4_BLOCK_SIZE];
-	XXH32_reset(xxh_state, CMP_SEED);
+	struct stat st;
+	if unlikely(::fstat(file->fd, &st) == -1) {
+		L_ERR(this, "IO error: fstat");
+		return -1;
+	}
+	size_t file_size = st.st_size > static_cast<off_t>(offset) ? st.st_size - offset : 0;
+
+	file->mmap(offset, file_size);
 
 	size_t size = 0;
-	ssize_t r;
-	while ((r = io::read(fd, buffer, sizeof(buffer))) > 0) {
-		std::string length(serialise_length(r));
-		if (!client->write(length) || !client->write(buffer, r)) {
+	while (size < file_size) {
+		size_t block_size = std::min(file_size - size, static_cast<size_t>(SENDFILE_BLOCK_SIZE));
+		off_t block_offset = offset + size;
+		if (!client->write_buffer(std::make_shared<FileBuffer>(serialise_length(block_size), file, block_offset, block_size))) {
 			L_ERR(this, "Write failed!");
 			return -1;
 		}
-		size += r;
-		XXH32_update(xxh_state, buffer, r);
+		size += block_size;
 	}
 
-	if (r < 0) {
-		L_ERR(this, "IO error: read");
-		return -1;
-	}
-
-	if (!client->write(serialise_length(0)) || !client->write(serialise_length(XXH32_digest(xxh_state)))) {
+	if (!client->write_buffer(std::make_shared<FileFooterBuffer>(file))) {
 		L_ERR(this, "Write Footer failed!");
 		return -1;
 	}
@@ -265,6 +489,24 @@ ClientNoDecompressor::decompress()
 }
 
 
+ssize_t
+Buffer::send(int fd)
+{
+#ifdef MSG_NOSIGNAL
+	return ::send(fd, dpos(), nbytes(), MSG_NOSIGNAL);
+#else
+	return io::write(fd, dpos(), nbytes());
+#endif
+}
+
+
+std::string
+Buffer::repr(size_t nbytes)
+{
+	return ::repr(dpos(), nbytes, true, true, 500);
+}
+
+
 BaseClient::BaseClient(const std::shared_ptr<BaseServer>& server_, ev::loop_ref* ev_loop_, unsigned int ev_flags_, int sock_)
 	: Worker(std::move(server_), ev_loop_, ev_flags_),
 	  io_read(*ev_loop),
@@ -458,14 +700,7 @@ BaseClient::write_directly(int fd)
 
 	std::shared_ptr<Buffer> buffer;
 	if (write_queue.front(buffer)) {
-		size_t buf_size = buffer->nbytes();
-		const char *buf_data = buffer->dpos();
-
-#ifdef MSG_NOSIGNAL
-		ssize_t written = ::send(fd, buf_data, buf_size, MSG_NOSIGNAL);
-#else
-		ssize_t written = io::write(fd, buf_data, buf_size);
-#endif
+		ssize_t written = buffer->send(fd);
 
 		if (written < 0) {
 			if (ignored_errorno(errno, true, false)) {
@@ -478,7 +713,7 @@ BaseClient::write_directly(int fd)
 			}
 		}
 
-		L_TCP_WIRE(this, "{fd:%d} <<-- %s (%zu bytes)", fd, repr(buf_data, written, true, true, 500).c_str(), written);
+		L_TCP_WIRE(this, "{fd:%d} <<-- %s (%zu bytes)", fd, buffer->repr(written).c_str(), written);
 		buffer->pos += written;
 		if (buffer->nbytes() == 0) {
 			if (write_queue.pop(buffer)) {
@@ -530,11 +765,104 @@ BaseClient::write(const char *buf, size_t buf_size)
 {
 	L_CALL(this, "BaseClient::write(<buf>, %lu)", buf_size);
 
-	if (!write_queue.push(std::make_shared<Buffer>('\0', buf, buf_size))) {
+	return write_buffer(std::make_shared<Buffer>('\0', buf, buf_size));
+}
+
+
+/*
+ * Sends the pieces with a single vectored write straight from the caller's
+ * memory when nothing else is waiting in the write queue. Only what the
+ * socket didn't take is copied and queued.
+ */
+bool
+BaseClient::writev(const struct iovec *iov, int iovcnt)
+{
+	L_CALL(this, "BaseClient::writev(<iov>, %d)", iovcnt);
+
+	int fd = sock.load();
+	if (fd == -1) {
+		return false;
+	}
+
+	// Other writers must not get ahead of the unsent rest
+	std::unique_lock<std::mutex> queue_lk(_queue_mutex);
+
+	ssize_t sent = 0;
+	{
+		std::lock_guard<std::mutex> lk(_mutex);
+		if (write_queue.empty()) {
+#ifdef MSG_NOSIGNAL
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = const_cast<struct iovec*>(iov);
+			msg.msg_iovlen = iovcnt;
+			sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+#else
+			sent = ::writev(fd, iov, iovcnt);
+#endif
+			if (sent < 0) {
+				if (ignored_errorno(errno, true, false)) {
+					sent = 0;
+				} else {
+					L_ERR(this, "ERROR: write error {fd:%d} - %d: %s", fd, errno, strerror(errno));
+					L_CONN(this, "WR:ERR.3: {fd:%d}", fd);
+				}
+			}
+		}
+	}
+	if (sent < 0) {
+		queue_lk.unlock();
+		close();
+		return false;
+	}
+
+	// Queue the rest, skipping whatever was sent
+	size_t skip = sent;
+	std::vector<struct iovec> pending;
+	for (int i = 0; i < iovcnt; ++i) {
+		if (skip >= iov[i].iov_len) {
+			skip -= iov[i].iov_len;
+		} else {
+			pending.push_back({ static_cast<char*>(iov[i].iov_base) + skip, iov[i].iov_len - skip });
+			skip = 0;
+		}
+	}
+	if (pending.empty()) {
+		written += 1;
+		return true;
+	}
+	// Pushing may wait for the write queue to drain, which needs _mutex
+	if (!write_queue.push(std::make_shared<Buffer>('\0', pending.data(), pending.size()))) {
 		return false;
 	}
+	queue_lk.unlock();
+
+	return _write_queued();
+}
+
+
+bool
+BaseClient::write_buffer(const std::shared_ptr<Buffer>& buffer)
+{
+	L_CALL(this, "BaseClient::write_buffer(<buffer>)");
+
+	{
+		std::lock_guard<std::mutex> queue_lk(_queue_mutex);
+		if (!write_queue.push(buffer)) {
+			return false;
+		}
+	}
 	//L_TCP_WIRE(this, "{fd:%d} <ENQUEUE> '%s'", fd, repr(buf, buf_size).c_str());
 
+	return _write_queued();
+}
+
+
+bool
+BaseClient::_write_queued()
+{
+	L_CALL(this, "BaseClient::_write_queued()");
+
 	int fd = sock.load();
 	if (fd == -1) {
 		return false;
@@ -592,6 +920,12 @@ BaseClient::io_cb_read(int fd)
 			// The peer has closed its half side of the connection.
 			L_CONN(this, "Received %s {fd:%d}!", (received == 0) ? "EOF" : "ECONNRESET", fd);
 			on_read(nullptr, received);
+			if (received == 0 && on_read_eof_pending()) {
+				// Nothing else to read, but the responses can still be written.
+				L_EV(this, "Disable read event (waiting for pending responses)");
+				io_read.stop();
+				return;
+			}
 			destroy();
 			detach();
 			return;
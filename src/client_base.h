@@ -29,6 +29,7 @@
 #include <string.h>      // for size_t, memcpy, strlen
 #include <string>        // for string
 #include <sys/types.h>   // for ssize_t
+#include <sys/uio.h>     // for iovec
 #include <time.h>        // for time_t
 
 #include "endpoint.h"    // for Endpoints
@@ -47,6 +48,7 @@ class LZ4CompressFile;
 //
 
 class Buffer {
+protected:
 	size_t len;
 	char *data;
 
@@ -63,6 +65,24 @@ public:
 		memcpy(data, bytes, len);
 	}
 
+	// Gathers all the pieces in a single buffer (sent with a single write)
+	Buffer(char type_, const struct iovec *iov, int iovcnt)
+		: len(0),
+		  data(nullptr),
+		  pos(0),
+		  type(type_)
+	{
+		for (int i = 0; i < iovcnt; ++i) {
+			len += iov[i].iov_len;
+		}
+		data = new char [len];
+		char *p = data;
+		for (int i = 0; i < iovcnt; ++i) {
+			memcpy(p, iov[i].iov_base, iov[i].iov_len);
+			p += iov[i].iov_len;
+		}
+	}
+
 	virtual ~Buffer() {
 		delete [] data;
 	}
@@ -71,9 +91,15 @@ public:
 		return data + pos;
 	}
 
-	size_t nbytes() {
+	virtual size_t nbytes() {
 		return len - pos;
 	}
+
+	// Sends as much as possible of the pending bytes, returns the number of bytes sent or -1
+	virtual ssize_t send(int fd);
+
+	// Printable representation of the next nbytes pending bytes
+	virtual std::string repr(size_t nbytes);
 };
 
 
@@ -88,12 +114,17 @@ class BaseClient : public Task<>, public Worker {
 	friend LZ4CompressFile;
 
 	WR _write(int fd);
+	bool _write_queued();
 
 	void destroyer();
 	void stop();
 
 	std::mutex _mutex;
 
+	// Held while queueing writes, so each one lands in the write queue (or
+	// on the wire) as a whole and in order.
+	std::mutex _queue_mutex;
+
 protected:
 	BaseClient(const std::shared_ptr<BaseServer>& server_, ev::loop_ref* ev_loop_, unsigned int ev_flags_, int sock_);
 
@@ -106,6 +137,12 @@ public:
 
 	virtual void on_read(const char *buf, ssize_t received) = 0;
 
+	// Whether the client still owes responses after the peer closed its
+	// half of the connection, the client then closes it once they're done.
+	virtual bool on_read_eof_pending() {
+		return false;
+	}
+
 	void close();
 
 	bool write(const char *buf, size_t buf_size);
@@ -118,6 +155,10 @@ public:
 		return write(buf.c_str(), buf.size());
 	}
 
+	bool writev(const struct iovec *iov, int iovcnt);
+
+	bool write_buffer(const std::shared_ptr<Buffer>& buffer);
+
 protected:
 	ev::io io_read;
 	ev::io io_write;
@@ -92,6 +92,11 @@ BinaryClient::~BinaryClient()
 {
 	checkin_database();
 
+	if (!repl_endpoints.empty() && XapiandManager::manager) {
+		// Let the manager trigger any replication merged while this one was going on
+		XapiandManager::manager->replication_done(endpoints[0]);
+	}
+
 	int binary_clients = --XapiandServer::binary_clients;
 	int total_clients = XapiandServer::total_clients;
 	if (binary_clients < 0 || binary_clients > total_clients) {
@@ -110,7 +115,7 @@ BinaryClient::init_remote()
 
 	state = State::INIT;
 
-	XapiandManager::manager->thread_pool.enqueue(share_this<BinaryClient>());
+	XapiandManager::manager->thread_pool.post(share_this<BinaryClient>());
 	return true;
 }
 
@@ -146,7 +151,7 @@ BinaryClient::init_replication(const Endpoint &src_endpoint, const Endpoint &dst
 	}
 	L_CONN(this, "Connected to %s! (in socket %d)", repr(src_endpoint.to_string()).c_str(), sock.load());
 
-	XapiandManager::manager->thread_pool.enqueue(share_this<BinaryClient>());
+	XapiandManager::manager->thread_pool.post(share_this<BinaryClient>());
 	return true;
 }
 
@@ -234,7 +239,7 @@ BinaryClient::on_read(const char *buf, ssize_t received)
 
 	if (!messages_queue.empty()) {
 		if (!running) {
-			XapiandManager::manager->thread_pool.enqueue(share_this<BinaryClient>());
+			XapiandManager::manager->thread_pool.post(share_this<BinaryClient>());
 		}
 	}
 }
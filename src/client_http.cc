@@ -25,6 +25,7 @@
 #include <algorithm>                        // for move
 #include <exception>                        // for exception
 #include <functional>                       // for __base, function
+#include <iterator>                         // for back_inserter
 #include <regex>                            // for regex_iterator, match_res...
 #include <stdexcept>                        // for invalid_argument, range_e...
 #include <stdlib.h>                         // for mkstemp
@@ -40,6 +41,8 @@
 #endif
 
 #include "config.h"                         // for PACKAGE_VERSION, PACKAGE_...
+#include "database_autocommit.h"            // for AutocommitLimits
+#include "database_utils.h"                 // for DB_META_AUTOCOMMIT
 #include "endpoint.h"                       // for Endpoints, Node, Endpoint
 #include "ev/ev++.h"                        // for async, io, loop_ref (ptr ...
 #include "exception.h"                      // for Exception, SerialisationE...
@@ -48,6 +51,7 @@
 #include "log.h"                            // for Log, L_CALL, L_ERR, LOG_D...
 #include "manager.h"                        // for XapiandManager, XapiandMa...
 #include "msgpack.h"                        // for MsgPack, object::object, ...
+#include "msgpack_transcoder.h"             // for MsgPackTranscoder
 #include "multivalue/aggregation.h"         // for AggregationMatchSpy
 #include "multivalue/aggregation_metric.h"  // for AGGREGATION_AGGS
 #include "queue.h"                          // for Queue
@@ -56,6 +60,7 @@
 #include "serialise.h"                      // for boolean
 #include "servers/server.h"                 // for XapiandServer, XapiandSer...
 #include "servers/server_http.h"            // for HttpServer
+#include "split.h"                          // for Split
 #include "stats.h"                          // for Stats
 #include "threadpool.h"                     // for ThreadPool
 #include "utils.h"                          // for delta_string
@@ -68,11 +73,12 @@
 #define MAX_BODY_SIZE (250 * 1024 * 1024)
 #define MAX_BODY_MEM (5 * 1024 * 1024)
 
-#define QUERY_FIELD_COMMIT (1 << 0)
-#define QUERY_FIELD_SEARCH (1 << 1)
-#define QUERY_FIELD_ID     (1 << 2)
-#define QUERY_FIELD_TIME   (1 << 3)
-#define QUERY_FIELD_PERIOD (1 << 4)
+#define QUERY_FIELD_COMMIT  (1 << 0)
+#define QUERY_FIELD_SEARCH  (1 << 1)
+#define QUERY_FIELD_ID      (1 << 2)
+#define QUERY_FIELD_TIME    (1 << 3)
+#define QUERY_FIELD_PERIOD  (1 << 4)
+#define QUERY_FIELD_SUGGEST (1 << 5)
 
 
 type_t content_type_pair(const std::string& ct_type) {
@@ -183,16 +189,23 @@ HttpClient::http_response(enum http_status status, int mode, unsigned short http
 
 HttpClient::HttpClient(std::shared_ptr<HttpServer> server_, ev::loop_ref* ev_loop_, unsigned int ev_flags_, int sock_)
 	: BaseClient(std::move(server_), ev_loop_, ev_flags_, sock_),
+	  processing(false),
+	  peer_closed(false),
+	  pipelined_requests(0),
 	  pretty(false),
 	  response_size(0),
 	  response_logged(false),
 	  body_size(0),
+	  body_decoding(false),
 	  body_descriptor(0),
 	  request_begining(true)
 {
 	parser.data = this;
 	http_parser_init(&parser, HTTP_REQUEST);
 
+	pipeline_parser.data = this;
+	http_parser_init(&pipeline_parser, HTTP_REQUEST);
+
 	int http_clients = ++XapiandServer::http_clients;
 	if (http_clients > XapiandServer::max_http_clients) {
 		XapiandServer::max_http_clients = http_clients;
@@ -255,6 +268,17 @@ HttpClient::on_read(const char* buf, ssize_t received)
 	unsigned init_state = parser.state;
 
 	if (received <= 0) {
+		std::unique_lock<std::mutex> lk(pipeline_mtx);
+		if (processing) {
+			// The request being processed (in the worker) owns the parser,
+			// pipeline_next() closes the connection once it's answered
+			if (received == 0) {
+				L_HTTP(this, "Client closed the other end while processing a request");
+				peer_closed = true;
+			}
+			return;
+		}
+		lk.unlock();
 		response_log.load()->clear();
 		if (received < 0 || init_state != 18 || !write_queue.empty()) {
 			L_WARNING(this, "Client unexpectedly closed the other end! [%d]", init_state);
@@ -265,6 +289,30 @@ HttpClient::on_read(const char* buf, ssize_t received)
 		return;
 	}
 
+	std::lock_guard<std::mutex> lk(pipeline_mtx);
+	if (processing) {
+		// Still processing a previous request, keep it for later
+		pipeline(buf, received);
+	} else {
+		process(buf, received);
+	}
+
+	if (processing && (pipelined_requests >= HTTP_PIPELINE_MAX_REQUESTS || pipeline_buffer.size() >= HTTP_PIPELINE_MAX_SIZE)) {
+		L_EV(this, "Disable read event (pipeline is full)");
+		io_read.stop();
+	}
+}
+
+
+void
+HttpClient::process(const char* buf, size_t received)
+{
+	L_CALL(this, "HttpClient::process(<buf>, %zu)", received);
+
+	// Must hold pipeline_mtx
+
+	unsigned init_state = parser.state;
+
 	if (request_begining) {
 		idle = false;
 		request_begining = false;
@@ -274,23 +322,26 @@ HttpClient::on_read(const char* buf, ssize_t received)
 		response_logged = false;
 	}
 
-	L_HTTP_WIRE(this, "HttpClient::on_read: %zd bytes", received);
-	ssize_t parsed = http_parser_execute(&parser, &settings, buf, received);
-	if (parsed == received) {
+	L_HTTP_WIRE(this, "HttpClient::process: %zu bytes", received);
+	size_t parsed = http_parser_execute(&parser, &settings, buf, received);
+	if (HTTP_PARSER_ERRNO(&parser) == HPE_PAUSED) {
+		// Message complete (the parser pauses there), whatever follows are pipelined requests
+		http_parser_pause(&parser, 0);
+		processing = true;
+		pipelined_requests = 0;
+		pipeline_buffer.clear();
+		http_parser_init(&pipeline_parser, HTTP_REQUEST);
+		pipeline(buf + parsed, received - parsed);
+		written = 0;
+		if (!closed) {
+			XapiandManager::manager->thread_pool.post(share_this<HttpClient>());
+		}
+	} else if (parsed == received) {
 		unsigned final_state = parser.state;
 		if (final_state == init_state) {
 			if (received == 1 and buf[0] == '\n') {  // ignore '\n' request
 				request_begining = true;
 				set_idle();
-				return;
-			}
-		}
-		if (final_state == 1 || final_state == 18) {  // dead or message_complete
-			L_EV(this, "Disable read event");
-			io_read.stop();
-			written = 0;
-			if (!closed) {
-				XapiandManager::manager->thread_pool.enqueue(share_this<HttpClient>());
 			}
 		}
 	} else {
@@ -314,6 +365,59 @@ HttpClient::on_read(const char* buf, ssize_t received)
 }
 
 
+void
+HttpClient::pipeline(const char* buf, size_t received)
+{
+	L_CALL(this, "HttpClient::pipeline(<buf>, %zu)", received);
+
+	// Must hold pipeline_mtx
+
+	if (received) {
+		pipeline_buffer.append(buf, received);
+		http_parser_execute(&pipeline_parser, &pipeline_settings, buf, received);
+	}
+}
+
+
+void
+HttpClient::pipeline_next()
+{
+	L_CALL(this, "HttpClient::pipeline_next()");
+
+	std::lock_guard<std::mutex> lk(pipeline_mtx);
+	processing = false;
+
+	if (!pipeline_buffer.empty()) {
+		std::string buffer;
+		std::swap(buffer, pipeline_buffer);
+		L_HTTP(this, "Processing pipelined requests (%zu pending)", pipelined_requests);
+		process(buffer.data(), buffer.size());
+	}
+
+	if (peer_closed) {
+		if (!processing) {
+			// Everything was answered, close once the responses are written
+			L_CONN(this, "Closing the connection the client closed");
+			closed = true;
+			update_async.send();
+		}
+	} else {
+		// Reading could have been disabled while the pipeline was full
+		read_start_async.send();
+	}
+}
+
+
+bool
+HttpClient::on_read_eof_pending()
+{
+	L_CALL(this, "HttpClient::on_read_eof_pending()");
+
+	std::lock_guard<std::mutex> lk(pipeline_mtx);
+	return peer_closed;
+}
+
+
 void
 HttpClient::on_read_file(const char*, ssize_t received)
 {
@@ -347,6 +451,20 @@ const http_parser_settings HttpClient::settings = {
 };
 
 
+const http_parser_settings HttpClient::pipeline_settings = {
+	.on_message_begin = nullptr,
+	.on_url = nullptr,
+	.on_status = nullptr,
+	.on_header_field = nullptr,
+	.on_header_value = nullptr,
+	.on_headers_complete = nullptr,
+	.on_body = nullptr,
+	.on_message_complete = HttpClient::on_pipelined,
+	.on_chunk_header = nullptr,
+	.on_chunk_complete = nullptr
+};
+
+
 int
 HttpClient::on_info(http_parser* p)
 {
@@ -360,11 +478,15 @@ HttpClient::on_info(http_parser* p)
 
 	switch (state) {
 		case 18:  // message_complete
+			// Pause, so data following the message (pipelined requests) isn't parsed until it's done
+			http_parser_pause(p, 1);
 			break;
 		case 19:  // message_begin
 			self->path.clear();
 			self->body.clear();
 			self->body_size = 0;
+			self->body_decoding = false;
+			self->body_decoder.reset();
 			self->header_name.clear();
 			self->header_value.clear();
 			if (self->body_descriptor && io::close(self->body_descriptor) < 0) {
@@ -387,6 +509,19 @@ HttpClient::on_info(http_parser* p)
 }
 
 
+int
+HttpClient::on_pipelined(http_parser* p)
+{
+	HttpClient *self = static_cast<HttpClient *>(p->data);
+
+	L_CALL(self, "HttpClient::on_pipelined(...)");
+
+	++self->pipelined_requests;
+
+	return 0;
+}
+
+
 int
 HttpClient::on_data(http_parser* p, const char* at, size_t length)
 {
@@ -506,11 +641,17 @@ HttpClient::on_data(http_parser* p, const char* at, size_t length)
 			self->header_value.clear();
 		}
 	} else if (state >= 59 && state <= 62) { // s_chunk_data_done, s_body_identity  ->  s_message_done
+		if (!self->body_size) {
+			// JSON bodies are decoded as they arrive, so the text isn't kept
+			self->body_decoding = self->content_type.empty() || self->content_type == JSON_CONTENT_TYPE;
+		}
 		self->body_size += length;
 		if (self->body_size > MAX_BODY_SIZE || p->content_length > MAX_BODY_SIZE) {
 			self->write(self->http_response(HTTP_STATUS_PAYLOAD_TOO_LARGE, HTTP_STATUS_RESPONSE, p->http_major, p->http_minor));
 			self->close();
 			return 0;
+		} else if (self->body_decoding) {
+			self->body_decoder.feed(at, length);
 		} else if (self->body_descriptor || self->body_size > MAX_BODY_MEM) {
 
 			// The next two lines are switching off the write body in to a file option when the body is too large
@@ -657,7 +798,7 @@ HttpClient::run()
 	}
 
 	clean_http_request();
-	read_start_async.send();
+	pipeline_next();
 
 	L_OBJ_END(this, "HttpClient::run:END");
 }
@@ -709,6 +850,10 @@ HttpClient::_get(enum http_method method)
 			path_parser.off_id = nullptr;  // Command has no ID
 			search_view(method, cmd);
 			break;
+		case Command::CMD_SUGGEST:
+			path_parser.off_id = nullptr;  // Command has no ID
+			suggest_view(method, cmd);
+			break;
 		case Command::CMD_META:
 			path_parser.off_id = nullptr;  // Command has no ID
 			meta_view(method, cmd);
@@ -873,8 +1018,12 @@ HttpClient::get_body()
 			}
 			break;
 		case xxh64::hash(JSON_CONTENT_TYPE):
-			json_load(rdoc, body);
-			msgpack = MsgPack(rdoc);
+			if (body_decoding) {
+				msgpack = body_decoder.decode();
+			} else {
+				json_load(rdoc, body);
+				msgpack = MsgPack(rdoc);
+			}
 			break;
 		case xxh64::hash(MSGPACK_CONTENT_TYPE):
 		case xxh64::hash(X_MSGPACK_CONTENT_TYPE):
@@ -1109,13 +1258,28 @@ HttpClient::meta_view(enum http_method method, Command)
 
 
 void
-HttpClient::write_meta_view(enum http_method, Command)
+HttpClient::write_meta_view(enum http_method method, Command)
 {
 	L_CALL(this, "HttpClient::write_meta_view()");
 
 	enum http_status status_code = HTTP_STATUS_BAD_REQUEST;
 
+	endpoints_maker(2s);
+
 	MsgPack response;
+	auto key = path_parser.get_pmt();
+	if (!key.empty()) {
+		// Only the autocommit limits are writable through _meta, other keys are internal
+		if (key != DB_META_AUTOCOMMIT) {
+			THROW(ClientError, "Metadata key %s is not writable", repr(key).c_str());
+		}
+		auto body_ = get_body();
+		AutocommitLimits::validate(body_.second);
+		db_handler.reset(endpoints, DB_WRITABLE | DB_SPAWN, method);
+		db_handler.set_metadata(key, body_.second.serialise());
+		status_code = HTTP_STATUS_OK;
+		response = body_.second;
+	}
 
 	write_http_response(status_code, response);
 }
@@ -1253,6 +1417,31 @@ HttpClient::schema_view(enum http_method method, Command)
 }
 
 
+void
+HttpClient::suggest_view(enum http_method method, Command)
+{
+	L_CALL(this, "HttpClient::suggest_view()");
+
+	endpoints_maker(1s);
+	query_field_maker(QUERY_FIELD_SUGGEST);
+
+	if (query_field->field.empty()) {
+		write_status_response(HTTP_STATUS_BAD_REQUEST, "Expecting a field to suggest completions for");
+		return;
+	}
+
+	operation_begins = std::chrono::system_clock::now();
+
+	db_handler.reset(endpoints, DB_OPEN, method);
+	MsgPack response;
+	response["_suggest"] = db_handler.get_suggestions(query_field->field, query_field->prefix, query_field->limit);
+
+	operation_ends = std::chrono::system_clock::now();
+
+	write_http_response(HTTP_STATUS_OK, response);
+}
+
+
 void
 HttpClient::search_view(enum http_method method, Command)
 {
@@ -1304,10 +1493,25 @@ HttpClient::search_view(enum http_method method, Command)
 		}
 
 		db_handler.reset(endpoints, db_flags, method);
-		if (body.empty()) {
+		if (!body_size) {
 			mset = db_handler.get_mset(*query_field, nullptr, nullptr, suggestions);
 		} else {
 			auto body_ = get_body();
+			for (const auto& key : { "_fields", "_source" }) {
+				auto it = body_.second.is_map() ? body_.second.find(std::string(key)) : body_.second.end();
+				if (it != body_.second.end()) {
+					const auto& selectors = it.value();
+					if (selectors.is_string()) {
+						query_field->fields.push_back(selectors.as_string());
+					} else if (selectors.is_array()) {
+						for (const auto& selector : selectors) {
+							query_field->fields.push_back(selector.as_string());
+						}
+					} else {
+						THROW(ClientError, "%s must be a string or an array of strings", key);
+					}
+				}
+			}
 			AggregationMatchSpy aggs(body_.second, db_handler.get_schema());
 			mset = db_handler.get_mset(*query_field, &body_.second, &aggs, suggestions);
 			aggregations = aggs.get_aggregation().at(AGGREGATION_AGGS);
@@ -1363,8 +1567,13 @@ HttpClient::search_view(enum http_method method, Command)
 			MsgPack basic_query({
 				{"_total_count", total_count},
 				{"_matches_estimated", mset.get_matches_estimated()},
-				{ "_hits", MsgPack(MsgPack::Type::ARRAY) },
 			});
+			// With cursors, _matches_estimated counts the matches remaining after the cursor
+			if (query_field->is_cursor && total_count) {
+				// Opaque token to get the next page
+				basic_query["_cursor"] = DatabaseHandler::get_cursor(mset);
+			}
+			basic_query["_hits"] = MsgPack(MsgPack::Type::ARRAY);
 			MsgPack basic_response;
 			if (aggregations) {
 				basic_response["_aggregations"] = aggregations;
@@ -1411,78 +1620,108 @@ HttpClient::search_view(enum http_method method, Command)
 			}
 		}
 
+		std::unique_ptr<MsgPackTranscoder::Projection> projection;
+		std::vector<slot_field_t> slot_fields;
+		if (!query_field->fields.empty()) {
+			projection = std::make_unique<MsgPackTranscoder::Projection>(query_field->fields);
+			if (chunked && !projection->has_wildcards()) {
+				slot_fields = db_handler.get_slot_fields(projection->get_paths());
+			}
+		}
+
 		std::string buffer;
 		const auto m_e = mset.end();
 		for (auto m = mset.begin(); m != m_e; ++rc, ++m) {
 			auto document = db_handler.get_document(*m);
 
-			const auto data = document.get_data();
-			if (data.empty()) {
-				continue;
+			MsgPack obj_data;
+			std::string serialised;
+			if (!slot_fields.empty()) {
+				// All selected fields could be in value slots, try not to read the data
+				serialised = document.get_slot_object(slot_fields);
 			}
 
-			MsgPack obj_data;
-			if (chunked) {
-				obj_data = MsgPack::unserialise(::split_data_obj(data));
-			} else {
-				std::string blob;
-				std::string ct_type_str;
-				auto store = ::split_data_store(data);
-				if (!store.first) {
-					blob = document.get_blob();
-					ct_type_str = unserialise_string_at(1, blob);
-				}
-				if (ct_type_str.empty()) {
-					const auto ct_type_mp = Document::get_field(CT_FIELD_NAME, obj_data);
-					ct_type_str = ct_type_mp ? ct_type_mp.as_string() : MSGPACK_CONTENT_TYPE;
-				}
-				ct_type = resolve_ct_type(ct_type_str);
-				if (ct_type.first == no_type.first && ct_type.second == no_type.second) {
-					enum http_status error_code = HTTP_STATUS_NOT_ACCEPTABLE;
-					MsgPack err_response = {
-						{ RESPONSE_STATUS, (int)error_code },
-						{ RESPONSE_MESSAGE, std::string("Response type " + ct_type_str + " not provided in the Accept header") }
-					};
-					write_http_response(error_code, err_response);
-					L_SEARCH(this, "ABORTED SEARCH");
-					return;
+			if (serialised.empty()) {
+				const auto data = document.get_data();
+				if (data.empty()) {
+					continue;
 				}
 
-				if (is_acceptable_type(ct_type, msgpack_serializers)) {
-					obj_data = MsgPack::unserialise(::split_data_obj(data));
-				} else {
-					// Returns blob_data in case that type is unkown
-					if (blob.empty()) {
+				if (!chunked) {
+					std::string blob;
+					std::string ct_type_str;
+					auto store = ::split_data_store(data);
+					if (!store.first) {
 						blob = document.get_blob();
+						ct_type_str = unserialise_string_at(1, blob);
 					}
-					auto blob_data = unserialise_string_at(2, blob);
-					if (type_encoding != Encoding::none) {
-						auto encoded = encoding_http_response(type_encoding, blob_data, false, true, true);
-						if (!encoded.empty() && encoded.size() <= blob_data.size()) {
-							write(http_response(HTTP_STATUS_OK, HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_CONTENT_ENCODING_RESPONSE | HTTP_BODY_RESPONSE, parser.http_major, parser.http_minor, 0, 0, encoded, ct_type.first + "/" + ct_type.second, readable_encoding(type_encoding)));
+					if (ct_type_str.empty()) {
+						const auto ct_type_mp = Document::get_field(CT_FIELD_NAME, obj_data);
+						ct_type_str = ct_type_mp ? ct_type_mp.as_string() : MSGPACK_CONTENT_TYPE;
+					}
+					ct_type = resolve_ct_type(ct_type_str);
+					if (ct_type.first == no_type.first && ct_type.second == no_type.second) {
+						enum http_status error_code = HTTP_STATUS_NOT_ACCEPTABLE;
+						MsgPack err_response = {
+							{ RESPONSE_STATUS, (int)error_code },
+							{ RESPONSE_MESSAGE, std::string("Response type " + ct_type_str + " not provided in the Accept header") }
+						};
+						write_http_response(error_code, err_response);
+						L_SEARCH(this, "ABORTED SEARCH");
+						return;
+					}
+
+					if (!is_acceptable_type(ct_type, msgpack_serializers)) {
+						// Returns blob_data in case that type is unkown
+						if (blob.empty()) {
+							blob = document.get_blob();
+						}
+						auto blob_data = unserialise_string_at(2, blob);
+						if (type_encoding != Encoding::none) {
+							auto encoded = encoding_http_response(type_encoding, blob_data, false, true, true);
+							if (!encoded.empty() && encoded.size() <= blob_data.size()) {
+								write(http_response(HTTP_STATUS_OK, HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_CONTENT_ENCODING_RESPONSE | HTTP_BODY_RESPONSE, parser.http_major, parser.http_minor, 0, 0, encoded, ct_type.first + "/" + ct_type.second, readable_encoding(type_encoding)));
+							} else {
+								write(http_response(HTTP_STATUS_OK, HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_CONTENT_ENCODING_RESPONSE | HTTP_BODY_RESPONSE, parser.http_major, parser.http_minor, 0, 0, blob_data, ct_type.first + "/" + ct_type.second, readable_encoding(Encoding::identity)));
+							}
 						} else {
-							write(http_response(HTTP_STATUS_OK, HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_CONTENT_ENCODING_RESPONSE | HTTP_BODY_RESPONSE, parser.http_major, parser.http_minor, 0, 0, blob_data, ct_type.first + "/" + ct_type.second, readable_encoding(Encoding::identity)));
+							write(http_response(HTTP_STATUS_OK, HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_BODY_RESPONSE, parser.http_major, parser.http_minor, 0, 0, blob_data, ct_type.first + "/" + ct_type.second));
 						}
-					} else {
-						write(http_response(HTTP_STATUS_OK, HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_BODY_RESPONSE, parser.http_major, parser.http_minor, 0, 0, blob_data, ct_type.first + "/" + ct_type.second));
+						return;
 					}
-					return;
 				}
-			}
 
-			if (obj_data.find(ID_FIELD_NAME) == obj_data.end()) {
-				obj_data[ID_FIELD_NAME] = document.get_value(ID_FIELD_NAME);
+				serialised = ::split_data_obj(data);
 			}
 
-			// Detailed info about the document:
-			obj_data[RESERVED_RANK] = m.get_rank();
-			obj_data[RESERVED_WEIGHT] = m.get_weight();
-			obj_data[RESERVED_PERCENT] = m.get_percent();
-			// int subdatabase = (document.get_docid() - 1) % endpoints.size();
-			// auto endpoint = endpoints[subdatabase];
-			// obj_data[RESERVED_ENDPOINT] = endpoint.to_string();
+			std::vector<MsgPackTranscoder::Field> fields = {
+				{ ID_FIELD_NAME, document.get_value(ID_FIELD_NAME), false },
+				// Detailed info about the document:
+				{ RESERVED_RANK, m.get_rank() },
+				{ RESERVED_WEIGHT, m.get_weight() },
+				{ RESERVED_PERCENT, m.get_percent() },
+				// int subdatabase = (document.get_docid() - 1) % endpoints.size();
+				// auto endpoint = endpoints[subdatabase];
+				// { RESERVED_ENDPOINT, endpoint.to_string() },
+			};
 
-			auto result = serialize_response(obj_data, ct_type, pretty);
+			std::pair<std::string, std::string> result;
+			if (is_acceptable_type(ct_type, json_type)) {
+				// Transcode the stored data straight to JSON (no MsgPack is built)
+				result = std::make_pair(MsgPackTranscoder(serialised, fields, projection.get()).to_json(pretty), json_type.first + "/" + json_type.second + "; charset=utf-8");
+			} else if (is_acceptable_type(ct_type, msgpack_type)) {
+				result = std::make_pair(MsgPackTranscoder(serialised, fields, projection.get()).to_msgpack(), msgpack_type.first + "/" + msgpack_type.second + "; charset=utf-8");
+			} else if (is_acceptable_type(ct_type, x_msgpack_type)) {
+				result = std::make_pair(MsgPackTranscoder(serialised, fields, projection.get()).to_msgpack(), x_msgpack_type.first + "/" + x_msgpack_type.second + "; charset=utf-8");
+			} else {
+				obj_data = MsgPack::unserialise(projection ? MsgPackTranscoder(serialised, { }, projection.get()).to_msgpack() : serialised);
+				for (const auto& field : fields) {
+					if (field.overwrite || obj_data.find(field.name) == obj_data.end()) {
+						obj_data[field.name] = MsgPack::unserialise(field.value);
+					}
+				}
+				result = serialize_response(obj_data, ct_type, pretty);
+			}
 			if (chunked) {
 				if (rc == 0) {
 					if (type_encoding != Encoding::none) {
@@ -1802,6 +2041,17 @@ HttpClient::query_field_maker(int flag)
 		}
 		query_parser.rewind();
 
+		// Field projection, comma separated dotted paths (with wildcards)
+		while (query_parser.next("fields") != -1) {
+			Split<char>::split(query_parser.get(), ',', std::back_inserter(query_field->fields));
+		}
+		query_parser.rewind();
+
+		while (query_parser.next("source") != -1) {
+			Split<char>::split(query_parser.get(), ',', std::back_inserter(query_field->fields));
+		}
+		query_parser.rewind();
+
 		if (query_parser.next("offset") != -1) {
 			try {
 				query_field->offset = static_cast<unsigned>(std::stoul(query_parser.get()));
@@ -1872,6 +2122,13 @@ HttpClient::query_field_maker(int flag)
 		}
 		query_parser.rewind();
 
+		// Cursor (search_after) pagination, an empty cursor starts it
+		if (query_parser.next("cursor") != -1) {
+			query_field->is_cursor = true;
+			query_field->cursor = query_parser.get();
+		}
+		query_parser.rewind();
+
 		if (query_parser.next("collapse_max") != -1) {
 			try {
 				query_field->collapse_max = static_cast<unsigned>(std::stoul(query_parser.get()));
@@ -1989,6 +2246,30 @@ HttpClient::query_field_maker(int flag)
 		}
 		query_parser.rewind();
 	}
+
+	if (flag & QUERY_FIELD_SUGGEST) {
+		if (query_parser.next("field") != -1) {
+			query_field->field = query_parser.get();
+		}
+		query_parser.rewind();
+
+		if (query_parser.next("q") != -1) {
+			query_field->prefix = query_parser.get();
+		}
+		query_parser.rewind();
+
+		if (query_parser.next("prefix") != -1) {
+			query_field->prefix = query_parser.get();
+		}
+		query_parser.rewind();
+
+		if (query_parser.next("limit") != -1) {
+			try {
+				query_field->limit = static_cast<unsigned>(std::stoul(query_parser.get()));
+			} catch (const std::invalid_argument&) { }
+		}
+		query_parser.rewind();
+	}
 }
 
 
@@ -2023,6 +2304,8 @@ HttpClient::clean_http_request()
 
 	path.clear();
 	body.clear();
+	body_decoding = false;
+	body_decoder.reset();
 	header_name.clear();
 	header_value.clear();
 	content_type.clear();
@@ -43,6 +43,7 @@
 #include "database_utils.h"     // for query_field_t (ptr only)
 #include "deflate_compressor.h" // for DeflateCompressData
 #include "http_parser.h"        // for http_parser, http_parser_settings
+#include "json_decoder.h"       // for JsonDecoder
 #include "lru.h"                // for LRU
 #include "msgpack.h"            // for MsgPack
 #include "url_parser.h"         // for PathParser, QueryParser
@@ -67,6 +68,9 @@ class Worker;
 #define HTTP_MATCHES_ESTIMATED_RESPONSE (1 << 9)
 #define HTTP_EXPECTED_CONTINUE_RESPONSE (1 << 10)
 
+#define HTTP_PIPELINE_MAX_REQUESTS      16           // Maximum number of requests pipelined (in flight) per connection
+#define HTTP_PIPELINE_MAX_SIZE          (1024 * 1024)  // Maximum size of the pipelined requests per connection
+
 
 using type_t = std::pair<std::string, std::string>;
 
@@ -144,13 +148,33 @@ class HttpClient : public BaseClient {
 		CMD_SCHEMA    = xxh64::hash("_schema"),
 		CMD_NODES     = xxh64::hash("_nodes"),
 		CMD_TOUCH     = xxh64::hash("_touch"),
+		CMD_SUGGEST   = xxh64::hash("_suggest"),
 		CMD_QUIT      = xxh64::hash("_quit"),
 	};
 
 	struct http_parser parser;
 	DatabaseHandler db_handler;
 
+	// Requests pipelined while processing the current one, they are parsed
+	// (and processed) back to back once it's done, so responses are written
+	// in request order. pipeline_parser only counts the requests buffered.
+	// When the peer closes its half while processing, the connection is
+	// closed once the pipelined requests have been answered.
+	std::mutex pipeline_mtx;
+	bool processing;
+	bool peer_closed;
+	std::string pipeline_buffer;
+	struct http_parser pipeline_parser;
+	size_t pipelined_requests;
+
+	static const http_parser_settings pipeline_settings;
+
+	void process(const char* buf, size_t received);
+	void pipeline(const char* buf, size_t received);
+	void pipeline_next();
+
 	void on_read(const char* buf, ssize_t received) override;
+	bool on_read_eof_pending() override;
 	void on_read_file(const char* buf, ssize_t received) override;
 	void on_read_file_done() override;
 
@@ -180,6 +204,8 @@ class HttpClient : public BaseClient {
 	std::string header_value;
 
 	size_t body_size;
+	bool body_decoding;
+	JsonDecoder body_decoder;
 	int body_descriptor;
 	char body_path[PATH_MAX];
 	std::vector<std::string> index_paths;
@@ -202,6 +228,7 @@ class HttpClient : public BaseClient {
 
 	static int on_info(http_parser* p);
 	static int on_data(http_parser* p, const char* at, size_t length);
+	static int on_pipelined(http_parser* p);
 
 	std::pair<std::string, MsgPack> get_body();
 
@@ -216,6 +243,7 @@ class HttpClient : public BaseClient {
 	void document_info_view(enum http_method method, Command cmd);
 	void update_document_view(enum http_method method, Command cmd);
 	void search_view(enum http_method method, Command cmd);
+	void suggest_view(enum http_method method, Command cmd);
 	void touch_view(enum http_method method, Command cmd);
 	void schema_view(enum http_method method, Command cmd);
 	void nodes_view(enum http_method method, Command cmd);
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <atomic>         // for atomic_bool, atomic_size_t
+#include <cstddef>        // for size_t
+#include <functional>     // for hash
+#include <list>           // for list
+#include <memory>         // for unique_ptr, make_unique
+#include <mutex>          // for unique_lock
+#include <shared_mutex>   // for shared_timed_mutex, shared_lock
+#include <sys/types.h>    // for ssize_t
+#include <unordered_map>  // for unordered_map
+#include <utility>        // for forward, make_pair
+#include <vector>         // for vector
+
+#include "lru.h"          // for DropAction, GetAction, InsertAction
+
+
+#define CONCURRENT_LRU_SHARDS 16
+
+
+namespace lru {
+
+
+// Default weight, every entry counts as one (capacity in number of entries).
+template<typename Key, typename T>
+struct EntryWeight {
+	size_t operator()(const Key&, const T&) const noexcept {
+		return 1;
+	}
+};
+
+
+/*
+ * Concurrent cache, striped in shards by key hash. Each shard keeps its
+ * entries in a CLOCK ring: hits only take the shard lock in shared mode and
+ * set the entry's reference bit; the clock hand clears those bits (second
+ * chance) while looking for entries to evict, under the exclusive lock.
+ *
+ * Values are returned by copy (entries can be evicted as soon as the shard
+ * lock is released), so T is usually a std::shared_ptr.
+ *
+ * Capacity (max_size) is measured using Weight, by default one per entry.
+ */
+template<typename Key, typename T, typename Hash=std::hash<Key>, typename Weight=EntryWeight<Key, T>>
+class ConcurrentLRU {
+	struct Entry {
+		const Key key;
+		T value;
+		size_t weight;
+		std::atomic_bool referenced;
+
+		template<typename K, typename V>
+		Entry(K&& key_, V&& value_, size_t weight_)
+			: key(std::forward<K>(key_)),
+			  value(std::forward<V>(value_)),
+			  weight(weight_),
+			  referenced(false) { }
+	};
+
+	using list_t = std::list<Entry>;
+	using map_t = std::unordered_map<Key, typename list_t::iterator, Hash>;
+
+	struct Shard {
+		std::shared_timed_mutex mtx;
+
+		list_t ring;
+		map_t map;
+		typename list_t::iterator hand;
+
+		size_t weight;
+		ssize_t max_weight;
+
+		std::atomic_size_t hits;
+		std::atomic_size_t misses;
+		std::atomic_size_t evictions;
+
+		Shard(ssize_t max_weight_)
+			: hand(ring.end()),
+			  weight(0),
+			  max_weight(max_weight_),
+			  hits(0),
+			  misses(0),
+			  evictions(0) { }
+	};
+
+	std::vector<std::unique_ptr<Shard>> _shards;
+	ssize_t _max_size;
+	Hash _hash;
+	Weight _weight;
+
+	Shard& _shard(const Key& key) {
+		return *_shards[_hash(key) % _shards.size()];
+	}
+
+	// Must hold the shard lock (shared at least)
+	bool _find(Shard& shard, const Key& key, T& value, GetAction action) {
+		auto it = shard.map.find(key);
+		if (it == shard.map.end()) {
+			return false;
+		}
+		auto& entry = *it->second;
+		if (action == GetAction::renew && !entry.referenced.load(std::memory_order_relaxed)) {
+			entry.referenced.store(true, std::memory_order_relaxed);
+		}
+		value = entry.value;
+		return true;
+	}
+
+	// Must hold the shard lock exclusively
+	void _erase(Shard& shard, typename map_t::iterator it) {
+		auto entry = it->second;
+		if (shard.hand == entry) {
+			++shard.hand;
+		}
+		shard.weight -= entry->weight;
+		shard.map.erase(it);
+		shard.ring.erase(entry);
+	}
+
+	// Must hold the shard lock exclusively
+	template<typename OnDrop>
+	void _trim(Shard& shard, const OnDrop& on_drop, typename list_t::iterator skip) {
+		if (shard.max_weight == -1) {
+			return;
+		}
+		// Two full turns of the clock hand at most, so it ends even if nothing can be dropped
+		for (size_t steps = 2 * shard.ring.size(); steps != 0 && static_cast<ssize_t>(shard.weight) > shard.max_weight; --steps) {
+			if (shard.hand == shard.ring.end()) {
+				shard.hand = shard.ring.begin();
+			}
+			auto it = shard.hand++;
+			if (it == skip) {
+				continue;
+			}
+			if (it->referenced.exchange(false, std::memory_order_relaxed)) {
+				continue;
+			}
+			switch (on_drop(it->value).second) {
+				case DropAction::renew:
+					it->referenced.store(true, std::memory_order_relaxed);
+					break;
+				case DropAction::leave:
+					break;
+				case DropAction::drop:
+					shard.weight -= it->weight;
+					shard.map.erase(it->key);
+					shard.ring.erase(it);
+					++shard.evictions;
+					break;
+			}
+		}
+	}
+
+	// Must hold the shard lock exclusively
+	template<typename OnDrop, typename K, typename V>
+	T& _insert(Shard& shard, const OnDrop& on_drop, K&& key, V&& value) {
+		auto mit = shard.map.find(key);
+		if (mit != shard.map.end()) {
+			_erase(shard, mit);
+		}
+
+		auto action = on_drop(value).first;
+		auto weight = _weight(key, value);
+		auto it = shard.ring.emplace(shard.hand, std::forward<K>(key), std::forward<V>(value), weight);
+		switch (action) {
+			case InsertAction::front:
+				// Right behind the clock hand, the last one it will visit
+				break;
+			case InsertAction::last:
+				// Right at the clock hand, the first one it will visit
+				shard.hand = it;
+				break;
+		}
+		shard.map.emplace(it->key, it);
+		shard.weight += weight;
+
+		_trim(shard, on_drop, it);
+
+		return it->value;
+	}
+
+	static auto _drop(const T&) {
+		return std::make_pair(InsertAction::front, DropAction::drop);
+	}
+
+public:
+	struct Stats {
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+	};
+
+	ConcurrentLRU(ssize_t max_size=-1, size_t num_shards=CONCURRENT_LRU_SHARDS, const Weight& weight=Weight())
+		: _max_size(max_size),
+		  _weight(weight)
+	{
+		if (num_shards == 0) {
+			num_shards = 1;
+		}
+		// Each shard gets its share of the total capacity, rounded up
+		auto max_weight = max_size == -1 ? -1 : static_cast<ssize_t>((max_size + num_shards - 1) / num_shards);
+		_shards.reserve(num_shards);
+		for (size_t i = 0; i < num_shards; ++i) {
+			_shards.push_back(std::make_unique<Shard>(max_weight));
+		}
+	}
+
+	ConcurrentLRU(const ConcurrentLRU&) = delete;
+	ConcurrentLRU& operator=(const ConcurrentLRU&) = delete;
+
+	virtual ~ConcurrentLRU() = default;
+
+	bool find(const Key& key, T& value, GetAction action=GetAction::renew) {
+		auto& shard = _shard(key);
+		std::shared_lock<std::shared_timed_mutex> lk(shard.mtx);
+		if (_find(shard, key, value, action)) {
+			++shard.hits;
+			return true;
+		}
+		++shard.misses;
+		return false;
+	}
+
+	bool exists(const Key& key) {
+		auto& shard = _shard(key);
+		std::shared_lock<std::shared_timed_mutex> lk(shard.mtx);
+		return shard.map.find(key) != shard.map.end();
+	}
+
+	size_t erase(const Key& key) {
+		auto& shard = _shard(key);
+		std::unique_lock<std::shared_timed_mutex> lk(shard.mtx);
+		auto it = shard.map.find(key);
+		if (it != shard.map.end()) {
+			_erase(shard, it);
+			return 1;
+		}
+		return 0;
+	}
+
+	template<typename OnDrop, typename K, typename V>
+	T insert_and(const OnDrop& on_drop, K&& key, V&& value) {
+		auto& shard = _shard(key);
+		std::unique_lock<std::shared_timed_mutex> lk(shard.mtx);
+		return _insert(shard, on_drop, std::forward<K>(key), std::forward<V>(value));
+	}
+
+	template<typename K, typename V>
+	T insert(K&& key, V&& value) {
+		return insert_and(_drop, std::forward<K>(key), std::forward<V>(value));
+	}
+
+	/*
+	 * Gets the value for key, a hit only takes the shard lock in shared mode.
+	 * On a miss, a new value is created using make() and inserted.
+	 */
+	template<typename OnDrop, typename F>
+	T get_and(const OnDrop& on_drop, const Key& key, F&& make) {
+		auto& shard = _shard(key);
+		T value;
+		{
+			std::shared_lock<std::shared_timed_mutex> lk(shard.mtx);
+			if (_find(shard, key, value, GetAction::renew)) {
+				++shard.hits;
+				return value;
+			}
+		}
+		++shard.misses;
+		std::unique_lock<std::shared_timed_mutex> lk(shard.mtx);
+		// Somebody else could have inserted it in the meantime
+		if (_find(shard, key, value, GetAction::renew)) {
+			return value;
+		}
+		return _insert(shard, on_drop, key, make());
+	}
+
+	template<typename F>
+	T get(const Key& key, F&& make) {
+		return get_and(_drop, key, std::forward<F>(make));
+	}
+
+	T get(const Key& key) {
+		return get_and(_drop, key, []() { return T(); });
+	}
+
+	template<typename F>
+	void for_each(F&& f) {
+		for (auto& shard : _shards) {
+			std::shared_lock<std::shared_timed_mutex> lk(shard->mtx);
+			for (auto& entry : shard->ring) {
+				f(entry.key, entry.value);
+			}
+		}
+	}
+
+	void clear() {
+		for (auto& shard : _shards) {
+			std::unique_lock<std::shared_timed_mutex> lk(shard->mtx);
+			shard->map.clear();
+			shard->ring.clear();
+			shard->hand = shard->ring.end();
+			shard->weight = 0;
+		}
+	}
+
+	bool empty() {
+		return size() == 0;
+	}
+
+	size_t size() {
+		size_t size = 0;
+		for (auto& shard : _shards) {
+			std::shared_lock<std::shared_timed_mutex> lk(shard->mtx);
+			size += shard->map.size();
+		}
+		return size;
+	}
+
+	size_t weight() {
+		size_t weight = 0;
+		for (auto& shard : _shards) {
+			std::shared_lock<std::shared_timed_mutex> lk(shard->mtx);
+			weight += shard->weight;
+		}
+		return weight;
+	}
+
+	ssize_t max_size() const noexcept {
+		return _max_size;
+	}
+
+	Stats stats() const noexcept {
+		Stats stats{0, 0, 0};
+		for (auto& shard : _shards) {
+			stats.hits += shard->hits.load();
+			stats.misses += shard->misses.load();
+			stats.evictions += shard->evictions.load();
+		}
+		return stats;
+	}
+};
+
+};
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "cover_cache.h"
+
+#include <cstring>   // for memcpy
+
+
+std::string
+CoverCache::key(const Geometry& geometry, bool partials, double error)
+{
+	auto key = geometry.toWKT();
+	char buf[1 + sizeof(double)];
+	buf[0] = partials ? '\x01' : '\x00';
+	std::memcpy(&buf[1], &error, sizeof(double));
+	key.append(buf, sizeof(buf));
+	return key;
+}
+
+
+CoverRanges
+CoverCache::get(const Geometry& geometry, bool partials, double error)
+{
+	return ConcurrentLRU::get(key(geometry, partials, error), [&]() {
+		return std::make_shared<const std::vector<range_t>>(geometry.getRanges(partials, error));
+	});
+}
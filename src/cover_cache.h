@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <memory>             // for shared_ptr
+#include <string>             // for string
+#include <vector>             // for vector
+
+#include "concurrent_lru.h"   // for ConcurrentLRU
+#include "geo/geometry.h"     // for Geometry, range_t
+
+
+#define COVER_CACHE_SIZE  (16 * 1024 * 1024)  /* Bytes of keys and ranges kept */
+
+
+using CoverRanges = std::shared_ptr<const std::vector<range_t>>;
+
+
+struct CoverCacheWeight {
+	size_t operator()(const std::string& key, const CoverRanges& ranges) const noexcept {
+		return key.size() + (ranges ? ranges->size() * sizeof(range_t) : 0);
+	}
+};
+
+
+/*
+ * HTM covers (ranges) of query geometries, keyed by the canonical WKT of
+ * the geometry and the partials and error they were decomposed with, so
+ * repeated geometries in queries skip the decomposition.
+ */
+class CoverCache : public lru::ConcurrentLRU<std::string, CoverRanges, std::hash<std::string>, CoverCacheWeight> {
+	static std::string key(const Geometry& geometry, bool partials, double error);
+
+public:
+	CoverCache(ssize_t max_size=-1)
+		: ConcurrentLRU(max_size) { }
+
+	CoverRanges get(const Geometry& geometry, bool partials, double error);
+};
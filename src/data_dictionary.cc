@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "data_dictionary.h"
+
+#include <algorithm>            // for max, min, sort, unique
+#include <cstring>              // for memcpy, strlen
+#include <mutex>                // for mutex, lock_guard
+#include <queue>                // for priority_queue
+#include <stdexcept>            // for logic_error
+#include <unordered_map>        // for unordered_map
+#include <unordered_set>        // for unordered_set
+
+#include "atomic_shared_ptr.h"  // for atomic_shared_ptr
+#include "database_utils.h"     // for split_data_obj, DB_META_DATA_DICT
+#include "exception.h"          // for Error, SerialisationError
+#include "length.h"             // for serialise_length, unserialise_length
+#include "log.h"                // for L_CALL, L_DATABASE, L_WARNING
+#include "lz4/xxhash.h"         // for XXH32, XXH64
+#include "utils.h"              // for repr
+
+
+using Registry = std::unordered_map<uint64_t, std::shared_ptr<const DataDictionary>>;
+
+
+// Versions trained in the background, waiting for the next commit of their index.
+struct Trained {
+	std::shared_ptr<const DataDictionary> data_dictionary;
+	Xapian::doccount doccount;
+};
+
+static std::mutex training_mtx;
+static std::unordered_set<std::string> training;
+static std::unordered_map<std::string, Trained> trained;
+
+
+static atomic_shared_ptr<const Registry>&
+registry()
+{
+	static atomic_shared_ptr<const Registry> registry(std::make_shared<const Registry>());
+	return registry;
+}
+
+
+// Sorted distinct k-mers of [p, p + size).
+static void
+get_kmers(const char* p, size_t size, std::vector<uint64_t>& kmers)
+{
+	kmers.clear();
+	for (size_t i = 0; i + DATA_DICTIONARY_KMER_SIZE <= size; ++i) {
+		uint64_t kmer = 0;
+		std::memcpy(&kmer, p + i, DATA_DICTIONARY_KMER_SIZE);
+		kmers.push_back(kmer);
+	}
+	std::sort(kmers.begin(), kmers.end());
+	kmers.erase(std::unique(kmers.begin(), kmers.end()), kmers.end());
+}
+
+
+DataDictionary::DataDictionary(std::string&& dictionary_)
+	: dictionary(std::move(dictionary_)),
+	  id(XXH64(dictionary.data(), dictionary.size(), 0))
+{
+	LZ4_resetStream(&stream);
+	LZ4_loadDict(&stream, dictionary.data(), dictionary.size());
+}
+
+
+std::string
+DataDictionary::compress(const std::string& obj) const
+{
+	std::string compressed(1, DATA_COMPRESSED_MAGIC);
+	compressed.append(serialise_length(id));
+	compressed.append(serialise_length(obj.size()));
+	compressed.append(serialise_length(XXH32(obj.data(), obj.size(), 0)));
+	const auto header_size = compressed.size();
+
+	const int bound = LZ4_compressBound(obj.size());
+	compressed.resize(header_size + bound);
+
+	// Loading the dictionary for every object would cost more than compressing it.
+	auto lz4Stream = stream;
+	const int size = LZ4_compress_fast_continue(&lz4Stream, obj.data(), &compressed[header_size], obj.size(), bound, 1);
+	if (size <= 0 || header_size + size >= obj.size()) {
+		return std::string();
+	}
+
+	compressed.resize(header_size + size);
+	return compressed;
+}
+
+
+std::string
+DataDictionary::decompress(const char* p, const char* p_end) const
+{
+	const auto size = unserialise_length(&p, p_end);
+	const auto checksum = unserialise_length(&p, p_end);
+
+	std::string obj(size, '\0');
+	if (LZ4_decompress_safe_usingDict(p, &obj[0], p_end - p, size, dictionary.data(), dictionary.size()) != static_cast<int>(size)) {
+		THROW(SerialisationError, "Corrupt compressed object");
+	}
+	if (XXH32(obj.data(), obj.size(), 0) != checksum) {
+		THROW(SerialisationError, "Corrupt compressed object (checksum mismatch)");
+	}
+
+	return obj;
+}
+
+
+std::string
+DataDictionary::train(const std::vector<std::string>& samples, size_t size)
+{
+	L_CALL(nullptr, "DataDictionary::train(<samples>, %zu)", size);
+
+	std::vector<uint64_t> kmers;
+
+	// Number of samples having each k-mer.
+	std::unordered_map<uint64_t, uint32_t> freqs;
+	for (const auto& sample : samples) {
+		get_kmers(sample.data(), sample.size(), kmers);
+		for (const auto& kmer : kmers) {
+			++freqs[kmer];
+		}
+	}
+
+	struct Segment {
+		uint64_t score;
+		const char* data;
+		size_t size;
+	};
+
+	// Score of a segment, the k-mers it covers weighted by how common they are.
+	const auto score = [&](const Segment& segment) {
+		uint64_t score = 0;
+		get_kmers(segment.data, segment.size, kmers);
+		for (const auto& kmer : kmers) {
+			const auto freq = freqs[kmer];
+			if (freq > 1) {
+				score += freq;
+			}
+		}
+		return score;
+	};
+
+	const auto lower = [](const Segment& a, const Segment& b) {
+		return a.score < b.score;
+	};
+	std::priority_queue<Segment, std::vector<Segment>, decltype(lower)> segments(lower);
+	for (const auto& sample : samples) {
+		for (size_t offset = 0; offset < sample.size(); offset += DATA_DICTIONARY_SEGMENT_SIZE) {
+			Segment segment{ 0, sample.data() + offset, std::min<size_t>(DATA_DICTIONARY_SEGMENT_SIZE, sample.size() - offset) };
+			segment.score = score(segment);
+			if (segment.score) {
+				segments.push(segment);
+			}
+		}
+	}
+
+	// Greedily take the best segment, scores only go down as k-mers get
+	// covered so they are lazily updated when segments reach the top.
+	std::vector<Segment> chosen;
+	size_t total = 0;
+	while (!segments.empty() && total < size) {
+		auto segment = segments.top();
+		segments.pop();
+		const auto current = score(segment);
+		if (!current) {
+			continue;
+		}
+		if (!segments.empty() && current < segments.top().score) {
+			segment.score = current;
+			segments.push(segment);
+			continue;
+		}
+		for (const auto& kmer : kmers) {
+			freqs[kmer] = 0;
+		}
+		chosen.push_back(segment);
+		total += segment.size;
+	}
+
+	// The best segments go last, closest to the compressed data.
+	std::string dictionary;
+	dictionary.reserve(total);
+	for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+		dictionary.append(it->data, it->size);
+	}
+	if (dictionary.size() > size) {
+		dictionary.erase(0, dictionary.size() - size);
+	}
+
+	return dictionary;
+}
+
+
+std::shared_ptr<const DataDictionary>
+DataDictionary::get(uint64_t id)
+{
+	const auto dictionaries = registry().load();
+	const auto it = dictionaries->find(id);
+	if (it == dictionaries->end()) {
+		return nullptr;
+	}
+	return it->second;
+}
+
+
+std::shared_ptr<const DataDictionary>
+DataDictionary::add(std::string&& dictionary)
+{
+	auto data_dictionary = std::make_shared<const DataDictionary>(std::move(dictionary));
+
+	auto dictionaries = registry().load();
+	while (true) {
+		const auto it = dictionaries->find(data_dictionary->id);
+		if (it != dictionaries->end()) {
+			return it->second;
+		}
+		auto updated = std::make_shared<Registry>(*dictionaries);
+		updated->emplace(data_dictionary->id, data_dictionary);
+		if (registry().compare_exchange_weak(dictionaries, std::move(updated))) {
+			return data_dictionary;
+		}
+	}
+}
+
+
+std::shared_ptr<const DataDictionary>
+DataDictionary::load(const Xapian::Database& db)
+{
+	L_CALL(nullptr, "DataDictionary::load(<db>)");
+
+	const auto prefix_size = std::strlen(DB_META_DATA_DICTS);
+	try {
+		const auto it_e = db.metadata_keys_end(DB_META_DATA_DICTS);
+		for (auto it = db.metadata_keys_begin(DB_META_DATA_DICTS); it != it_e; ++it) {
+			const auto key = *it;
+			const char* p = key.data() + prefix_size;
+			const auto id = unserialise_length(&p, key.data() + key.size());
+			if (!get(id)) {
+				add(db.get_metadata(key));
+			}
+		}
+	} catch (const Xapian::UnimplementedError&) {
+		return nullptr;
+	}
+
+	const auto current = db.get_metadata(DB_META_DATA_DICT);
+	if (current.empty()) {
+		return nullptr;
+	}
+	const char* p = current.data();
+	return get(unserialise_length(&p, p + current.size()));
+}
+
+
+bool
+DataDictionary::due(const Xapian::Database& db)
+{
+	L_CALL(nullptr, "DataDictionary::due(<db>)");
+
+	Xapian::doccount trained = 0;
+	const auto current = db.get_metadata(DB_META_DATA_DICT);
+	if (!current.empty()) {
+		const char* p = current.data();
+		const char* p_end = p + current.size();
+		unserialise_length(&p, p_end);
+		trained = unserialise_length(&p, p_end);
+	}
+	return db.get_doccount() >= (trained ? trained * DATA_DICTIONARY_GROWTH : DATA_DICTIONARY_MIN_DOCUMENTS);
+}
+
+
+std::shared_ptr<const DataDictionary>
+DataDictionary::train(const Xapian::Database& db)
+{
+	L_CALL(nullptr, "DataDictionary::train(<db>)");
+
+	// Sample objects evenly across the whole index.
+	std::vector<std::string> samples;
+	const auto lastdocid = db.get_lastdocid();
+	const auto step = std::max<Xapian::docid>(1, lastdocid / DATA_DICTIONARY_SAMPLES);
+	for (Xapian::docid did = 1; did <= lastdocid && samples.size() < DATA_DICTIONARY_SAMPLES; did += step) {
+		try {
+			auto obj = split_data_obj(db.get_document(did).get_data());
+			if (!obj.empty()) {
+				samples.push_back(std::move(obj));
+			}
+		} catch (const Xapian::DocNotFoundError&) { }
+	}
+
+	auto dictionary = train(samples);
+	if (dictionary.empty()) {
+		return nullptr;
+	}
+
+	auto data_dictionary = add(std::move(dictionary));
+
+	L_DATABASE(nullptr, "Data dictionary %016llx trained with %zu of %u documents (%zu bytes)", static_cast<unsigned long long>(data_dictionary->id), samples.size(), db.get_doccount(), data_dictionary->dictionary.size());
+
+	return data_dictionary;
+}
+
+
+void
+DataDictionary::schedule(const std::string& path)
+{
+	L_CALL(nullptr, "DataDictionary::schedule(%s)", repr(path).c_str());
+
+	{
+		std::lock_guard<std::mutex> lk(training_mtx);
+		if (trained.find(path) != trained.end() || !training.insert(path).second) {
+			return;
+		}
+	}
+
+	try {
+		thread_pool().enqueue([path]() {
+			Trained result{ nullptr, 0 };
+			try {
+				Xapian::Database db(path);
+				if (due(db)) {
+					result.doccount = db.get_doccount();
+					result.data_dictionary = train(db);
+				}
+			} catch (const Xapian::Error& exc) {
+				// The next commit schedules it again
+				L_WARNING(nullptr, "Cannot train data dictionary for %s: %s", repr(path).c_str(), exc.get_msg().c_str());
+			}
+
+			std::lock_guard<std::mutex> lk(training_mtx);
+			if (result.data_dictionary) {
+				trained[path] = std::move(result);
+			}
+			training.erase(path);
+		});
+	} catch (const std::logic_error&) {
+		// Shutting down
+		std::lock_guard<std::mutex> lk(training_mtx);
+		training.erase(path);
+	}
+}
+
+
+std::shared_ptr<const DataDictionary>
+DataDictionary::commit(Xapian::WritableDatabase& wdb, const std::string& path)
+{
+	L_CALL(nullptr, "DataDictionary::commit(<wdb>, %s)", repr(path).c_str());
+
+	Trained result{ nullptr, 0 };
+	{
+		std::lock_guard<std::mutex> lk(training_mtx);
+		auto it = trained.find(path);
+		if (it != trained.end()) {
+			result = std::move(it->second);
+			trained.erase(it);
+		}
+	}
+
+	if (!result.data_dictionary) {
+		if (due(wdb)) {
+			schedule(path);
+		}
+		return nullptr;
+	}
+
+	const auto& data_dictionary = result.data_dictionary;
+	wdb.set_metadata(DB_META_DATA_DICTS + serialise_length(data_dictionary->id), data_dictionary->dictionary);
+	wdb.set_metadata(DB_META_DATA_DICT, serialise_length(data_dictionary->id) + serialise_length(result.doccount));
+
+	return data_dictionary;
+}
+
+
+std::string
+DataDictionary::uncompress(std::string&& obj)
+{
+	if (!is_compressed(obj)) {
+		return std::move(obj);
+	}
+
+	const char* p = obj.data() + 1;
+	const char* p_end = obj.data() + obj.size();
+	const auto id = unserialise_length(&p, p_end);
+	const auto data_dictionary = get(id);
+	if (!data_dictionary) {
+		THROW(Error, "Unknown data dictionary %016llx", static_cast<unsigned long long>(id));
+	}
+
+	return data_dictionary->decompress(p, p_end);
+}
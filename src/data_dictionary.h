@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <memory>        // for shared_ptr
+#include <string>        // for string
+#include <vector>        // for vector
+#include <xapian.h>      // for Database, WritableDatabase
+
+#include "lz4/lz4.h"     // for LZ4_stream_t
+#include "threadpool.h"  // for ThreadPool
+
+
+#define DATA_DICTIONARY_SIZE            (1024 * 16)  /* Bytes of a trained dictionary */
+#define DATA_DICTIONARY_SAMPLES         2048         /* Documents sampled to train a dictionary */
+#define DATA_DICTIONARY_MIN_DOCUMENTS   256          /* Documents needed to train the first dictionary */
+#define DATA_DICTIONARY_GROWTH          8            /* Growth of the index that trains a new version */
+#define DATA_DICTIONARY_SEGMENT_SIZE    64           /* Bytes of the sample segments chosen for a dictionary */
+#define DATA_DICTIONARY_KMER_SIZE       6            /* Bytes of the substrings counted across samples */
+
+#define DATA_COMPRESSED_MAGIC           '\xc1'       /* Never used by msgpack */
+
+
+/*
+ * LZ4 dictionaries for the serialised objects of the documents.
+ *
+ * Each index trains a dictionary out of a sample of its documents once it
+ * has some, and a new version whenever it grows DATA_DICTIONARY_GROWTH
+ * times. Dictionaries are made of the sample segments covering the most
+ * common substrings (mostly field names and repeated values), so even
+ * small objects compress well against them. Training happens in the
+ * background, the next commit of the index stores the new version.
+ *
+ * Dictionaries are identified by their 64 bits hash and kept in the metadata
+ * of the index forever, as documents compressed with them may still be
+ * around. Loaded dictionaries are shared by every database in a process-wide
+ * registry, used to uncompress any object. Compressed objects carry a
+ * checksum of their contents, verified when they are uncompressed.
+ */
+class DataDictionary {
+	std::string dictionary;
+
+	// Stream with the dictionary already loaded, copied for each object.
+	LZ4_stream_t stream;
+
+public:
+	const uint64_t id;
+
+	explicit DataDictionary(std::string&& dictionary_);
+
+	// This class is not CopyConstructible or CopyAssignable.
+	DataDictionary(const DataDictionary&) = delete;
+	DataDictionary& operator=(const DataDictionary&) = delete;
+
+	// Returns the compressed object, or an empty string if it doesn't pay.
+	std::string compress(const std::string& obj) const;
+	std::string decompress(const char* p, const char* p_end) const;
+
+	static std::string train(const std::vector<std::string>& samples, size_t size=DATA_DICTIONARY_SIZE);
+
+	static std::shared_ptr<const DataDictionary> get(uint64_t id);
+	static std::shared_ptr<const DataDictionary> add(std::string&& dictionary);
+
+	// Registers every dictionary of db, returns the current one (if any).
+	static std::shared_ptr<const DataDictionary> load(const Xapian::Database& db);
+
+	// Whether db has grown enough to train a new version.
+	static bool due(const Xapian::Database& db);
+
+	// Trains (and registers) a new version out of a sample of db.
+	static std::shared_ptr<const DataDictionary> train(const Xapian::Database& db);
+
+	// Trains a new version for the index at path in the background.
+	static void schedule(const std::string& path);
+
+	// Stores the version trained in the background for the index at path
+	// (if any) in wdb, scheduling a new one if it's due.
+	static std::shared_ptr<const DataDictionary> commit(Xapian::WritableDatabase& wdb, const std::string& path);
+
+	static ThreadPool<>& thread_pool() {
+		static ThreadPool<> thread_pool("D%02zu", 1);
+		return thread_pool;
+	}
+
+	static void finish() {
+		thread_pool().finish();
+	}
+
+	static void join() {
+		thread_pool().join();
+	}
+
+	static size_t running_size() {
+		return thread_pool().running_size();
+	}
+
+	static bool is_compressed(const std::string& obj) {
+		return !obj.empty() && obj.front() == DATA_COMPRESSED_MAGIC;
+	}
+
+	// Uncompresses obj if it's compressed, using the registered dictionaries.
+	static std::string uncompress(std::string&& obj);
+};
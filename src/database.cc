@@ -36,6 +36,7 @@
 #include "atomic_shared_ptr.h"    // for atomic_shared_ptr
 #include "database_autocommit.h"  // for DatabaseAutocommit
 #include "database_handler.h"     // for DatabaseHandler
+#include "database_warmup.h"      // for DatabaseWarmup
 #include "exception.h"            // for Error, MSG_Error, Exception, DocNot...
 #include "guid/guid.h"            // for Guid
 #include "io_utils.h"             // for close, strerrno, write, open
@@ -44,8 +45,11 @@
 #include "manager.h"              // for sig_exit
 #include "msgpack.h"              // for MsgPack
 #include "msgpack/unpack.hpp"     // for unpack_error
+#include "multivalue/doc_values.h" // for DocValues
 #include "schema.h"               // for FieldType, FieldType::TERM
 #include "serialise.h"            // for uuid
+#include "stats.h"                // for Stats
+#include "suggester.h"            // for Suggester
 #include "utils.h"                // for repr, to_string, File_ptr, find_fil...
 
 
@@ -55,8 +59,6 @@
 
 #define DATA_STORAGE_PATH "docdata."
 
-#define WAL_STORAGE_PATH "wal."
-
 #define MAGIC 0xC0DE
 
 #define WAL_SYNC_MODE     STORAGE_ASYNC_SYNC
@@ -127,6 +129,19 @@ DatabaseWAL::~DatabaseWAL()
 }
 
 
+void
+DatabaseWAL::prefetch_volume(const std::string& path)
+{
+	L_CALL(nullptr, "DatabaseWAL::prefetch_volume(%s)", repr(path).c_str());
+
+	int fd = io::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd != -1) {
+		io::fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		io::close(fd);
+	}
+}
+
+
 bool
 DatabaseWAL::open_current(bool commited)
 {
@@ -172,6 +187,11 @@ DatabaseWAL::open_current(bool commited)
 	} else {
 		modified = false;
 
+		// Let the kernel start reading the volumes to replay in the background
+		for (auto volume = lowest_revision; volume <= highest_revision; ++volume) {
+			prefetch_volume(base_path + WAL_STORAGE_PATH + std::to_string(volume));
+		}
+
 		bool reach_end = false;
 		uint32_t start_off, end_off;
 		uint32_t file_rev, begin_rev, end_rev;
@@ -654,10 +674,16 @@ Database::Database(std::shared_ptr<DatabaseQueue>& queue_, const Endpoints& endp
 	  access_time(std::chrono::system_clock::now()),
 	  modified(false),
 	  mastery_level(-1),
-	  checkout_revision(0)
+	  checkout_revision(0),
+	  pending_documents(0),
+	  pending_bytes(0)
 {
 	reopen();
 
+	if (flags & DB_WRITABLE) {
+		load_autocommit_limits();
+	}
+
 	if (auto queue = weak_queue.lock()) {
 		queue->inc_count();
 	}
@@ -701,6 +727,14 @@ Database::reopen()
 		// Try to reopen
 		try {
 			bool ret = db->reopen();
+			if (ret) {
+				// Dictionaries trained after the database was opened
+				DataDictionary::load(*db);
+			}
+			if (ret && !(flags & DB_WRITABLE)) {
+				// Warm up the new revision, already in use (the replay runs in the background)
+				DatabaseWarmup::replay(endpoints);
+			}
 			L_DATABASE_WRAP(this, "Reopen done (took %s) [1]", delta_string(access_time, std::chrono::system_clock::now()).c_str());
 			return ret;
 		} catch (const Xapian::DatabaseOpeningError& exc) {
@@ -717,6 +751,7 @@ Database::reopen()
 	storages.clear();
 	writable_storages.clear();
 #endif /* XAPIAND_DATA_STORAGE */
+	shards.clear();
 
 	auto endpoints_size = endpoints.size();
 	auto i = endpoints.cbegin();
@@ -763,6 +798,7 @@ Database::reopen()
 		}
 
 		db->add_database(wdb);
+		data_dictionary = DataDictionary::load(wdb);
 
 		if (local) {
 			checkout_revision = get_revision();
@@ -856,6 +892,8 @@ Database::reopen()
 			}
 
 			db->add_database(rdb);
+			DataDictionary::load(rdb);
+			shards.push_back(rdb);
 
 	#ifdef XAPIAND_DATA_STORAGE
 			if (local && endpoints_size == 1) {
@@ -909,6 +947,143 @@ Database::get_revision_str() const
 }
 
 
+// Rough size of what a document adds to Xapian's in-memory buffers
+static inline size_t
+pending_size(const Xapian::Document& doc)
+{
+	return doc.get_data().size() + doc.termlist_count() * 32 + doc.values_count() * 16;
+}
+
+
+void
+Database::add_pending(size_t documents, size_t bytes)
+{
+	if (!modified) {
+		pending_since = std::chrono::system_clock::now();
+	}
+	modified = true;
+	pending_documents += documents;
+	pending_bytes += bytes;
+}
+
+
+void
+Database::commit_zone_maps(Xapian::WritableDatabase* wdb)
+{
+	L_CALL(this, "Database::commit_zone_maps(<wdb>)");
+
+	ZoneMap::commit(*wdb, pending_zone_maps);
+}
+
+
+void
+Database::add_doc_values(Xapian::docid did, const Xapian::Document& doc)
+{
+	L_CALL(this, "Database::add_doc_values(%d, <doc>)", did);
+
+	if (!XapiandManager::manager->doc_values) {
+		return;
+	}
+
+	// Only the values are needed for updating the columns.
+	Xapian::Document values;
+	const auto it_e = doc.values_end();
+	for (auto it = doc.values_begin(); it != it_e; ++it) {
+		values.add_value(it.get_valueno(), *it);
+	}
+	pending_doc_values[did] = std::move(values);
+}
+
+
+void
+Database::commit_doc_values(uint32_t previous_revision)
+{
+	L_CALL(this, "Database::commit_doc_values(%u)", previous_revision);
+
+	if (!pending_doc_values.empty() && endpoints[0].is_local()) {
+		DocValues::update(endpoints[0].path, pending_doc_values, previous_revision, get_revision());
+	}
+	pending_doc_values.clear();
+}
+
+
+void
+Database::add_completions(Xapian::WritableDatabase* wdb, Xapian::docid did)
+{
+	L_CALL(this, "Database::add_completions(<wdb>, %d)", did);
+
+	// Inputs of the document about to be replaced or deleted.
+	if (did && wdb->get_value_freq(DB_SLOT_COMPLETION)) {
+		try {
+			Suggester::document_inputs(wdb->get_document(did), pending_completions);
+		} catch (const Xapian::DocNotFoundError&) { }
+	}
+}
+
+
+void
+Database::add_completions(const Xapian::Document& doc)
+{
+	L_CALL(this, "Database::add_completions(<doc>)");
+
+	Suggester::document_inputs(doc, pending_completions);
+}
+
+
+void
+Database::commit_completions(uint32_t previous_revision)
+{
+	L_CALL(this, "Database::commit_completions(%u)", previous_revision);
+
+	// Remembered even without changes, suggesters follow commits one by one.
+	if (endpoints[0].is_local()) {
+		XapiandManager::manager->suggesters.commit(normalize_path(endpoints[0].path, true), previous_revision, get_revision(), std::move(pending_completions));
+	}
+	pending_completions.clear();
+}
+
+
+void
+Database::compress_data(Xapian::Document& doc) const
+{
+	L_CALL(this, "Database::compress_data()");
+
+	if (!data_dictionary) {
+		return;
+	}
+
+	auto data = doc.get_data();
+	auto obj = split_data_obj(data);
+	if (obj.empty()) {
+		return;
+	}
+
+	auto compressed = data_dictionary->compress(obj);
+	if (!compressed.empty()) {
+		auto store = split_data_store(data);
+		doc.set_data(join_data(store.first, store.second, compressed, split_data_blob(data)));
+	}
+}
+
+
+void
+Database::load_autocommit_limits()
+{
+	L_CALL(this, "Database::load_autocommit_limits()");
+
+	AutocommitLimits limits;
+	try {
+		auto value = get_metadata(DB_META_AUTOCOMMIT);
+		if (!value.empty()) {
+			limits.update(MsgPack::unserialise(value));
+		}
+	} catch (const msgpack::unpack_error&) {
+		L_WARNING(this, "Ignoring invalid autocommit limits: %s", repr(endpoints.to_string()).c_str());
+	} catch (const Error&) { }
+	autocommit_limits = limits;
+}
+
+
 bool
 Database::commit(bool wal_)
 {
@@ -925,6 +1100,8 @@ Database::commit(bool wal_)
 	(void)wal_;
 #endif
 
+	auto commit_begins = std::chrono::system_clock::now();
+
 	L_DATABASE_WRAP_INIT();
 
 	for (int t = DB_RETRIES; t >= 0; --t) {
@@ -934,8 +1111,23 @@ Database::commit(bool wal_)
 #ifdef XAPIAND_DATA_STORAGE
 			storage_commit();
 #endif /* XAPIAND_DATA_STORAGE */
+			commit_zone_maps(wdb);
+			std::shared_ptr<const DataDictionary> trained;
+			if (endpoints[0].is_local()) {
+				trained = DataDictionary::commit(*wdb, endpoints[0].path);
+			}
+			auto previous_revision = get_revision();
 			wdb->commit();
 			modified = false;
+			pending_zone_maps.clear();
+			commit_doc_values(previous_revision);
+			commit_completions(previous_revision);
+			if (trained) {
+				data_dictionary = trained;
+			}
+			DatabaseAutocommit::committed(pending_documents, pending_bytes);
+			pending_documents = 0;
+			pending_bytes = 0;
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -955,6 +1147,8 @@ Database::commit(bool wal_)
 		reopen();
 	}
 
+	Stats::cnt().add("commit", std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - commit_begins).count());
+
 	L_DATABASE_WRAP(this, "Commit made (took %s)", delta_string(start, std::chrono::system_clock::now()).c_str());
 
 	return true;
@@ -984,6 +1178,8 @@ Database::cancel(bool wal_)
 		try {
 			wdb->begin_transaction(false);
 			wdb->cancel_transaction();
+			pending_zone_maps.clear();
+			pending_doc_values.clear();
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1022,8 +1218,10 @@ Database::delete_document(Xapian::docid did, bool commit_, bool wal_)
 		// L_DATABASE_WRAP(this, "Deleting document: %d  t: %d", did, t);
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
+			add_completions(wdb, did);
 			wdb->delete_document(did);
-			modified = true;
+			add_doc_values(did, Xapian::Document());
+			add_pending(1, sizeof(did));
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1064,8 +1262,13 @@ Database::delete_document_term(const std::string& term, bool commit_, bool wal_)
 		// L_DATABASE_WRAP(this, "Deleting document: '%s'  t: %d", term.c_str(), t);
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
+			auto it = wdb->postlist_begin(term);
+			if (it != wdb->postlist_end(term)) {
+				add_completions(wdb, *it);
+				add_doc_values(*it, Xapian::Document());
+			}
 			wdb->delete_document(term);
-			modified = true;
+			add_pending(1, term.size());
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1217,6 +1420,7 @@ Database::add_document(const Xapian::Document& doc, bool commit_, bool wal_)
 #ifdef XAPIAND_DATA_STORAGE
 	storage_push_blob(doc_);
 #endif /* XAPIAND_DATA_STORAGE */
+	compress_data(doc_);
 
 	L_DATABASE_WRAP_INIT();
 
@@ -1225,7 +1429,10 @@ Database::add_document(const Xapian::Document& doc, bool commit_, bool wal_)
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
 			did = wdb->add_document(doc_);
-			modified = true;
+			add_completions(doc_);
+			ZoneMap::update(pending_zone_maps, did, doc_);
+			add_doc_values(did, doc_);
+			add_pending(1, pending_size(doc_));
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1262,6 +1469,7 @@ Database::replace_document(Xapian::docid did, const Xapian::Document& doc, bool
 #ifdef XAPIAND_DATA_STORAGE
 	storage_push_blob(doc_);
 #endif /* XAPIAND_DATA_STORAGE */
+	compress_data(doc_);
 
 	L_DATABASE_WRAP_INIT();
 
@@ -1269,8 +1477,12 @@ Database::replace_document(Xapian::docid did, const Xapian::Document& doc, bool
 		// L_DATABASE_WRAP(this, "Replacing: %d  t: %d", did, t);
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
+			add_completions(wdb, did);
 			wdb->replace_document(did, doc_);
-			modified = true;
+			add_completions(doc_);
+			ZoneMap::update(pending_zone_maps, did, doc_);
+			add_doc_values(did, doc_);
+			add_pending(1, pending_size(doc_));
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1309,6 +1521,7 @@ Database::replace_document_term(const std::string& term, const Xapian::Document&
 #ifdef XAPIAND_DATA_STORAGE
 	storage_push_blob(doc_);
 #endif /* XAPIAND_DATA_STORAGE */
+	compress_data(doc_);
 
 	L_DATABASE_WRAP_INIT();
 
@@ -1316,8 +1529,15 @@ Database::replace_document_term(const std::string& term, const Xapian::Document&
 		// L_DATABASE_WRAP(this, "Replacing: '%s'  t: %d", term.c_str(), t);
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
+			auto it = wdb->postlist_begin(term);
+			if (it != wdb->postlist_end(term)) {
+				add_completions(wdb, *it);
+			}
 			did = wdb->replace_document(term, doc_);
-			modified = true;
+			add_completions(doc_);
+			ZoneMap::update(pending_zone_maps, did, doc_);
+			add_doc_values(did, doc_);
+			add_pending(1, pending_size(doc_));
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database %s was modified, try again (%s)", repr(endpoints.to_string()).c_str(), exc.get_msg().c_str());
@@ -1356,7 +1576,7 @@ Database::add_spelling(const std::string& word, Xapian::termcount freqinc, bool
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
 			wdb->add_spelling(word, freqinc);
-			modified = true;
+			add_pending(0, word.size());
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1393,7 +1613,7 @@ Database::remove_spelling(const std::string& word, Xapian::termcount freqdec, bo
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
 			wdb->remove_spelling(word, freqdec);
-			modified = true;
+			add_pending(0, word.size());
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1545,7 +1765,7 @@ Database::set_metadata(const std::string& key, const std::string& value, bool co
 		Xapian::WritableDatabase *wdb = static_cast<Xapian::WritableDatabase *>(db.get());
 		try {
 			wdb->set_metadata(key, value);
-			modified = true;
+			add_pending(0, key.size() + value.size());
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -1559,6 +1779,10 @@ Database::set_metadata(const std::string& key, const std::string& value, bool co
 
 	L_DATABASE_WRAP(this, "Set metadata (took %s)", delta_string(start, std::chrono::system_clock::now()).c_str());
 
+	if (key == DB_META_AUTOCOMMIT) {
+		load_autocommit_limits();
+	}
+
 	if (commit_) {
 		commit(wal_);
 	}
@@ -1713,29 +1937,27 @@ DatabaseQueue::dec_count()
 
 
 DatabasesLRU::DatabasesLRU(ssize_t max_size)
-	: LRU(max_size) { }
+	: ConcurrentLRU(max_size, 1) { }
 
 
-std::shared_ptr<DatabaseQueue>&
+std::shared_ptr<DatabaseQueue>
 DatabasesLRU::operator[](const std::pair<size_t, bool>& key)
 {
-	try {
-		return at(key.first);
-	} catch (std::range_error) {
-		return insert_and([](std::shared_ptr<DatabaseQueue>& val) {
-			lru::DropAction drop_action;
-			if (val->persistent || val->size() < val->count || val->state != DatabaseQueue::replica_state::REPLICA_FREE) {
-				drop_action = lru::DropAction::renew;
-			} else {
-				drop_action =  lru::DropAction::drop;
-			}
-			if (val->_volatile) {
-				return std::make_pair(lru::InsertAction::last, drop_action);
-			} else {
-				return std::make_pair(lru::InsertAction::front, drop_action);
-			}
-		}, std::make_pair(key.first, DatabaseQueue::make_shared(key.second)));
-	}
+	return get_and([](std::shared_ptr<DatabaseQueue>& val) {
+		lru::DropAction drop_action;
+		if (val->persistent || val->size() < val->count || val->state != DatabaseQueue::replica_state::REPLICA_FREE) {
+			drop_action = lru::DropAction::renew;
+		} else {
+			drop_action =  lru::DropAction::drop;
+		}
+		if (val->_volatile) {
+			return std::make_pair(lru::InsertAction::last, drop_action);
+		} else {
+			return std::make_pair(lru::InsertAction::front, drop_action);
+		}
+	}, key.first, [&key]() {
+		return DatabaseQueue::make_shared(key.second);
+	});
 }
 
 
@@ -1744,9 +1966,9 @@ DatabasesLRU::finish()
 {
 	L_CALL(this, "DatabasesLRU::finish()");
 
-	for (auto it = begin(); it != end(); ++it) {
-		it->second->finish();
-	}
+	for_each([](const size_t&, std::shared_ptr<DatabaseQueue>& queue) {
+		queue->finish();
+	});
 }
 
 
@@ -1759,11 +1981,29 @@ DatabasesLRU::finish()
  */
 
 
-DatabasePool::DatabasePool(size_t max_size)
+DatabasePool::DatabasesShard::DatabasesShard(ssize_t max_size)
+	: databases(max_size),
+	  writable_databases(max_size),
+	  contentions(0) { }
+
+
+DatabasePool::DatabasePool(size_t max_size, size_t num_shards)
 	: finished(false),
-	  databases(max_size),
-	  writable_databases(max_size)
+	  checkouts_fast(0),
+	  checkouts_slow(0),
+	  checkins_fast(0),
+	  checkins_slow(0)
 {
+	if (num_shards == 0) {
+		num_shards = 1;
+	}
+	// Each shard gets its share of the total size, rounded up
+	auto shard_size = static_cast<ssize_t>((max_size + num_shards - 1) / num_shards);
+	shards.reserve(num_shards);
+	for (size_t i = 0; i < num_shards; ++i) {
+		shards.push_back(std::make_unique<DatabasesShard>(shard_size));
+	}
+
 	L_OBJ(this, "CREATED DATABASE POLL!");
 }
 
@@ -1776,11 +2016,50 @@ DatabasePool::~DatabasePool()
 }
 
 
+std::unique_lock<std::shared_timed_mutex>
+DatabasePool::lock_shard(DatabasesShard& shard)
+{
+	std::unique_lock<std::shared_timed_mutex> lk(shard.mtx, std::try_to_lock);
+	if (!lk.owns_lock()) {
+		++shard.contentions;
+		lk.lock();
+	}
+	return lk;
+}
+
+
+std::shared_lock<std::shared_timed_mutex>
+DatabasePool::lock_shard_shared(DatabasesShard& shard)
+{
+	std::shared_lock<std::shared_timed_mutex> lk(shard.mtx, std::try_to_lock);
+	if (!lk.owns_lock()) {
+		++shard.contentions;
+		lk.lock();
+	}
+	return lk;
+}
+
+
+std::vector<std::unique_lock<std::shared_timed_mutex>>
+DatabasePool::lock_shards()
+{
+	// Always locked in the same order, to avoid deadlocks
+	std::vector<std::unique_lock<std::shared_timed_mutex>> locks;
+	locks.reserve(shards.size());
+	for (auto& shard : shards) {
+		locks.push_back(lock_shard(*shard));
+	}
+	return locks;
+}
+
+
 void
 DatabasePool::add_endpoint_queue(const Endpoint& endpoint, const std::shared_ptr<DatabaseQueue>& queue)
 {
 	L_CALL(this, "DatabasePool::add_endpoint_queue(%s, <queue>)", repr(endpoint.to_string()).c_str());
 
+	std::lock_guard<std::mutex> lk(queues_mtx);
+
 	size_t hash = endpoint.hash();
 	auto& queues_set = queues[hash];
 	queues_set.insert(queue);
@@ -1792,6 +2071,8 @@ DatabasePool::drop_endpoint_queue(const Endpoint& endpoint, const std::shared_pt
 {
 	L_CALL(this, "DatabasePool::drop_endpoint_queue(%s, <queue>)", repr(endpoint.to_string()).c_str());
 
+	std::lock_guard<std::mutex> lk(queues_mtx);
+
 	size_t hash = endpoint.hash();
 	auto& queues_set = queues[hash];
 	queues_set.erase(queue);
@@ -1802,22 +2083,79 @@ DatabasePool::drop_endpoint_queue(const Endpoint& endpoint, const std::shared_pt
 }
 
 
+bool
+DatabasePool::checkout_fast(std::shared_ptr<Database>& database, size_t hash, bool writable, bool persistent)
+{
+	L_CALL(this, "DatabasePool::checkout_fast(<database>, %zu, %s, %s)", hash, writable ? "true" : "false", persistent ? "true" : "false");
+
+	auto& shard = get_shard(hash);
+	auto lk = lock_shard_shared(shard);
+
+	std::shared_ptr<DatabaseQueue> queue;
+	if (!shard.lru(writable).find(hash, queue)) {
+		return false;
+	}
+
+	if (queue->state != DatabaseQueue::replica_state::REPLICA_FREE) {
+		return false;
+	}
+
+	if (!queue->pop(database, 0)) {
+		return false;
+	}
+
+	queue->persistent = persistent;
+	return true;
+}
+
+
+bool
+DatabasePool::checkin_fast(std::shared_ptr<Database>& database)
+{
+	L_CALL(this, "DatabasePool::checkin_fast(%s)", repr(database->to_string()).c_str());
+
+	auto& shard = get_shard(database->hash);
+	auto lk = lock_shard_shared(shard);
+
+	std::shared_ptr<DatabaseQueue> queue;
+	if (!shard.lru(database->flags & DB_WRITABLE).find(database->hash, queue)) {
+		return false;
+	}
+
+	if (queue->state != DatabaseQueue::replica_state::REPLICA_FREE) {
+		return false;
+	}
+
+	ASSERT(database->weak_queue.lock() == queue);
+
+	if (database->modified) {
+		DatabaseAutocommit::commit(database);
+	}
+
+	queue->push(database);
+
+	if (queue->count < queue->size()) {
+		L_CRIT(this, "Inconsistency in the number of databases in queue");
+		sig_exit(-EX_SOFTWARE);
+	}
+
+	return true;
+}
+
+
 template<typename F, typename... Args>
 inline bool
 DatabasePool::checkout(std::shared_ptr<Database>& database, const Endpoints& endpoints, int flags, F&& f, Args&&... args)
 {
 	bool ret = checkout(database, endpoints, flags);
 	if (!ret) {
-		std::lock_guard<std::mutex> lk(qmtx);
+		size_t hash = endpoints.hash();
+		auto& shard = get_shard(hash);
+		auto lk = lock_shard(shard);
 
-		const auto index = std::make_pair(endpoints.hash(), flags & DB_VOLATILE);
+		const auto index = std::make_pair(hash, flags & DB_VOLATILE);
 
-		std::shared_ptr<DatabaseQueue> queue;
-		if (flags & DB_WRITABLE) {
-			queue = writable_databases[index];
-		} else {
-			queue = databases[index];
-		}
+		std::shared_ptr<DatabaseQueue> queue = shard.lru(flags & DB_WRITABLE)[index];
 
 		queue->checkin_callbacks.clear();
 		queue->checkin_callbacks.enqueue(std::forward<F>(f), std::forward<Args>(args)...);
@@ -1858,18 +2196,19 @@ DatabasePool::checkout(std::shared_ptr<Database>& database, const Endpoints& end
 		return false;
 	}
 
-	if (!finished) {
+	if (!finished && !replication && checkout_fast(database, endpoints.hash(), writable, persistent)) {
+		++checkouts_fast;
+	} else if (!finished) {
+		++checkouts_slow;
+
 		size_t hash = endpoints.hash();
 		const auto index = std::make_pair(hash, _volatile);
-		std::shared_ptr<DatabaseQueue> queue;
 
-		std::unique_lock<std::mutex> lk(qmtx);
+		auto& shard = get_shard(hash);
+		auto& lru = shard.lru(writable);
+		auto lk = lock_shard(shard);
 
-		if (writable) {
-			queue = writable_databases[index];
-		} else {
-			queue = databases[index];
-		}
+		std::shared_ptr<DatabaseQueue> queue = lru[index];
 
 		auto old_state = queue->state;
 
@@ -1957,11 +2296,7 @@ DatabasePool::checkout(std::shared_ptr<Database>& database, const Endpoints& end
 			queue->persistent = old_persistent;
 			if (queue->count == 0) {
 				//L_DEBUG(this, "There is a error, the queue ended up being empty, remove it");
-				if (writable) {
-					writable_databases.erase(hash);
-				} else {
-					databases.erase(hash);
-				}
+				lru.erase(hash);
 			}
 			database.reset();
 		}
@@ -1999,10 +2334,6 @@ DatabasePool::checkin(std::shared_ptr<Database>& database)
 
 	ASSERT(database);
 
-	std::shared_ptr<DatabaseQueue> queue;
-
-	std::unique_lock<std::mutex> lk(qmtx);
-
 	if (database->flags & DB_WRITABLE) {
 		auto& endpoint = database->endpoints[0];
 		if (endpoint.is_local()) {
@@ -2015,11 +2346,22 @@ DatabasePool::checkin(std::shared_ptr<Database>& database)
 				}
 			}
 		}
-		queue = writable_databases[std::make_pair(database->hash, false)];
-	} else {
-		queue = databases[std::make_pair(database->hash, false)];
 	}
 
+	if (checkin_fast(database)) {
+		++checkins_fast;
+		L_DATABASE_END(this, "-- CHECKED IN DB [%s]: %s", (database->flags & DB_WRITABLE) ? "WR" : "RO", repr(database->endpoints.to_string()).c_str());
+		database.reset();
+		return;
+	}
+
+	++checkins_slow;
+
+	auto& shard = get_shard(database->hash);
+	auto lk = lock_shard(shard);
+
+	std::shared_ptr<DatabaseQueue> queue = shard.lru(database->flags & DB_WRITABLE)[std::make_pair(database->hash, false)];
+
 	ASSERT(database->weak_queue.lock() == queue);
 
 	if (database->modified) {
@@ -2028,13 +2370,26 @@ DatabasePool::checkin(std::shared_ptr<Database>& database)
 
 	queue->push(database);
 
-	auto& endpoints = database->endpoints;
+	if (queue->count < queue->size()) {
+		L_CRIT(this, "Inconsistency in the number of databases in queue");
+		sig_exit(-EX_SOFTWARE);
+	}
+
+	auto endpoints = database->endpoints;
+
+	L_DATABASE_END(this, "-- CHECKED IN DB [%s]: %s", (database->flags & DB_WRITABLE) ? "WR" : "RO", repr(endpoints.to_string()).c_str());
+
+	database.reset();
+
 	bool signal_checkins = false;
 	switch (queue->state) {
 		case DatabaseQueue::replica_state::REPLICA_SWITCH:
+			// Switching needs all shards locked, release this one first
+			lk.unlock();
 			for (const auto& endpoint : endpoints) {
-				_switch_db(endpoint);
+				switch_db(endpoint);
 			}
+			lk.lock();
 			if (queue->state == DatabaseQueue::replica_state::REPLICA_FREE) {
 				signal_checkins = true;
 			}
@@ -2047,15 +2402,6 @@ DatabasePool::checkin(std::shared_ptr<Database>& database)
 			break;
 	}
 
-	if (queue->count < queue->size()) {
-		L_CRIT(this, "Inconsistency in the number of databases in queue");
-		sig_exit(-EX_SOFTWARE);
-	}
-
-	L_DATABASE_END(this, "-- CHECKED IN DB [%s]: %s", (database->flags & DB_WRITABLE) ? "WR" : "RO", repr(endpoints.to_string()).c_str());
-
-	database.reset();
-
 	lk.unlock();
 
 	if (signal_checkins) {
@@ -2071,8 +2417,11 @@ DatabasePool::finish()
 
 	finished = true;
 
-	writable_databases.finish();
-	databases.finish();
+	for (auto& shard : shards) {
+		auto lk = lock_shard(*shard);
+		shard->writable_databases.finish();
+		shard->databases.finish();
+	}
 
 	L_OBJ(this, "FINISH DATABASE!");
 }
@@ -2083,6 +2432,8 @@ DatabasePool::_switch_db(const Endpoint& endpoint)
 {
 	L_CALL(this, "DatabasePool::_switch_db(%s)", repr(endpoint.to_string()).c_str());
 
+	std::lock_guard<std::mutex> lk(queues_mtx);
+
 	auto& queues_set = queues[endpoint.hash()];
 
 	bool switched = true;
@@ -2114,7 +2465,7 @@ DatabasePool::switch_db(const Endpoint& endpoint)
 {
 	L_CALL(this, "DatabasePool::switch_db(%s)", repr(endpoint.to_string()).c_str());
 
-	std::lock_guard<std::mutex> lk(qmtx);
+	auto lks = lock_shards();
 	return _switch_db(endpoint);
 }
 
@@ -2126,22 +2477,43 @@ DatabasePool::recover_database(const Endpoints& endpoints, int flags)
 
 	size_t hash = endpoints.hash();
 
+	auto& shard = get_shard(hash);
+
 	if ((flags & RECOVER_REMOVE_WRITABLE) || (flags & RECOVER_REMOVE_ALL)) {
 		/* erase from writable queue if exist */
-		std::lock_guard<std::mutex> lk(qmtx);
-		writable_databases.erase(hash);
+		auto lk = lock_shard(shard);
+		shard.writable_databases.erase(hash);
 	}
 
 	if (flags & RECOVER_DECREMENT_COUNT) {
 		/* Delete the count of the database creation */
 		/* Avoid mismatch between queue size and counter */
-		std::lock_guard<std::mutex> lk(qmtx);
-		databases[std::make_pair(hash, false)]->dec_count();
+		auto lk = lock_shard(shard);
+		shard.databases[std::make_pair(hash, false)]->dec_count();
 	}
 
 	if ((flags & RECOVER_REMOVE_DATABASE) || (flags & RECOVER_REMOVE_ALL)) {
 		/* erase from queue if exist */
-		std::lock_guard<std::mutex> lk(qmtx);
-		databases.erase(hash);
+		auto lk = lock_shard(shard);
+		shard.databases.erase(hash);
+	}
+}
+
+
+void
+DatabasePool::get_stats(MsgPack& stats)
+{
+	L_CALL(this, "DatabasePool::get_stats(<stats>)");
+
+	size_t contentions = 0;
+	for (auto& shard : shards) {
+		contentions += shard->contentions.load();
 	}
+
+	stats["shards"] = shards.size();
+	stats["checkouts_fast"] = checkouts_fast.load();
+	stats["checkouts_slow"] = checkouts_slow.load();
+	stats["checkins_fast"] = checkins_fast.load();
+	stats["checkins_slow"] = checkins_slow.load();
+	stats["lock_contentions"] = contentions;
 }
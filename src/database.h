@@ -24,12 +24,16 @@
 
 #include "xapiand.h"
 
-#include <atomic>               // for atomic_bool
+#include <atomic>               // for atomic_bool, atomic_size_t
 #include <chrono>               // for system_clock, system_clock::time_point
+#include <condition_variable>   // for condition_variable_any
 #include <cstring>              // for size_t
 #include <list>                 // for __list_iterator, operator!=
+#include <map>                  // for map
 #include <memory>               // for shared_ptr, enable_shared_from_this, mak...
 #include <mutex>                // for mutex, condition_variable, unique_lock
+#include <set>                  // for set
+#include <shared_mutex>         // for shared_timed_mutex, shared_lock
 #include <stdexcept>            // for range_error
 #include <string>               // for string, operator!=
 #include <sys/types.h>          // for uint32_t, uint8_t, ssize_t
@@ -41,9 +45,12 @@
 #include <xapian.h>             // for docid, termcount, Document, ExpandDecider
 
 #include "atomic_shared_ptr.h"  // for atomic_shared_ptr
+#include "concurrent_lru.h"     // for ConcurrentLRU, DropAction, InsertAction
+#include "data_dictionary.h"    // for DataDictionary
+#include "database_autocommit.h" // for AutocommitLimits
 #include "database_utils.h"     // for DB_WRITABLE
 #include "endpoint.h"           // for Endpoints, Endpoint
-#include "lru.h"                // for LRU, DropAction, LRU<>::iterator, DropAc...
+#include "multivalue/zone_map.h" // for ZoneMap
 #include "queue.h"              // for Queue, QueueSet
 #include "storage.h"            // for STORAGE_BLOCK_SIZE, StorageCorruptVolume...
 #include "threadpool.h"         // for TaskQueue
@@ -64,6 +71,8 @@ constexpr int RECOVER_REMOVE_ALL              = 0x04; // Remove endpoint from wr
 constexpr int RECOVER_DECREMENT_COUNT         = 0x08; // Decrement count queue
 
 
+#define WAL_STORAGE_PATH "wal."
+
 #define WAL_SLOTS ((STORAGE_BLOCK_SIZE - sizeof(WalHeader::StorageHeaderHead)) / sizeof(uint32_t))
 
 
@@ -174,6 +183,8 @@ public:
 	DatabaseWAL(const std::string& base_path_, Database* database_);
 	~DatabaseWAL();
 
+	static void prefetch_volume(const std::string& path);
+
 	bool open_current(bool current);
 
 	bool init_database();
@@ -275,6 +286,16 @@ class Database {
 	void storage_commit();
 #endif /* XAPIAND_DATA_STORAGE */
 
+	void add_pending(size_t documents, size_t bytes);
+	void load_autocommit_limits();
+	void commit_zone_maps(Xapian::WritableDatabase* wdb);
+	void add_doc_values(Xapian::docid did, const Xapian::Document& doc);
+	void commit_doc_values(uint32_t previous_revision);
+	void add_completions(Xapian::WritableDatabase* wdb, Xapian::docid did);
+	void add_completions(const Xapian::Document& doc);
+	void commit_completions(uint32_t previous_revision);
+	void compress_data(Xapian::Document& doc) const;
+
 public:
 	std::weak_ptr<DatabaseQueue> weak_queue;
 	Endpoints endpoints;
@@ -285,8 +306,29 @@ public:
 	long long mastery_level;
 	uint32_t checkout_revision;
 
+	// Changes not committed yet (used by the autocommit policy)
+	size_t pending_documents;
+	size_t pending_bytes;
+	std::chrono::system_clock::time_point pending_since;
+	AutocommitLimits autocommit_limits;
+
+	// Zones of the documents not committed yet, by slot
+	std::map<Xapian::valueno, ZoneMap> pending_zone_maps;
+
+	// Values of the documents changed since the last commit, by docid
+	std::map<Xapian::docid, Xapian::Document> pending_doc_values;
+
+	// Completion inputs changed since the last commit
+	std::set<std::string> pending_completions;
+
+	// Dictionary compressing the objects of new documents (if trained)
+	std::shared_ptr<const DataDictionary> data_dictionary;
+
 	std::unique_ptr<Xapian::Database> db;
 
+	// Handles of each shard of a read-only db, they share its revision.
+	std::vector<Xapian::Database> shards;
+
 #if XAPIAND_DATABASE_WAL
 	std::unique_ptr<DatabaseWAL> wal;
 #endif /* XAPIAND_DATABASE_WAL */
@@ -356,12 +398,12 @@ private:
 	};
 
 	replica_state state;
-	bool persistent;
+	std::atomic_bool persistent;
 	bool _volatile;
 
 	size_t count;
 
-	std::condition_variable switch_cond;
+	std::condition_variable_any switch_cond;
 
 	std::weak_ptr<DatabasePool> weak_database_pool;
 	Endpoints endpoints;
@@ -396,11 +438,11 @@ public:
 };
 
 
-class DatabasesLRU : public lru::LRU<size_t, std::shared_ptr<DatabaseQueue>> {
+class DatabasesLRU : public lru::ConcurrentLRU<size_t, std::shared_ptr<DatabaseQueue>> {
 public:
 	DatabasesLRU(ssize_t max_size);
 
-	std::shared_ptr<DatabaseQueue>& operator[](const std::pair<size_t, bool>& key);
+	std::shared_ptr<DatabaseQueue> operator[](const std::pair<size_t, bool>& key);
 
 	void finish();
 };
@@ -412,19 +454,53 @@ class DatabasePool {
 	friend class DatabaseQueue;
 	friend class lock_database;
 
-	std::mutex qmtx;
+	/*
+	 * Queues are split in shards (by endpoints hash), each shard with its own
+	 * lock and LRUs. Lookups of an already existing queue with an idle database
+	 * only need the shard's lock in shared mode. The shard lock also guards the
+	 * queues' replica state, that's why the LRUs themselves aren't striped.
+	 */
+	struct DatabasesShard {
+		std::shared_timed_mutex mtx;
+
+		DatabasesLRU databases;
+		DatabasesLRU writable_databases;
+
+		std::atomic_size_t contentions;
+
+		DatabasesShard(ssize_t max_size);
+
+		DatabasesLRU& lru(bool writable) {
+			return writable ? writable_databases : databases;
+		}
+	};
+
 	std::atomic_bool finished;
 
+	std::mutex queues_mtx;
 	std::unordered_map<size_t, std::unordered_set<std::shared_ptr<DatabaseQueue>>> queues;
 
-	DatabasesLRU databases;
-	DatabasesLRU writable_databases;
+	std::vector<std::unique_ptr<DatabasesShard>> shards;
 
-	std::condition_variable checkin_cond;
+	std::atomic_size_t checkouts_fast;
+	std::atomic_size_t checkouts_slow;
+	std::atomic_size_t checkins_fast;
+	std::atomic_size_t checkins_slow;
+
+	DatabasesShard& get_shard(size_t hash) {
+		return *shards[hash % shards.size()];
+	}
+
+	std::unique_lock<std::shared_timed_mutex> lock_shard(DatabasesShard& shard);
+	std::shared_lock<std::shared_timed_mutex> lock_shard_shared(DatabasesShard& shard);
+	std::vector<std::unique_lock<std::shared_timed_mutex>> lock_shards();
 
 	void add_endpoint_queue(const Endpoint& endpoint, const std::shared_ptr<DatabaseQueue>& queue);
 	void drop_endpoint_queue(const Endpoint& endpoint, const std::shared_ptr<DatabaseQueue>& queue);
 
+	bool checkout_fast(std::shared_ptr<Database>& database, size_t hash, bool writable, bool persistent);
+	bool checkin_fast(std::shared_ptr<Database>& database);
+
 	template<typename F, typename... Args>
 	bool checkout(std::shared_ptr<Database>& database, const Endpoints& endpoints, int flags, F&& f, Args&&... args);
 	bool checkout(std::shared_ptr<Database>& database, const Endpoints& endpoints, int flags);
@@ -436,7 +512,7 @@ class DatabasePool {
 public:
 	queue::QueueSet<Endpoint> updated_databases;
 
-	DatabasePool(size_t max_size);
+	DatabasePool(size_t max_size, size_t num_shards=DBPOOL_SHARDS);
 	DatabasePool(const DatabasePool&) = delete;
 	DatabasePool(DatabasePool&&) = delete;
 	DatabasePool& operator=(const DatabasePool&) = delete;
@@ -446,4 +522,6 @@ public:
 	void finish();
 	bool switch_db(const Endpoint& endpoint);
 	void recover_database(const Endpoints& endpoints, int flags);
+
+	void get_stats(MsgPack& stats);
 };
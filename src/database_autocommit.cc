@@ -25,21 +25,130 @@
 #include "database.h"          // for Database, DatabasePool
 #include "database_handler.h"  // for DatabaseHandler
 #include "endpoint.h"          // for Endpoints
+#include "exception.h"         // for ClientError
 #include "log.h"               // for Log, L_OBJ, L_CALL, L_DEBUG, L_WARNING
 #include "manager.h"           // for XapiandManager
+#include "msgpack.h"           // for MsgPack
+#include "stats.h"             // for Stats
 #include "utils.h"             // for delta_string
 
 
 std::mutex DatabaseAutocommit::statuses_mtx;
 std::unordered_map<Endpoints, DatabaseAutocommit::Status> DatabaseAutocommit::statuses;
+std::unique_ptr<AutocommitPolicy> DatabaseAutocommit::policy = std::make_unique<AutocommitPolicy>();
 
+std::atomic_size_t DatabaseAutocommit::commits(0);
+std::atomic_size_t DatabaseAutocommit::committed_documents(0);
+std::atomic_size_t DatabaseAutocommit::committed_bytes(0);
+std::atomic_size_t DatabaseAutocommit::reasons[static_cast<int>(AutocommitReason::MAX)];
 
-DatabaseAutocommit::DatabaseAutocommit(bool forced_, Endpoints endpoints_, std::weak_ptr<const Database> weak_database_)
-	: forced(forced_),
+
+void
+AutocommitLimits::update(const MsgPack& obj)
+{
+	if (!obj.is_map()) {
+		return;
+	}
+
+	auto it = obj.find("max_documents");
+	if (it != obj.end() && it.value().is_number()) {
+		max_documents = it.value().as_u64();
+	}
+
+	it = obj.find("max_bytes");
+	if (it != obj.end() && it.value().is_number()) {
+		max_bytes = it.value().as_u64();
+	}
+
+	it = obj.find("delay");
+	if (it != obj.end() && it.value().is_number()) {
+		delay = std::chrono::milliseconds(static_cast<long long>(it.value().as_f64() * 1000));
+	}
+
+	it = obj.find("max_delay");
+	if (it != obj.end() && it.value().is_number()) {
+		max_delay = std::chrono::milliseconds(static_cast<long long>(it.value().as_f64() * 1000));
+	}
+}
+
+
+void
+AutocommitLimits::validate(const MsgPack& obj)
+{
+	if (!obj.is_map()) {
+		THROW(ClientError, "Autocommit limits must be an object");
+	}
+
+	for (const auto& key : obj) {
+		auto str_key = key.as_string();
+		if (str_key != "max_documents" && str_key != "max_bytes" && str_key != "delay" && str_key != "max_delay") {
+			THROW(ClientError, "Unknown autocommit limit: %s", repr(str_key).c_str());
+		}
+		const auto& value = obj.at(str_key);
+		if (str_key == "max_documents" || str_key == "max_bytes") {
+			if (!value.is_integer() || value.as_f64() < 0) {
+				THROW(ClientError, "Autocommit limit %s must be a non-negative integer", str_key.c_str());
+			}
+		} else if (!value.is_number() || value.as_f64() < 0) {
+			THROW(ClientError, "Autocommit limit %s must be a non-negative number", str_key.c_str());
+		}
+	}
+
+	AutocommitLimits limits;
+	limits.update(obj);
+	if (limits.max_delay < limits.delay) {
+		THROW(ClientError, "Autocommit max_delay must not be less than delay");
+	}
+}
+
+
+/*
+ * Commits right away once the pending changes cross the documents or bytes
+ * limits (hot indexes don't keep growing Xapian's buffers), otherwise waits
+ * for the writes to settle down for delay, but never longer than max_delay
+ * since the first pending change.
+ */
+std::chrono::system_clock::time_point
+AutocommitPolicy::next_commit(const Database& database, std::chrono::system_clock::time_point now, AutocommitReason& reason) const
+{
+	const auto& limits = database.autocommit_limits;
+
+	if (database.pending_documents >= limits.max_documents) {
+		reason = AutocommitReason::DOCUMENTS;
+		return now;
+	}
+
+	if (database.pending_bytes >= limits.max_bytes) {
+		reason = AutocommitReason::BYTES;
+		return now;
+	}
+
+	auto max_commit = database.pending_since + limits.max_delay;
+	auto next_commit = now + limits.delay;
+	if (next_commit >= max_commit) {
+		reason = AutocommitReason::MAX_DELAY;
+		return max_commit;
+	}
+
+	reason = AutocommitReason::DELAY;
+	return next_commit;
+}
+
+
+DatabaseAutocommit::DatabaseAutocommit(AutocommitReason reason_, Endpoints endpoints_, std::weak_ptr<const Database> weak_database_)
+	: reason(reason_),
 	  endpoints(endpoints_),
 	  weak_database(weak_database_) { }
 
 
+void
+DatabaseAutocommit::set_policy(std::unique_ptr<AutocommitPolicy>&& policy_)
+{
+	std::lock_guard<std::mutex> statuses_lk(DatabaseAutocommit::statuses_mtx);
+	policy = std::move(policy_);
+}
+
+
 void
 DatabaseAutocommit::commit(const std::shared_ptr<Database>& database)
 {
@@ -52,42 +161,50 @@ DatabaseAutocommit::commit(const std::shared_ptr<Database>& database)
 		auto now = std::chrono::system_clock::now();
 
 		std::lock_guard<std::mutex> statuses_lk(DatabaseAutocommit::statuses_mtx);
-		auto it = DatabaseAutocommit::statuses.find(database->endpoints);
-
-		DatabaseAutocommit::Status* status;
-		if (it == DatabaseAutocommit::statuses.end()) {
-			auto& status_ref = DatabaseAutocommit::statuses[database->endpoints] = {
-				nullptr,
-				time_point_to_ullong(now + 9s)
-			};
-			status = &status_ref;
-		} else {
-			status = &(it->second);
-		}
 
-		bool forced;
-		next_wakeup_time = time_point_to_ullong(now + 3s);
-		if (next_wakeup_time > status->max_wakeup_time) {
-			next_wakeup_time = status->max_wakeup_time;
-			forced = true;
-		} else {
-			forced = false;
-		}
+		AutocommitReason reason;
+		next_wakeup_time = time_point_to_ullong(policy->next_commit(*database, now, reason));
 
-		if (status->task) {
-			if (status->task->wakeup_time == next_wakeup_time) {
+		auto& status = DatabaseAutocommit::statuses[database->endpoints];
+		if (status.task) {
+			if (status.task->wakeup_time == next_wakeup_time) {
 				return;
 			}
-			status->task->clear();
+			status.task->clear();
 		}
-		status->task = std::make_shared<DatabaseAutocommit>(forced, database->endpoints, database);
-		task = status->task;
+		status.task = std::make_shared<DatabaseAutocommit>(reason, database->endpoints, database);
+		task = status.task;
 	}
 
 	scheduler().add(task, next_wakeup_time);
 }
 
 
+void
+DatabaseAutocommit::committed(size_t documents, size_t bytes)
+{
+	++commits;
+	committed_documents += documents;
+	committed_bytes += bytes;
+}
+
+
+void
+DatabaseAutocommit::get_stats(MsgPack& stats)
+{
+	size_t commits_ = commits.load();
+	size_t documents_ = committed_documents.load();
+	stats["commits"] = commits_;
+	stats["documents"] = documents_;
+	stats["bytes"] = committed_bytes.load();
+	stats["documents_per_commit"] = commits_ ? static_cast<double>(documents_) / commits_ : 0.0;
+	auto& reasons_ = stats["reasons"];
+	for (int i = 0; i < static_cast<int>(AutocommitReason::MAX); ++i) {
+		reasons_[AutocommitReasonNames[i]] = reasons[i].load();
+	}
+}
+
+
 void
 DatabaseAutocommit::run()
 {
@@ -112,9 +229,11 @@ DatabaseAutocommit::run()
 		auto end = std::chrono::system_clock::now();
 
 		if (successful) {
-			L_DEBUG(this, "Autocommit: %s%s (took %s)", repr(endpoints.to_string()).c_str(), forced ? " (forced)" : "", delta_string(start, end).c_str());
+			++reasons[static_cast<int>(reason)];
+			Stats::cnt().add(std::string("autocommit_") + AutocommitReasonNames[static_cast<int>(reason)], std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+			L_DEBUG(this, "Autocommit: %s (%s) (took %s)", repr(endpoints.to_string()).c_str(), AutocommitReasonNames[static_cast<int>(reason)], delta_string(start, end).c_str());
 		} else {
-			L_WARNING(this, "Autocommit falied: %s%s (took %s)", repr(endpoints.to_string()).c_str(), forced ? " (forced)" : "", delta_string(start, end).c_str());
+			L_WARNING(this, "Autocommit falied: %s (%s) (took %s)", repr(endpoints.to_string()).c_str(), AutocommitReasonNames[static_cast<int>(reason)], delta_string(start, end).c_str());
 		}
 	}
 }
@@ -24,7 +24,11 @@
 
 #include "xapiand.h"
 
+#include <atomic>         // for atomic_size_t
+#include <chrono>         // for system_clock, milliseconds
+#include <memory>         // for shared_ptr, unique_ptr
 #include <mutex>          // for mutex
+#include <string>         // for string
 #include <unordered_map>  // for unordered_map
 
 #include "endpoint.h"     // for Endpoints
@@ -32,18 +36,79 @@
 
 
 class Database;
+class MsgPack;
+
+
+constexpr size_t AUTOCOMMIT_MAX_DOCUMENTS = 10000;
+constexpr size_t AUTOCOMMIT_MAX_BYTES = 64 * 1024 * 1024;
+constexpr std::chrono::milliseconds AUTOCOMMIT_DELAY = std::chrono::seconds(3);
+constexpr std::chrono::milliseconds AUTOCOMMIT_MAX_DELAY = std::chrono::seconds(9);
+
+
+/*
+ * Per index limits for the pending (not yet committed) changes, stored in
+ * the index's metadata (DB_META_AUTOCOMMIT) as an object with any of:
+ * "max_documents", "max_bytes", "delay" and "max_delay" (in seconds).
+ */
+struct AutocommitLimits {
+	size_t max_documents;                  // Commit right away after this many changed documents...
+	size_t max_bytes;                      // ...or after this many bytes of changes
+	std::chrono::milliseconds delay;       // Commit after this long without changes...
+	std::chrono::milliseconds max_delay;   // ...but no later than this after the first change
+
+	AutocommitLimits()
+		: max_documents(AUTOCOMMIT_MAX_DOCUMENTS),
+		  max_bytes(AUTOCOMMIT_MAX_BYTES),
+		  delay(AUTOCOMMIT_DELAY),
+		  max_delay(AUTOCOMMIT_MAX_DELAY) { }
+
+	void update(const MsgPack& obj);
+
+	// Throws ClientError unless obj is a map of known, non-negative limits
+	static void validate(const MsgPack& obj);
+};
+
+
+enum class AutocommitReason {
+	DOCUMENTS,                  // Too many changed documents
+	BYTES,                      // Too many bytes of changes
+	DELAY,                      // No changes for a while
+	MAX_DELAY,                  // Changes pending for too long
+	MAX,
+};
+
+
+static constexpr const char* const AutocommitReasonNames[] = {
+	"documents", "bytes", "delay", "max_delay",
+};
+
+
+/*
+ * Decides when the pending changes of a database should be committed.
+ */
+class AutocommitPolicy {
+public:
+	virtual ~AutocommitPolicy() = default;
+
+	virtual std::chrono::system_clock::time_point next_commit(const Database& database, std::chrono::system_clock::time_point now, AutocommitReason& reason) const;
+};
 
 
 class DatabaseAutocommit : public ScheduledTask {
 	struct Status {
 		std::shared_ptr<DatabaseAutocommit> task;
-		unsigned long long max_wakeup_time;
 	};
 
 	static std::mutex statuses_mtx;
 	static std::unordered_map<Endpoints, Status> statuses;
+	static std::unique_ptr<AutocommitPolicy> policy;
+
+	static std::atomic_size_t commits;
+	static std::atomic_size_t committed_documents;
+	static std::atomic_size_t committed_bytes;
+	static std::atomic_size_t reasons[static_cast<int>(AutocommitReason::MAX)];
 
-	bool forced;
+	AutocommitReason reason;
 	Endpoints endpoints;
 	std::weak_ptr<const Database> weak_database;
 
@@ -65,11 +130,18 @@ public:
 		return scheduler().running_size();
 	}
 
-	DatabaseAutocommit(bool forced_, Endpoints endpoints_, std::weak_ptr<const Database> weak_database_);
+	DatabaseAutocommit(AutocommitReason reason_, Endpoints endpoints_, std::weak_ptr<const Database> weak_database_);
 	void run() override;
 
+	static void set_policy(std::unique_ptr<AutocommitPolicy>&& policy_);
+
 	static void commit(const std::shared_ptr<Database>& database);
 
+	// Accounts for a commit (of any kind) of the given pending changes
+	static void committed(size_t documents, size_t bytes);
+
+	static void get_stats(MsgPack& stats);
+
 	std::string __repr__() const override {
 		return ScheduledTask::__repr__("DatabaseAutocommit");
 	}
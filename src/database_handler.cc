@@ -25,23 +25,29 @@
 #include <algorithm>                        // for min, move
 #include <ctype.h>                          // for isupper, tolower
 #include <exception>                        // for exception
+#include <iterator>                         // for back_inserter
 #include <stdexcept>                        // for out_of_range
 
 #include "cast.h"                           // for Cast
+#include "cppcodec/base64_default_url_unpadded.hpp"  // for base64 namespace
 #include "database.h"                       // for DatabasePool, Database
+#include "database_warmup.h"                // for DatabaseWarmup
 #include "exception.h"                      // for CheckoutError, ClientError
 #include "length.h"                         // for unserialise_length, seria...
 #include "log.h"                            // for L_CALL, Log
 #include "msgpack.h"                        // for MsgPack, object::object, ...
 #include "msgpack_patcher.h"                // for apply_patch
 #include "multivalue/aggregation.h"         // for AggregationMatchSpy
+#include "multivalue/doc_values.h"          // for DocValues
 #include "multivalue/keymaker.h"            // for Multi_MultiValueKeyMaker
 #include "query_dsl.h"                      // for QUERYDSL_QUERY, QueryDSL
 #include "rapidjson/document.h"             // for Document
 #include "schema.h"                         // for Schema, required_spc_t
 #include "schemas_lru.h"                    // for SchemasLRU
 #include "serialise.h"                      // for cast, serialise, type
-#include "utils.h"                          // for repr
+#include "serialise_list.h"                 // for StringList
+#include "suggester.h"                      // for Suggester
+#include "utils.h"                          // for repr, lower_string
 #include "v8/exception.h"                   // for Error, ReferenceError
 #include "v8/v8pp.h"                        // for Processor::Function, Proc...
 
@@ -65,6 +71,160 @@ public:
 };
 
 
+/*
+ * Matches only documents ranked after the cursor (search_after), used as a
+ * filter so deep pages don't need to rank and discard all the previous
+ * results. Cursors walk documents by sort key (if any) and then by docid:
+ * unsorted cursors skip straight past the cursor's docid, sorted ones only
+ * compute the sort key of the documents the rest of the query matches.
+ *
+ * Every shard gets its own clone, initialised by Xapian in shard order,
+ * which maps the shard's docids back to the combined docid of the cursor.
+ */
+class CursorPostingSource : public Xapian::PostingSource {
+	Xapian::KeyMaker* sorter;
+	std::string key;
+	Xapian::docid cursor_did;
+	Xapian::doccount shards;
+	std::shared_ptr<Xapian::doccount> next_shard;
+
+	Xapian::Database db;
+	Xapian::doccount shard;
+	Xapian::docid first_did;
+	Xapian::PostingIterator it, it_end;
+	bool started;
+	bool pending;  // it was moved by check() to a document not consumed yet
+	Xapian::doccount termfreq_min, termfreq_est, termfreq_max;
+
+	bool accept(Xapian::docid did) const {
+		if (sorter) {
+			auto cmp = (*sorter)(db.get_document(did)).compare(key);
+			if (cmp != 0) {
+				return cmp > 0;
+			}
+		}
+		return (did - 1) * shards + shard + 1 > cursor_did;
+	}
+
+	void start() {
+		if (!started) {
+			started = true;
+			it = db.postlist_begin("");
+			it_end = db.postlist_end("");
+		}
+	}
+
+	void advance() {
+		while (it != it_end && !accept(*it)) {
+			++it;
+		}
+	}
+
+public:
+	CursorPostingSource(Xapian::KeyMaker* sorter_, const std::string& key_, Xapian::docid cursor_did_, Xapian::doccount shards_, std::shared_ptr<Xapian::doccount> next_shard_=std::make_shared<Xapian::doccount>(0))
+		: sorter(sorter_),
+		  key(key_),
+		  cursor_did(cursor_did_),
+		  shards(shards_ ? shards_ : 1),
+		  next_shard(std::move(next_shard_)),
+		  shard(0),
+		  first_did(1),
+		  started(false),
+		  pending(false),
+		  termfreq_min(0),
+		  termfreq_est(0),
+		  termfreq_max(0) { }
+
+	Xapian::doccount get_termfreq_min() const override {
+		return termfreq_min;
+	}
+
+	Xapian::doccount get_termfreq_est() const override {
+		return termfreq_est;
+	}
+
+	Xapian::doccount get_termfreq_max() const override {
+		return termfreq_max;
+	}
+
+	Xapian::docid get_docid() const override {
+		return *it;
+	}
+
+	bool at_end() const override {
+		return started && it == it_end;
+	}
+
+	void next(double) override {
+		if (!started) {
+			start();
+			it.skip_to(first_did);
+		} else if (pending) {
+			pending = false;
+		} else {
+			++it;
+		}
+		advance();
+	}
+
+	void skip_to(Xapian::docid min_docid, double) override {
+		start();
+		pending = false;
+		it.skip_to(std::max(min_docid, first_did));
+		advance();
+	}
+
+	bool check(Xapian::docid min_docid, double min_wt) override {
+		if (!sorter || min_docid < first_did) {
+			// Docids are checked by skipping, no sort keys involved
+			skip_to(min_docid, min_wt);
+			return true;
+		}
+		start();
+		it.skip_to(min_docid);
+		if (it == it_end) {
+			return true;
+		}
+		// Not matching either because min_docid doesn't exist (the next
+		// document is still to be checked) or because it's before the cursor
+		pending = *it != min_docid;
+		return !pending && accept(min_docid);
+	}
+
+	Xapian::PostingSource* clone() const override {
+		return new CursorPostingSource(sorter, key, cursor_did, shards, next_shard);
+	}
+
+	void init(const Xapian::Database& db_) override {
+		db = db_;
+		shard = (*next_shard)++;
+		started = false;
+		pending = false;
+
+		auto doccount = db.get_doccount();
+		auto lastdocid = db.get_lastdocid();
+		if (sorter) {
+			// Any document could sort after the cursor
+			first_did = 1;
+			termfreq_min = 0;
+			termfreq_est = doccount;
+			termfreq_max = doccount;
+		} else {
+			// First docid of this shard after the cursor's combined docid
+			first_did = cursor_did > shard ? (cursor_did - shard - 1) / shards + 2 : 1;
+			if (first_did > lastdocid) {
+				termfreq_min = termfreq_est = termfreq_max = 0;
+			} else {
+				auto span = lastdocid - first_did + 1;
+				termfreq_min = doccount > first_did - 1 ? doccount - (first_did - 1) : 0;
+				termfreq_max = std::min(doccount, span);
+				termfreq_est = std::max(termfreq_min, static_cast<Xapian::doccount>(static_cast<double>(doccount) * span / lastdocid));
+			}
+		}
+	}
+};
+
+
 template<typename F, typename... Args>
 lock_database::lock_database(DatabaseHandler* db_handler_, F&& f, Args&&... args)
 	: db_handler(db_handler_)
@@ -662,9 +822,30 @@ DatabaseHandler::get_mset(const query_field_t& e, const MsgPack* qdsl, Aggregati
 		fuzzy_rset = get_rset(query, e.fuzzy.n_rset);
 	}
 
+	// Configure cursor (search_after).
+	bool cursor_after = false;
+	std::string cursor_key;
+	Xapian::docid cursor_did = 0;
+	if (e.is_cursor && !e.cursor.empty()) {
+		try {
+			auto serialised = base64::decode<std::string>(e.cursor);
+			const char *p = serialised.data();
+			const char *p_end = p + serialised.size();
+			cursor_key = unserialise_string(&p, p_end);
+			cursor_did = static_cast<Xapian::docid>(unserialise_length(&p, p_end));
+		} catch (const std::exception&) {
+			THROW(ClientError, "Invalid cursor: %s", repr(e.cursor).c_str());
+		}
+		if (!cursor_key.empty() && !sorter) {
+			THROW(ClientError, "Cursor was obtained from a sorted search, sort is required");
+		}
+		cursor_after = true;
+	}
+
 	lock_database lk_db(this);
 	for (int t = DB_RETRIES; t >= 0; --t) {
 		try {
+			DocValues::Scope doc_values_scope(database.get());
 			auto final_query = query;
 			Xapian::Enquire enquire(*database->db);
 			if (collapse_key != Xapian::BAD_VALUENO) {
@@ -673,7 +854,14 @@ DatabaseHandler::get_mset(const query_field_t& e, const MsgPack* qdsl, Aggregati
 			if (aggs) {
 				enquire.add_matchspy(aggs);
 			}
-			if (sorter) {
+			if (e.is_cursor) {
+				// Cursors need a total order known before matching: sort key (if any), then docid
+				if (sorter) {
+					enquire.set_sort_by_key(sorter.get(), false);
+				} else {
+					enquire.set_weighting_scheme(Xapian::BoolWeight());
+				}
+			} else if (sorter) {
 				enquire.set_sort_by_key_then_relevance(sorter.get(), false);
 			}
 			if (e.is_nearest) {
@@ -684,8 +872,19 @@ DatabaseHandler::get_mset(const query_field_t& e, const MsgPack* qdsl, Aggregati
 				auto eset = enquire.get_eset(e.fuzzy.n_eset, fuzzy_rset, fuzzy_edecider.get());
 				final_query = Xapian::Query(Xapian::Query::OP_OR, final_query, Xapian::Query(Xapian::Query::OP_ELITE_SET, eset.begin(), eset.end(), e.fuzzy.n_term));
 			}
-			enquire.set_query(final_query);
-			mset = enquire.get_mset(e.offset, e.limit, e.check_at_least);
+			if (cursor_after) {
+				// Matches estimates of cursor pages count the matches remaining after the cursor
+				auto cursor_source = new CursorPostingSource(sorter.get(), cursor_key, cursor_did, database->db->size());
+				enquire.set_query(Xapian::Query(Xapian::Query::OP_FILTER, final_query, Xapian::Query(cursor_source->release())));
+			} else {
+				enquire.set_query(final_query);
+			}
+			if (e.is_cursor) {
+				mset = enquire.get_mset(0, e.limit, e.check_at_least);
+			} else {
+				mset = enquire.get_mset(e.offset, e.limit, e.check_at_least);
+			}
+			DatabaseWarmup::record(endpoints, final_query);
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
@@ -711,6 +910,56 @@ DatabaseHandler::get_mset(const query_field_t& e, const MsgPack* qdsl, Aggregati
 }
 
 
+std::vector<slot_field_t>
+DatabaseHandler::get_slot_fields(const std::vector<std::vector<std::string>>& paths)
+{
+	L_CALL(this, "DatabaseHandler::get_slot_fields(<paths>)");
+
+	auto schema_ = get_schema();
+
+	std::vector<slot_field_t> slot_fields;
+	slot_fields.reserve(paths.size());
+	for (const auto& path : paths) {
+		auto slot_field = schema_->get_slot_field(join_string(path, std::string(1, DB_OFFSPRING_UNION)));
+		if (slot_field.slot == Xapian::BAD_VALUENO) {
+			return std::vector<slot_field_t>();
+		}
+		if (slot_field.sep_types[1] == FieldType::ARRAY || slot_field.flags.inside_namespace) {
+			// A single value in the slot could have been a one element array in the data
+			return std::vector<slot_field_t>();
+		}
+		switch (slot_field.get_type()) {
+			// Types whose values are kept in the slots as they are in the data,
+			// numbers and booleans could have been given as strings (or
+			// integers as floats) and must be read from the data
+			case FieldType::TERM:
+			case FieldType::TEXT:
+			case FieldType::STRING:
+				slot_fields.push_back({ path, slot_field.slot, slot_field.get_type() });
+				break;
+			default:
+				return std::vector<slot_field_t>();
+		}
+	}
+
+	return slot_fields;
+}
+
+
+std::string
+DatabaseHandler::get_cursor(const MSet& mset)
+{
+	L_CALL(nullptr, "DatabaseHandler::get_cursor(<mset>)");
+
+	if (mset.empty()) {
+		return std::string();
+	}
+
+	auto last = mset[mset.size() - 1];
+	return base64::encode(serialise_string(last.get_sort_key()) + serialise_length(*last));
+}
+
+
 std::pair<bool, bool>
 DatabaseHandler::update_schema()
 {
@@ -759,6 +1008,32 @@ DatabaseHandler::get_metadata(const std::string& key)
 
 
 
+MsgPack
+DatabaseHandler::get_suggestions(const std::string& field_name, const std::string& prefix, size_t limit)
+{
+	L_CALL(this, "DatabaseHandler::get_suggestions(%s, %s, %zu)", repr(field_name).c_str(), repr(prefix).c_str(), limit);
+
+	schema = get_schema();
+	const auto field_spc = schema->get_data_field(field_name, false).first;
+	if (!field_spc.flags.completion) {
+		THROW(ClientError, "Field %s does not have %s", repr(field_name).c_str(), RESERVED_COMPLETION);
+	}
+
+	lock_database lk_db(this);
+	const auto suggester = Suggester::get(database.get(), field_spc.prefix);
+	lk_db.unlock();
+
+	MsgPack suggestions(MsgPack::Type::ARRAY);
+	for (const auto& suggestion : suggester->suggest(lower_string(prefix), limit)) {
+		suggestions.push_back(MsgPack({
+			{ "_text", suggestion.first },
+			{ "_weight", suggestion.second },
+		}));
+	}
+	return suggestions;
+}
+
+
 void
 DatabaseHandler::set_metadata(const std::string& key, const std::string& value)
 {
@@ -1248,6 +1523,32 @@ Document::get_value(const std::string& slot_name)
 }
 
 
+std::string
+Document::get_slot_object(const std::vector<slot_field_t>& slot_fields)
+{
+	L_CALL(this, "Document::get_slot_object(<slot_fields>)");
+
+	MsgPack obj(MsgPack::Type::MAP);
+	for (const auto& slot_field : slot_fields) {
+		const auto serialised = get_value(slot_field.slot);
+		std::vector<std::string> values;
+		const char* p = serialised.data();
+		StringList::unserialise(&p, p + serialised.size(), std::back_inserter(values));
+		if (values.size() != 1) {
+			// Missing fields and arrays (kept as sets of values) must be read from the data
+			return std::string();
+		}
+		auto* field = &obj;
+		for (auto it = slot_field.path.begin(), it_last = slot_field.path.end() - 1; it != it_last; ++it) {
+			field = &(*field)[*it];
+		}
+		(*field)[slot_field.path.back()] = Unserialise::MsgPack(slot_field.type, values.front());
+	}
+
+	return obj.serialise();
+}
+
+
 std::pair<bool, std::string>
 Document::get_store()
 {
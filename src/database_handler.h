@@ -47,6 +47,14 @@ class Schema;
 class SchemasLRU;
 
 
+// A field read from its value slot instead of from the document's data
+struct slot_field_t {
+	std::vector<std::string> path;
+	Xapian::valueno slot;
+	FieldType type;
+};
+
+
 class MSet : public Xapian::MSet {
 public:
 	MSet() = default;
@@ -135,11 +143,16 @@ public:
 	Xapian::RSet get_rset(const Xapian::Query& query, Xapian::doccount maxitems);
 	MSet get_mset(const query_field_t& e, const MsgPack* qdsl, AggregationMatchSpy* aggs, std::vector<std::string>& suggestions);
 
+	static std::string get_cursor(const MSet& mset);
+
+	std::vector<slot_field_t> get_slot_fields(const std::vector<std::vector<std::string>>& paths);
+
 	std::pair<bool, bool> update_schema();
 
 	std::string get_prefixed_term_id(const std::string& doc_id);
 
 	std::string get_metadata(const std::string& key);
+	MsgPack get_suggestions(const std::string& field_name, const std::string& prefix, size_t limit);
 	void set_metadata(const std::string& key, const std::string& value);
 
 	Document get_document(const Xapian::docid& did);
@@ -190,4 +203,5 @@ public:
 	MsgPack get_obj();
 	MsgPack get_field(const std::string& slot_name);
 	static MsgPack get_field(const std::string& slot_name, const MsgPack& obj);
+	std::string get_slot_object(const std::vector<slot_field_t>& slot_fields);
 };
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "database_recovery.h"
+
+#include <chrono>              // for system_clock, nanoseconds
+#include <dirent.h>            // for DIR, dirent, readdir, closedir
+#include <stdexcept>           // for logic_error
+#include <xapian.h>            // for Error
+
+#include "database.h"          // for WAL_STORAGE_PATH
+#include "database_handler.h"  // for DatabaseHandler
+#include "database_utils.h"    // for DB_WRITABLE
+#include "endpoint.h"          // for Endpoints, Endpoint
+#include "exception.h"         // for Error
+#include "log.h"               // for L_CALL, L_INFO, L_WARNING, L_NOTICE
+#include "msgpack.h"           // for MsgPack
+#include "stats.h"             // for Stats
+#include "utils.h"             // for delta_string, repr, startswith
+
+
+std::atomic_size_t DatabaseRecovery::total(0);
+std::atomic_size_t DatabaseRecovery::replaying(0);
+std::atomic_size_t DatabaseRecovery::recovered(0);
+std::atomic_size_t DatabaseRecovery::failed(0);
+std::atomic_llong DatabaseRecovery::start_time(0);
+std::atomic_llong DatabaseRecovery::end_time(0);
+
+
+static long long
+now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+std::vector<std::string>
+DatabaseRecovery::find_indexes(const std::string& path)
+{
+	L_CALL(nullptr, "DatabaseRecovery::find_indexes(%s)", repr(path).c_str());
+
+	std::vector<std::string> indexes;
+
+	std::vector<std::string> pending({ "" });
+	while (!pending.empty()) {
+		auto dir_path = std::move(pending.back());
+		pending.pop_back();
+
+		DIR* dirp = ::opendir((dir_path.empty() ? path : path + "/" + dir_path).c_str());
+		if (!dirp) {
+			continue;
+		}
+
+		bool has_wal = false;
+		struct dirent *ent;
+		while ((ent = readdir(dirp)) != nullptr) {
+			const char *s = ent->d_name;
+			if (ent->d_type == DT_DIR) {
+				// Skip ".", ".." and hidden directories
+				if (s[0] != '.') {
+					pending.push_back(dir_path.empty() ? s : dir_path + "/" + s);
+				}
+			} else if (ent->d_type == DT_REG && !has_wal) {
+				has_wal = startswith(s, WAL_STORAGE_PATH);
+			}
+		}
+		closedir(dirp);
+
+		// The root directory holds the cluster database, which has no WAL
+		if (has_wal && !dir_path.empty()) {
+			indexes.push_back(std::move(dir_path));
+		}
+	}
+
+	return indexes;
+}
+
+
+void
+DatabaseRecovery::recover(const std::string& path)
+{
+	L_CALL(nullptr, "DatabaseRecovery::recover(%s)", repr(path).c_str());
+
+	++replaying;
+
+	auto start = std::chrono::system_clock::now();
+
+	bool successful = false;
+	try {
+		// Checking out the index replays its WAL, commit right away so the
+		// replayed slots are checkpointed in the new revision.
+		DatabaseHandler db_handler(Endpoints(Endpoint(path)), DB_WRITABLE);
+		db_handler.commit();
+		successful = true;
+	} catch (const Error& exc) {
+		L_WARNING(nullptr, "WAL recovery failed: %s (%s)", repr(path).c_str(), exc.get_context());
+	} catch (const Xapian::Error& exc) {
+		L_WARNING(nullptr, "WAL recovery failed: %s (%s)", repr(path).c_str(), exc.get_msg().c_str());
+	}
+
+	auto end = std::chrono::system_clock::now();
+
+	if (successful) {
+		++recovered;
+		Stats::cnt().add("wal_recovery", std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		L_DEBUG(nullptr, "WAL recovered: %s (took %s)", repr(path).c_str(), delta_string(start, end).c_str());
+	} else {
+		++failed;
+	}
+
+	if (--replaying == 0 && recovered + failed == total) {
+		end_time = now_ns();
+		L_NOTICE(nullptr, "WAL recovery finished: %zu recovered, %zu failed (took %s)", recovered.load(), failed.load(), delta_string(end_time - start_time).c_str());
+	}
+}
+
+
+void
+DatabaseRecovery::start(size_t num_threads)
+{
+	L_CALL(nullptr, "DatabaseRecovery::start(%zu)", num_threads);
+
+	start_time = now_ns();
+
+	auto indexes = find_indexes(".");
+	total = indexes.size();
+	if (indexes.empty()) {
+		end_time = start_time.load();
+		return;
+	}
+
+	L_INFO(nullptr, "Recovering %zu %s with %zu %s...", indexes.size(), (indexes.size() == 1) ? "index" : "indexes", num_threads, (num_threads == 1) ? "thread" : "threads");
+
+	auto& pool = thread_pool(num_threads);
+	for (auto& index : indexes) {
+		try {
+			pool.enqueue([index = std::move(index)]() {
+				recover(index);
+			});
+		} catch (const std::logic_error&) {
+			// Shutting down
+			break;
+		}
+	}
+}
+
+
+void
+DatabaseRecovery::get_stats(MsgPack& stats)
+{
+	size_t total_ = total.load();
+	size_t recovered_ = recovered.load();
+	size_t failed_ = failed.load();
+	stats["total"] = total_;
+	stats["replaying"] = replaying.load();
+	stats["recovered"] = recovered_;
+	stats["failed"] = failed_;
+	stats["pending"] = total_ - recovered_ - failed_;
+	stats["progress"] = total_ ? static_cast<double>(recovered_ + failed_) / total_ : 1.0;
+	auto start_time_ = start_time.load();
+	if (start_time_) {
+		auto end_time_ = end_time.load();
+		stats["elapsed"] = delta_string((end_time_ ? end_time_ : now_ns()) - start_time_);
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <atomic>         // for atomic_size_t, atomic_llong
+#include <string>         // for string
+#include <vector>         // for vector
+
+#include "threadpool.h"   // for ThreadPool
+
+
+class MsgPack;
+
+
+/*
+ * Eager crash recovery: at startup every local index having write-ahead
+ * log volumes is checked out (which replays its WAL) and committed right
+ * away, several indexes at a time, instead of waiting for the first
+ * request to each index to pay for the replay.
+ *
+ * The committed Xapian revision is the checkpoint; WAL slots up to it are
+ * skipped by DatabaseWAL::open_current() on the next replay.
+ */
+class DatabaseRecovery {
+	static std::atomic_size_t total;
+	static std::atomic_size_t replaying;
+	static std::atomic_size_t recovered;
+	static std::atomic_size_t failed;
+	static std::atomic_llong start_time;  // In nanoseconds since the epoch
+	static std::atomic_llong end_time;
+
+	static void recover(const std::string& path);
+
+public:
+	static ThreadPool<>& thread_pool(size_t num_threads=0) {
+		static ThreadPool<> thread_pool("R%02zu", num_threads);
+		return thread_pool;
+	}
+
+	static void finish() {
+		thread_pool().finish();
+	}
+
+	static void join() {
+		thread_pool().join();
+	}
+
+	static size_t running_size() {
+		return thread_pool().running_size();
+	}
+
+	// Returns the paths (relative to path) of the indexes with WAL volumes
+	static std::vector<std::string> find_indexes(const std::string& path);
+
+	// Enqueues the recovery of all local indexes with WAL volumes
+	static void start(size_t num_threads);
+
+	static void get_stats(MsgPack& stats);
+};
@@ -32,6 +32,7 @@
 
 #include "cast.h"                                    // for Cast
 #include "cppcodec/base64_default_url_unpadded.hpp"  // for base64 namespace
+#include "data_dictionary.h"                         // for DataDictionary
 #include "exception.h"                               // for ClientError, MSG_ClientError
 #include "guid/guid.h"                               // for Guid
 #include "io_utils.h"                                // for close, open, read, write
@@ -414,7 +415,7 @@ std::string split_data_obj(const std::string& data)
 	}
 
 	if (*(p + length) == DATABASE_DATA_FOOTER_MAGIC) {
-		return std::string(p, length);
+		return DataDictionary::uncompress(std::string(p, length));
 	}
 
 	return std::string();
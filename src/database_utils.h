@@ -86,6 +86,10 @@
 // Reserved words used in schema only for GEO fields.
 #define RESERVED_PARTIALS          "_partials"
 #define RESERVED_ERROR             "_error"
+// Reserved words used in schema only for TERM and STRING fields.
+#define RESERVED_INFIX             "_infix"
+// Reserved words used in schema only for TERM, STRING and TEXT fields.
+#define RESERVED_COMPLETION        "_completion"
 // Reserved words used for doing explicit cast convertions
 #define RESERVED_FLOAT             "_float"
 #define RESERVED_POSITIVE          "_positive"
@@ -112,6 +116,10 @@
 
 
 #define DB_META_SCHEMA         "schema"
+#define DB_META_AUTOCOMMIT     "autocommit"
+#define DB_META_ZONE_MAP       "zone_map:"         // Followed by the serialised slot
+#define DB_META_DATA_DICT      "data_dictionary"   // Current data dictionary and documents it was trained with
+#define DB_META_DATA_DICTS     "data_dictionary:"  // Followed by the serialised dictionary id
 #define DB_OFFSPRING_UNION     '.'
 #define DB_VERSION_SCHEMA      1.0
 
@@ -120,6 +128,7 @@
 
 #define DB_SLOT_ID             0     // Slot ID document
 #define DB_SLOT_CONTENT_TYPE   1     // Slot content type data
+#define DB_SLOT_COMPLETION     2     // Slot for the completion inputs of the document
 
 #define DB_SLOT_NUMERIC        10    // Slot for saving global float/integer/positive values
 #define DB_SLOT_DATE           11    // Slot for saving global date values
@@ -192,22 +201,29 @@ struct query_field_t {
 	bool unique_doc;
 	bool is_fuzzy;
 	bool is_nearest;
+	bool is_cursor;
+	std::string cursor;
 	std::string collapse;
 	unsigned collapse_max;
 	std::vector<std::string> query;
 	std::vector<std::string> sort;
+	std::vector<std::string> fields;  // Projection of the returned objects
 	similar_field_t fuzzy;
 	similar_field_t nearest;
 	std::string time;
 	std::string period;
 
+	// Only used by completion suggestions.
+	std::string field;
+	std::string prefix;
+
 	// Only used when the sort type is string.
 	std::string metric;
 	bool icase;
 
 	query_field_t()
 		: offset(0), limit(10), check_at_least(0), volatile_(false), spelling(true), synonyms(false), commit(false),
-		  unique_doc(false), is_fuzzy(false), is_nearest(false), collapse_max(1), icase(false) { }
+		  unique_doc(false), is_fuzzy(false), is_nearest(false), is_cursor(false), collapse_max(1), icase(false) { }
 };
 
 
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "database_warmup.h"
+
+#include <algorithm>           // for sort, nth_element, min
+#include <chrono>              // for system_clock, nanoseconds
+#include <errno.h>             // for errno
+#include <fcntl.h>             // for O_RDONLY, O_CLOEXEC
+#include <stdexcept>           // for logic_error
+#include <stdio.h>             // for rename
+#include <string.h>            // for strerror
+#include <sys/stat.h>          // for fstat
+#include <thread>              // for sleep_for
+#include <unistd.h>            // for unlink
+#include <utility>             // for pair
+#include <vector>              // for vector
+#include <xapian.h>            // for Database, Enquire, Query
+
+#include "endpoint.h"          // for Endpoints, Endpoint
+#include "io_utils.h"          // for open, close, read, write, fadvise
+#include "log.h"               // for L_CALL, L_DEBUG, L_INFO, L_WARNING
+#include "msgpack.h"           // for MsgPack
+#include "query_cache.h"       // for QueryCache
+#include "utils.h"             // for repr, delta_string, exists
+
+
+std::mutex DatabaseWarmup::mtx;
+lru::LRU<std::string, size_t> DatabaseWarmup::hits(WARMUP_MAX_SAMPLED);
+lru::LRU<size_t, std::deque<std::string>> DatabaseWarmup::queries(WARMUP_MAX_SAMPLED);
+std::unordered_set<size_t> DatabaseWarmup::replaying;
+
+std::atomic_size_t DatabaseWarmup::searches(0);
+std::atomic_bool DatabaseWarmup::finished(false);
+
+std::atomic_size_t DatabaseWarmup::prefetched_indexes(0);
+std::atomic_size_t DatabaseWarmup::prefetched_bytes(0);
+std::atomic_size_t DatabaseWarmup::replayed_queries(0);
+
+
+// Tables prefetched for each index, in order of importance
+static const std::vector<std::string> glass_tables({
+	"postlist.glass",
+	"termlist.glass",
+	"docdata.glass",
+	"position.glass",
+});
+
+static const std::vector<std::string> chert_tables({
+	"postlist.DB",
+	"termlist.DB",
+	"record.DB",
+	"position.DB",
+});
+
+
+void
+DatabaseWarmup::record(const Endpoints& endpoints, const Xapian::Query& query)
+{
+	if (++searches % WARMUP_QUERY_SAMPLE) {
+		return;
+	}
+
+	L_CALL(nullptr, "DatabaseWarmup::record(%s, <query>)", repr(endpoints.to_string()).c_str());
+
+	std::string serialised;
+	try {
+		serialised = query.serialise();
+	} catch (const Xapian::Error&) {
+		// Queries using posting sources which can't be serialised are not sampled
+	}
+
+	std::lock_guard<std::mutex> lk(mtx);
+
+	for (const auto& endpoint : endpoints) {
+		if (endpoint.is_local()) {
+			++hits[endpoint.path];
+		}
+	}
+
+	if (!serialised.empty()) {
+		auto& sampled = queries[endpoints.hash()];
+		sampled.push_back(std::move(serialised));
+		if (sampled.size() > WARMUP_MAX_QUERIES) {
+			sampled.pop_front();
+		}
+	}
+}
+
+
+void
+DatabaseWarmup::replay(const Endpoints& endpoints)
+{
+	L_CALL(nullptr, "DatabaseWarmup::replay(%s)", repr(endpoints.to_string()).c_str());
+
+	for (const auto& endpoint : endpoints) {
+		if (!endpoint.is_local()) {
+			return;
+		}
+	}
+
+	auto hash = endpoints.hash();
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		if (!queries.exists(hash) || !replaying.insert(hash).second) {
+			return;
+		}
+	}
+
+	try {
+		thread_pool().enqueue([endpoints]() {
+			replay_sampled(endpoints);
+		});
+	} catch (const std::logic_error&) {
+		// Shutting down
+		std::lock_guard<std::mutex> lk(mtx);
+		replaying.erase(hash);
+	}
+}
+
+
+void
+DatabaseWarmup::replay_sampled(const Endpoints& endpoints)
+{
+	L_CALL(nullptr, "DatabaseWarmup::replay_sampled(%s)", repr(endpoints.to_string()).c_str());
+
+	std::deque<std::string> sampled;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		auto hash = endpoints.hash();
+		replaying.erase(hash);
+		auto it = queries.find(hash);
+		if (it == queries.end()) {
+			return;
+		}
+		sampled = it->second;
+	}
+
+	if (finished) {
+		return;
+	}
+
+	auto start = std::chrono::system_clock::now();
+
+	// The reopened database belongs to whoever checks it out, replay against a new one.
+	Xapian::Database db;
+	try {
+		for (const auto& endpoint : endpoints) {
+			db.add_database(Xapian::Database(endpoint.path, Xapian::DB_OPEN));
+		}
+	} catch (const Xapian::Error& exc) {
+		L_DEBUG(nullptr, "Warm-up queries could not be replayed: %s", exc.get_msg().c_str());
+		return;
+	}
+
+	const auto& registry = QueryCache::registry();
+	for (const auto& serialised : sampled) {
+		if (finished) {
+			return;
+		}
+		try {
+			Xapian::Enquire enquire(db);
+			enquire.set_query(Xapian::Query::unserialise(serialised, registry));
+			enquire.get_mset(0, WARMUP_REPLAY_LIMIT);
+			++replayed_queries;
+		} catch (const Xapian::Error& exc) {
+			L_DEBUG(nullptr, "Warm-up query could not be replayed: %s", exc.get_msg().c_str());
+		}
+	}
+
+	L_DEBUG(nullptr, "Replayed %zu warm-up %s for %s (took %s)", sampled.size(), (sampled.size() == 1) ? "query" : "queries", repr(endpoints.to_string()).c_str(), delta_string(start, std::chrono::system_clock::now()).c_str());
+}
+
+
+size_t
+DatabaseWarmup::prefetch_file(const std::string& path)
+{
+	L_CALL(nullptr, "DatabaseWarmup::prefetch_file(%s)", repr(path).c_str());
+
+	int fd = io::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return 0;
+	}
+
+	size_t prefetched = 0;
+
+	struct stat st;
+	if (::fstat(fd, &st) == 0) {
+		auto start = std::chrono::system_clock::now();
+		for (off_t offset = 0; offset < st.st_size && !finished; offset += WARMUP_CHUNK_SIZE) {
+			auto len = std::min<off_t>(WARMUP_CHUNK_SIZE, st.st_size - offset);
+			io::fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+			prefetched += len;
+			prefetched_bytes += len;
+
+			// Stay within the I/O budget
+			auto budget = std::chrono::nanoseconds(static_cast<long long>(prefetched * 1e9 / WARMUP_BYTES_PER_SECOND));
+			auto elapsed = std::chrono::system_clock::now() - start;
+			if (elapsed < budget) {
+				std::this_thread::sleep_for(budget - elapsed);
+			}
+		}
+	}
+
+	io::close(fd);
+
+	return prefetched;
+}
+
+
+void
+DatabaseWarmup::prefetch(const std::string& path)
+{
+	L_CALL(nullptr, "DatabaseWarmup::prefetch(%s)", repr(path).c_str());
+
+	const auto& tables = exists(path + "/iamchert") ? chert_tables : glass_tables;
+
+	size_t prefetched = 0;
+	for (const auto& table : tables) {
+		if (finished) {
+			return;
+		}
+		prefetched += prefetch_file(path + "/" + table);
+	}
+
+	if (prefetched) {
+		++prefetched_indexes;
+		L_DEBUG(nullptr, "Prefetched %zu bytes of %s", prefetched, repr(path).c_str());
+	}
+}
+
+
+void
+DatabaseWarmup::start()
+{
+	L_CALL(nullptr, "DatabaseWarmup::start()");
+
+	std::string serialised;
+
+	int fd = io::open(WARMUP_FILE, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return;
+	}
+	char buf[4096];
+	ssize_t r;
+	while ((r = io::read(fd, buf, sizeof(buf))) > 0) {
+		serialised.append(buf, r);
+	}
+	io::close(fd);
+
+	std::vector<std::pair<size_t, std::string>> hottest;
+	try {
+		auto obj = MsgPack::unserialise(serialised);
+		for (const auto& key : obj) {
+			hottest.emplace_back(obj.at(key).as_u64(), key.as_string());
+		}
+	} catch (const std::exception&) {
+		L_WARNING(nullptr, "Ignoring invalid warm-up file: %s", WARMUP_FILE);
+		return;
+	}
+
+	std::sort(hottest.begin(), hottest.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b) {
+		return a.first > b.first;
+	});
+
+	{
+		// Old hits count half so the list follows changes in the workload,
+		// the hottest are added last so they are the last ones evicted
+		std::lock_guard<std::mutex> lk(mtx);
+		for (auto it = hottest.rbegin(); it != hottest.rend(); ++it) {
+			hits[it->second] += it->first / 2;
+		}
+	}
+
+	if (hottest.empty()) {
+		return;
+	}
+
+	L_INFO(nullptr, "Warming up %zu %s...", hottest.size(), (hottest.size() == 1) ? "index" : "indexes");
+
+	auto& pool = thread_pool();
+	for (auto& index : hottest) {
+		try {
+			pool.enqueue([path = std::move(index.second)]() {
+				prefetch(path);
+			});
+		} catch (const std::logic_error&) {
+			// Shutting down
+			break;
+		}
+	}
+}
+
+
+void
+DatabaseWarmup::save()
+{
+	L_CALL(nullptr, "DatabaseWarmup::save()");
+
+	std::vector<std::pair<size_t, std::string>> hottest;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		hottest.reserve(hits.size());
+		for (const auto& index : hits) {
+			if (index.second) {
+				hottest.emplace_back(index.second, index.first);
+			}
+		}
+	}
+
+	if (hottest.size() > WARMUP_MAX_INDEXES) {
+		std::nth_element(hottest.begin(), hottest.begin() + WARMUP_MAX_INDEXES, hottest.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b) {
+			return a.first > b.first;
+		});
+		hottest.resize(WARMUP_MAX_INDEXES);
+	}
+
+	MsgPack obj(MsgPack::Type::MAP);
+	for (const auto& index : hottest) {
+		obj[index.second] = index.first;
+	}
+	auto serialised = obj.serialise();
+
+	// Write to a temporary file and rename it, so the list is never left half written
+	std::string tmp = WARMUP_FILE ".tmp";
+	int fd = io::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		L_WARNING(nullptr, "Cannot save warm-up file: %s (%s)", WARMUP_FILE, strerror(errno));
+		return;
+	}
+	bool written = io::write(fd, serialised.data(), serialised.size()) == static_cast<ssize_t>(serialised.size());
+	io::close(fd);
+	if (!written || ::rename(tmp.c_str(), WARMUP_FILE) == -1) {
+		L_WARNING(nullptr, "Cannot save warm-up file: %s (%s)", WARMUP_FILE, strerror(errno));
+		::unlink(tmp.c_str());
+	}
+}
+
+
+void
+DatabaseWarmup::get_stats(MsgPack& stats)
+{
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		stats["hot_indexes"] = hits.size();
+	}
+	stats["prefetched_indexes"] = prefetched_indexes.load();
+	stats["prefetched_bytes"] = prefetched_bytes.load();
+	stats["replayed_queries"] = replayed_queries.load();
+}
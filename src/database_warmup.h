@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <atomic>         // for atomic_size_t, atomic_bool
+#include <deque>          // for deque
+#include <mutex>          // for mutex
+#include <string>         // for string
+#include <unordered_set>  // for unordered_set
+
+#include "lru.h"          // for LRU
+#include "threadpool.h"   // for ThreadPool
+
+
+class Endpoints;
+class MsgPack;
+namespace Xapian {
+	class Query;
+}
+
+
+#define WARMUP_FILE               "xapiand.warmup"  /* Hot indexes, saved in the node's root */
+#define WARMUP_MAX_INDEXES        100               /* Hottest indexes to remember */
+#define WARMUP_MAX_SAMPLED        1000              /* Indexes whose searches are being sampled */
+#define WARMUP_QUERY_SAMPLE       10                /* Sample one of each this many searches */
+#define WARMUP_MAX_QUERIES        8                 /* Sampled queries to keep per index */
+#define WARMUP_REPLAY_LIMIT       10                /* Results to fetch when replaying a query */
+#define WARMUP_CHUNK_SIZE         (1024 * 1024)     /* Bytes prefetched at a time */
+#define WARMUP_BYTES_PER_SECOND   (32 * 1024 * 1024) /* Prefetch I/O budget */
+
+
+/*
+ * Keeps frequently searched indexes warm in the page cache.
+ *
+ * Searches are sampled to learn which indexes are hot (saved to WARMUP_FILE
+ * at shutdown) and to keep a few recent queries per index. At startup the
+ * tables of the hot indexes are prefetched in the background, throttled to
+ * WARMUP_BYTES_PER_SECOND. Whenever a read-only database reopens to a new
+ * revision its sampled queries are replayed in the background, against a
+ * database of their own; the reopen doesn't wait for them, so the first
+ * searches of the new revision may still run cold.
+ *
+ * Only the WARMUP_MAX_SAMPLED most recently searched indexes are sampled.
+ */
+class DatabaseWarmup {
+	static std::mutex mtx;
+	static lru::LRU<std::string, size_t> hits;                      // Sampled searches by index path
+	static lru::LRU<size_t, std::deque<std::string>> queries;       // Serialised queries by endpoints hash
+	static std::unordered_set<size_t> replaying;                    // Endpoints hashes with a replay pending
+
+	static std::atomic_size_t searches;
+	static std::atomic_bool finished;
+
+	static std::atomic_size_t prefetched_indexes;
+	static std::atomic_size_t prefetched_bytes;
+	static std::atomic_size_t replayed_queries;
+
+	static size_t prefetch_file(const std::string& path);
+	static void prefetch(const std::string& path);
+	static void replay_sampled(const Endpoints& endpoints);
+
+public:
+	static ThreadPool<>& thread_pool() {
+		static ThreadPool<> thread_pool("P%02zu", 1);
+		return thread_pool;
+	}
+
+	static void finish() {
+		finished = true;
+		thread_pool().finish();
+	}
+
+	static void join() {
+		thread_pool().join();
+	}
+
+	static size_t running_size() {
+		return thread_pool().running_size();
+	}
+
+	// Samples a search for the given endpoints
+	static void record(const Endpoints& endpoints, const Xapian::Query& query);
+
+	// Replays the sampled queries of the given (local) endpoints in the background,
+	// once their new revision is already being searched
+	static void replay(const Endpoints& endpoints);
+
+	// Loads the hot indexes and starts prefetching them in the background
+	static void start();
+
+	// Saves the hottest indexes
+	static void save();
+
+	static void get_stats(MsgPack& stats);
+};
@@ -213,35 +213,27 @@ EndpointList::show_list()
 void
 EndpointResolver::add_index_endpoint(const Endpoint &index, bool renew, bool wakeup)
 {
-	std::unique_lock<std::mutex> lk(re_qmtx);
-	action = renew ? lru::GetAction::renew : lru::GetAction::leave;
-	EndpointList &enl = (*this)[index.path];
-	action = lru::GetAction::renew;
-	lk.unlock();
+	auto enl = get_list(index.path, renew ? lru::GetAction::renew : lru::GetAction::leave);
 
-	enl.add_endpoint(index);
+	enl->add_endpoint(index);
 
-	if (wakeup) enl.wakeup();
+	if (wakeup) enl->wakeup();
 }
 
 
 bool EndpointResolver::resolve_index_endpoint(const std::string &path, std::vector<Endpoint> &endpv, size_t n_endps, duration<double, std::milli> timeout)
 {
-	std::unique_lock<std::mutex> lk(re_qmtx);
-	EndpointList &enl = (*this)[path];
-	lk.unlock();
+	auto enl = get_list(path);
 
-	return enl.resolve_endpoint(path, endpv, n_endps, timeout);
+	return enl->resolve_endpoint(path, endpv, n_endps, timeout);
 }
 
 
 bool EndpointResolver::get_master_node(const std::string &index, std::shared_ptr<const Node>* node)
 {
-	std::unique_lock<std::mutex> lk(re_qmtx);
-	EndpointList &enl = (*this)[index];
-	lk.unlock();
+	auto enl = get_list(index);
 
-	return enl.get_endpoints(1, nullptr, node);
+	return enl->get_endpoints(1, nullptr, node);
 }
 
 #endif
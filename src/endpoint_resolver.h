@@ -30,9 +30,9 @@
 #include <mutex>
 #include <queue>
 
+#include "concurrent_lru.h"
 #include "endpoint.h"
 #include "length.h"
-#include "lru.h"
 #include "times.h"
 
 class XapiandManager;
@@ -86,20 +86,16 @@ public:
 
 
 
-class EndpointResolver : public lru::LRU<std::string, EndpointList> {
-	std::mutex re_qmtx;
-
-	lru::GetAction action;
-
-	EndpointList& operator[] (const std::string& key) {
-		try {
-			return at_and([this](EndpointList&) {
-				return action;
-			}, key);
-		} catch (const std::range_error&) {
-			return insert(std::make_pair(key, EndpointList()));
+class EndpointResolver : public lru::ConcurrentLRU<std::string, std::shared_ptr<EndpointList>> {
+	std::shared_ptr<EndpointList> get_list(const std::string& key, lru::GetAction action=lru::GetAction::renew) {
+		std::shared_ptr<EndpointList> enl;
+		if (!find(key, enl, action)) {
+			enl = get(key, []() {
+				return std::make_shared<EndpointList>();
+			});
 		}
-	 }
+		return enl;
+	}
 
 public:
 	void add_index_endpoint(const Endpoint &index, bool renew, bool wakeup);
@@ -109,8 +105,7 @@ public:
 	bool get_master_node(const std::string &index, std::shared_ptr<const Node>* node);
 
 	EndpointResolver(size_t max_size) :
-	    LRU<std::string, EndpointList>(max_size),
-	    action(lru::GetAction::renew) {}
+	    ConcurrentLRU<std::string, std::shared_ptr<EndpointList>>(max_size) {}
 
 	~EndpointResolver() = default;
 };
@@ -29,54 +29,6 @@ class Convex;
 class MultiCircle;
 
 
-struct range_data {
-	bool partials;
-	uint8_t max_level;
-	std::vector<range_t> ranges;
-	std::vector<range_t> partial_ranges;
-	std::vector<range_t>& aux_ranges;
-
-	range_data(bool partials_, uint8_t max_level_)
-		: partials(partials_),
-		  max_level(max_level_),
-		  ranges(),
-		  partial_ranges(),
-		  aux_ranges(partials ? ranges : partial_ranges) { }
-
-	std::vector<range_t> getRanges() {
-		if (!partials && ranges.empty()) {
-			ranges.reserve(partial_ranges.size());
-			ranges.insert(ranges.begin(), std::make_move_iterator(partial_ranges.begin()), std::make_move_iterator(partial_ranges.end()));
-		}
-		return std::move(ranges);
-	}
-};
-
-
-struct trixel_data {
-	bool partials;
-	uint8_t max_level;
-	std::vector<std::string> trixels;
-	std::vector<std::string> partial_trixels;
-	std::vector<std::string>& aux_trixels;
-
-	trixel_data(bool partials_, uint8_t max_level_)
-		: partials(partials_),
-		  max_level(max_level_),
-		  trixels(),
-		  partial_trixels(),
-		  aux_trixels(partials ? trixels : partial_trixels) { }
-
-	std::vector<std::string> getTrixels() {
-		if (!partials && trixels.empty()) {
-			trixels.reserve(partial_trixels.size());
-			trixels.insert(trixels.begin(), std::make_move_iterator(partial_trixels.begin()), std::make_move_iterator(partial_trixels.end()));
-		}
-		return std::move(trixels);
-	}
-};
-
-
 class Circle : public Geometry {
 	friend class Convex;
 	friend class MultiCircle;
@@ -84,8 +36,6 @@ class Circle : public Geometry {
 	Constraint constraint;
 
 	TypeTrixel verifyTrixel(const Cartesian&, const Cartesian&, const Cartesian&) const;
-	void lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, std::string name, trixel_data& data, uint8_t level) const;
-	void lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, uint64_t id, range_data& data, uint8_t level) const;
 
 public:
 	template <typename T, typename = std::enable_if_t<std::is_same<Cartesian, std::decay_t<T>>::value>>
@@ -126,6 +76,5 @@ public:
 
 	std::string toWKT() const override;
 	std::string to_string() const override;
-	std::vector<std::string> getTrixels(bool partials, double error) const override;
 	std::vector<range_t> getRanges(bool partials, double error) const override;
 };
@@ -88,22 +88,6 @@ Collection::to_string() const
 }
 
 
-std::vector<std::string>
-Collection::getTrixels(bool partials, double error) const
-{
-	std::vector<std::string> trixels;
-	trixels = HTM::trixel_union(std::move(trixels), multipoint.getTrixels(partials, error));
-	trixels = HTM::trixel_union(std::move(trixels), multicircle.getTrixels(partials, error));
-	trixels = HTM::trixel_union(std::move(trixels), multiconvex.getTrixels(partials, error));
-	trixels = HTM::trixel_union(std::move(trixels), multipolygon.getTrixels(partials, error));
-	for (const auto& intersection : intersections) {
-		trixels = HTM::trixel_union(std::move(trixels), intersection.getTrixels(partials, error));
-	}
-
-	return trixels;
-}
-
-
 std::vector<range_t>
 Collection::getRanges(bool partials, double error) const
 {
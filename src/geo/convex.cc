@@ -163,161 +163,6 @@ Convex::verifyTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian&
 }
 
 
-void
-Convex::lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, std::string name, trixel_data& data, uint8_t level) const
-{
-	// Finish the recursion.
-	if (level == data.max_level) {
-		data.aux_trixels.push_back(std::move(name));
-		return;
-	}
-
-	auto w2 = HTM::midPoint(v0, v1);
-	auto w0 = HTM::midPoint(v1, v2);
-	auto w1 = HTM::midPoint(v2, v0);
-
-	TypeTrixel type_trixels[4] = {
-		verifyTrixel(v0, w2, w1),
-		verifyTrixel(v1, w0, w2),
-		verifyTrixel(v2, w1, w0),
-		verifyTrixel(w0, w1, w2)
-	};
-
-	// Number of full subtrixels.
-	uint8_t F = (type_trixels[0] == TypeTrixel::FULL) + (type_trixels[1] == TypeTrixel::FULL) + (type_trixels[2] == TypeTrixel::FULL) + (type_trixels[3] == TypeTrixel::FULL);
-
-	// Finish the recursion.
-	if (F == 4) {
-		data.trixels.push_back(std::move(name));
-		return;
-	}
-
-	++level;
-
-	switch (type_trixels[0]) {
-		case TypeTrixel::FULL:
-			data.trixels.push_back(name + "0");
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(v0, w2, w1, name + "0", data, level);
-			break;
-		default:
-			break;
-	}
-
-	switch (type_trixels[1]) {
-		case TypeTrixel::FULL:
-			data.trixels.push_back(name + "1");
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(v1, w0, w2, name + "1", data, level);
-			break;
-		default:
-			break;
-	}
-
-	switch (type_trixels[2]) {
-		case TypeTrixel::FULL:
-			data.trixels.push_back(name + "2");
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(v2, w1, w0, name + "2", data, level);
-			break;
-		default:
-			break;
-	}
-
-	switch (type_trixels[3]) {
-		case TypeTrixel::FULL:
-			data.trixels.push_back(name + "3");
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(w0, w1, w2, name + "3", data, level);
-			break;
-		default:
-			break;
-	}
-}
-
-
-void
-Convex::lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, uint64_t id, range_data& data, uint8_t level) const
-{
-	// Finish the recursion.
-	if (level == data.max_level) {
-		HTM::insertGreaterRange(data.aux_ranges, HTM::getRange(id, level));
-		return;
-	}
-
-	auto w2 = HTM::midPoint(v0, v1);
-	auto w0 = HTM::midPoint(v1, v2);
-	auto w1 = HTM::midPoint(v2, v0);
-
-	TypeTrixel type_trixels[4] = {
-		verifyTrixel(v0, w2, w1),
-		verifyTrixel(v1, w0, w2),
-		verifyTrixel(v2, w1, w0),
-		verifyTrixel(w0, w1, w2)
-	};
-
-	// Number of full subtrixels.
-	uint8_t F = (type_trixels[0] == TypeTrixel::FULL) + (type_trixels[1] == TypeTrixel::FULL) + (type_trixels[2] == TypeTrixel::FULL) + (type_trixels[3] == TypeTrixel::FULL);
-
-	// Finish the recursion.
-	if (F == 4) {
-		HTM::insertGreaterRange(data.ranges, HTM::getRange(id, level));
-		return;
-	}
-
-	++level;
-	id <<= 2;
-
-	switch (type_trixels[0]) {
-		case TypeTrixel::FULL:
-			HTM::insertGreaterRange(data.ranges, HTM::getRange(id, level));
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(v0, w2, w1, id, data, level);
-			break;
-		default:
-			break;
-	}
-
-	switch (type_trixels[1]) {
-		case TypeTrixel::FULL:
-			HTM::insertGreaterRange(data.ranges, HTM::getRange(id + 1, level));
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(v1, w0, w2, id + 1, data, level);
-			break;
-		default:
-			break;
-	}
-
-	switch (type_trixels[2]) {
-		case TypeTrixel::FULL:
-			HTM::insertGreaterRange(data.ranges, HTM::getRange(id + 2, level));
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(v2, w1, w0, id + 2, data, level);
-			break;
-		default:
-			break;
-	}
-
-	switch (type_trixels[3]) {
-		case TypeTrixel::FULL:
-			HTM::insertGreaterRange(data.ranges, HTM::getRange(id + 3, level));
-			break;
-		case TypeTrixel::PARTIAL:
-			lookupTrixel(w0, w1, w2, id + 3, data, level);
-			break;
-		default:
-			break;
-	}
-}
-
-
 std::string
 Convex::toWKT() const
 {
@@ -345,58 +190,6 @@ Convex::to_string() const
 }
 
 
-std::vector<std::string>
-Convex::getTrixels(bool partials, double error) const
-{
-	if (error < HTM_MIN_ERROR || error > HTM_MAX_ERROR) {
-		THROW(HTMError, "Error must be in [%f, %f]", HTM_MIN_ERROR, HTM_MAX_ERROR);
-	}
-
-	trixel_data data(partials, HTM_MAX_LEVEL);
-	error = error * circles.begin()->constraint.radius;
-	for (size_t i = 0; i < HTM_MAX_LEVEL; ++i) {
-		if (ERROR_NIVEL[i] < error) {
-			data.max_level = i;
-			break;
-		}
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[0].v0], start_vertices[start_trixels[0].v1], start_vertices[start_trixels[0].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[0].v0], start_vertices[start_trixels[0].v1], start_vertices[start_trixels[0].v2], start_trixels[0].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[1].v0], start_vertices[start_trixels[1].v1], start_vertices[start_trixels[1].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[1].v0], start_vertices[start_trixels[1].v1], start_vertices[start_trixels[1].v2], start_trixels[1].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[2].v0], start_vertices[start_trixels[2].v1], start_vertices[start_trixels[2].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[2].v0], start_vertices[start_trixels[2].v1], start_vertices[start_trixels[2].v2], start_trixels[2].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[3].v0], start_vertices[start_trixels[3].v1], start_vertices[start_trixels[3].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[3].v0], start_vertices[start_trixels[3].v1], start_vertices[start_trixels[3].v2], start_trixels[3].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[4].v0], start_vertices[start_trixels[4].v1], start_vertices[start_trixels[4].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[4].v0], start_vertices[start_trixels[4].v1], start_vertices[start_trixels[4].v2], start_trixels[4].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[5].v0], start_vertices[start_trixels[5].v1], start_vertices[start_trixels[5].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[5].v0], start_vertices[start_trixels[5].v1], start_vertices[start_trixels[5].v2], start_trixels[5].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[6].v0], start_vertices[start_trixels[6].v1], start_vertices[start_trixels[6].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[6].v0], start_vertices[start_trixels[6].v1], start_vertices[start_trixels[6].v2], start_trixels[6].name, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[7].v0], start_vertices[start_trixels[7].v1], start_vertices[start_trixels[7].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[7].v0], start_vertices[start_trixels[7].v1], start_vertices[start_trixels[7].v2], start_trixels[7].name, data, 0);
-	}
-
-	return data.getTrixels();
-}
-
-
 std::vector<range_t>
 Convex::getRanges(bool partials, double error) const
 {
@@ -404,46 +197,16 @@ Convex::getRanges(bool partials, double error) const
 		THROW(HTMError, "Error must be in [%f, %f]", HTM_MIN_ERROR, HTM_MAX_ERROR);
 	}
 
-	range_data data(partials, HTM_MAX_LEVEL);
+	uint8_t max_level = HTM_MAX_LEVEL;
 	error = error * circles.begin()->constraint.radius;
 	for (size_t i = 0; i < HTM_MAX_LEVEL; ++i) {
 		if (ERROR_NIVEL[i] < error) {
-			data.max_level = i;
+			max_level = i;
 			break;
 		}
 	}
 
-	if (verifyTrixel(start_vertices[start_trixels[0].v0], start_vertices[start_trixels[0].v1], start_vertices[start_trixels[0].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[0].v0], start_vertices[start_trixels[0].v1], start_vertices[start_trixels[0].v2], start_trixels[0].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[1].v0], start_vertices[start_trixels[1].v1], start_vertices[start_trixels[1].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[1].v0], start_vertices[start_trixels[1].v1], start_vertices[start_trixels[1].v2], start_trixels[1].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[2].v0], start_vertices[start_trixels[2].v1], start_vertices[start_trixels[2].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[2].v0], start_vertices[start_trixels[2].v1], start_vertices[start_trixels[2].v2], start_trixels[2].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[3].v0], start_vertices[start_trixels[3].v1], start_vertices[start_trixels[3].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[3].v0], start_vertices[start_trixels[3].v1], start_vertices[start_trixels[3].v2], start_trixels[3].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[4].v0], start_vertices[start_trixels[4].v1], start_vertices[start_trixels[4].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[4].v0], start_vertices[start_trixels[4].v1], start_vertices[start_trixels[4].v2], start_trixels[4].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[5].v0], start_vertices[start_trixels[5].v1], start_vertices[start_trixels[5].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[5].v0], start_vertices[start_trixels[5].v1], start_vertices[start_trixels[5].v2], start_trixels[5].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[6].v0], start_vertices[start_trixels[6].v1], start_vertices[start_trixels[6].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[6].v0], start_vertices[start_trixels[6].v1], start_vertices[start_trixels[6].v2], start_trixels[6].id, data, 0);
-	}
-
-	if (verifyTrixel(start_vertices[start_trixels[7].v0], start_vertices[start_trixels[7].v1], start_vertices[start_trixels[7].v2]) != TypeTrixel::OUTSIDE) {
-		lookupTrixel(start_vertices[start_trixels[7].v0], start_vertices[start_trixels[7].v1], start_vertices[start_trixels[7].v2], start_trixels[7].id, data, 0);
-	}
-
-	return data.getRanges();
+	return HTM::lookupRanges([this](const Cartesian& v0, const Cartesian& v1, const Cartesian& v2) {
+		return verifyTrixel(v0, v1, v2);
+	}, partials, max_level);
 }
@@ -42,9 +42,6 @@ class Convex : public Geometry {
 	bool intersectCircles(const Constraint& bounding_circle) const;
 	TypeTrixel verifyTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2) const;
 
-	void lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, std::string name, trixel_data& info, uint8_t level) const;
-	void lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, uint64_t id, range_data& info, uint8_t level) const;
-
 public:
 	Convex()
 		: Geometry(Type::CONVEX),
@@ -128,6 +125,5 @@ public:
 
 	std::string toWKT() const override;
 	std::string to_string() const override;
-	std::vector<std::string> getTrixels(bool partials, double error) const override;
 	std::vector<range_t> getRanges(bool partials, double error) const override;
 };
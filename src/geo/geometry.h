@@ -162,9 +162,12 @@ public:
 
 	virtual std::string toWKT() const = 0;
 	virtual std::string to_string() const = 0;
-	virtual std::vector<std::string> getTrixels(bool partials, double error) const = 0;
 	virtual std::vector<range_t> getRanges(bool partials, double error) const = 0;
 
+	std::vector<std::string> getTrixels(bool partials, double error) const {
+		return HTM::getTrixels(getRanges(partials, error));
+	}
+
 	virtual std::vector<Cartesian> getCentroids() const {
 		return std::vector<Cartesian>();
 	}
@@ -24,163 +24,10 @@
 
 #include <algorithm>
 #include <fstream>
-#include <set>
 
 #include "collection.h"
 
 
-std::vector<std::string>
-HTM::trixel_union(std::vector<std::string>&& txs1, std::vector<std::string>&& txs2)
-{
-	if (txs1.empty()) {
-		return std::move(txs2);
-	}
-
-	if (txs2.empty()) {
-		return std::move(txs1);
-	}
-
-	std::vector<std::string> res;
-	res.reserve(txs1.size() + txs2.size());
-
-	std::merge(std::make_move_iterator(txs1.begin()), std::make_move_iterator(txs1.end()),
-		std::make_move_iterator(txs2.begin()), std::make_move_iterator(txs2.end()), std::back_inserter(res));
-
-	return res;
-}
-
-
-std::vector<std::string>
-HTM::trixel_intersection(std::vector<std::string>&& txs1, std::vector<std::string>&& txs2)
-{
-	if (txs1.empty() || txs2.empty()) {
-		return std::vector<std::string>();
-	}
-
-	std::vector<std::string> res;
-	res.reserve(txs1.size() < txs2.size() ? txs1.size() : txs2.size());
-
-	const auto it1_e = txs1.end();
-	const auto it2_e = txs2.end();
-	auto it1 = txs1.begin();
-	auto it2 = txs2.begin();
-
-	while (it1 != it1_e && it2 != it2_e) {
-		if (*it1 > *it2) {
-			if (it1->find(*it2) == 0) {
-				res.push_back(std::move(*it1));
-				++it1;
-			} else {
-				++it2;
-			}
-		} else {
-			if (it2->find(*it1) == 0) {
-				res.push_back(std::move(*it2));
-				++it2;
-			} else {
-				++it1;
-			}
-		}
-	}
-
-	return res;
-}
-
-
-/*
- * Fills result with the trixels that conform to the father except trixel's son.
- *   Father      Son			 Trixels back:
- *     /\	     /\
- *    /__\      /__\	   =>	     __
- *   /\  /\					       /\  /\
- *  /__\/__\					  /__\/__\
- *
- * result is sort.
- */
-inline static void exclusive_disjunction(std::vector<std::string>& result, const std::string& father, const std::string& son, size_t depth) {
-	if (depth) {
-		switch (son.at(father.length())) {
-			case '0':
-				exclusive_disjunction(result, father + std::string(1, '0'), son, --depth);
-				result.push_back(father + std::string(1, '1'));
-				result.push_back(father + std::string(1, '2'));
-				result.push_back(father + std::string(1, '3'));
-				return;
-			case '1':
-				result.push_back(father + std::string(1, '0'));
-				exclusive_disjunction(result, father + std::string(1, '1'), son, --depth);
-				result.push_back(father + std::string(1, '2'));
-				result.push_back(father + std::string(1, '3'));
-				return;
-			case '2':
-				result.push_back(father + std::string(1, '0'));
-				result.push_back(father + std::string(1, '1'));
-				exclusive_disjunction(result, father + std::string(1, '2'), son, --depth);
-				result.push_back(father + std::string(1, '3'));
-				return;
-			case '3':
-				result.push_back(father + std::string(1, '0'));
-				result.push_back(father + std::string(1, '1'));
-				result.push_back(father + std::string(1, '2'));
-				exclusive_disjunction(result, father + std::string(1, '3'), son, --depth);
-				return;
-		}
-	}
-}
-
-
-std::vector<std::string>
-HTM::trixel_exclusive_disjunction(std::vector<std::string>&& txs1, std::vector<std::string>&& txs2)
-{
-	if (txs1.empty()) {
-		return std::move(txs2);
-	}
-
-	if (txs2.empty()) {
-		return std::move(txs1);
-	}
-
-	auto it1 = txs1.begin();
-	auto it2 = txs2.begin();
-
-	while (it1 != txs1.end() && it2 != txs2.end()) {
-		if (*it1 > *it2) {
-			if (it1->find(*it2) == 0) {
-				size_t depth = it1->length() - it2->length();
-				std::vector<std::string> subtrixels;
-				subtrixels.reserve(3 * depth);
-				exclusive_disjunction(subtrixels, *it2, *it1, depth);
-				it2 = txs2.erase(it2);
-				it2 = txs2.insert(it2, std::make_move_iterator(subtrixels.begin()), std::make_move_iterator(subtrixels.end()));
-				it1 = txs1.erase(it1);
-			} else {
-				++it2;
-			}
-		} else {
-			if (it2->find(*it1) == 0) {
-				size_t depth = it2->length() - it1->length();
-				std::vector<std::string> subtrixels;
-				subtrixels.reserve(3 * depth);
-				exclusive_disjunction(subtrixels, *it1, *it2, depth);
-				it1 = txs1.erase(it1);
-				it1 = txs1.insert(it1, std::make_move_iterator(subtrixels.begin()), std::make_move_iterator(subtrixels.end()));
-				it2 = txs2.erase(it2);
-			} else {
-				++it1;
-			}
-		}
-	}
-
-	std::vector<std::string> res;
-	res.reserve(txs1.size() + txs2.size());
-
-	std::merge(std::make_move_iterator(txs1.begin()), std::make_move_iterator(txs1.end()),
-		std::make_move_iterator(txs2.begin()), std::make_move_iterator(txs2.end()), std::back_inserter(res));
-
-	return res;
-}
-
-
 std::vector<range_t>
 HTM::range_union(std::vector<range_t>&& rs1, std::vector<range_t>&& rs2)
 {
@@ -559,56 +406,21 @@ HTM::simplifyRanges(std::vector<range_t>& ranges)
 std::string
 HTM::getTrixelName(const Cartesian& coord)
 {
-	const auto& start_trixel = startTrixel(coord);
-	auto v0 = start_vertices[start_trixel.v0];
-	auto v1 = start_vertices[start_trixel.v1];
-	auto v2 = start_vertices[start_trixel.v2];
-	auto name = start_trixel.name;
-
-	// Search in children's trixel
-	int8_t depth = HTM_MAX_LEVEL;
-	while (depth-- > 0) {
-		auto w2 = midPoint(v0, v1);
-		auto w0 = midPoint(v1, v2);
-		auto w1 = midPoint(v2, v0);
-		if (insideVertex_Trixel(coord, v0, w2, w1)) {
-			name.push_back('0');
-			v1 = w2;
-			v2 = w1;
-		} else if (insideVertex_Trixel(coord, v1, w0, w2)) {
-			name.push_back('1');
-			v0 = v1;
-			v1 = w0;
-			v2 = w2;
-		} else if (insideVertex_Trixel(coord, v2, w1, w0)) {
-			name.push_back('2');
-			v0 = v2;
-			v1 = w1;
-			v2 = w0;
-		} else {
-			name.push_back('3');
-			v0 = w0;
-			v1 = w1;
-			v2 = w2;
-		}
-	}
-
-	return name;
+	return getTrixelName(getId(coord));
 }
 
 
 std::string
 HTM::getTrixelName(uint64_t id)
 {
-	uint64_t last_pos = std::ceil(std::log2(id));
+	// The two most significant bits are the hemisphere, then two bits per level.
+	int pos = 64 - __builtin_clzll(id) - 2;
 	std::string trixel;
-	trixel.reserve(last_pos / 2);
-	last_pos -= 2;
-	uint64_t mask = static_cast<uint64_t>(3) << last_pos;
-	trixel.push_back((id & mask) == 3 ? 'S' : 'N');
-	while (mask >>= 2) {
-		last_pos -= 2;
-		trixel.push_back('0' + ((id & mask) >> last_pos));
+	trixel.reserve(pos / 2 + 2);
+	trixel.push_back((id >> pos) == 3 ? 'S' : 'N');
+	while (pos > 0) {
+		pos -= 2;
+		trixel.push_back('0' + ((id >> pos) & 3));
 	}
 
 	return trixel;
@@ -693,37 +505,14 @@ HTM::getRange(const std::string& name)
 
 
 inline static void get_trixels(std::vector<std::string>& trixels, uint64_t start, uint64_t end) {
-	if (start == end) {
-		trixels.push_back(HTM::getTrixelName(start));
-		return;
-	}
-
-	uint64_t log_inc = std::ceil(std::log2(end - start));
-	log_inc -= (log_inc % 2 == 1);
-	uint64_t max_inc = std::pow(2, log_inc);
-
-	uint64_t mod = start % max_inc;
-	uint64_t _start = mod ? start + max_inc - mod : start;
-
-	while (end < (_start + max_inc - 1)) {
-		log_inc -= 2;
-		max_inc = std::pow(2, log_inc);
-		mod = start % max_inc;
-		_start = mod ? start + max_inc - mod : start;
-	}
-
-	if (_start > start) {
-		get_trixels(trixels, start, _start - 1);
-	}
-
-	uint64_t _end = end - max_inc + 2;
-	while (_start < _end) {
-		trixels.push_back(HTM::getTrixelName(_start >> log_inc));
-		_start += max_inc;
-	}
-
-	if (_start <= end) {
-		get_trixels(trixels, _start, end);
+	while (start <= end) {
+		// Largest trixel starting at start and inside the range (a block of 4^level ids).
+		size_t shift = 0;
+		while (shift < 2 * HTM_MAX_LEVEL && !(start & ((static_cast<uint64_t>(4) << shift) - 1)) && start + (static_cast<uint64_t>(4) << shift) - 1 <= end) {
+			shift += 2;
+		}
+		trixels.push_back(HTM::getTrixelName(start >> shift));
+		start += static_cast<uint64_t>(1) << shift;
 	}
 }
 
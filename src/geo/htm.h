@@ -64,7 +64,6 @@ constexpr double ERROR_NIVEL[] = {
 
 struct trixel_t {
 	uint64_t id;
-	std::string name;
 	int v0, v1, v2;
 };
 
@@ -127,8 +126,9 @@ namespace std {
 	template<>
 	struct hash<range_t> {
 		inline size_t operator()(const range_t& p) const {
-			static std::hash<std::string> hash_fn;
-			return hash_fn(p.to_string());
+			static std::hash<uint64_t> hash_fn;
+			auto seed = hash_fn(p.start);
+			return seed ^ (hash_fn(p.end) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
 		}
 	};
 }
@@ -145,14 +145,14 @@ const Cartesian start_vertices[6] = {
 
 
 const trixel_t start_trixels[8] = {
-	{ 8,  "N0", 1, 0, 4 },
-	{ 9,  "N1", 4, 0, 3 },
-	{ 10, "N2", 3, 0, 2 },
-	{ 11, "N3", 2, 0, 1 },
-	{ 12, "S0", 1, 5, 2 },
-	{ 13, "S1", 2, 5, 3 },
-	{ 14, "S2", 3, 5, 4 },
-	{ 15, "S3", 4, 5, 1 },
+	{ 8,  1, 0, 4 },  // N0
+	{ 9,  4, 0, 3 },  // N1
+	{ 10, 3, 0, 2 },  // N2
+	{ 11, 2, 0, 1 },  // N3
+	{ 12, 1, 5, 2 },  // S0
+	{ 13, 2, 5, 3 },  // S1
+	{ 14, 3, 5, 4 },  // S2
+	{ 15, 4, 5, 1 },  // S3
 };
 
 
@@ -170,11 +170,6 @@ class Geometry;
  *   http://www.noao.edu/noao/staff/yao/sdss_papers/kunszt.pdf
  */
 namespace HTM {
-	// Union and intersection and exclusive disjunction of two sort vectors of ranges.
-	std::vector<std::string> trixel_union(std::vector<std::string>&& txs1, std::vector<std::string>&& txs2);
-	std::vector<std::string> trixel_intersection(std::vector<std::string>&& txs1, std::vector<std::string>&& txs2);
-	std::vector<std::string> trixel_exclusive_disjunction(std::vector<std::string>&& txs1, std::vector<std::string>&& txs2);
-
 	// Union, intersection and exclusive disjunction of two sort vectors of ranges.
 	std::vector<range_t> range_union(std::vector<range_t>&& rs1, std::vector<range_t>&& rs2);
 	std::vector<range_t> range_intersection(std::vector<range_t>&& rs1, std::vector<range_t>&& rs2);
@@ -214,7 +209,7 @@ namespace HTM {
 	void simplifyRanges(std::vector<range_t>& ranges);
 
 	// Calculates its trixel name.
-	std::string getTrixelName(const Cartesian& name);
+	std::string getTrixelName(const Cartesian& coord);
 	std::string getTrixelName(uint64_t id);
 
 	// Calculates its HTM id.
@@ -243,6 +238,99 @@ namespace HTM {
 		}
 	}
 
+	/*
+	 * Gets the ranges of the trixels covering a region, verify(v0, v1, v2)
+	 * returns the TypeTrixel of a trixel with respect to the region.
+	 * Trixels are subdivided up to max_level in depth-first order (using an
+	 * explicit stack, children are pushed in reverse), so ranges come out
+	 * sorted and are joined by insertGreaterRange. Partial trixels at
+	 * max_level are only returned if partials or there are no full trixels.
+	 */
+	template <typename F>
+	std::vector<range_t> lookupRanges(F&& verify, bool partials, uint8_t max_level) {
+		struct trixel_s {
+			Cartesian v0, v1, v2;
+			uint64_t id;
+			uint8_t level;
+			bool full;
+		};
+
+		std::vector<range_t> ranges;
+		std::vector<range_t> partial_ranges;
+		auto& aux_ranges = partials ? ranges : partial_ranges;
+
+		// Every subdivision pops one trixel and pushes at most four.
+		std::vector<trixel_s> stack;
+		stack.reserve(3 * max_level + 8);
+		for (int i = 7; i >= 0; --i) {
+			const auto& v0 = start_vertices[start_trixels[i].v0];
+			const auto& v1 = start_vertices[start_trixels[i].v1];
+			const auto& v2 = start_vertices[start_trixels[i].v2];
+			if (verify(v0, v1, v2) != TypeTrixel::OUTSIDE) {
+				stack.push_back({ v0, v1, v2, start_trixels[i].id, 0, false });
+			}
+		}
+
+		while (!stack.empty()) {
+			auto trixel = std::move(stack.back());
+			stack.pop_back();
+
+			if (trixel.full) {
+				insertGreaterRange(ranges, getRange(trixel.id, trixel.level));
+				continue;
+			}
+
+			if (trixel.level == max_level) {
+				insertGreaterRange(aux_ranges, getRange(trixel.id, trixel.level));
+				continue;
+			}
+
+			auto w2 = midPoint(trixel.v0, trixel.v1);
+			auto w0 = midPoint(trixel.v1, trixel.v2);
+			auto w1 = midPoint(trixel.v2, trixel.v0);
+
+			const auto id = trixel.id << 2;
+			const uint8_t level = trixel.level + 1;
+			trixel_s children[4] = {
+				{ trixel.v0, w2, w1, id,     level, false },
+				{ trixel.v1, w0, w2, id + 1, level, false },
+				{ trixel.v2, w1, w0, id + 2, level, false },
+				{ w0,        w1, w2, id + 3, level, false },
+			};
+
+			TypeTrixel type_trixels[4];
+			int full = 0;
+			for (int i = 0; i < 4; ++i) {
+				type_trixels[i] = verify(children[i].v0, children[i].v1, children[i].v2);
+				full += type_trixels[i] == TypeTrixel::FULL;
+			}
+
+			if (full == 4) {
+				insertGreaterRange(ranges, getRange(trixel.id, trixel.level));
+				continue;
+			}
+
+			for (int i = 3; i >= 0; --i) {
+				switch (type_trixels[i]) {
+					case TypeTrixel::FULL:
+						children[i].full = true;
+						stack.push_back(std::move(children[i]));
+						break;
+					case TypeTrixel::PARTIAL:
+						stack.push_back(std::move(children[i]));
+						break;
+					default:
+						break;
+				}
+			}
+		}
+
+		if (!partials && ranges.empty()) {
+			return partial_ranges;
+		}
+		return ranges;
+	}
+
 	std::tuple<Cartesian, Cartesian, Cartesian> getCorners(const std::string& name);
 
 	// Functions to test HTM trixels.
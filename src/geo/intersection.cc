@@ -63,24 +63,6 @@ Intersection::to_string() const
 }
 
 
-std::vector<std::string>
-Intersection::getTrixels(bool partials, double error) const
-{
-	if (geometries.empty()) {
-		return std::vector<std::string>();
-	}
-
-	const auto it_e = geometries.end();
-	auto it = geometries.begin();
-	auto trixels = (*it)->getTrixels(partials, error);
-	for (++it; !trixels.empty() && it != it_e; ++it) {
-		trixels = HTM::trixel_intersection(std::move(trixels), (*it)->getTrixels(partials, error));
-	}
-
-	return trixels;
-}
-
-
 std::vector<range_t>
 Intersection::getRanges(bool partials, double error) const
 {
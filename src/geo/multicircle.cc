@@ -76,18 +76,6 @@ MultiCircle::to_string() const
 }
 
 
-std::vector<std::string>
-MultiCircle::getTrixels(bool partials, double error) const
-{
-	std::vector<std::string> trixels;
-	for (const auto& circle : circles) {
-		trixels = HTM::trixel_union(std::move(trixels), circle.getTrixels(partials, error));
-	}
-
-	return trixels;
-}
-
-
 std::vector<range_t>
 MultiCircle::getRanges(bool partials, double error) const
 {
@@ -82,18 +82,6 @@ MultiConvex::to_string() const
 }
 
 
-std::vector<std::string>
-MultiConvex::getTrixels(bool partials, double error) const
-{
-	std::vector<std::string> trixels;
-	for (const auto& convex : convexs) {
-		trixels = HTM::trixel_union(std::move(trixels), convex.getTrixels(partials, error));
-	}
-
-	return trixels;
-}
-
-
 std::vector<range_t>
 MultiConvex::getRanges(bool partials, double error) const
 {
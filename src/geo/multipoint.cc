@@ -64,21 +64,6 @@ MultiPoint::to_string() const
 }
 
 
-std::vector<std::string>
-MultiPoint::getTrixels(bool, double) const
-{
-	std::vector<std::string> trixels;
-	trixels.reserve(points.size());
-	for (const auto& point : points) {
-		trixels.push_back(HTM::getTrixelName(point.p));
-	}
-
-	std::sort(trixels.begin(), trixels.end());
-
-	return trixels;
-}
-
-
 std::vector<range_t>
 MultiPoint::getRanges(bool, double) const
 {
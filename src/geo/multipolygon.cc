@@ -82,18 +82,6 @@ MultiPolygon::to_string() const
 
 
 
-std::vector<std::string>
-MultiPolygon::getTrixels(bool partials, double error) const
-{
-	std::vector<std::string> trixels;
-	for (const auto& polygon : polygons) {
-		trixels = HTM::trixel_union(std::move(trixels), polygon.getTrixels(partials, error));
-	}
-
-	return trixels;
-}
-
-
 std::vector<range_t>
 MultiPolygon::getRanges(bool partials, double error) const
 {
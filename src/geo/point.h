@@ -93,10 +93,6 @@ public:
 		return std::string(result);
 	}
 
-	std::vector<std::string> getTrixels(bool, double) const override {
-		return { HTM::getTrixelName(p) };
-	}
-
 	std::vector<range_t> getRanges(bool, double) const override {
 		auto id = HTM::getId(p);
 		return { range_t(id, id) };
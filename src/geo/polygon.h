@@ -55,8 +55,6 @@ public:
 
 		int insideVertex(const Cartesian& v) const noexcept;
 		TypeTrixel verifyTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2) const;
-		void lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, std::string name, trixel_data& data, uint8_t level) const;
-		void lookupTrixel(const Cartesian& v0, const Cartesian& v1, const Cartesian& v2, uint64_t id, range_data& data, uint8_t level) const;
 
 	public:
 		ConvexPolygon(Geometry::Type type, std::vector<Cartesian>&& points)
@@ -138,7 +136,6 @@ public:
 
 		std::string toWKT() const override;
 		std::string to_string() const override;
-		std::vector<std::string> getTrixels(bool, double) const override;
 		std::vector<range_t> getRanges(bool, double) const override;
 	};
 
@@ -217,6 +214,5 @@ public:
 
 	std::string toWKT() const override;
 	std::string to_string() const override;
-	std::vector<std::string> getTrixels(bool partials, double error) const override;
 	std::vector<range_t> getRanges(bool partials, double error) const override;
 };
@@ -24,8 +24,15 @@
 
 #include <string.h>     // for strerror, size_t
 #include <sys/errno.h>  // for __error, errno, EINTR
+#include <sys/socket.h> // for sendfile (BSD)
+#include <sys/types.h>  // for off_t
+#include <sys/uio.h>    // for sendfile (BSD)
 
-#include "config.h"     // for HAVE_PWRITE, HAVE_FSYNC
+#include "config.h"     // for HAVE_PWRITE, HAVE_FSYNC, HAVE_SENDFILE
+
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>  // for sendfile
+#endif
 #include "log.h"        // for Log, L_CALL, L_ERRNO
 
 namespace io {
@@ -279,6 +286,48 @@ ssize_t pread(int fd, void* buf, size_t nbyte, off_t offset) {
 }
 
 
+ssize_t sendfile(int out_fd, int in_fd, off_t offset, size_t nbyte) {
+	L_CALL(nullptr, "io::sendfile(%d, %d, %lu, %lu)", out_fd, in_fd, offset, nbyte);
+
+	while (true) {
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+		ssize_t c = ::sendfile(out_fd, in_fd, &offset, nbyte);
+#elif defined(HAVE_SENDFILE) && defined(__APPLE__)
+		off_t len = nbyte;
+		ssize_t c = ::sendfile(in_fd, out_fd, offset, &len, nullptr, 0);
+		if (c < 0 && len > 0) {
+			// Partially sent before being interrupted or blocked
+			c = len;
+		} else if (c == 0) {
+			c = len;
+		}
+#elif defined(HAVE_SENDFILE) && defined(__FreeBSD__)
+		off_t len = 0;
+		ssize_t c = ::sendfile(in_fd, out_fd, offset, nbyte, nullptr, &len, 0);
+		if (c < 0 && len > 0) {
+			// Partially sent before being interrupted or blocked
+			c = len;
+		} else if (c == 0) {
+			c = len;
+		}
+#else
+		(void)out_fd; (void)in_fd; (void)offset; (void)nbyte;
+		errno = ENOSYS;
+		ssize_t c = -1;
+#endif
+		if unlikely(c < 0) {
+			if (errno == EINTR) continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				// A full socket isn't an error, the caller retries once it's writable
+				L_ERRNO(nullptr, "io::sendfile() -> %s (%d): %s", strerrno(errno), errno, strerror(errno));
+			}
+			return -1;
+		}
+		return c;
+	}
+}
+
+
 int fsync(int fd) {
 	L_CALL(nullptr, "io::fsync(%d)", fd);
 
@@ -61,6 +61,10 @@ ssize_t pwrite(int fd, const void* buf, size_t nbyte, off_t offset);
 ssize_t read(int fd, void* buf, size_t nbyte);
 ssize_t pread(int fd, void* buf, size_t nbyte, off_t offset);
 
+// Copies up to nbyte bytes of in_fd (starting at offset) to out_fd (a socket),
+// without going through user space. Fails with ENOSYS if not supported.
+ssize_t sendfile(int out_fd, int in_fd, off_t offset, size_t nbyte);
+
 int fsync(int fd);
 int full_fsync(int fd);
 
@@ -0,0 +1,541 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "json_decoder.h"
+
+#include <cerrno>          // for errno, ERANGE
+#include <cstdlib>         // for strtod, strtoll, strtoull
+#include <utility>         // for move
+
+#include "exception.h"     // for ClientError, MSG_ClientError
+
+
+namespace {
+	// Stream for msgpack::packer appending to a string
+	struct StringStream {
+		std::string& str;
+
+		void write(const char* data, size_t size) {
+			str.append(data, size);
+		}
+	};
+
+
+	inline void store32(std::string& buffer, size_t pos, uint32_t size) {
+		buffer[pos + 1] = static_cast<char>((size >> 24) & 0xff);
+		buffer[pos + 2] = static_cast<char>((size >> 16) & 0xff);
+		buffer[pos + 3] = static_cast<char>((size >> 8) & 0xff);
+		buffer[pos + 4] = static_cast<char>(size & 0xff);
+	}
+
+
+	inline int hex_value(char c) {
+		if (c >= '0' && c <= '9') {
+			return c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			return c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			return c - 'A' + 10;
+		}
+		return -1;
+	}
+
+
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+
+	// Validates the JSON number grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	bool valid_number(const std::string& token, bool& is_integer) {
+		auto p = token.data();
+		auto p_end = p + token.size();
+		is_integer = true;
+		if (p != p_end && *p == '-') {
+			++p;
+		}
+		if (p == p_end) {
+			return false;
+		}
+		if (*p == '0') {
+			++p;
+		} else if (*p >= '1' && *p <= '9') {
+			while (p != p_end && *p >= '0' && *p <= '9') ++p;
+		} else {
+			return false;
+		}
+		if (p != p_end && *p == '.') {
+			is_integer = false;
+			++p;
+			auto digits = p;
+			while (p != p_end && *p >= '0' && *p <= '9') ++p;
+			if (p == digits) {
+				return false;
+			}
+		}
+		if (p != p_end && (*p == 'e' || *p == 'E')) {
+			is_integer = false;
+			++p;
+			if (p != p_end && (*p == '+' || *p == '-')) {
+				++p;
+			}
+			auto digits = p;
+			while (p != p_end && *p >= '0' && *p <= '9') ++p;
+			if (p == digits) {
+				return false;
+			}
+		}
+		return p == p_end;
+	}
+}
+
+
+JsonDecoder::JsonDecoder()
+{
+	reset();
+}
+
+
+void
+JsonDecoder::reset()
+{
+	state = State::VALUE;
+	empty_ok = false;
+	is_key = false;
+	stack.clear();
+	buffer.clear();
+	token.clear();
+	literal = nullptr;
+	literal_pos = 0;
+	codepoint = 0;
+	high_surrogate = 0;
+	unicode_digits = 0;
+	line = 1;
+	col = 0;
+	error.clear();
+	decoded = MsgPack();
+	finished = false;
+}
+
+
+void
+JsonDecoder::fail(const char* message)
+{
+	if (error.empty()) {
+		error.assign(message);
+	}
+	state = State::ERROR;
+	// Nothing decoded is of any use now
+	stack.clear();
+	buffer.clear();
+	buffer.shrink_to_fit();
+}
+
+
+void
+JsonDecoder::begin_string(bool key)
+{
+	is_key = key;
+	string_header = buffer.size();
+	buffer.append("\xdb\0\0\0\0", 5);
+	state = State::STRING;
+}
+
+
+void
+JsonDecoder::end_string()
+{
+	store32(buffer, string_header, static_cast<uint32_t>(buffer.size() - string_header - 5));
+	if (is_key) {
+		state = State::COLON;
+	} else {
+		end_value();
+	}
+}
+
+
+void
+JsonDecoder::append_codepoint(uint32_t code)
+{
+	if (code < 0x80) {
+		buffer.push_back(static_cast<char>(code));
+	} else if (code < 0x800) {
+		buffer.push_back(static_cast<char>(0xc0 | (code >> 6)));
+		buffer.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+	} else if (code < 0x10000) {
+		buffer.push_back(static_cast<char>(0xe0 | (code >> 12)));
+		buffer.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+		buffer.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+	} else {
+		buffer.push_back(static_cast<char>(0xf0 | (code >> 18)));
+		buffer.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+		buffer.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+		buffer.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+	}
+}
+
+
+bool
+JsonDecoder::end_number()
+{
+	bool is_integer;
+	if (!valid_number(token, is_integer)) {
+		fail("Invalid value.");
+		return false;
+	}
+
+	StringStream stream{buffer};
+	msgpack::packer<StringStream> packer(stream);
+	if (is_integer) {
+		errno = 0;
+		if (token[0] == '-') {
+			auto value = std::strtoll(token.c_str(), nullptr, 10);
+			if (errno != ERANGE) {
+				packer.pack_int64(value);
+				token.clear();
+				end_value();
+				return true;
+			}
+		} else {
+			auto value = std::strtoull(token.c_str(), nullptr, 10);
+			if (errno != ERANGE) {
+				packer.pack_uint64(value);
+				token.clear();
+				end_value();
+				return true;
+			}
+		}
+	}
+	packer.pack_double(std::strtod(token.c_str(), nullptr));
+	token.clear();
+	end_value();
+	return true;
+}
+
+
+void
+JsonDecoder::begin_container(bool is_map)
+{
+	stack.push_back({ is_map, buffer.size(), 0 });
+	buffer.append(is_map ? "\xdf\0\0\0\0" : "\xdd\0\0\0\0", 5);
+	state = is_map ? State::KEY : State::VALUE;
+	empty_ok = true;
+}
+
+
+void
+JsonDecoder::end_container()
+{
+	const auto& container = stack.back();
+	store32(buffer, container.header, container.size);
+	stack.pop_back();
+	end_value();
+}
+
+
+void
+JsonDecoder::end_value()
+{
+	empty_ok = false;
+	if (stack.empty()) {
+		state = State::DONE;
+	} else {
+		++stack.back().size;
+		state = State::NEXT;
+	}
+}
+
+
+void
+JsonDecoder::feed(const char* data, size_t size)
+{
+	const char* p = data;
+	const char* p_end = data + size;
+
+	while (p != p_end) {
+		char c = *p;
+
+		switch (state) {
+			case State::STRING: {
+				// Copy the run of plain characters at once
+				auto run = p;
+				while (run != p_end && *run != '"' && *run != '\\' && static_cast<unsigned char>(*run) >= 0x20) {
+					++run;
+				}
+				if (run != p) {
+					buffer.append(p, run - p);
+					col += run - p;
+					p = run;
+					continue;
+				}
+				if (c == '"') {
+					end_string();
+				} else if (c == '\\') {
+					state = State::ESCAPE;
+				} else {
+					fail("Invalid encoding in string.");
+				}
+				break;
+			}
+
+			case State::ESCAPE:
+				state = State::STRING;
+				switch (c) {
+					case '"':  buffer.push_back('"'); break;
+					case '\\': buffer.push_back('\\'); break;
+					case '/':  buffer.push_back('/'); break;
+					case 'b':  buffer.push_back('\b'); break;
+					case 'f':  buffer.push_back('\f'); break;
+					case 'n':  buffer.push_back('\n'); break;
+					case 'r':  buffer.push_back('\r'); break;
+					case 't':  buffer.push_back('\t'); break;
+					case 'u':
+						state = State::UNICODE;
+						codepoint = 0;
+						unicode_digits = 0;
+						break;
+					default:
+						fail("Invalid escape character in string.");
+						break;
+				}
+				break;
+
+			case State::UNICODE: {
+				auto value = hex_value(c);
+				if (value < 0) {
+					fail("Incorrect hex digit after \\u escape in string.");
+					break;
+				}
+				codepoint = (codepoint << 4) | value;
+				if (++unicode_digits == 4) {
+					if (high_surrogate) {
+						if (codepoint < 0xdc00 || codepoint > 0xdfff) {
+							fail("The surrogate pair in string is invalid.");
+							break;
+						}
+						append_codepoint(0x10000 + ((high_surrogate - 0xd800) << 10) + (codepoint - 0xdc00));
+						high_surrogate = 0;
+						state = State::STRING;
+					} else if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+						high_surrogate = codepoint;
+						state = State::SURROGATE_BACKSLASH;
+					} else if (codepoint >= 0xdc00 && codepoint <= 0xdfff) {
+						fail("The surrogate pair in string is invalid.");
+					} else {
+						append_codepoint(codepoint);
+						state = State::STRING;
+					}
+				}
+				break;
+			}
+
+			case State::SURROGATE_BACKSLASH:
+				if (c == '\\') {
+					state = State::SURROGATE_U;
+				} else {
+					fail("The surrogate pair in string is invalid.");
+				}
+				break;
+
+			case State::SURROGATE_U:
+				if (c == 'u') {
+					state = State::UNICODE;
+					codepoint = 0;
+					unicode_digits = 0;
+				} else {
+					fail("The surrogate pair in string is invalid.");
+				}
+				break;
+
+			case State::NUMBER:
+				if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+					token.push_back(c);
+					break;
+				}
+				// The number ends here, the character is processed again in the next state
+				if (end_number()) {
+					continue;
+				}
+				break;
+
+			case State::LITERAL:
+				if (c != literal[literal_pos]) {
+					fail("Invalid value.");
+					break;
+				}
+				if (!literal[++literal_pos]) {
+					StringStream stream{buffer};
+					msgpack::packer<StringStream> packer(stream);
+					switch (*literal) {
+						case 't':
+							packer.pack_true();
+							break;
+						case 'f':
+							packer.pack_false();
+							break;
+						default:
+							packer.pack_nil();
+							break;
+					}
+					end_value();
+				}
+				break;
+
+			case State::VALUE:
+				if (is_space(c)) {
+					break;
+				}
+				switch (c) {
+					case '{':
+						begin_container(true);
+						break;
+					case '[':
+						begin_container(false);
+						break;
+					case '"':
+						empty_ok = false;
+						begin_string(false);
+						break;
+					case 't':
+						literal = "true";
+						literal_pos = 1;
+						state = State::LITERAL;
+						break;
+					case 'f':
+						literal = "false";
+						literal_pos = 1;
+						state = State::LITERAL;
+						break;
+					case 'n':
+						literal = "null";
+						literal_pos = 1;
+						state = State::LITERAL;
+						break;
+					case ']':
+						if (empty_ok) {
+							end_container();
+						} else {
+							fail("Invalid value.");
+						}
+						break;
+					default:
+						if (c == '-' || (c >= '0' && c <= '9')) {
+							token.assign(1, c);
+							state = State::NUMBER;
+						} else {
+							fail("Invalid value.");
+						}
+						break;
+				}
+				break;
+
+			case State::KEY:
+				if (is_space(c)) {
+					break;
+				}
+				if (c == '"') {
+					empty_ok = false;
+					begin_string(true);
+				} else if (c == '}' && empty_ok) {
+					end_container();
+				} else {
+					fail("Missing a name for object member.");
+				}
+				break;
+
+			case State::COLON:
+				if (is_space(c)) {
+					break;
+				}
+				if (c == ':') {
+					state = State::VALUE;
+				} else {
+					fail("Missing a colon after a name of object member.");
+				}
+				break;
+
+			case State::NEXT:
+				if (is_space(c)) {
+					break;
+				}
+				if (c == ',') {
+					state = stack.back().is_map ? State::KEY : State::VALUE;
+				} else if (c == '}' && stack.back().is_map) {
+					end_container();
+				} else if (c == ']' && !stack.back().is_map) {
+					end_container();
+				} else if (stack.back().is_map) {
+					fail("Missing a comma or '}' after an object member.");
+				} else {
+					fail("Missing a comma or ']' after an array element.");
+				}
+				break;
+
+			case State::DONE:
+				if (!is_space(c)) {
+					fail("The document root must not be followed by other values.");
+				}
+				break;
+
+			case State::ERROR:
+				return;
+		}
+
+		if (state == State::ERROR) {
+			return;
+		}
+
+		if (c == '\n') {
+			++line;
+			col = 0;
+		} else {
+			++col;
+		}
+		++p;
+	}
+}
+
+
+MsgPack
+JsonDecoder::decode()
+{
+	if (!finished) {
+		if (state == State::NUMBER && stack.empty()) {
+			end_number();
+		}
+		if (state != State::DONE && state != State::ERROR) {
+			fail(state == State::VALUE && stack.empty() ? "The document is empty." : "Unexpected end of document.");
+		}
+		if (state == State::DONE) {
+			decoded = MsgPack::unserialise(buffer);
+			buffer.clear();
+			buffer.shrink_to_fit();
+		}
+		finished = true;
+	}
+
+	if (!error.empty()) {
+		THROW(ClientError, "JSON parse error at line %zu, col: %zu : %s", line, col + 1, error.c_str());
+	}
+
+	return std::move(decoded);
+}
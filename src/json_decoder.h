@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <cstdint>      // for uint32_t
+#include <string>       // for string
+#include <vector>       // for vector
+
+#include "msgpack.h"    // for MsgPack
+
+
+/*
+ * Incremental (push) JSON decoder. Data is fed as it arrives and gets
+ * encoded right away as msgpack, so the JSON text doesn't need to be kept
+ * around (nor a DOM built) to get the MsgPack in the end.
+ *
+ * Maps, arrays and strings are written with 32 bit headers whose sizes are
+ * patched once they're closed (sizes aren't known beforehand), numbers are
+ * encoded as MsgPack(rapidjson::Document) would.
+ *
+ * Errors are delayed until decode(), so feed() can be called from places
+ * which can't throw (i.e. http_parser callbacks).
+ */
+class JsonDecoder {
+	enum class State : uint8_t {
+		VALUE,
+		KEY,
+		COLON,
+		NEXT,
+		STRING,
+		ESCAPE,
+		UNICODE,
+		SURROGATE_BACKSLASH,
+		SURROGATE_U,
+		NUMBER,
+		LITERAL,
+		DONE,
+		ERROR,
+	};
+
+	struct Container {
+		bool is_map;
+		size_t header;
+		uint32_t size;
+	};
+
+	State state;
+	bool empty_ok;
+	bool is_key;
+	std::vector<Container> stack;
+
+	std::string buffer;      // msgpack encoded data
+	size_t string_header;
+	std::string token;       // number being decoded
+	const char* literal;
+	size_t literal_pos;
+	uint32_t codepoint;
+	uint32_t high_surrogate;
+	int unicode_digits;
+
+	size_t line;
+	size_t col;
+	std::string error;
+
+	MsgPack decoded;
+	bool finished;
+
+	void fail(const char* message);
+
+	void begin_string(bool key);
+	void end_string();
+	void append_codepoint(uint32_t code);
+	bool end_number();
+	void begin_container(bool is_map);
+	void end_container();
+	void end_value();
+
+public:
+	JsonDecoder();
+
+	void reset();
+	void feed(const char* data, size_t size);
+
+	bool empty() const noexcept {
+		return state == State::VALUE && stack.empty() && buffer.empty() && error.empty();
+	}
+
+	// Finishes decoding and hands over the MsgPack (so it can only be taken
+	// once), throws ClientError on parse errors
+	MsgPack decode();
+};
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <atomic>       // for atomic, atomic_thread_fence, memory_order_*
+#include <cstddef>      // for size_t
+#include <cstdint>      // for int64_t
+#include <memory>       // for unique_ptr
+
+
+namespace queue {
+
+	inline size_t next_power_of_2(size_t n) {
+		size_t p = 1;
+		while (p < n) {
+			p <<= 1;
+		}
+		return p;
+	}
+
+
+	/*
+	 * Bounded multi-producer multi-consumer queue (Dmitry Vyukov's algorithm).
+	 * Each cell has a sequence number telling producers and consumers whether
+	 * it's ready for them, so push and pop are a single CAS on the positions.
+	 * T should be trivially copyable (usually a pointer).
+	 */
+	template<typename T>
+	class BoundedQueue {
+		struct Cell {
+			std::atomic_size_t sequence;
+			T data;
+		};
+
+		std::unique_ptr<Cell[]> _buffer;
+		size_t _mask;
+
+		alignas(64) std::atomic_size_t _enqueue_pos;
+		alignas(64) std::atomic_size_t _dequeue_pos;
+
+	public:
+		BoundedQueue(size_t capacity)
+			: _buffer(std::make_unique<Cell[]>(next_power_of_2(capacity))),
+			  _mask(next_power_of_2(capacity) - 1),
+			  _enqueue_pos(0),
+			  _dequeue_pos(0)
+		{
+			for (size_t i = 0; i <= _mask; ++i) {
+				_buffer[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+		// Returns false if the queue is full
+		bool push(T data) {
+			Cell* cell;
+			auto pos = _enqueue_pos.load(std::memory_order_relaxed);
+			while (true) {
+				cell = &_buffer[pos & _mask];
+				auto seq = cell->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+				if (diff == 0) {
+					if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = _enqueue_pos.load(std::memory_order_relaxed);
+				}
+			}
+			cell->data = data;
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Returns false if the queue is empty
+		bool pop(T& data) {
+			Cell* cell;
+			auto pos = _dequeue_pos.load(std::memory_order_relaxed);
+			while (true) {
+				cell = &_buffer[pos & _mask];
+				auto seq = cell->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+				if (diff == 0) {
+					if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = _dequeue_pos.load(std::memory_order_relaxed);
+				}
+			}
+			data = cell->data;
+			cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Approximate number of elements
+		size_t size() const {
+			auto enqueue_pos = _enqueue_pos.load(std::memory_order_relaxed);
+			auto dequeue_pos = _dequeue_pos.load(std::memory_order_relaxed);
+			return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+		}
+
+		bool empty() const {
+			return size() == 0;
+		}
+
+		size_t capacity() const {
+			return _mask + 1;
+		}
+	};
+
+
+	/*
+	 * Fixed size work stealing deque (Chase-Lev, with the memory orderings
+	 * from Lê et al. "Correct and Efficient Work-Stealing for Weak Memory
+	 * Models"). Only the owner thread can push() and pop() at the bottom,
+	 * any other thread can steal() from the top.
+	 * T should be trivially copyable (usually a pointer).
+	 */
+	template<typename T>
+	class StealingDeque {
+		std::unique_ptr<std::atomic<T>[]> _buffer;
+		int64_t _mask;
+
+		alignas(64) std::atomic<int64_t> _top;
+		alignas(64) std::atomic<int64_t> _bottom;
+
+	public:
+		StealingDeque(size_t capacity)
+			: _buffer(std::make_unique<std::atomic<T>[]>(next_power_of_2(capacity))),
+			  _mask(static_cast<int64_t>(next_power_of_2(capacity)) - 1),
+			  _top(0),
+			  _bottom(0) { }
+
+		StealingDeque(const StealingDeque&) = delete;
+		StealingDeque& operator=(const StealingDeque&) = delete;
+
+		// Owner only. Returns false if the deque is full
+		bool push(T data) {
+			auto b = _bottom.load(std::memory_order_relaxed);
+			auto t = _top.load(std::memory_order_acquire);
+			if (b - t > _mask) {
+				return false;
+			}
+			_buffer[b & _mask].store(data, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Owner only. Returns false if the deque is empty
+		bool pop(T& data) {
+			auto b = _bottom.load(std::memory_order_relaxed) - 1;
+			_bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto t = _top.load(std::memory_order_relaxed);
+			if (t > b) {
+				// Empty
+				_bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+			data = _buffer[b & _mask].load(std::memory_order_acquire);
+			if (t == b) {
+				// Last element, race against thieves
+				bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				_bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+
+		// Any thread. Returns false if the deque is empty or the race was lost
+		bool steal(T& data) {
+			auto t = _top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto b = _bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return false;
+			}
+			data = _buffer[t & _mask].load(std::memory_order_acquire);
+			return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		// Approximate number of elements
+		size_t size() const {
+			auto b = _bottom.load(std::memory_order_relaxed);
+			auto t = _top.load(std::memory_order_relaxed);
+			return b > t ? static_cast<size_t>(b - t) : 0;
+		}
+
+		bool empty() const {
+			return size() == 0;
+		}
+	};
+};
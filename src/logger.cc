@@ -22,29 +22,33 @@
 
 #include "logger.h"
 
+#include <cctype>        // for isdigit
+#include <cstdint>       // for uint16_t, uint32_t, intmax_t
+#include <cstddef>       // for ptrdiff_t
+#include <cstdlib>       // for abs
 #include <ctime>         // for time_t
 #include <functional>    // for ref
 #include <iostream>      // for cerr
-#include <regex>         // for regex_replace, regex
-#include <stdarg.h>      // for va_list, va_end, va_start
-#include <stdexcept>     // for out_of_range
+#include <stdarg.h>      // for va_list, va_copy, va_end, va_start
 #include <stdio.h>       // for fileno, vsnprintf, stderr
+#include <string.h>      // for memchr, memcpy, strchr, strlen, strncpy, strnlen
 #include <system_error>  // for system_error
 #include <unistd.h>      // for isatty
 
 #include "datetime.h"    // for to_string
 #include "exception.h"   // for traceback
-#include "utils.h"       // for get_thread_name
+#include "msgpack.h"     // for MsgPack
+#include "utils.h"       // for get_thread_name, set_thread_name, delta_string
 
-#define BUFFER_SIZE (500 * 1024)
 #define STACKED_INDENT "<indent>"
 
+#define LOG_RECORD_PADDING  1  // Unused space at the end of the ring buffer
+#define LOG_RECORD_INFO     2  // Needs the timestamp and thread name prepended
+#define LOG_RECORD_CAPTURED 4  // Holds the format and its arguments, not the message
+
 
 std::atomic<uint64_t> logger_info_hook;
 
-const std::regex filter_re("\033\\[[;\\d]*m");
-std::mutex Log::stack_mtx;
-std::unordered_map<std::thread::id, unsigned> Log::stack_levels;
 int Log::log_level = DEFAULT_LOG_LEVEL;
 std::vector<std::unique_ptr<Logger>> Log::handlers;
 
@@ -61,6 +65,831 @@ const char *priorities[] = {
 };
 
 
+/*
+ * Removes ANSI color escape sequences (ESC [ digits/semicolons m).
+ */
+static std::string
+filter_colors(const std::string& str)
+{
+	std::string result;
+	result.reserve(str.size());
+	auto p = str.data();
+	auto p_end = p + str.size();
+	while (p != p_end) {
+		auto esc = static_cast<const char*>(memchr(p, '\033', p_end - p));
+		if (esc == nullptr) {
+			result.append(p, p_end);
+			break;
+		}
+		result.append(p, esc);
+		auto q = esc + 1;
+		if (q != p_end && *q == '[') {
+			++q;
+			while (q != p_end && (*q == ';' || (*q >= '0' && *q <= '9'))) {
+				++q;
+			}
+			if (q != p_end && *q == 'm') {
+				p = q + 1;
+				continue;
+			}
+		}
+		result.push_back(*esc);
+		p = esc + 1;
+	}
+	return result;
+}
+
+
+/*
+ * Appends the formatted string to result (no intermediate buffers for short strings).
+ */
+static void
+vappend(std::string& result, const char *format, va_list argptr)
+{
+	char buffer[1024];
+	va_list args;
+	va_copy(args, argptr);
+	auto len = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (len < 0) {
+		return;
+	}
+	if (static_cast<size_t>(len) < sizeof(buffer)) {
+		result.append(buffer, len);
+		return;
+	}
+	auto pos = result.size();
+	result.resize(pos + len + 1);
+	va_copy(args, argptr);
+	vsnprintf(&result[pos], len + 1, format, args);
+	va_end(args);
+	result.resize(pos + len);
+}
+
+
+static void
+append_formatted(std::string& result, const char *format, ...)
+{
+	va_list argptr;
+	va_start(argptr, format);
+	vappend(result, format, argptr);
+	va_end(argptr);
+}
+
+
+/*
+ * A printf conversion specification, as far as knowing the type of its
+ * argument goes. Width and precision given as '*' take an int argument each.
+ */
+struct FormatSpec {
+	enum class Arg {
+		NONE,
+		INT,
+		LONG,
+		LONG_LONG,
+		SIZE,
+		INTMAX,
+		PTRDIFF,
+		DOUBLE,
+		LONG_DOUBLE,
+		STRING,
+		POINTER,
+		UNSUPPORTED,
+	};
+
+	Arg arg;
+	const char* width_star;
+	const char* precision_star;
+	int precision;
+};
+
+
+// Parses the specification following a '%' at p, returns where it ends.
+static const char*
+parse_spec(const char* p, FormatSpec& spec)
+{
+	spec = FormatSpec{ FormatSpec::Arg::UNSUPPORTED, nullptr, nullptr, -1 };
+
+	while (*p && strchr("-+ #0'", *p)) {
+		++p;
+	}
+	if (*p == '*') {
+		spec.width_star = p++;
+	} else {
+		while (isdigit(*p)) {
+			++p;
+		}
+	}
+	if (*p == '.') {
+		++p;
+		if (*p == '*') {
+			spec.precision_star = p++;
+		} else {
+			spec.precision = 0;
+			while (isdigit(*p)) {
+				spec.precision = spec.precision * 10 + (*p++ - '0');
+			}
+		}
+	}
+
+	char length = '\0';
+	switch (*p) {
+		case 'h':
+			length = *p++;
+			if (*p == 'h') {
+				++p;
+			}
+			break;
+		case 'l':
+			length = *p++;
+			if (*p == 'l') {
+				length = 'q';
+				++p;
+			}
+			break;
+		case 'q':
+		case 'L':
+		case 'z':
+		case 'j':
+		case 't':
+			length = *p++;
+			break;
+	}
+
+	switch (*p) {
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'c':
+			switch (length) {
+				case '\0':
+				case 'h':
+					spec.arg = FormatSpec::Arg::INT;
+					break;
+				case 'l':
+					spec.arg = *p == 'c' ? FormatSpec::Arg::UNSUPPORTED : FormatSpec::Arg::LONG;
+					break;
+				case 'q':
+					spec.arg = FormatSpec::Arg::LONG_LONG;
+					break;
+				case 'z':
+					spec.arg = FormatSpec::Arg::SIZE;
+					break;
+				case 'j':
+					spec.arg = FormatSpec::Arg::INTMAX;
+					break;
+				case 't':
+					spec.arg = FormatSpec::Arg::PTRDIFF;
+					break;
+			}
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			spec.arg = length == 'L' ? FormatSpec::Arg::LONG_DOUBLE : FormatSpec::Arg::DOUBLE;
+			break;
+		case 's':
+			spec.arg = length ? FormatSpec::Arg::UNSUPPORTED : FormatSpec::Arg::STRING;
+			break;
+		case 'p':
+			spec.arg = FormatSpec::Arg::POINTER;
+			break;
+		case '%':
+			spec.arg = FormatSpec::Arg::NONE;
+			break;
+	}
+
+	return *p ? p + 1 : p;
+}
+
+
+template <typename T>
+inline static void
+capture(std::string& blob, T value)
+{
+	blob.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template <typename T>
+inline static T
+uncapture(const char*& p)
+{
+	T value;
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return value;
+}
+
+
+inline static void
+capture_string(std::string& blob, const char* str, size_t length)
+{
+	capture<uint32_t>(blob, length);
+	blob.append(str, length);
+}
+
+
+/*
+ * Copies the arguments of format into blob, so the message can be formatted
+ * later by the logging thread. Strings are copied as they might not outlive
+ * the call. Returns false for conversions it doesn't know how to copy.
+ */
+static bool
+capture_args(std::string& blob, const char* format, va_list argptr)
+{
+	va_list args;
+	va_copy(args, argptr);
+	bool captured = true;
+	for (const char* p = format; *p && captured;) {
+		if (*p++ != '%') {
+			continue;
+		}
+		FormatSpec spec;
+		p = parse_spec(p, spec);
+		if (spec.width_star) {
+			capture(blob, va_arg(args, int));
+		}
+		auto precision = spec.precision;
+		if (spec.precision_star) {
+			precision = va_arg(args, int);
+			capture(blob, precision);
+		}
+		switch (spec.arg) {
+			case FormatSpec::Arg::NONE:
+				break;
+			case FormatSpec::Arg::INT:
+				capture(blob, va_arg(args, int));
+				break;
+			case FormatSpec::Arg::LONG:
+				capture(blob, va_arg(args, long));
+				break;
+			case FormatSpec::Arg::LONG_LONG:
+				capture(blob, va_arg(args, long long));
+				break;
+			case FormatSpec::Arg::SIZE:
+				capture(blob, va_arg(args, size_t));
+				break;
+			case FormatSpec::Arg::INTMAX:
+				capture(blob, va_arg(args, intmax_t));
+				break;
+			case FormatSpec::Arg::PTRDIFF:
+				capture(blob, va_arg(args, ptrdiff_t));
+				break;
+			case FormatSpec::Arg::DOUBLE:
+				capture(blob, va_arg(args, double));
+				break;
+			case FormatSpec::Arg::LONG_DOUBLE:
+				capture(blob, va_arg(args, long double));
+				break;
+			case FormatSpec::Arg::STRING: {
+				auto str = va_arg(args, const char*);
+				if (!str) {
+					str = "(null)";
+				}
+				capture_string(blob, str, precision < 0 ? strlen(str) : strnlen(str, precision));
+				break;
+			}
+			case FormatSpec::Arg::POINTER:
+				capture(blob, va_arg(args, void*));
+				break;
+			case FormatSpec::Arg::UNSUPPORTED:
+				captured = false;
+				break;
+		}
+	}
+	va_end(args);
+	return captured;
+}
+
+
+/*
+ * Formats the arguments captured by capture_args(), p is left past them.
+ */
+static void
+format_args(std::string& result, const char* format, const char*& p)
+{
+	std::string spec_str;
+	std::string str;
+	const char* f = format;
+	while (*f) {
+		auto percent = strchr(f, '%');
+		if (!percent) {
+			result.append(f);
+			break;
+		}
+		result.append(f, percent - f);
+
+		FormatSpec spec;
+		f = parse_spec(percent + 1, spec);
+
+		// Widths and precisions taken from the arguments go in the specification
+		spec_str.clear();
+		for (auto c = percent; c != f; ++c) {
+			if (c == spec.width_star) {
+				spec_str.append(std::to_string(uncapture<int>(p)));
+			} else if (c == spec.precision_star) {
+				auto precision = uncapture<int>(p);
+				if (precision < 0) {
+					spec_str.pop_back();  // Negative precisions are taken as if omitted
+				} else {
+					spec_str.append(std::to_string(precision));
+				}
+			} else {
+				spec_str.push_back(*c);
+			}
+		}
+
+		switch (spec.arg) {
+			case FormatSpec::Arg::NONE:
+				result.push_back('%');
+				break;
+			case FormatSpec::Arg::INT:
+				append_formatted(result, spec_str.c_str(), uncapture<int>(p));
+				break;
+			case FormatSpec::Arg::LONG:
+				append_formatted(result, spec_str.c_str(), uncapture<long>(p));
+				break;
+			case FormatSpec::Arg::LONG_LONG:
+				append_formatted(result, spec_str.c_str(), uncapture<long long>(p));
+				break;
+			case FormatSpec::Arg::SIZE:
+				append_formatted(result, spec_str.c_str(), uncapture<size_t>(p));
+				break;
+			case FormatSpec::Arg::INTMAX:
+				append_formatted(result, spec_str.c_str(), uncapture<intmax_t>(p));
+				break;
+			case FormatSpec::Arg::PTRDIFF:
+				append_formatted(result, spec_str.c_str(), uncapture<ptrdiff_t>(p));
+				break;
+			case FormatSpec::Arg::DOUBLE:
+				append_formatted(result, spec_str.c_str(), uncapture<double>(p));
+				break;
+			case FormatSpec::Arg::LONG_DOUBLE:
+				append_formatted(result, spec_str.c_str(), uncapture<long double>(p));
+				break;
+			case FormatSpec::Arg::STRING: {
+				auto length = uncapture<uint32_t>(p);
+				str.assign(p, length);
+				p += length;
+				append_formatted(result, spec_str.c_str(), str.c_str());
+				break;
+			}
+			case FormatSpec::Arg::POINTER:
+				append_formatted(result, spec_str.c_str(), uncapture<void*>(p));
+				break;
+			case FormatSpec::Arg::UNSUPPORTED:
+				// Never captured
+				return;
+		}
+	}
+}
+
+
+/*
+ * Captured message body: the text before the formatted message, the format
+ * (null terminated), the text after it and then the arguments.
+ */
+static bool
+capture_body(std::string& blob, bool stacked, const char *file, int line, const char *suffix, const char *prefix, const char *format, va_list argptr)
+{
+	auto start = blob.size();
+	capture<uint32_t>(blob, 0);
+	blob.push_back(' ');
+#ifdef LOG_LOCATION
+	blob.append(" ").append(file).append(":").append(std::to_string(line)).append(": ");
+#else
+	(void)file;
+	(void)line;
+#endif
+	if (stacked) {
+		blob.append(STACKED_INDENT);
+	}
+	blob.append(prefix);
+	uint32_t length = blob.size() - start - sizeof(uint32_t);
+	memcpy(&blob[start], &length, sizeof(uint32_t));
+
+	capture_string(blob, format, strlen(format) + 1);
+	capture_string(blob, suffix, strlen(suffix));
+	return capture_args(blob, format, argptr);
+}
+
+
+static void
+format_body(std::string& result, const char* p)
+{
+	auto length = uncapture<uint32_t>(p);
+	result.append(p, length);
+	p += length;
+
+	length = uncapture<uint32_t>(p);
+	auto format = p;
+	p += length;
+
+	length = uncapture<uint32_t>(p);
+	auto suffix = p;
+	p += length;
+
+	format_args(result, format, p);
+	result.append(suffix, length);
+}
+
+
+/*
+ * Binary log record, as written by producers into their ring buffer.
+ * The message (or its captured format and arguments) follows the header,
+ * unless it was too long for the ring, in which case it's in overflow.
+ */
+struct LogRecord {
+	uint32_t size;         // Space used in the ring buffer (header and message, aligned)
+	uint32_t length;       // Length of the message
+	int16_t priority;
+	uint16_t indent;
+	uint32_t flags;
+	unsigned long long created_at;  // As in time_point_to_ullong()
+	const void* obj;
+	std::string* overflow;
+	char thread_name[32];
+};
+
+
+inline static size_t
+record_size(size_t length)
+{
+	return (sizeof(LogRecord) + length + alignof(LogRecord) - 1) & ~(alignof(LogRecord) - 1);
+}
+
+
+/*
+ * Single producer, single consumer ring buffer of variable sized records.
+ * Records never wrap around: if one doesn't fit before the end of the
+ * buffer the remaining space is skipped.
+ */
+class LogRing {
+	std::unique_ptr<char[]> _buffer;
+	size_t _mask;
+
+	alignas(64) std::atomic_size_t _head;  // Consumer position
+	alignas(64) std::atomic_size_t _tail;  // Producer position
+
+public:
+	// Counters are only written by the producer
+	std::atomic_size_t written;
+	std::atomic_size_t dropped;
+	std::atomic_size_t waited;
+
+	std::atomic_bool finished;
+
+	LogRing(size_t size)
+		: _buffer(std::make_unique<char[]>(size)),
+		  _mask(size - 1),
+		  _head(0),
+		  _tail(0),
+		  written(0),
+		  dropped(0),
+		  waited(0),
+		  finished(false) { }
+
+	size_t capacity() const {
+		return _mask + 1;
+	}
+
+	// Producer only. Returns room for size bytes, or nullptr if the ring is full.
+	char* reserve(size_t size) {
+		auto tail = _tail.load(std::memory_order_relaxed);
+		auto free = capacity() - (tail - _head.load(std::memory_order_acquire));
+		auto offset = tail & _mask;
+		auto contiguous = capacity() - offset;
+		if (contiguous < size) {
+			if (free < contiguous + size) {
+				return nullptr;
+			}
+			if (contiguous >= sizeof(LogRecord)) {
+				auto padding = reinterpret_cast<LogRecord*>(&_buffer[offset]);
+				padding->size = contiguous;
+				padding->flags = LOG_RECORD_PADDING;
+			}
+			_tail.store(tail + contiguous, std::memory_order_release);
+			return &_buffer[0];
+		}
+		if (free < size) {
+			return nullptr;
+		}
+		return &_buffer[offset];
+	}
+
+	// Producer only. Publishes the record written in the reserved space.
+	void commit(size_t size) {
+		_tail.store(_tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+	}
+
+	// Consumer only. Returns the oldest record, or nullptr if the ring is empty.
+	LogRecord* front() {
+		while (true) {
+			auto head = _head.load(std::memory_order_relaxed);
+			if (head == _tail.load(std::memory_order_acquire)) {
+				return nullptr;
+			}
+			auto offset = head & _mask;
+			auto contiguous = capacity() - offset;
+			if (contiguous < sizeof(LogRecord)) {
+				_head.store(head + contiguous, std::memory_order_release);
+				continue;
+			}
+			auto record = reinterpret_cast<LogRecord*>(&_buffer[offset]);
+			if (record->flags & LOG_RECORD_PADDING) {
+				_head.store(head + record->size, std::memory_order_release);
+				continue;
+			}
+			return record;
+		}
+	}
+
+	// Consumer only. Releases the record returned by front().
+	void pop(const LogRecord* record) {
+		_head.store(_head.load(std::memory_order_relaxed) + record->size, std::memory_order_release);
+	}
+};
+
+
+/*
+ * Asynchronous log records go to the calling thread's ring buffer (no locks,
+ * no allocations) and a single background thread merges them in creation
+ * order, formats them, prepends timestamp and thread name and hands them to
+ * the handlers.
+ * When a ring is full, errors wait a bit for room (backpressure) and the
+ * rest are dropped; both are counted.
+ */
+class LogQueue {
+	struct LocalRing {
+		std::shared_ptr<LogRing> ring;
+
+		~LocalRing() {
+			if (ring) {
+				ring->finished = true;
+			}
+		}
+	};
+
+	static thread_local LocalRing local_ring;
+
+	std::mutex mtx;
+	std::condition_variable wakeup_signal;
+	std::vector<std::shared_ptr<LogRing>> rings;
+
+	// Counters from rings of threads already gone
+	size_t written;
+	size_t dropped;
+	size_t waited;
+	size_t reported_dropped;
+
+	std::atomic_bool running;
+	std::atomic_bool sleeping;
+	std::thread inner_thread;
+
+	LogRing& ring() {
+		if (!local_ring.ring) {
+			local_ring.ring = std::make_shared<LogRing>(LOG_RING_SIZE);
+			std::lock_guard<std::mutex> lk(mtx);
+			rings.push_back(local_ring.ring);
+		}
+		return *local_ring.ring;
+	}
+
+	void wakeup() {
+		if (sleeping.load()) {
+			std::lock_guard<std::mutex> lk(mtx);
+			wakeup_signal.notify_one();
+		}
+	}
+
+	void emit(const LogRecord& record) {
+		std::string msg;
+		if (record.flags & LOG_RECORD_INFO) {
+			msg = Log::str_info(time_point_from_ullong(record.created_at), record.thread_name, record.obj);
+		}
+		const char* data = record.overflow ? record.overflow->data() : reinterpret_cast<const char*>(&record + 1);
+		if (record.flags & LOG_RECORD_CAPTURED) {
+			format_body(msg, data);
+		} else {
+			msg.append(data, record.length);
+		}
+		delete record.overflow;
+		auto log_age = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - time_point_from_ullong(record.created_at)).count();
+		if (log_age > 2e8) {
+			msg += " ~" + delta_string(log_age, true);
+		}
+		Log::log(record.priority, msg, record.indent);
+	}
+
+	// Writes pending records from all rings, oldest first
+	size_t flush(const std::vector<std::shared_ptr<LogRing>>& active) {
+		size_t count = 0;
+		// Bounded, so new rings are picked up even under constant load
+		while (count < 1024) {
+			LogRing* oldest_ring = nullptr;
+			LogRecord* oldest = nullptr;
+			for (auto& ring : active) {
+				auto record = ring->front();
+				if (record && (!oldest || record->created_at < oldest->created_at)) {
+					oldest_ring = ring.get();
+					oldest = record;
+				}
+			}
+			if (!oldest) {
+				break;
+			}
+			emit(*oldest);
+			oldest_ring->pop(oldest);
+			++count;
+		}
+		return count;
+	}
+
+	void report_dropped() {
+		size_t total = dropped;
+		{
+			std::lock_guard<std::mutex> lk(mtx);
+			for (auto& ring : rings) {
+				total += ring->dropped.load(std::memory_order_relaxed);
+			}
+		}
+		if (total != reported_dropped) {
+			Log::log(LOG_WARNING, Log::str_info(std::chrono::system_clock::now(), get_thread_name(), nullptr) + " " + WARNING_COL + std::to_string(total - reported_dropped) + " log messages dropped (ring buffers full)" + NO_COL);
+			reported_dropped = total;
+		}
+	}
+
+	void run() {
+		set_thread_name("LOG");
+
+		std::vector<std::shared_ptr<LogRing>> active;
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lk(mtx);
+				for (auto it = rings.begin(); it != rings.end();) {
+					auto& ring = *it;
+					if (ring->finished && !ring->front()) {
+						written += ring->written.load(std::memory_order_relaxed);
+						dropped += ring->dropped.load(std::memory_order_relaxed);
+						waited += ring->waited.load(std::memory_order_relaxed);
+						it = rings.erase(it);
+					} else {
+						++it;
+					}
+				}
+				active = rings;
+			}
+
+			if (flush(active)) {
+				continue;
+			}
+
+			report_dropped();
+
+			if (!running) {
+				break;
+			}
+
+			std::unique_lock<std::mutex> lk(mtx);
+			sleeping.store(true);
+			bool pending = false;
+			for (auto& ring : active) {
+				if (ring->front()) {
+					pending = true;
+					break;
+				}
+			}
+			if (!pending && running) {
+				wakeup_signal.wait_for(lk, 100ms);
+			}
+			sleeping.store(false);
+		}
+	}
+
+public:
+	LogQueue()
+		: written(0),
+		  dropped(0),
+		  waited(0),
+		  reported_dropped(0),
+		  running(true),
+		  sleeping(false),
+		  inner_thread(&LogQueue::run, this) { }
+
+	~LogQueue() {
+		finish(1);
+	}
+
+	/*
+	 * Queues a message (or a captured body, see capture_body()), returns
+	 * false if the queue is not running (the caller should then log
+	 * synchronously).
+	 */
+	bool push(int priority, unsigned indent, uint32_t flags, std::chrono::time_point<std::chrono::system_clock> created_at, const void* obj, const std::string& msg) {
+		if (!running) {
+			return false;
+		}
+
+		auto& ring = this->ring();
+
+		bool overflow = msg.size() > ring.capacity() / 4;
+		auto size = record_size(overflow ? 0 : msg.size());
+
+		auto ptr = ring.reserve(size);
+		if (!ptr) {
+			if (std::abs(priority) > LOG_ERR) {
+				ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				wakeup();
+				return true;
+			}
+			ring.waited.store(ring.waited.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOG_RING_TIMEOUT);
+			do {
+				wakeup();
+				std::this_thread::sleep_for(1ms);
+				ptr = ring.reserve(size);
+			} while (!ptr && std::chrono::steady_clock::now() < deadline);
+			if (!ptr) {
+				ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		auto record = reinterpret_cast<LogRecord*>(ptr);
+		record->size = size;
+		record->length = overflow ? 0 : msg.size();
+		record->priority = priority;
+		record->indent = indent;
+		record->flags = flags;
+		record->created_at = time_point_to_ullong(created_at);
+		record->obj = obj;
+		record->overflow = overflow ? new std::string(msg) : nullptr;
+		if (flags & LOG_RECORD_INFO) {
+			strncpy(record->thread_name, get_thread_name().c_str(), sizeof(record->thread_name) - 1);
+			record->thread_name[sizeof(record->thread_name) - 1] = '\0';
+		} else {
+			record->thread_name[0] = '\0';
+		}
+		if (!overflow) {
+			memcpy(record + 1, msg.data(), msg.size());
+		}
+		ring.commit(size);
+
+		ring.written.store(ring.written.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		wakeup();
+		return true;
+	}
+
+	void finish(int wait) {
+		running = false;
+		{
+			std::lock_guard<std::mutex> lk(mtx);
+		}
+		wakeup_signal.notify_all();
+
+		if (wait) {
+			join();
+		}
+	}
+
+	void join() {
+		try {
+			if (inner_thread.joinable()) {
+				inner_thread.join();
+			}
+		} catch (const std::system_error&) { }
+	}
+
+	void get_stats(MsgPack& stats) {
+		std::lock_guard<std::mutex> lk(mtx);
+		auto total_written = written;
+		auto total_dropped = dropped;
+		auto total_waited = waited;
+		for (auto& ring : rings) {
+			total_written += ring->written.load(std::memory_order_relaxed);
+			total_dropped += ring->dropped.load(std::memory_order_relaxed);
+			total_waited += ring->waited.load(std::memory_order_relaxed);
+		}
+		stats["rings"] = rings.size();
+		stats["written"] = total_written;
+		stats["dropped"] = total_dropped;
+		stats["waited"] = total_waited;
+	}
+};
+
+
+thread_local LogQueue::LocalRing LogQueue::local_ring;
+
+
 void
 println(bool with_endl, const char *format, va_list argptr, const void* obj, bool info)
 {
@@ -88,17 +917,24 @@ _log(bool cleanup, bool stacked, std::chrono::time_point<std::chrono::system_clo
 
 
 LogWrapper::LogWrapper(LogWrapper&& o)
-	: log(std::move(o.log))
+	: log(std::move(o.log)),
+	  stack_counter(std::move(o.stack_counter))
 {
 	o.log.reset();
+	o.stack_counter.reset();
 }
 
 
 LogWrapper&
 LogWrapper::operator=(LogWrapper&& o)
 {
+	if (stack_counter) {
+		--(*stack_counter);
+	}
 	log = std::move(o.log);
+	stack_counter = std::move(o.stack_counter);
 	o.log.reset();
+	o.stack_counter.reset();
 	return *this;
 }
 
@@ -106,33 +942,40 @@ LogWrapper::LogWrapper(LogType log_)
 	: log(log_) { }
 
 
+LogWrapper::LogWrapper(std::shared_ptr<std::atomic<unsigned>> stack_counter_)
+	: stack_counter(std::move(stack_counter_)) { }
+
+
 LogWrapper::~LogWrapper()
 {
 	if (log) {
 		log->cleanup();
 	}
 	log.reset();
+	if (stack_counter) {
+		--(*stack_counter);
+	}
 }
 
 
 bool
 LogWrapper::unlog(int priority, const char *file, int line, const char *suffix, const char *prefix, const void *obj, const char *format, va_list argptr)
 {
-	return log->unlog(priority, file, line, suffix, prefix, obj, format, argptr);
+	return log ? log->unlog(priority, file, line, suffix, prefix, obj, format, argptr) : false;
 }
 
 
 bool
 LogWrapper::clear()
 {
-	return log->clear();
+	return log ? log->clear() : false;
 }
 
 
 long double
 LogWrapper::age()
 {
-	return log->age();
+	return log ? log->age() : 0;
 }
 
 
@@ -148,7 +991,7 @@ LogWrapper::release()
 void
 StreamLogger::log(int priority, const std::string& str, bool with_priority, bool with_endl)
 {
-	ofs << std::regex_replace((with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str, filter_re, "");
+	ofs << filter_colors((with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str);
 	if (with_endl) {
 		ofs << std::endl;
 	}
@@ -161,7 +1004,7 @@ StderrLogger::log(int priority, const std::string& str, bool with_priority, bool
 	if (isatty(fileno(stderr))) {
 		std::cerr << (with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str;
 	} else {
-		std::cerr << std::regex_replace((with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str, filter_re, "");
+		std::cerr << filter_colors((with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str);
 	}
 	if (with_endl) {
 		std::cerr << std::endl;
@@ -184,7 +1027,16 @@ SysLog::~SysLog()
 void
 SysLog::log(int priority, const std::string& str, bool with_priority, bool)
 {
-	syslog(priority, "%s", std::regex_replace((with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str, filter_re, "").c_str());
+	syslog(priority, "%s", filter_colors((with_priority ? priorities[priority < 0 ? -priority : priority] : "") + str).c_str());
+}
+
+
+// Each thread has its own counter of stacked logs still alive
+static const std::shared_ptr<std::atomic<unsigned>>&
+local_stack_counter()
+{
+	static thread_local auto stack_counter = std::make_shared<std::atomic<unsigned>>(0);
+	return stack_counter;
 }
 
 
@@ -200,13 +1052,8 @@ Log::Log(const std::string& str, bool clean_, bool stacked_, bool async_, int pr
 {
 
 	if (stacked) {
-		std::lock_guard<std::mutex> lk(stack_mtx);
-		thread_id = std::this_thread::get_id();
-		try {
-			stack_level = ++stack_levels.at(thread_id);
-		} catch (const std::out_of_range&) {
-			stack_levels[thread_id] = 0;
-		}
+		stack_counter = local_stack_counter();
+		stack_level = (*stack_counter)++;
 	}
 }
 
@@ -224,11 +1071,8 @@ Log::cleanup()
 	cleared_at.compare_exchange_strong(c, clean ? time_point_to_ullong(std::chrono::system_clock::now()) : 0);
 
 	if (!cleaned.exchange(true)) {
-		if (stacked) {
-			std::lock_guard<std::mutex> lk(stack_mtx);
-			if (stack_levels.at(thread_id)-- == 0) {
-				stack_levels.erase(thread_id);
-			}
+		if (stack_counter) {
+			--(*stack_counter);
 		}
 	}
 }
@@ -255,10 +1099,19 @@ Log::scheduler()
 }
 
 
+LogQueue&
+Log::queue()
+{
+	static LogQueue queue;
+	return queue;
+}
+
+
 void
 Log::finish(int wait)
 {
 	scheduler().finish(wait);
+	queue().finish(wait);
 }
 
 
@@ -266,6 +1119,14 @@ void
 Log::join()
 {
 	scheduler().join();
+	queue().join();
+}
+
+
+void
+Log::get_stats(MsgPack& stats)
+{
+	queue().get_stats(stats);
 }
 
 
@@ -284,26 +1145,31 @@ Log::run()
 
 
 std::string
-Log::str_format(bool stacked, int priority, const std::string& exc, const char *file, int line, const char *suffix, const char *prefix, const void* obj, const char *format, va_list argptr, bool info)
+Log::str_info(std::chrono::time_point<std::chrono::system_clock> created_at, const std::string& thread_name, const void* obj)
 {
-	char* buffer = new char[BUFFER_SIZE];
-	vsnprintf(buffer, BUFFER_SIZE, format, argptr);
-	std::string msg(buffer);
 	std::string result;
-	if (info) {
-		auto iso8601 = "[" + Datetime::to_string(std::chrono::system_clock::now()) + "]";
-		auto tid = " (" + get_thread_name() + ")";
-		result = iso8601 + tid;
+	result.reserve(64);
+	result.append("[");
+	result.append(Datetime::to_string(created_at));
+	result.append("] (");
+	result.append(thread_name);
+	result.append(")");
 #ifdef LOG_OBJ_ADDRESS
-		if (obj) {
-			snprintf(buffer, BUFFER_SIZE, " [%p]", obj);
-			result += buffer;
-		}
+	if (obj) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), " [%p]", obj);
+		result.append(buffer);
+	}
 #else
-		(void)obj;
+	(void)obj;
 #endif
-	}
+	return result;
+}
 
+
+void
+Log::str_body(std::string& result, bool stacked, int priority, const std::string& exc, const char *file, int line, const char *suffix, const char *prefix, const char *format, va_list argptr)
+{
 	result += " ";
 
 #ifdef LOG_LOCATION
@@ -313,8 +1179,9 @@ Log::str_format(bool stacked, int priority, const std::string& exc, const char *
 	if (stacked) {
 		result += STACKED_INDENT;
 	}
-	result += prefix + msg + suffix;
-	delete []buffer;
+	result += prefix;
+	vappend(result, format, argptr);
+	result += suffix;
 	if (priority < 0) {
 		if (exc.empty()) {
 			result += DARK_GREY + traceback(file, line) + NO_COL;
@@ -322,6 +1189,17 @@ Log::str_format(bool stacked, int priority, const std::string& exc, const char *
 			result += NO_COL + exc + NO_COL;
 		}
 	}
+}
+
+
+std::string
+Log::str_format(bool stacked, int priority, const std::string& exc, const char *file, int line, const char *suffix, const char *prefix, const void* obj, const char *format, va_list argptr, bool info)
+{
+	std::string result;
+	if (info) {
+		result = str_info(std::chrono::system_clock::now(), get_thread_name(), obj);
+	}
+	str_body(result, stacked, priority, exc, file, line, suffix, prefix, format, argptr);
 	return result;
 }
 
@@ -329,11 +1207,54 @@ Log::str_format(bool stacked, int priority, const std::string& exc, const char *
 LogWrapper
 Log::log(bool clean, bool stacked, std::chrono::time_point<std::chrono::system_clock> wakeup, bool async, int priority, const std::string& exc, const char *file, int line, const char *suffix, const char *prefix, const void *obj, const char *format, va_list argptr)
 {
+	auto now = std::chrono::system_clock::now();
+
 	if (priority > log_level) {
-		return LogWrapper(std::make_shared<Log>("", clean, stacked, async, priority, std::chrono::system_clock::now()));
+		if (clean) {
+			return LogWrapper(std::make_shared<Log>("", clean, stacked, async, priority, now));
+		}
+		// Nothing to log, stacked logs still indent the ones inside them
+		if (stacked) {
+			const auto& stack_counter = local_stack_counter();
+			++(*stack_counter);
+			return LogWrapper(stack_counter);
+		}
+		return LogWrapper(LogType());
 	}
 
-	std::string str(str_format(stacked, priority, exc, file, line, suffix, prefix, obj, format, argptr, true)); // TODO: Slow!
+	if (async && wakeup <= now && !clean) {
+		// Only the arguments are copied here, the logging thread formats the message
+		std::shared_ptr<std::atomic<unsigned>> stack_counter;
+		unsigned stack_level = 0;
+		if (stacked) {
+			stack_counter = local_stack_counter();
+			stack_level = (*stack_counter)++;
+		}
+		static thread_local std::string body;
+		body.clear();
+		uint32_t flags = LOG_RECORD_INFO;
+		if (priority >= 0 && exc.empty() && capture_body(body, stacked, file, line, suffix, prefix, format, argptr)) {
+			flags |= LOG_RECORD_CAPTURED;
+		} else {
+			body.clear();
+			str_body(body, stacked, priority, exc, file, line, suffix, prefix, format, argptr);
+		}
+		if (!queue().push(priority, stack_level * 2, flags, now, obj, body)) {
+			auto msg = str_info(now, get_thread_name(), obj);
+			if (flags & LOG_RECORD_CAPTURED) {
+				format_body(msg, body.data());
+			} else {
+				msg.append(body);
+			}
+			log(priority, msg, stack_level * 2);
+		}
+		if (stacked) {
+			return LogWrapper(std::move(stack_counter));
+		}
+		return LogWrapper(LogType());
+	}
+
+	std::string str(str_format(stacked, priority, exc, file, line, suffix, prefix, obj, format, argptr, true));
 
 	return print(str, clean, stacked, wakeup, async, priority);
 }
@@ -414,11 +1335,13 @@ Log::print(const std::string& str, bool clean, bool stacked, std::chrono::time_p
 		return LogWrapper(std::make_shared<Log>(str, clean, stacked, async, priority, created_at));
 	}
 
-	if (async || wakeup > std::chrono::system_clock::now()) {
+	if (wakeup > std::chrono::system_clock::now()) {
 		return add(str, clean, stacked, wakeup, async, priority, created_at);
-	} else {
-		auto l_ptr = std::make_shared<Log>(str, clean, stacked, async, priority, created_at);
+	}
+
+	auto l_ptr = std::make_shared<Log>(str, clean, stacked, async, priority, created_at);
+	if (!async || !queue().push(priority, l_ptr->stack_level * 2, 0, created_at, nullptr, str)) {
 		log(priority, str, l_ptr->stack_level * 2);
-		return LogWrapper(l_ptr);
 	}
+	return LogWrapper(l_ptr);
 }
@@ -34,7 +34,6 @@
 #include <thread>             // for thread, thread::id
 #include <time.h>             // for time_t
 #include <type_traits>        // for forward, decay_t, enable_if_t, is_base_of
-#include <unordered_map>      // for unordered_map
 #include <vector>             // for vector
 
 #include "logger_fwd.h"
@@ -43,6 +42,12 @@
 
 
 #define DEFAULT_LOG_LEVEL LOG_WARNING  // The default log_level (higher than this are filtered out)
+#define LOG_RING_SIZE (64 * 1024)      // Size of each thread's ring buffer of pending log records
+#define LOG_RING_TIMEOUT 100           // Milliseconds errors wait for room in a full ring buffer before being dropped
+
+
+class MsgPack;
+class LogQueue;
 
 
 class Logger {
@@ -84,14 +89,17 @@ class LogWrapper;
 
 class Log : public ScheduledTask {
 	friend class LogWrapper;
+	friend class LogQueue;
 
 	static Scheduler& scheduler();
+	static LogQueue& queue();
 
 	static LogWrapper add(const std::string& str, bool cleanup, bool stacked, std::chrono::time_point<std::chrono::system_clock> wakeup, bool async, int priority, std::chrono::time_point<std::chrono::system_clock> created_at=std::chrono::system_clock::now());
 
-	static std::mutex stack_mtx;
-	static std::unordered_map<std::thread::id, unsigned> stack_levels;
-	std::thread::id thread_id;
+	static std::string str_info(std::chrono::time_point<std::chrono::system_clock> created_at, const std::string& thread_name, const void *obj);
+	static void str_body(std::string& result, bool stacked, int priority, const std::string& exc, const char *file, int line, const char *suffix, const char *prefix, const char *format, va_list argptr);
+
+	std::shared_ptr<std::atomic<unsigned>> stack_counter;
 	unsigned stack_level;
 	bool stacked;
 
@@ -117,6 +125,7 @@ public:
 
 	static void finish(int wait=10);
 	static void join();
+	static void get_stats(MsgPack& stats);
 	static void add(const TaskType& task, std::chrono::time_point<std::chrono::system_clock> wakeup);
 
 	static void log(int priority, std::string str, int indent=0, bool with_priority=true, bool with_endl=true);
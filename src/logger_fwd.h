@@ -26,6 +26,7 @@
 #include <atomic>             // for atomic_uulong
 #include <chrono>             // for system_clock, time_point, duration, millise...
 #include <cstdarg>            // for va_list, va_end
+#include <memory>             // for shared_ptr
 
 #include "exception.h"
 #include "utils.h"
@@ -48,6 +49,9 @@ using LogType = std::shared_ptr<Log>;
 class LogWrapper {
 	LogType log;
 
+	// Stacked logs with no Log object only hold their thread's stack level
+	std::shared_ptr<std::atomic<unsigned>> stack_counter;
+
 	LogWrapper(const LogWrapper&) = delete;
 	LogWrapper& operator=(const LogWrapper&) = delete;
 
@@ -56,6 +60,7 @@ public:
 	LogWrapper& operator=(LogWrapper&& o);
 
 	LogWrapper(LogType log_);
+	LogWrapper(std::shared_ptr<std::atomic<unsigned>> stack_counter_);
 	~LogWrapper();
 
 	bool unlog(int priority, const char *file, int line, const char *suffix, const char *prefix, const void *obj, const char *format, va_list argptr);
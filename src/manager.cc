@@ -31,6 +31,7 @@
 #include <ctype.h>                           // for isspace
 #include <exception>                         // for exception
 #include <functional>                        // for __base
+#include <future>                            // for future, promise
 #include <ifaddrs.h>                         // for ifaddrs, freeifaddrs
 #include <memory>                            // for allocator, shared_ptr
 #include <mutex>                             // for mutex, lock_guard, uniqu...
@@ -55,9 +56,12 @@
 
 #include "async_fsync.h"                     // for AsyncFsync
 #include "atomic_shared_ptr.h"               // for atomic_shared_ptr
+#include "data_dictionary.h"                 // for DataDictionary
 #include "database.h"                        // for DatabasePool
 #include "database_autocommit.h"             // for DatabaseAutocommit
 #include "database_handler.h"                // for DatabaseHandler
+#include "database_recovery.h"               // for DatabaseRecovery
+#include "database_warmup.h"                 // for DatabaseWarmup
 #include "database_utils.h"                  // for RESERVED_TYPE, DB_NOWAL
 #include "endpoint.h"                        // for Node, Endpoint, local_node
 #include "ev/ev++.h"                         // for async, loop_ref (ptr only)
@@ -65,7 +69,9 @@
 #include "http_parser.h"                     // for http_method
 #include "io_utils.h"                        // for close, open, read, write
 #include "log.h"                             // for Log, L_CALL, L_DEBUG
+#include "logger.h"                          // for Log::get_stats
 #include "msgpack.h"                         // for MsgPack, object::object
+#include "multivalue/doc_values.h"           // for DocValues
 #include "serialise.h"                       // for TERM_STR
 #include "servers/http.h"                    // for Http
 #include "servers/server.h"                  // for XapiandServer, XapiandSe...
@@ -103,6 +109,9 @@ XapiandManager::XapiandManager(ev::loop_ref* ev_loop_, unsigned int ev_flags_, c
 	: Worker(nullptr, ev_loop_, ev_flags_),
 	  database_pool(o.dbpool_size),
 	  schemas(o.dbpool_size),
+	  query_cache(QUERY_CACHE_SIZE),
+	  cover_cache(COVER_CACHE_SIZE),
+	  suggesters(SUGGESTER_CACHE_SIZE),
 	  thread_pool("W%02zu", o.threadpool_size),
 	  server_pool("S%02zu", o.num_servers),
 #ifdef XAPIAND_CLUSTERING
@@ -121,6 +130,7 @@ XapiandManager::XapiandManager(ev::loop_ref* ev_loop_, unsigned int ev_flags_, c
 #endif
 	  strict(o.strict),
 	  optimal(o.optimal),
+	  doc_values(o.doc_values),
 	  atom_sig(0),
 	  signal_sig_async(*ev_loop)
 {
@@ -653,6 +663,9 @@ XapiandManager::run(const opts_t& o)
 	DatabaseAutocommit::scheduler(o.num_committers);
 	AsyncFsync::scheduler(o.num_committers);
 
+	DatabaseRecovery::start(o.num_recoverers);
+	DatabaseWarmup::start();
+
 	std::string msg = "Started " + std::to_string(o.num_servers) + ((o.num_servers == 1) ? " server" : " servers");
 	msg += ", " + std::to_string(o.threadpool_size) +( (o.threadpool_size == 1) ? " worker thread" : " worker threads");
 #ifdef XAPIAND_CLUSTERING
@@ -701,6 +714,18 @@ XapiandManager::finish()
 
 	L_MANAGER(this, "Finishing async fsync pool!");
 	AsyncFsync::finish();
+
+	L_MANAGER(this, "Finishing recovery pool!");
+	DatabaseRecovery::finish();
+
+	L_MANAGER(this, "Finishing warm-up pool!");
+	DatabaseWarmup::finish();
+
+	L_MANAGER(this, "Finishing data dictionaries pool!");
+	DataDictionary::finish();
+
+	L_MANAGER(this, "Finishing doc values pool!");
+	DocValues::finish();
 }
 
 
@@ -735,6 +760,33 @@ XapiandManager::join()
 	L_MANAGER(this, "Waiting for %zu async fsync%s...", AsyncFsync::running_size(), (AsyncFsync::running_size() == 1) ? "" : "s");
 	AsyncFsync::join();
 
+	L_MANAGER(this, "Finishing recovery threads pool!");
+	DatabaseRecovery::finish();
+
+	L_MANAGER(this, "Waiting for %zu recoverer%s...", DatabaseRecovery::running_size(), (DatabaseRecovery::running_size() == 1) ? "" : "s");
+	DatabaseRecovery::join();
+
+	L_MANAGER(this, "Finishing warm-up threads pool!");
+	DatabaseWarmup::finish();
+
+	L_MANAGER(this, "Waiting for %zu warm-up thread%s...", DatabaseWarmup::running_size(), (DatabaseWarmup::running_size() == 1) ? "" : "s");
+	DatabaseWarmup::join();
+
+	L_MANAGER(this, "Finishing data dictionaries threads pool!");
+	DataDictionary::finish();
+
+	L_MANAGER(this, "Waiting for %zu data dictionary trainer%s...", DataDictionary::running_size(), (DataDictionary::running_size() == 1) ? "" : "s");
+	DataDictionary::join();
+
+	L_MANAGER(this, "Finishing doc values threads pool!");
+	DocValues::finish();
+
+	L_MANAGER(this, "Waiting for %zu doc values builder%s...", DocValues::running_size(), (DocValues::running_size() == 1) ? "" : "s");
+	DocValues::join();
+
+	L_MANAGER(this, "Saving hot indexes!");
+	DatabaseWarmup::save();
+
 	L_MANAGER(this, "Finishing worker threads pool!");
 	thread_pool.finish();
 
@@ -952,12 +1004,70 @@ XapiandManager::trigger_replication(const Endpoint& src_endpoint, const Endpoint
 {
 	L_CALL(this, "XapiandManager::trigger_replication(%s, %s)", repr(src_endpoint.to_string()).c_str(), repr(dst_endpoint.to_string()).c_str());
 
+	{
+		std::lock_guard<std::mutex> lk(replications_mtx);
+		auto it = replications.find(dst_endpoint.path);
+		if (it != replications.end()) {
+			// Already replicating, replicate (only once more) after it's done
+			L_REPLICATION(this, "Replication of %s already in progress, merging trigger", repr(dst_endpoint.to_string()).c_str());
+			it->second.pending = true;
+			it->second.src_endpoint = src_endpoint;
+			std::promise<bool> promise;
+			promise.set_value(true);
+			return promise.get_future();
+		}
+		replications.emplace(dst_endpoint.path, Replication{ false, src_endpoint });
+	}
+
 	if (auto binary = weak_binary.lock()) {
-		return binary->trigger_replication(src_endpoint, dst_endpoint);
+		try {
+			return binary->trigger_replication(src_endpoint, dst_endpoint);
+		} catch (const std::logic_error&) {
+			// The task was dropped and its guard already cleared the entry
+			L_WARNING(this, "Cannot enqueue replication of %s", repr(dst_endpoint.to_string()).c_str());
+			return std::future<bool>();
+		}
 	}
+
+	std::lock_guard<std::mutex> lk(replications_mtx);
+	replications.erase(dst_endpoint.path);
 	return std::future<bool>();
 }
 
+
+XapiandManager::ReplicationGuard::~ReplicationGuard()
+{
+	if (active && XapiandManager::manager) {
+		// Dropped before it ran, don't try to re-trigger merged replications
+		XapiandManager::manager->replication_done(dst_endpoint, false);
+	}
+}
+
+
+void
+XapiandManager::replication_done(const Endpoint& dst_endpoint, bool merged)
+{
+	L_CALL(this, "XapiandManager::replication_done(%s, %s)", repr(dst_endpoint.to_string()).c_str(), merged ? "true" : "false");
+
+	Endpoint src_endpoint;
+	{
+		std::lock_guard<std::mutex> lk(replications_mtx);
+		auto it = replications.find(dst_endpoint.path);
+		if (it == replications.end()) {
+			return;
+		}
+		bool pending = it->second.pending;
+		src_endpoint = it->second.src_endpoint;
+		replications.erase(it);
+		if (!pending || !merged) {
+			return;
+		}
+	}
+
+	L_DEBUG(this, "Triggering merged replication for %s", repr(dst_endpoint.to_string()).c_str());
+	trigger_replication(src_endpoint, dst_endpoint);
+}
+
 #endif
 
 
@@ -1005,9 +1115,49 @@ XapiandManager::server_status(MsgPack& stats)
 	stats["worker_tasks_enqueued"] = thread_pool.size();
 	stats["worker_tasks_pool_size"] = thread_pool.threadpool_size();
 
+	database_pool.get_stats(stats["database_pool"]);
+
+	Log::get_stats(stats["logger"]);
+
+	auto schemas_stats = schemas.stats();
+	auto& schemas_cache = stats["schemas_cache"];
+	schemas_cache["size"] = schemas.size();
+	schemas_cache["hits"] = schemas_stats.hits;
+	schemas_cache["misses"] = schemas_stats.misses;
+	schemas_cache["evictions"] = schemas_stats.evictions;
+
+	auto query_cache_stats = query_cache.stats();
+	auto& query_cache_ = stats["query_cache"];
+	query_cache_["size"] = query_cache.size();
+	query_cache_["bytes"] = query_cache.weight();
+	query_cache_["hits"] = query_cache_stats.hits;
+	query_cache_["misses"] = query_cache_stats.misses;
+	query_cache_["evictions"] = query_cache_stats.evictions;
+
+	auto cover_cache_stats = cover_cache.stats();
+	auto& cover_cache_ = stats["cover_cache"];
+	cover_cache_["size"] = cover_cache.size();
+	cover_cache_["bytes"] = cover_cache.weight();
+	cover_cache_["hits"] = cover_cache_stats.hits;
+	cover_cache_["misses"] = cover_cache_stats.misses;
+	cover_cache_["evictions"] = cover_cache_stats.evictions;
+
+	auto suggesters_stats = suggesters.stats();
+	auto& suggesters_ = stats["suggesters"];
+	suggesters_["size"] = suggesters.size();
+	suggesters_["bytes"] = suggesters.weight();
+	suggesters_["hits"] = suggesters_stats.hits;
+	suggesters_["misses"] = suggesters_stats.misses;
+	suggesters_["evictions"] = suggesters_stats.evictions;
+	suggesters_["builds"] = suggesters.builds();
+	suggesters_["updates"] = suggesters.updates();
+
 	stats["servers_threads"] = server_pool.running_size();
 	stats["committers_threads"] = DatabaseAutocommit::running_size();
+	DatabaseAutocommit::get_stats(stats["autocommit"]);
 	stats["fsync_threads"] = AsyncFsync::running_size();
+	DatabaseRecovery::get_stats(stats["wal_recovery"]);
+	DatabaseWarmup::get_stats(stats["warmup"]);
 #ifdef XAPIAND_CLUSTERING
 	if(!solo) {
 		stats["replicator_threads"] = replicator_pool.running_size();
@@ -30,12 +30,15 @@
 #include <unordered_map>
 
 #include "cppcodec/base64_default_url_unpadded.hpp"
+#include "cover_cache.h"
 #include "database.h"
 #include "endpoint_resolver.h"
 #include "ev/ev++.h"
 #include "length.h"
+#include "query_cache.h"
 #include "schemas_lru.h"
 #include "stats.h"
+#include "suggester.h"
 #include "threadpool.h"
 #include "worker.h"
 
@@ -50,6 +53,7 @@ struct opts_t {
 	bool solo;
 	bool strict;
 	bool optimal;
+	bool doc_values;
 	std::string database;
 	std::string cluster_name;
 	std::string node_name;
@@ -69,6 +73,7 @@ struct opts_t {
 	size_t threadpool_size;
 	size_t endpoints_list_size;
 	size_t num_committers;
+	size_t num_recoverers;
 	size_t max_clients;
 	unsigned int ev_flags;
 };
@@ -120,6 +125,18 @@ class XapiandManager : public Worker  {
 
 	void _get_stats_time(MsgPack& stats, int start, int end, int increment);
 
+#ifdef XAPIAND_CLUSTERING
+	// Replications in flight, by destination path. Triggers arriving while
+	// a replication is going on are merged into a single pending one.
+	struct Replication {
+		bool pending;
+		Endpoint src_endpoint;
+	};
+
+	std::mutex replications_mtx;
+	std::unordered_map<std::string, Replication> replications;
+#endif
+
 protected:
 	std::mutex nodes_mtx;
 	nodes_map_t nodes;
@@ -166,6 +183,9 @@ public:
 
 	DatabasePool database_pool;
 	SchemasLRU schemas;
+	QueryCache query_cache;
+	CoverCache cover_cache;
+	SuggesterCache suggesters;
 
 	ThreadPool<> thread_pool;
 	ThreadPool<> server_pool;
@@ -185,6 +205,7 @@ public:
 	bool solo;
 	bool strict;
 	bool optimal;
+	bool doc_values;
 
 	std::atomic_int atom_sig;
 	ev::async signal_sig_async;
@@ -220,6 +241,29 @@ public:
 	int32_t get_region();
 
 	std::future<bool> trigger_replication(const Endpoint& src_endpoint, const Endpoint& dst_endpoint);
+	void replication_done(const Endpoint& dst_endpoint, bool merged=true);
+
+	// Clears the in-flight replication entry of dst_endpoint unless released,
+	// so a replication task dropped before it runs (shutdown, failed enqueue)
+	// doesn't block every later trigger for the same path.
+	class ReplicationGuard {
+		Endpoint dst_endpoint;
+		bool active;
+
+	public:
+		explicit ReplicationGuard(const Endpoint& dst_endpoint_)
+			: dst_endpoint(dst_endpoint_),
+			  active(true) { }
+
+		ReplicationGuard(const ReplicationGuard&) = delete;
+		ReplicationGuard& operator=(const ReplicationGuard&) = delete;
+
+		~ReplicationGuard();
+
+		void release() noexcept {
+			active = false;
+		}
+	};
 #endif
 
 	bool resolve_index_endpoint(const std::string &path, std::vector<Endpoint> &endpv, size_t n_endps=1, std::chrono::duration<double, std::milli> timeout=1s);
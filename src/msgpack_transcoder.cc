@@ -0,0 +1,616 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "msgpack_transcoder.h"
+
+#include <cstdint>                      // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstring>                      // for memcpy, memcmp
+#include <fnmatch.h>                    // for fnmatch
+#include <iterator>                     // for back_inserter
+#include <utility>                      // for pair
+
+#include "exception.h"                  // for SerialisationError, MSG_SerialisationError
+#include "msgpack/sysdep.h"             // for _msgpack_load16, _msgpack_store16...
+#include "rapidjson/prettywriter.h"     // for PrettyWriter
+#include "rapidjson/stringbuffer.h"     // for StringBuffer
+#include "rapidjson/writer.h"           // for Writer
+#include "split.h"                      // for Split
+
+
+namespace {
+
+enum class Kind : uint8_t {
+	NIL,
+	BOOLEAN,
+	POSITIVE_INTEGER,
+	NEGATIVE_INTEGER,
+	FLOAT,
+	STR,
+	ARRAY,
+	MAP,
+};
+
+
+/*
+ * Header of a MsgPack object, strings (and bins and exts) come with
+ * their payload.
+ */
+struct Header {
+	Kind kind;
+	union {
+		bool boolean;
+		uint64_t u64;
+		int64_t i64;
+		double f64;
+	} via;
+	const char* ptr;
+	uint32_t size;  // Length of strings, number of elements of arrays and maps
+};
+
+
+inline void
+need(const char* p, const char* end, size_t n)
+{
+	if (static_cast<size_t>(end - p) < n) {
+		THROW(SerialisationError, "Truncated MsgPack data");
+	}
+}
+
+
+inline uint64_t
+load(const char*& p, const char* end, size_t n)
+{
+	need(p, end, n);
+	uint64_t value;
+	switch (n) {
+		case 1:
+			value = static_cast<uint8_t>(*p);
+			break;
+		case 2: {
+			uint16_t v;
+			_msgpack_load16(uint16_t, p, &v);
+			value = v;
+			break;
+		}
+		case 4: {
+			uint32_t v;
+			_msgpack_load32(uint32_t, p, &v);
+			value = v;
+			break;
+		}
+		default: {
+			uint64_t v;
+			_msgpack_load64(uint64_t, p, &v);
+			value = v;
+			break;
+		}
+	}
+	p += n;
+	return value;
+}
+
+
+inline void
+set_signed(Header& header, int64_t value)
+{
+	if (value < 0) {
+		header.kind = Kind::NEGATIVE_INTEGER;
+		header.via.i64 = value;
+	} else {
+		header.kind = Kind::POSITIVE_INTEGER;
+		header.via.u64 = value;
+	}
+}
+
+
+inline void
+set_payload(Header& header, const char*& p, const char* end, Kind kind, uint32_t size)
+{
+	need(p, end, size);
+	header.kind = kind;
+	header.ptr = p;
+	header.size = size;
+	p += size;
+}
+
+
+Header
+read_header(const char*& p, const char* end)
+{
+	need(p, end, 1);
+	Header header;
+	uint8_t c = static_cast<uint8_t>(*p++);
+	if (c <= 0x7f) {
+		header.kind = Kind::POSITIVE_INTEGER;
+		header.via.u64 = c;
+	} else if (c <= 0x8f) {
+		header.kind = Kind::MAP;
+		header.size = c & 0x0f;
+	} else if (c <= 0x9f) {
+		header.kind = Kind::ARRAY;
+		header.size = c & 0x0f;
+	} else if (c <= 0xbf) {
+		set_payload(header, p, end, Kind::STR, c & 0x1f);
+	} else if (c >= 0xe0) {
+		header.kind = Kind::NEGATIVE_INTEGER;
+		header.via.i64 = static_cast<int8_t>(c);
+	} else {
+		switch (c) {
+			case 0xc0:  // nil
+				header.kind = Kind::NIL;
+				break;
+			case 0xc2:  // false
+			case 0xc3:  // true
+				header.kind = Kind::BOOLEAN;
+				header.via.boolean = c == 0xc3;
+				break;
+			case 0xc4:  // bin 8
+			case 0xd9:  // str 8
+				set_payload(header, p, end, Kind::STR, load(p, end, 1));
+				break;
+			case 0xc5:  // bin 16
+			case 0xda:  // str 16
+				set_payload(header, p, end, Kind::STR, load(p, end, 2));
+				break;
+			case 0xc6:  // bin 32
+			case 0xdb:  // str 32
+				set_payload(header, p, end, Kind::STR, load(p, end, 4));
+				break;
+			case 0xc7:  // ext 8
+				set_payload(header, p, end, Kind::NIL, load(p, end, 1) + 1);
+				break;
+			case 0xc8:  // ext 16
+				set_payload(header, p, end, Kind::NIL, load(p, end, 2) + 1);
+				break;
+			case 0xc9:  // ext 32
+				set_payload(header, p, end, Kind::NIL, load(p, end, 4) + 1);
+				break;
+			case 0xca: {  // float 32
+				uint32_t bits = load(p, end, 4);
+				float f;
+				memcpy(&f, &bits, sizeof(f));
+				header.kind = Kind::FLOAT;
+				header.via.f64 = f;
+				break;
+			}
+			case 0xcb: {  // float 64
+				uint64_t bits = load(p, end, 8);
+				header.kind = Kind::FLOAT;
+				memcpy(&header.via.f64, &bits, sizeof(header.via.f64));
+				break;
+			}
+			case 0xcc:  // uint 8
+				header.kind = Kind::POSITIVE_INTEGER;
+				header.via.u64 = load(p, end, 1);
+				break;
+			case 0xcd:  // uint 16
+				header.kind = Kind::POSITIVE_INTEGER;
+				header.via.u64 = load(p, end, 2);
+				break;
+			case 0xce:  // uint 32
+				header.kind = Kind::POSITIVE_INTEGER;
+				header.via.u64 = load(p, end, 4);
+				break;
+			case 0xcf:  // uint 64
+				header.kind = Kind::POSITIVE_INTEGER;
+				header.via.u64 = load(p, end, 8);
+				break;
+			case 0xd0:  // int 8
+				set_signed(header, static_cast<int8_t>(load(p, end, 1)));
+				break;
+			case 0xd1:  // int 16
+				set_signed(header, static_cast<int16_t>(load(p, end, 2)));
+				break;
+			case 0xd2:  // int 32
+				set_signed(header, static_cast<int32_t>(load(p, end, 4)));
+				break;
+			case 0xd3:  // int 64
+				set_signed(header, static_cast<int64_t>(load(p, end, 8)));
+				break;
+			case 0xd4:  // fixext 1
+			case 0xd5:  // fixext 2
+			case 0xd6:  // fixext 4
+			case 0xd7:  // fixext 8
+			case 0xd8:  // fixext 16
+				set_payload(header, p, end, Kind::NIL, (1 << (c - 0xd4)) + 1);
+				break;
+			case 0xdc:  // array 16
+				header.kind = Kind::ARRAY;
+				header.size = load(p, end, 2);
+				break;
+			case 0xdd:  // array 32
+				header.kind = Kind::ARRAY;
+				header.size = load(p, end, 4);
+				break;
+			case 0xde:  // map 16
+				header.kind = Kind::MAP;
+				header.size = load(p, end, 2);
+				break;
+			case 0xdf:  // map 32
+				header.kind = Kind::MAP;
+				header.size = load(p, end, 4);
+				break;
+			default:
+				THROW(SerialisationError, "Invalid MsgPack data");
+		}
+	}
+	return header;
+}
+
+
+void
+skip(const char*& p, const char* end)
+{
+	auto header = read_header(p, end);
+	switch (header.kind) {
+		case Kind::ARRAY:
+			for (uint32_t i = 0; i < header.size; ++i) {
+				skip(p, end);
+			}
+			break;
+		case Kind::MAP:
+			for (uint32_t i = 0; i < header.size; ++i) {
+				skip(p, end);
+				skip(p, end);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+// Writes JSON the same way converting to a rapidjson::Document would (see xchange/rapidjson.hpp)
+template <typename Writer>
+void
+write_json(Writer& writer, const char*& p, const char* end)
+{
+	auto header = read_header(p, end);
+	switch (header.kind) {
+		case Kind::NIL:
+			writer.Null();
+			break;
+		case Kind::BOOLEAN:
+			writer.Bool(header.via.boolean);
+			break;
+		case Kind::POSITIVE_INTEGER:
+			writer.Uint64(header.via.u64);
+			break;
+		case Kind::NEGATIVE_INTEGER:
+			writer.Int64(header.via.i64);
+			break;
+		case Kind::FLOAT:
+			writer.Double(header.via.f64);
+			break;
+		case Kind::STR:
+			writer.String(header.ptr, header.size);
+			break;
+		case Kind::ARRAY:
+			writer.StartArray();
+			for (uint32_t i = 0; i < header.size; ++i) {
+				write_json(writer, p, end);
+			}
+			writer.EndArray();
+			break;
+		case Kind::MAP:
+			writer.StartObject();
+			for (uint32_t i = 0; i < header.size; ++i) {
+				auto key = read_header(p, end);
+				if (key.kind != Kind::STR) {
+					THROW(SerialisationError, "MsgPack map keys must be strings");
+				}
+				writer.Key(key.ptr, key.size);
+				write_json(writer, p, end);
+			}
+			writer.EndObject();
+			break;
+	}
+}
+
+
+void
+write_map_header(std::string& out, size_t size)
+{
+	if (size < 16) {
+		out.push_back(static_cast<char>(0x80u | size));
+	} else if (size < 65536) {
+		char buf[3];
+		buf[0] = static_cast<char>(0xdeu); _msgpack_store16(&buf[1], static_cast<uint16_t>(size));
+		out.append(buf, 3);
+	} else {
+		char buf[5];
+		buf[0] = static_cast<char>(0xdfu); _msgpack_store32(&buf[1], static_cast<uint32_t>(size));
+		out.append(buf, 5);
+	}
+}
+
+
+// Selectors still being matched, with the index of their next path level
+using Selection = std::vector<std::pair<const std::vector<std::string>*, size_t>>;
+
+
+inline bool
+glob_match(const std::string& pattern, const std::string& key)
+{
+	if (pattern.find_first_of("*?[") == std::string::npos) {
+		return pattern == key;
+	}
+	return ::fnmatch(pattern.c_str(), key.c_str(), 0) == 0;
+}
+
+
+/*
+ * Matches a key against the selection. Returns true if the whole value is
+ * selected, otherwise sub gets the selectors going deeper into the value.
+ */
+bool
+select(const Selection& selection, const Header& key, Selection& sub)
+{
+	std::string key_str(key.ptr, key.size);
+	for (const auto& selector : selection) {
+		const auto& path = *selector.first;
+		if (glob_match(path[selector.second], key_str)) {
+			if (selector.second + 1 == path.size()) {
+				return true;
+			}
+			sub.emplace_back(selector.first, selector.second + 1);
+		}
+	}
+	return false;
+}
+
+
+inline Kind
+peek_kind(const char* p, const char* end)
+{
+	return read_header(p, end).kind;
+}
+
+
+inline Header
+read_key(const char*& p, const char* end)
+{
+	auto key = read_header(p, end);
+	if (key.kind != Kind::STR) {
+		THROW(SerialisationError, "MsgPack map keys must be strings");
+	}
+	return key;
+}
+
+
+template <typename Writer>
+void
+write_json_map(Writer& writer, const char*& p, const char* end, uint32_t size, const Selection& selection)
+{
+	writer.StartObject();
+	for (uint32_t i = 0; i < size; ++i) {
+		auto key = read_key(p, end);
+		Selection sub;
+		if (select(selection, key, sub)) {
+			writer.Key(key.ptr, key.size);
+			write_json(writer, p, end);
+		} else if (!sub.empty() && peek_kind(p, end) == Kind::MAP) {
+			writer.Key(key.ptr, key.size);
+			auto header = read_header(p, end);
+			write_json_map(writer, p, end, header.size, sub);
+		} else {
+			skip(p, end);
+		}
+	}
+	writer.EndObject();
+}
+
+
+// Appends the selected entries of a map, returns how many were appended
+size_t
+write_msgpack_map(std::string& out, const char*& p, const char* end, uint32_t size, const Selection& selection)
+{
+	size_t count = 0;
+	for (uint32_t i = 0; i < size; ++i) {
+		const char* entry = p;
+		auto key = read_key(p, end);
+		Selection sub;
+		if (select(selection, key, sub)) {
+			skip(p, end);
+			out.append(entry, p - entry);
+			++count;
+		} else if (!sub.empty() && peek_kind(p, end) == Kind::MAP) {
+			out.append(entry, p - entry);
+			auto header = read_header(p, end);
+			std::string body;
+			write_map_header(out, write_msgpack_map(body, p, end, header.size, sub));
+			out.append(body);
+			++count;
+		} else {
+			skip(p, end);
+		}
+	}
+	return count;
+}
+
+
+/*
+ * Walks the entries of the serialised map calling on_entry(entry, key, value, entry_end, field, sub)
+ * for each selected one (field is the spliced field for the key or nullptr, sub the selectors
+ * going deeper into the value or nullptr if the whole value is selected), then on_field(field)
+ * for each field not found in the map. Returns the number of entries in the resulting map.
+ */
+template <typename OnEntry, typename OnField>
+size_t
+walk_map(const std::string& serialised, const std::vector<MsgPackTranscoder::Field>& fields, const MsgPackTranscoder::Projection* projection, OnEntry&& on_entry, OnField&& on_field)
+{
+	const char* p = serialised.data();
+	const char* end = p + serialised.size();
+
+	auto header = read_header(p, end);
+	if (header.kind != Kind::MAP) {
+		THROW(SerialisationError, "Expected a MsgPack map");
+	}
+
+	Selection selection;
+	if (projection) {
+		for (const auto& path : projection->get_paths()) {
+			selection.emplace_back(&path, 0);
+		}
+	}
+
+	size_t size = 0;
+	std::vector<bool> found(fields.size(), false);
+	for (uint32_t i = 0; i < header.size; ++i) {
+		const char* entry = p;
+		auto key = read_key(p, end);
+		const char* value = p;
+
+		bool is_field = false;
+		const MsgPackTranscoder::Field* field = nullptr;
+		for (size_t f = 0; f < fields.size(); ++f) {
+			if (fields[f].name.size() == key.size && memcmp(fields[f].name.data(), key.ptr, key.size) == 0) {
+				found[f] = true;
+				is_field = true;
+				if (fields[f].overwrite) {
+					field = &fields[f];
+				}
+				break;
+			}
+		}
+
+		// Spliced fields are always selected
+		Selection sub;
+		if (!projection || is_field || select(selection, key, sub)) {
+			skip(p, end);
+			on_entry(entry, key, value, p, field, nullptr);
+			++size;
+		} else if (!sub.empty() && peek_kind(p, end) == Kind::MAP) {
+			skip(p, end);
+			on_entry(entry, key, value, p, field, &sub);
+			++size;
+		} else {
+			skip(p, end);
+		}
+	}
+
+	for (size_t f = 0; f < fields.size(); ++f) {
+		if (!found[f]) {
+			on_field(fields[f]);
+			++size;
+		}
+	}
+	return size;
+}
+
+
+template <typename Writer>
+void
+transcode_json(Writer& writer, const std::string& serialised, const std::vector<MsgPackTranscoder::Field>& fields, const MsgPackTranscoder::Projection* projection)
+{
+	auto write_field = [&writer](const MsgPackTranscoder::Field& field) {
+		const char* p = field.value.data();
+		write_json(writer, p, p + field.value.size());
+	};
+
+	writer.StartObject();
+	walk_map(serialised, fields, projection, [&writer, &write_field](const char*, const Header& key, const char* value, const char* value_end, const MsgPackTranscoder::Field* field, const Selection* sub) {
+		writer.Key(key.ptr, key.size);
+		if (field) {
+			write_field(*field);
+		} else if (sub) {
+			auto header = read_header(value, value_end);
+			write_json_map(writer, value, value_end, header.size, *sub);
+		} else {
+			write_json(writer, value, value_end);
+		}
+	}, [&writer, &write_field](const MsgPackTranscoder::Field& field) {
+		writer.Key(field.name.data(), field.name.size());
+		write_field(field);
+	});
+	writer.EndObject();
+}
+
+}
+
+
+MsgPackTranscoder::Projection::Projection(const std::vector<std::string>& selectors)
+	: wildcards(false)
+{
+	for (const auto& selector : selectors) {
+		if (selector.empty()) {
+			continue;
+		}
+		std::vector<std::string> path;
+		Split<char>::split(selector, '.', std::back_inserter(path));
+		if (path.empty()) {
+			continue;
+		}
+		if (selector.find_first_of("*?[") != std::string::npos) {
+			wildcards = true;
+		}
+		paths.push_back(std::move(path));
+	}
+}
+
+
+std::string
+MsgPackTranscoder::to_json(bool pretty) const
+{
+	rapidjson::StringBuffer buffer;
+	if (pretty) {
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		transcode_json(writer, serialised, fields, projection);
+	} else {
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		transcode_json(writer, serialised, fields, projection);
+	}
+	return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+
+std::string
+MsgPackTranscoder::to_msgpack() const
+{
+	std::string body;
+	body.reserve(serialised.size() + 128);
+
+	auto size = walk_map(serialised, fields, projection, [&body](const char* entry, const Header&, const char* value, const char* entry_end, const Field* field, const Selection* sub) {
+		if (field) {
+			body.append(entry, value - entry);
+			body.append(field->value);
+		} else if (sub) {
+			body.append(entry, value - entry);
+			auto header = read_header(value, entry_end);
+			std::string sub_body;
+			write_map_header(body, write_msgpack_map(sub_body, value, entry_end, header.size, *sub));
+			body.append(sub_body);
+		} else {
+			body.append(entry, entry_end - entry);
+		}
+	}, [&body](const Field& field) {
+		MsgPack name(field.name);
+		body.append(name.serialise());
+		body.append(field.value);
+	});
+
+	std::string result;
+	result.reserve(body.size() + 5);
+	write_map_header(result, size);
+	result.append(body);
+	return result;
+}
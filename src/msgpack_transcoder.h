@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <string>       // for string
+#include <vector>       // for vector
+
+#include "msgpack.h"    // for MsgPack
+
+
+/*
+ * Transcodes a serialised MsgPack map straight from its bytes, without
+ * unserialising it into a MsgPack first, splicing in some extra fields.
+ *
+ * JSON is rendered through rapidjson's writers, so the output is the same
+ * MsgPack::to_string() gives (including its number formatting and string
+ * escaping). MsgPack is passed through, copying the untouched entries.
+ *
+ * An optional projection selects which fields of the map are transcoded,
+ * the rest are skipped over without being decoded.
+ */
+class MsgPackTranscoder {
+public:
+	struct Field {
+		std::string name;
+		std::string value;  // Serialised value
+		bool overwrite;     // Replace the field if it's already in the map
+
+		Field(const std::string& name_, const MsgPack& value_, bool overwrite_=true)
+			: name(name_),
+			  value(value_.serialise()),
+			  overwrite(overwrite_) { }
+	};
+
+	/*
+	 * Fields selected by dotted paths ("user.name"), each level of the path
+	 * can be a glob pattern ("user.*", "*_at"). Spliced fields are always
+	 * selected.
+	 */
+	class Projection {
+		std::vector<std::vector<std::string>> paths;
+		bool wildcards;
+
+	public:
+		explicit Projection(const std::vector<std::string>& selectors);
+
+		const std::vector<std::vector<std::string>>& get_paths() const noexcept {
+			return paths;
+		}
+
+		bool has_wildcards() const noexcept {
+			return wildcards;
+		}
+	};
+
+private:
+	const std::string& serialised;
+	const std::vector<Field>& fields;
+	const Projection* projection;
+
+public:
+	MsgPackTranscoder(const std::string& serialised_, const std::vector<Field>& fields_, const Projection* projection_=nullptr)
+		: serialised(serialised_),
+		  fields(fields_),
+		  projection(projection_) { }
+
+	std::string to_json(bool pretty=false) const;
+	std::string to_msgpack() const;
+};
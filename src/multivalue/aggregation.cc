@@ -56,6 +56,7 @@ const std::unordered_map<std::string, dispatch_aggregations> map_dispatch_aggreg
 	// { AGGREGATION_DATE_HISTOGRAM,   &Aggregation::add_bucket<DateHistogramAggregation>                             },
 	// { AGGREGATION_DATE_RANGE,       &Aggregation::add_bucket<DateRangeAggregation>                                 },
 	// { AGGREGATION_GEO_DISTANCE,     &Aggregation::add_bucket<GeoDistanceAggregation>                               },
+	{ AGGREGATION_GEO_GRID,         &Aggregation::add_bucket<GeoGridAggregation>                                   },
 	// { AGGREGATION_GEO_TRIXELS,      &Aggregation::add_bucket<GeoTrixelsAggregation>                                },
 	{ AGGREGATION_HISTOGRAM,        &Aggregation::add_bucket<HistogramAggregation>                                 },
 	// { AGGREGATION_MISSING,          &Aggregation::add_bucket<MissingAggregation>                                   },
@@ -22,11 +22,14 @@
 
 #include "aggregation_bucket.h"
 
-#include <algorithm>                      // for move, set_intersection
+#include <algorithm>                      // for move, set_intersection, sort
 #include <iterator>                       // for back_insert_iterator, back_...
 #include <map>                            // for __tree_const_iterator, oper...
 
+#include "geo/geospatial.h"               // for GeoSpatial
+#include "manager.h"                      // for XapiandManager
 #include "metrics/basic_string_metric.h"  // for Counter
+#include "multivalue/doc_values.h"        // for DocValues
 #include "multivalue/aggregation.h"       // for Aggregation
 #include "schema.h"                       // for Schema, required_spc_t
 
@@ -77,7 +80,7 @@ FilterAggregation::check_single(const Xapian::Document& doc)
 {
 	for (const auto& filter : _filters) {
 		std::unordered_set<std::string> values;
-		StringList::unserialise(doc.get_value(filter.first), std::inserter(values, values.begin()));
+		StringList::unserialise(DocValues::get_value(doc, filter.first), std::inserter(values, values.begin()));
 		if (values.find(*filter.second.begin()) != values.end()) {
 			return _agg(doc);
 		}
@@ -90,7 +93,7 @@ FilterAggregation::check_multiple(const Xapian::Document& doc)
 {
 	for (const auto& filter : _filters) {
 		std::set<std::string> values;
-		StringList::unserialise(doc.get_value(filter.first), std::inserter(values, values.begin()));
+		StringList::unserialise(DocValues::get_value(doc, filter.first), std::inserter(values, values.begin()));
 		Counter c;
 		std::set_intersection(values.begin(), values.end(), filter.second.begin(), filter.second.end(), std::back_inserter(c));
 		if (c.count) {
@@ -98,3 +101,98 @@ FilterAggregation::check_multiple(const Xapian::Document& doc)
 		}
 	}
 }
+
+
+GeoGridAggregation::GeoGridAggregation(MsgPack& result, const MsgPack& conf, const std::shared_ptr<Schema>& schema)
+	: BucketAggregation(AGGREGATION_GEO_GRID, result, conf, schema),
+	  _level(AGGREGATION_GEO_GRID_LEVEL)
+{
+	const auto& geo_grid_conf = _conf.at(AGGREGATION_GEO_GRID);
+	try {
+		const auto field_name = geo_grid_conf.at(AGGREGATION_FIELD).as_string();
+		const auto field_spc = schema->get_slot_field(field_name);
+		if (field_spc.get_type() != FieldType::GEO) {
+			THROW(AggregationError, "Field: %s is not geospatial", field_name.c_str());
+		}
+		_slot = field_spc.slot;
+	} catch (const std::out_of_range&) {
+		THROW(AggregationError, "'%s' must be specified in '%s'", AGGREGATION_FIELD, AGGREGATION_GEO_GRID);
+	} catch (const msgpack::type_error&) {
+		THROW(AggregationError, "'%s' must be object", AGGREGATION_GEO_GRID);
+	}
+
+	try {
+		const auto level = geo_grid_conf.at(AGGREGATION_LEVEL).as_u64();
+		if (level > HTM_MAX_LEVEL) {
+			THROW(AggregationError, "'%s' must be in [0, %zu]", AGGREGATION_LEVEL, HTM_MAX_LEVEL);
+		}
+		_level = level;
+	} catch (const std::out_of_range&) {
+	} catch (const msgpack::type_error&) {
+		THROW(AggregationError, "'%s' must be a non-negative integer", AGGREGATION_LEVEL);
+	}
+
+	const MsgPack* bounds = nullptr;
+	try {
+		bounds = &geo_grid_conf.at(AGGREGATION_BOUNDS);
+	} catch (const std::out_of_range&) { }
+	if (bounds) {
+		GeoSpatial geo(*bounds);
+		_bounds = XapiandManager::manager->cover_cache.get(*geo.getGeometry(), DEFAULT_GEO_PARTIALS, DEFAULT_GEO_ERROR);
+	}
+}
+
+
+void
+GeoGridAggregation::operator()(const Xapian::Document& doc)
+{
+	const auto serialised = DocValues::get_value(doc, _slot);
+	if (serialised.empty()) {
+		return;
+	}
+
+	std::vector<range_t> ranges;
+	const auto values = Unserialise::ranges_centroids(serialised);
+	if (values.second.empty()) {
+		ranges.assign(values.first.begin(), values.first.end());
+	} else {
+		for (const auto& centroid : values.second) {
+			const auto id = HTM::getId(centroid);
+			ranges.emplace_back(id, id);
+		}
+		std::sort(ranges.begin(), ranges.end());
+		HTM::simplifyRanges(ranges);
+	}
+
+	// Clip the (sorted) ranges to the bounds.
+	if (_bounds) {
+		std::vector<range_t> clipped;
+		auto it = _bounds->begin();
+		const auto it_e = _bounds->end();
+		for (const auto& range : ranges) {
+			while (it != it_e && it->end < range.start) {
+				++it;
+			}
+			for (auto it_b = it; it_b != it_e && it_b->start <= range.end; ++it_b) {
+				clipped.emplace_back(std::max(range.start, it_b->start), std::min(range.end, it_b->end));
+			}
+		}
+		ranges = std::move(clipped);
+	}
+
+	// Cells at _level are the ids without the two bits of every level below it.
+	const auto shift = 2 * (HTM_MAX_LEVEL - _level);
+	size_t num_cells = 0;
+	uint64_t last_cell = 0;  // Zero is not a trixel id.
+	for (const auto& range : ranges) {
+		auto cell = std::max(range.start >> shift, last_cell + 1);
+		const auto end = range.end >> shift;
+		for (; cell <= end; ++cell) {
+			if (++num_cells > AGGREGATION_GEO_GRID_MAX_CELLS) {
+				THROW(AggregationError, "Too many cells in '%s', use a lower '%s' or '%s'", AGGREGATION_GEO_GRID, AGGREGATION_LEVEL, AGGREGATION_BOUNDS);
+			}
+			aggregate(HTM::getTrixelName(cell), doc);
+		}
+		last_cell = std::max(last_cell, end);
+	}
+}
@@ -38,6 +38,7 @@
 #include <xapian.h>                         // for Document, valueno
 
 #include "aggregation.h"                    // for Aggregation
+#include "cover_cache.h"                    // for CoverRanges
 #include "msgpack.h"                        // for MsgPack, object::object, ...
 #include "multivalue/aggregation_metric.h"  // for AGGREGATION_INTERVAL, AGG...
 #include "multivalue/exception.h"           // for AggregationError, MSG_Agg...
@@ -48,6 +49,10 @@
 class Schema;
 
 
+#define AGGREGATION_GEO_GRID_LEVEL      8        /* Default level of the cells (about 40 km) */
+#define AGGREGATION_GEO_GRID_MAX_CELLS  65536    /* Maximum number of cells per document */
+
+
 class BucketAggregation : public HandledSubAggregation {
 protected:
 	std::unordered_map<std::string, Aggregation> _aggs;
@@ -341,6 +346,25 @@ public:
 };
 
 
+/*
+ * Buckets documents by the HTM trixels (cells) at the given level covered
+ * by their geospatial values: by their centroids if they have any, or by
+ * their ranges. Buckets are keyed by trixel name, a document is counted
+ * once per cell. Optionally, only the cells inside the bounds (a
+ * geospatial query) are aggregated.
+ */
+class GeoGridAggregation : public BucketAggregation {
+	Xapian::valueno _slot;
+	uint8_t _level;
+	CoverRanges _bounds;
+
+public:
+	GeoGridAggregation(MsgPack& result, const MsgPack& conf, const std::shared_ptr<Schema>& schema);
+
+	void operator()(const Xapian::Document& doc) override;
+};
+
+
 class FilterAggregation : public SubAggregation {
 	using func_filter = void (FilterAggregation::*)(const Xapian::Document&);
 
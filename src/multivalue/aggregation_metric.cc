@@ -23,6 +23,7 @@
 #include "aggregation_metric.h"
 
 #include "msgpack/object_fwd.hpp"  // for type_error
+#include "multivalue/doc_values.h" // for DocValues
 #include "multivalue/exception.h"  // for AggregationError, MSG_AggregationE...
 #include "schema.h"                // for FieldType, required_spc_t, FieldTy...
 #include "utils.h"                 // for repr, toUType
@@ -59,7 +60,7 @@ static func_value_handle get_func_value_handle(FieldType type, const std::string
 void
 ValueHandle::operator()(SubAggregation* agg, const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 
 	if (!multiValues.empty()) {
 		(agg->*_func)(multiValues, doc);
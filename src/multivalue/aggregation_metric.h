@@ -46,11 +46,13 @@ class Schema;
 
 
 constexpr const char AGGREGATION_AGGS[]             = "_aggregations";
+constexpr const char AGGREGATION_BOUNDS[]           = "_bounds";
 constexpr const char AGGREGATION_DOC_COUNT[]        = "_doc_count";
 constexpr const char AGGREGATION_FIELD[]            = "_field";
 constexpr const char AGGREGATION_FROM[]             = "_from";
 constexpr const char AGGREGATION_INTERVAL[]         = "_interval";
 constexpr const char AGGREGATION_KEY[]              = "_key";
+constexpr const char AGGREGATION_LEVEL[]            = "_level";
 constexpr const char AGGREGATION_RANGES[]           = "_ranges";
 constexpr const char AGGREGATION_SUM_OF_SQ[]        = "_sum_of_squares";
 constexpr const char AGGREGATION_TO[]               = "_to";
@@ -77,6 +79,7 @@ constexpr const char AGGREGATION_DATE_HISTOGRAM[]   = "_date_histogram";
 constexpr const char AGGREGATION_DATE_RANGE[]       = "_date_range";
 constexpr const char AGGREGATION_FILTER[]           = "_filter";
 constexpr const char AGGREGATION_GEO_DISTANCE[]     = "_geo_distance";
+constexpr const char AGGREGATION_GEO_GRID[]         = "_geo_grid";
 constexpr const char AGGREGATION_GEO_IP[]           = "_geo_ip";
 constexpr const char AGGREGATION_GEO_TRIXELS[]      = "_geo_trixels";
 constexpr const char AGGREGATION_HISTOGRAM[]        = "_histogram";
@@ -0,0 +1,664 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "doc_values.h"
+
+#include <algorithm>          // for max
+#include <cstring>            // for memcpy, memset, memcmp
+#include <dirent.h>           // for DIR, closedir
+#include <errno.h>            // for errno
+#include <fcntl.h>            // for O_RDONLY, O_WRONLY, O_CREAT, O_TRUNC
+#include <mutex>              // for mutex, lock_guard
+#include <set>                // for set
+#include <stdexcept>          // for invalid_argument, out_of_range
+#include <stdio.h>            // for rename
+#include <sys/mman.h>         // for mmap, munmap, MAP_FAILED
+#include <sys/stat.h>         // for fstat
+#include <vector>             // for vector
+
+#include "database.h"         // for Database
+#include "database_utils.h"   // for DB_SLOT_RESERVED
+#include "io_utils.h"         // for open, close, pread, pwrite, unlink
+#include "log.h"              // for L_WARNING
+#include "lru.h"              // for LRU
+#include "manager.h"          // for XapiandManager
+#include "utils.h"            // for repr, normalize_path, opendir, endswith, ...
+
+
+// Name of the file of a segment of the column in filename
+static inline std::string
+segment_filename(const std::string& filename, size_t segment, uint32_t revision)
+{
+	return filename + "." + std::to_string(segment) + "." + std::to_string(revision);
+}
+
+
+// Reads the column file, returns false if it isn't one
+static bool
+read_column(const std::string& filename, uint32_t& revision, uint32_t& overflows, uint32_t& last_docid, std::vector<uint32_t>& revisions)
+{
+	int fd = io::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	uint32_t header[4];
+	bool read = io::pread(fd, header, sizeof(header), 0) == sizeof(header) && header[0] == DOC_VALUES_MAGIC;
+	if (read) {
+		revision = header[1];
+		overflows = header[2];
+		last_docid = header[3];
+		revisions.resize(last_docid / DOC_VALUES_SEGMENT_SIZE + 1);
+		auto size = static_cast<ssize_t>(revisions.size() * sizeof(uint32_t));
+		read = io::pread(fd, revisions.data(), size, sizeof(header)) == size;
+	}
+	io::close(fd);
+	return read;
+}
+
+
+DocValuesColumn::DocValuesColumn(const std::string& filename)
+	: header{ 0, 0, 0, 0 }
+{
+	Header header_;
+	std::vector<uint32_t> revisions;
+	if (!read_column(filename, header_.revision, header_.overflows, header_.last_docid, revisions)) {
+		return;
+	}
+	header_.magic = DOC_VALUES_MAGIC;
+
+	segments.resize(revisions.size(), nullptr);
+	for (size_t segment = 0; segment < revisions.size(); ++segment) {
+		if (!revisions[segment]) {
+			continue;
+		}
+		// Segments are gone once a newer revision replaces them.
+		int segment_fd = io::open(segment_filename(filename, segment, revisions[segment]).c_str(), O_RDONLY | O_CLOEXEC);
+		if (segment_fd == -1) {
+			return;
+		}
+		struct stat st;
+		void* addr = MAP_FAILED;
+		if (::fstat(segment_fd, &st) == 0 && st.st_size == DOC_VALUES_SEGMENT_SIZE * DOC_VALUES_CELL_SIZE) {
+			addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, segment_fd, 0);
+		}
+		io::close(segment_fd);
+		if (addr == MAP_FAILED) {
+			return;
+		}
+		segments[segment] = static_cast<const char*>(addr);
+	}
+	header = header_;
+}
+
+
+DocValuesColumn::~DocValuesColumn()
+{
+	for (auto data : segments) {
+		if (data) {
+			::munmap(const_cast<char*>(data), DOC_VALUES_SEGMENT_SIZE * DOC_VALUES_CELL_SIZE);
+		}
+	}
+}
+
+
+bool
+DocValuesColumn::valid() const noexcept
+{
+	return header.magic == DOC_VALUES_MAGIC;
+}
+
+
+bool
+DocValuesColumn::get(Xapian::docid did, std::string& value) const
+{
+	if (!did) {
+		// Documents not in the database (the first cell is never used).
+		return false;
+	}
+	if (did > header.last_docid) {
+		// Documents after the last cell have no values.
+		value.clear();
+		return true;
+	}
+	auto data = segments[did / DOC_VALUES_SEGMENT_SIZE];
+	if (!data) {
+		value.clear();
+		return true;
+	}
+	auto cell = data + (did % DOC_VALUES_SEGMENT_SIZE) * DOC_VALUES_CELL_SIZE;
+	auto length = static_cast<unsigned char>(cell[0]);
+	if (length == DOC_VALUES_OVERFLOW) {
+		return false;
+	}
+	value.assign(cell + 1, length);
+	return true;
+}
+
+
+// Fills cell with value, returns false if it doesn't fit
+static bool
+set_cell(char* cell, const std::string& value)
+{
+	std::memset(cell, 0, DOC_VALUES_CELL_SIZE);
+	if (value.size() >= DOC_VALUES_CELL_SIZE) {
+		cell[0] = static_cast<char>(DOC_VALUES_OVERFLOW);
+		return false;
+	}
+	cell[0] = static_cast<char>(value.size());
+	std::memcpy(cell + 1, value.data(), value.size());
+	return true;
+}
+
+
+// Held while reading and writing column files, so a column built in the
+// background doesn't replace one a commit is updating.
+static std::mutex columns_mtx;
+
+// Columns being built in the background, by filename.
+static std::mutex building_mtx;
+static std::set<std::string> building;
+
+
+// Writes the column file anew (renaming it over the old one)
+static bool
+write_column(const std::string& filename, uint32_t revision, uint32_t overflows, uint32_t last_docid, const std::vector<uint32_t>& revisions)
+{
+	auto tmp = filename + ".tmp";
+	int fd = io::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+	uint32_t header[4] = { DOC_VALUES_MAGIC, revision, overflows, last_docid };
+	auto size = static_cast<ssize_t>(revisions.size() * sizeof(uint32_t));
+	bool written = io::pwrite(fd, header, sizeof(header), 0) == sizeof(header) && io::pwrite(fd, revisions.data(), size, sizeof(header)) == size;
+	io::close(fd);
+	if (!written || ::rename(tmp.c_str(), filename.c_str()) == -1) {
+		io::unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+// Writes the cells of a segment to a new file
+static bool
+write_segment(const std::string& filename, const std::string& cells)
+{
+	int fd = io::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+	bool written = io::pwrite(fd, cells.data(), cells.size(), 0) == static_cast<ssize_t>(cells.size());
+	io::close(fd);
+	return written;
+}
+
+
+void
+DocValuesColumn::update(const std::string& path, Xapian::valueno slot, const std::map<Xapian::docid, Xapian::Document>& changed, uint32_t previous_revision, uint32_t revision)
+{
+	auto filename = path + DOC_VALUES_PATH + std::to_string(slot);
+	char cell[DOC_VALUES_CELL_SIZE];
+
+	std::unique_lock<std::mutex> lk(columns_mtx);
+
+	uint32_t column_revision, overflows, last_docid;
+	std::vector<uint32_t> revisions;
+	if (!read_column(filename, column_revision, overflows, last_docid, revisions) || column_revision != previous_revision) {
+		// Columns that missed a commit (e.g. while doc values were disabled) are rebuilt.
+		lk.unlock();
+		schedule(path, slot);
+		return;
+	}
+
+	auto new_last_docid = std::max<uint32_t>(last_docid, changed.rbegin()->first);
+	revisions.resize(new_last_docid / DOC_VALUES_SEGMENT_SIZE + 1, 0);
+
+	// Changed documents are in docid order, so each segment is rewritten once.
+	std::vector<std::string> replaced;
+	bool written = true;
+	auto it = changed.begin();
+	const auto it_e = changed.end();
+	while (written && it != it_e) {
+		const size_t segment = it->first / DOC_VALUES_SEGMENT_SIZE;
+		std::string cells(DOC_VALUES_SEGMENT_SIZE * DOC_VALUES_CELL_SIZE, '\0');
+		if (revisions[segment]) {
+			int fd = io::open(segment_filename(filename, segment, revisions[segment]).c_str(), O_RDONLY | O_CLOEXEC);
+			written = fd != -1 && io::pread(fd, &cells[0], cells.size(), 0) == static_cast<ssize_t>(cells.size());
+			if (fd != -1) {
+				io::close(fd);
+			}
+		}
+		bool modified = false;
+		for (; written && it != it_e && it->first / DOC_VALUES_SEGMENT_SIZE == segment; ++it) {
+			auto old_cell = &cells[(it->first % DOC_VALUES_SEGMENT_SIZE) * DOC_VALUES_CELL_SIZE];
+			if (!set_cell(cell, it->second.get_value(slot))) {
+				++overflows;
+			}
+			if (static_cast<unsigned char>(old_cell[0]) == DOC_VALUES_OVERFLOW) {
+				--overflows;
+			}
+			if (std::memcmp(cell, old_cell, sizeof(cell)) != 0) {
+				std::memcpy(old_cell, cell, sizeof(cell));
+				modified = true;
+			}
+		}
+		if (written && modified) {
+			written = write_segment(segment_filename(filename, segment, revision), cells);
+			if (revisions[segment]) {
+				replaced.push_back(segment_filename(filename, segment, revisions[segment]));
+			}
+			revisions[segment] = revision;
+		}
+	}
+
+	// Readers of the previous revision keep using the unchanged segments.
+	if (!written || !write_column(filename, revision, overflows, new_last_docid, revisions)) {
+		L_WARNING(nullptr, "Cannot update doc values: %s (%s)", repr(filename).c_str(), strerror(errno));
+		io::unlink(filename.c_str());
+		return;
+	}
+	for (const auto& segment : replaced) {
+		io::unlink(segment.c_str());
+	}
+}
+
+
+// Removes the segment files of the column in filename not in revisions
+static void
+remove_segments(const std::string& path, const std::string& filename, const std::vector<uint32_t>& revisions)
+{
+	DIR *dir = opendir(path.c_str(), false);
+	if (!dir) {
+		return;
+	}
+
+	std::set<std::string> current;
+	for (size_t segment = 0; segment < revisions.size(); ++segment) {
+		if (revisions[segment]) {
+			current.insert(segment_filename(filename, segment, revisions[segment]));
+		}
+	}
+
+	auto prefix = filename.substr(path.size()) + ".";
+	std::vector<std::string> unused;
+	File_ptr fptr;
+	find_file_dir(dir, fptr, prefix, true);
+	while (fptr.ent) {
+		auto segment = path + fptr.ent->d_name;
+		if (current.find(segment) == current.end() && !endswith(segment, ".tmp")) {
+			unused.push_back(std::move(segment));
+		}
+		find_file_dir(dir, fptr, prefix, true);
+	}
+	closedir(dir);
+
+	for (const auto& segment : unused) {
+		io::unlink(segment.c_str());
+	}
+}
+
+
+bool
+DocValuesColumn::build(const std::string& path, Xapian::valueno slot)
+{
+#if HAVE_XAPIAN_DATABASE_GET_REVISION
+	auto filename = path + DOC_VALUES_PATH + std::to_string(slot);
+	char cell[DOC_VALUES_CELL_SIZE];
+
+	Xapian::Database db(path);
+	const uint32_t revision = db.get_revision();
+	const uint32_t last_docid = db.get_lastdocid();
+	uint32_t overflows = 0;
+	std::vector<uint32_t> revisions(last_docid / DOC_VALUES_SEGMENT_SIZE + 1, 0);
+
+	// Segments are named after the revision being built, no commit writes
+	// them while the column is stale.
+	bool written = true;
+	std::string cells;
+	size_t segment = 0;
+	const auto flush = [&]() {
+		if (!cells.empty()) {
+			written = write_segment(segment_filename(filename, segment, revision), cells);
+			revisions[segment] = revision;
+			cells.clear();
+		}
+	};
+	const auto it_e = db.valuestream_end(slot);
+	for (auto it = db.valuestream_begin(slot); written && it != it_e; ++it) {
+		const auto did = it.get_docid();
+		if (did > last_docid) {
+			break;
+		}
+		if (did / DOC_VALUES_SEGMENT_SIZE != segment || cells.empty()) {
+			flush();
+			segment = did / DOC_VALUES_SEGMENT_SIZE;
+			cells.assign(DOC_VALUES_SEGMENT_SIZE * DOC_VALUES_CELL_SIZE, '\0');
+		}
+		if (!set_cell(cell, *it)) {
+			++overflows;
+		}
+		std::memcpy(&cells[(did % DOC_VALUES_SEGMENT_SIZE) * DOC_VALUES_CELL_SIZE], cell, sizeof(cell));
+	}
+	if (written) {
+		flush();
+	}
+
+	std::lock_guard<std::mutex> lk(columns_mtx);
+
+	uint32_t column_revision, column_overflows, column_last_docid;
+	std::vector<uint32_t> column_revisions;
+	if (read_column(filename, column_revision, column_overflows, column_last_docid, column_revisions) && column_revision >= revision) {
+		// The column is already up to date, keep it
+		remove_segments(path, filename, column_revisions);
+		return true;
+	}
+
+	if (!written || !write_column(filename, revision, overflows, last_docid, revisions)) {
+		L_WARNING(nullptr, "Cannot write doc values: %s (%s)", repr(filename).c_str(), strerror(errno));
+		io::unlink(filename.c_str());
+		revisions.clear();
+		written = false;
+	}
+	remove_segments(path, filename, revisions);
+	return written;
+#else
+	(void)path;
+	(void)slot;
+	return false;
+#endif
+}
+
+
+void
+DocValuesColumn::schedule(const std::string& path, Xapian::valueno slot)
+{
+	auto filename = path + DOC_VALUES_PATH + std::to_string(slot);
+
+	{
+		std::lock_guard<std::mutex> lk(building_mtx);
+		if (!building.insert(filename).second) {
+			return;
+		}
+	}
+
+	try {
+		DocValues::thread_pool().enqueue([path, slot, filename]() {
+			try {
+				build(path, slot);
+			} catch (const Xapian::Error& exc) {
+				// The next commit schedules it again
+				L_WARNING(nullptr, "Cannot build doc values: %s (%s)", repr(filename).c_str(), exc.get_msg().c_str());
+			}
+
+			std::lock_guard<std::mutex> lk(building_mtx);
+			building.erase(filename);
+		});
+	} catch (const std::logic_error&) {
+		// Shutting down
+		std::lock_guard<std::mutex> lk(building_mtx);
+		building.erase(filename);
+	}
+}
+
+
+// Slots with a column file in path
+static std::set<Xapian::valueno>
+column_slots(const std::string& path)
+{
+	std::set<Xapian::valueno> slots;
+
+	DIR *dir = opendir(path.c_str(), false);
+	if (!dir) {
+		return slots;
+	}
+
+	File_ptr fptr;
+	find_file_dir(dir, fptr, DOC_VALUES_PATH, true);
+	while (fptr.ent) {
+		std::string filename(fptr.ent->d_name + sizeof(DOC_VALUES_PATH) - 1);
+		try {
+			size_t pos;
+			auto slot = std::stoul(filename, &pos);
+			if (pos == filename.size()) {
+				slots.insert(static_cast<Xapian::valueno>(slot));
+			}
+		} catch (const std::invalid_argument&) {
+		} catch (const std::out_of_range&) { }
+		find_file_dir(dir, fptr, DOC_VALUES_PATH, true);
+	}
+	closedir(dir);
+
+	return slots;
+}
+
+
+DocValues::DocValues(const std::string& path, uint32_t revision_)
+	: revision(revision_)
+{
+	for (auto slot : column_slots(path)) {
+		auto column = std::make_unique<DocValuesColumn>(path + DOC_VALUES_PATH + std::to_string(slot));
+		if (column->valid() && column->revision() == revision) {
+			columns.emplace(slot, std::move(column));
+		}
+	}
+}
+
+
+std::shared_ptr<const DocValues>
+DocValues::get(Database* database)
+{
+#if HAVE_XAPIAN_DATABASE_GET_REVISION
+	if (!XapiandManager::manager->doc_values || database->endpoints.size() != 1 || !database->endpoints[0].is_local()) {
+		return nullptr;
+	}
+
+	// Columns don't have the changes not committed yet.
+	if (database->modified) {
+		return nullptr;
+	}
+
+	static std::mutex mtx;
+	static lru::LRU<std::string, std::shared_ptr<const DocValues>> cache(DOC_VALUES_CACHE_SIZE);
+
+	auto path = normalize_path(database->endpoints[0].path, true);
+	auto revision = database->get_revision();
+
+	std::lock_guard<std::mutex> lk(mtx);
+	auto& doc_values = cache[path];
+	if (!doc_values || doc_values->revision != revision) {
+		doc_values = std::make_shared<const DocValues>(path, revision);
+	}
+	return doc_values;
+#else
+	(void)database;
+	return nullptr;
+#endif
+}
+
+
+static thread_local std::shared_ptr<const DocValues> current_doc_values;
+
+
+const std::shared_ptr<const DocValues>&
+DocValues::current()
+{
+	return current_doc_values;
+}
+
+
+std::string
+DocValues::get_value(const Xapian::Document& doc, Xapian::valueno slot)
+{
+	if (current_doc_values) {
+		auto column = current_doc_values->column(slot);
+		std::string value;
+		if (column && column->get(doc.get_docid(), value)) {
+			return value;
+		}
+	}
+	return doc.get_value(slot);
+}
+
+
+void
+DocValues::update(const std::string& path, const std::map<Xapian::docid, Xapian::Document>& changed, uint32_t previous_revision, uint32_t revision)
+{
+	auto path_ = normalize_path(path, true);
+
+	// Existing columns and slots new to the changed documents.
+	auto slots = column_slots(path_);
+	for (const auto& doc : changed) {
+		const auto it_e = doc.second.values_end();
+		for (auto it = doc.second.values_begin(); it != it_e; ++it) {
+			if (it.get_valueno() >= DB_SLOT_RESERVED) {
+				slots.insert(it.get_valueno());
+			}
+		}
+	}
+
+	for (auto slot : slots) {
+		DocValuesColumn::update(path_, slot, changed, previous_revision, revision);
+	}
+}
+
+
+DocValues::Scope::Scope(Database* database)
+	: previous(std::move(current_doc_values))
+{
+	current_doc_values = DocValues::get(database);
+}
+
+
+DocValues::Scope::Scope(std::shared_ptr<const DocValues> doc_values)
+	: previous(std::move(current_doc_values))
+{
+	current_doc_values = std::move(doc_values);
+}
+
+
+DocValues::Scope::~Scope()
+{
+	current_doc_values = std::move(previous);
+}
+
+
+void
+DocValuesPostingSource::seek(Xapian::docid min_docid)
+{
+	auto last_did = column->last_docid();
+	for (did = min_docid; did <= last_did; ++did) {
+		if (column->get(did, value) && !value.empty()) {
+			return;
+		}
+	}
+}
+
+
+bool
+DocValuesPostingSource::at_end() const
+{
+	if (column) {
+		return did > column->last_docid();
+	}
+	return Xapian::ValuePostingSource::at_end();
+}
+
+
+Xapian::docid
+DocValuesPostingSource::get_docid() const
+{
+	if (column) {
+		return did;
+	}
+	return Xapian::ValuePostingSource::get_docid();
+}
+
+
+void
+DocValuesPostingSource::next(double min_wt)
+{
+	if (column) {
+		seek(min_wt > get_maxweight() ? column->last_docid() + 1 : did + 1);
+	} else {
+		Xapian::ValuePostingSource::next(min_wt);
+	}
+}
+
+
+void
+DocValuesPostingSource::skip_to(Xapian::docid min_docid, double min_wt)
+{
+	if (column) {
+		if (min_wt > get_maxweight()) {
+			seek(column->last_docid() + 1);
+		} else if (min_docid > did) {
+			seek(min_docid);
+		}
+	} else {
+		Xapian::ValuePostingSource::skip_to(min_docid, min_wt);
+	}
+}
+
+
+bool
+DocValuesPostingSource::check(Xapian::docid min_docid, double min_wt)
+{
+	if (column) {
+		if (min_wt > get_maxweight()) {
+			seek(column->last_docid() + 1);
+		} else if (min_docid > did) {
+			did = min_docid;
+			if (did <= column->last_docid()) {
+				return column->get(did, value) && !value.empty();
+			}
+		}
+		return true;
+	}
+	return Xapian::ValuePostingSource::check(min_docid, min_wt);
+}
+
+
+void
+DocValuesPostingSource::init(const Xapian::Database& db_)
+{
+	Xapian::ValuePostingSource::init(db_);
+
+	doc_values.reset();
+	column = nullptr;
+	did = 0;
+
+	// Only the database being searched by this thread has its columns current.
+	const auto& current = DocValues::current();
+#if HAVE_XAPIAN_DATABASE_GET_REVISION
+	if (current && current->revision == db_.get_revision()) {
+		auto column_ = current->column(get_slot());
+		if (column_ && column_->overflows() == 0) {
+			doc_values = current;
+			column = column_;
+		}
+	}
+#else
+	(void)current;
+#endif
+}
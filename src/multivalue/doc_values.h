@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <cstdint>          // for uint32_t
+#include <map>              // for map
+#include <memory>           // for shared_ptr, unique_ptr
+#include <string>           // for string
+#include <unordered_map>    // for unordered_map
+#include <vector>           // for vector
+#include <xapian.h>         // for docid, valueno, Document, ValuePostingSource
+
+#include "threadpool.h"     // for ThreadPool
+
+
+class Database;
+
+
+#define DOC_VALUES_PATH          "docvalues."  // Followed by the slot
+#define DOC_VALUES_MAGIC         0x32435644    // "DVC2"
+#define DOC_VALUES_CELL_SIZE     16            // Bytes by document
+#define DOC_VALUES_OVERFLOW      0xff          // Cell length of values not fitting in the cell
+#define DOC_VALUES_SEGMENT_SIZE  65536         // Documents by segment file (1 MiB)
+#define DOC_VALUES_CACHE_SIZE    100           // Databases whose columns are kept mapped
+
+
+/*
+ * Column with the values of a slot, memory mapped read-only.
+ *
+ * The column is split in segment files of DOC_VALUES_SEGMENT_SIZE
+ * documents, with a fixed-width cell for each docid: a length byte and
+ * the serialised value (exactly what Xapian::Document::get_value()
+ * returns) when it fits in the cell. Values that don't fit are marked as
+ * overflows and must be read from the database.
+ *
+ * The column file itself has a header, with the database revision the
+ * column is up to date with, followed by the revision each segment was
+ * written at (0 for segments without values), which names its file.
+ * Commits write the segments they change as new files and then the
+ * column file anew, renaming it over the old one, so mapped segments
+ * never change under a search.
+ */
+class DocValuesColumn {
+	struct Header {
+		uint32_t magic;
+		uint32_t revision;
+		uint32_t overflows;
+		uint32_t last_docid;
+	};
+
+	Header header;
+	std::vector<const char*> segments;
+
+public:
+	explicit DocValuesColumn(const std::string& filename);
+	~DocValuesColumn();
+
+	DocValuesColumn(const DocValuesColumn&) = delete;
+	DocValuesColumn& operator=(const DocValuesColumn&) = delete;
+
+	bool valid() const noexcept;
+
+	uint32_t revision() const noexcept {
+		return header.revision;
+	}
+
+	uint32_t overflows() const noexcept {
+		return header.overflows;
+	}
+
+	Xapian::docid last_docid() const noexcept {
+		return header.last_docid;
+	}
+
+	// Sets value to the one of did, returns false if it must be read from the database
+	bool get(Xapian::docid did, std::string& value) const;
+
+	/*
+	 * Brings the column of slot in path up to date with the documents
+	 * changed in a commit (deleted ones with no values), rewriting only
+	 * the segments with changed cells. Columns that don't exist or aren't
+	 * at previous_revision are built in the background instead.
+	 */
+	static void update(const std::string& path, Xapian::valueno slot, const std::map<Xapian::docid, Xapian::Document>& changed, uint32_t previous_revision, uint32_t revision);
+
+	// Builds the column of slot from the value stream of the index at path.
+	static bool build(const std::string& path, Xapian::valueno slot);
+
+	// Builds the column of slot in path in the background.
+	static void schedule(const std::string& path, Xapian::valueno slot);
+};
+
+
+/*
+ * Columns of a local database at a given revision.
+ *
+ * DocValues::Scope makes the columns of a database available to the
+ * key makers, match spies and posting sources run by a search in the
+ * current thread (DocValues::current()).
+ */
+class DocValues {
+	std::unordered_map<Xapian::valueno, std::unique_ptr<DocValuesColumn>> columns;
+
+public:
+	const uint32_t revision;
+
+	DocValues(const std::string& path, uint32_t revision_);
+
+	const DocValuesColumn* column(Xapian::valueno slot) const {
+		auto it = columns.find(slot);
+		return it == columns.end() ? nullptr : it->second.get();
+	}
+
+	// Columns of database at its current revision, nullptr if it can't have them
+	static std::shared_ptr<const DocValues> get(Database* database);
+
+	static const std::shared_ptr<const DocValues>& current();
+
+	// Value of slot in doc, read from the current columns when possible
+	static std::string get_value(const Xapian::Document& doc, Xapian::valueno slot);
+
+	// Adds the documents changed by the commit from previous_revision to revision to the columns in path
+	static void update(const std::string& path, const std::map<Xapian::docid, Xapian::Document>& changed, uint32_t previous_revision, uint32_t revision);
+
+	static ThreadPool<>& thread_pool() {
+		static ThreadPool<> thread_pool("V%02zu", 1);
+		return thread_pool;
+	}
+
+	static void finish() {
+		thread_pool().finish();
+	}
+
+	static void join() {
+		thread_pool().join();
+	}
+
+	static size_t running_size() {
+		return thread_pool().running_size();
+	}
+
+	class Scope {
+		std::shared_ptr<const DocValues> previous;
+
+	public:
+		explicit Scope(Database* database);
+		explicit Scope(std::shared_ptr<const DocValues> doc_values);
+		~Scope();
+	};
+};
+
+
+/*
+ * ValuePostingSource reading the current column of its slot (if every
+ * value of the column fits in its cells) instead of the value stream.
+ */
+class DocValuesPostingSource : public Xapian::ValuePostingSource {
+	std::shared_ptr<const DocValues> doc_values;
+	const DocValuesColumn* column;
+	Xapian::docid did;
+	std::string value;
+
+	// Moves to the first document with a value from min_docid on.
+	void seek(Xapian::docid min_docid);
+
+public:
+	explicit DocValuesPostingSource(Xapian::valueno slot_)
+		: Xapian::ValuePostingSource(slot_),
+		  column(nullptr),
+		  did(0) { }
+
+	std::string get_value() const {
+		return column ? value : Xapian::ValuePostingSource::get_value();
+	}
+
+	bool at_end() const override;
+	Xapian::docid get_docid() const override;
+	void next(double min_wt) override;
+	void skip_to(Xapian::docid min_docid, double min_wt) override;
+	bool check(Xapian::docid min_docid, double min_wt) override;
+	void init(const Xapian::Database& db_) override;
+};
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "fuzzy.h"
+
+#include <algorithm>          // for min, max, sort
+
+#include "database_utils.h"   // for prefixed
+#include "exception.h"        // for SerialisationError
+#include "length.h"           // for serialise_length, unserialise_length
+#include "schema.h"           // for required_spc_t
+#include "serialise_list.h"   // for StringList
+#include "utils.h"            // for startswith
+
+
+// Decodes the UTF-8 character at pos and moves pos past it; stray bytes stand for themselves.
+static uint32_t
+next_char(const std::string& str, size_t& pos)
+{
+	const auto c = static_cast<unsigned char>(str[pos++]);
+	size_t extra;
+	uint32_t ch;
+	if (c < 0xc0) {
+		return c;
+	} else if (c < 0xe0) {
+		extra = 1;
+		ch = c & 0x1f;
+	} else if (c < 0xf0) {
+		extra = 2;
+		ch = c & 0x0f;
+	} else {
+		extra = 3;
+		ch = c & 0x07;
+	}
+	if (pos + extra > str.size()) {
+		return c;
+	}
+	for (size_t i = 0; i < extra; ++i) {
+		const auto cc = static_cast<unsigned char>(str[pos + i]);
+		if ((cc & 0xc0) != 0x80) {
+			return c;
+		}
+		ch = (ch << 6) | (cc & 0x3f);
+	}
+	pos += extra;
+	return ch;
+}
+
+
+LevenshteinAutomaton::LevenshteinAutomaton(const std::string& word_, unsigned max_edits_)
+	: max_edits(max_edits_)
+{
+	for (size_t pos = 0; pos < word_.size(); ) {
+		word.push_back(next_char(word_, pos));
+	}
+}
+
+
+LevenshteinAutomaton::State
+LevenshteinAutomaton::start() const
+{
+	State state(word.size() + 1);
+	for (size_t j = 0; j < state.size(); ++j) {
+		state[j] = std::min<unsigned>(j, max_edits + 1);
+	}
+	return state;
+}
+
+
+LevenshteinAutomaton::State
+LevenshteinAutomaton::step(const State& state, const State* prev_state, uint32_t c, uint32_t prev_c) const
+{
+	State new_state(state.size());
+	new_state[0] = std::min(state[0] + 1, max_edits + 1);
+	for (size_t j = 1; j < state.size(); ++j) {
+		auto edits = std::min({
+			state[j] + 1,                               // deletion
+			new_state[j - 1] + 1,                       // insertion
+			state[j - 1] + (word[j - 1] == c ? 0 : 1),  // substitution
+		});
+		if (prev_state && j > 1 && word[j - 2] == c && word[j - 1] == prev_c) {
+			edits = std::min(edits, (*prev_state)[j - 2] + 1);  // transposition
+		}
+		new_state[j] = std::min(edits, max_edits + 1);
+	}
+	return new_state;
+}
+
+
+bool
+LevenshteinAutomaton::can_match(const State& state) const
+{
+	return *std::min_element(state.begin(), state.end()) <= max_edits;
+}
+
+
+std::vector<LevenshteinAutomaton::Match>
+LevenshteinAutomaton::intersect(Xapian::TermIterator it, const Xapian::TermIterator& it_end, const std::string& prefix) const
+{
+	std::vector<Match> matches;
+
+	// States, characters and end offsets (within the suffix) of the
+	// candidate read so far, reused for the prefix shared with the next.
+	std::vector<State> states{ start() };
+	std::vector<uint32_t> chars;
+	std::vector<size_t> offsets{ 0 };
+	std::string previous;
+
+	while (it != it_end) {
+		const auto term = *it;
+		if (!startswith(term, prefix)) {
+			break;
+		}
+		const auto suffix = term.substr(prefix.size());
+
+		size_t common = 0;
+		while (common < suffix.size() && common < previous.size() && suffix[common] == previous[common]) {
+			++common;
+		}
+		size_t reused = 0;
+		while (reused < chars.size() && offsets[reused + 1] <= common) {
+			++reused;
+		}
+		states.resize(reused + 1);
+		chars.resize(reused);
+		offsets.resize(reused + 1);
+
+		bool dead = false;
+		for (size_t pos = offsets.back(); pos < suffix.size(); ) {
+			const auto c = next_char(suffix, pos);
+			const State* prev_state = states.size() > 1 ? &states[states.size() - 2] : nullptr;
+			const auto prev_c = chars.empty() ? 0 : chars.back();
+			states.push_back(step(states.back(), prev_state, c, prev_c));
+			chars.push_back(c);
+			offsets.push_back(pos);
+			if (!can_match(states.back())) {
+				dead = true;
+				break;
+			}
+		}
+		previous = suffix;
+
+		if (dead) {
+			// Nothing starting like this can match, jump to the first term after all of them.
+			auto next = prefix + suffix.substr(0, offsets.back());
+			while (next.size() > prefix.size() && static_cast<unsigned char>(next.back()) == 0xff) {
+				next.pop_back();
+			}
+			if (next.size() == prefix.size()) {
+				break;
+			}
+			++next.back();
+			it.skip_to(next);
+			continue;
+		}
+
+		const auto edits = distance(states.back());
+		if (edits <= max_edits) {
+			matches.push_back({ term, edits, it.get_termfreq() });
+		}
+		++it;
+	}
+
+	return matches;
+}
+
+
+template <typename T, typename>
+FuzzyTerm::FuzzyTerm(T&& prefix_, T&& term_, unsigned max_edits_, unsigned prefix_length_)
+	: prefix(std::forward<T>(prefix_)),
+	  term(std::forward<T>(term_)),
+	  max_edits(max_edits_),
+	  prefix_length(prefix_length_),
+	  termfreq_min(0),
+	  termfreq_est(0),
+	  did(0),
+	  weight(0.0),
+	  started(false) { }
+
+
+// Used for the prototypes in QueryCache::registry().
+template FuzzyTerm::FuzzyTerm(std::string&&, std::string&&, unsigned, unsigned);
+
+
+unsigned
+FuzzyTerm::auto_edits(const std::string& term)
+{
+	size_t length = 0;
+	for (size_t pos = 0; pos < term.size(); ++length) {
+		next_char(term, pos);
+	}
+	if (length <= 2) {
+		return 0;
+	}
+	if (length <= 5) {
+		return 1;
+	}
+	return 2;
+}
+
+
+Xapian::Query
+FuzzyTerm::getQuery(const required_spc_t& field_spc, const std::string& term, unsigned max_edits, unsigned prefix_length, Xapian::termcount wqf)
+{
+	if (max_edits == 0) {
+		return Xapian::Query(prefixed(term, field_spc.prefix, field_spc.get_ctype()), wqf);
+	}
+
+	auto ft = new FuzzyTerm(field_spc.prefix + field_spc.get_ctype(), std::string(term), std::min<unsigned>(max_edits, FUZZY_MAX_EDITS), prefix_length);
+	return Xapian::Query(ft->release());
+}
+
+
+void
+FuzzyTerm::update()
+{
+	did = 0;
+	weight = 0.0;
+	for (const auto& candidate : candidates) {
+		if (candidate.it == candidate.it_end) {
+			continue;
+		}
+		const auto c_did = *candidate.it;
+		if (!did || c_did < did) {
+			did = c_did;
+			weight = candidate.weight;
+		} else if (c_did == did) {
+			weight = std::max(weight, candidate.weight);
+		}
+	}
+}
+
+
+Xapian::doccount
+FuzzyTerm::get_termfreq_min() const
+{
+	return termfreq_min;
+}
+
+
+Xapian::doccount
+FuzzyTerm::get_termfreq_est() const
+{
+	return termfreq_est;
+}
+
+
+Xapian::doccount
+FuzzyTerm::get_termfreq_max() const
+{
+	return termfreq_est;
+}
+
+
+void
+FuzzyTerm::next(double)
+{
+	if (started) {
+		for (auto& candidate : candidates) {
+			if (candidate.it != candidate.it_end && *candidate.it == did) {
+				++candidate.it;
+			}
+		}
+	} else {
+		started = true;
+	}
+	update();
+}
+
+
+void
+FuzzyTerm::skip_to(Xapian::docid min_docid, double)
+{
+	started = true;
+	for (auto& candidate : candidates) {
+		if (candidate.it != candidate.it_end && *candidate.it < min_docid) {
+			candidate.it.skip_to(min_docid);
+		}
+	}
+	update();
+}
+
+
+bool
+FuzzyTerm::at_end() const
+{
+	return started && !did;
+}
+
+
+Xapian::docid
+FuzzyTerm::get_docid() const
+{
+	return did;
+}
+
+
+double
+FuzzyTerm::get_weight() const
+{
+	return weight;
+}
+
+
+FuzzyTerm*
+FuzzyTerm::clone() const
+{
+	return new FuzzyTerm(prefix, term, max_edits, prefix_length);
+}
+
+
+std::string
+FuzzyTerm::name() const
+{
+	return "FuzzyTerm";
+}
+
+
+std::string
+FuzzyTerm::serialise() const
+{
+	std::vector<std::string> data = { prefix, term, serialise_length(max_edits), serialise_length(prefix_length) };
+	return StringList::serialise(data.begin(), data.end());
+}
+
+
+FuzzyTerm*
+FuzzyTerm::unserialise_with_registry(const std::string& s, const Xapian::Registry&) const
+{
+	try {
+		StringList data(s);
+
+		if (data.size() != 4) {
+			throw Xapian::NetworkError("Bad serialised FuzzyTerm");
+		}
+
+		auto it = data.begin();
+		auto prefix_ = std::move(*it);
+		auto term_ = std::move(*(++it));
+		auto max_edits_ = unserialise_length(*(++it));
+		auto prefix_length_ = unserialise_length(*(++it));
+		return new FuzzyTerm(std::move(prefix_), std::move(term_), max_edits_, prefix_length_);
+	} catch (const SerialisationError& er) {
+		throw Xapian::NetworkError("Bad serialised FuzzyTerm");
+	}
+}
+
+
+void
+FuzzyTerm::init(const Xapian::Database& db_)
+{
+	candidates.clear();
+	termfreq_min = 0;
+	termfreq_est = 0;
+	did = 0;
+	weight = 0.0;
+	started = false;
+
+	// The first prefix_length characters must match exactly.
+	size_t pos = 0;
+	for (unsigned i = 0; i < prefix_length && pos < term.size(); ++i) {
+		next_char(term, pos);
+	}
+	const auto fixed_prefix = prefix + term.substr(0, pos);
+
+	LevenshteinAutomaton automaton(term.substr(pos), max_edits);
+	auto matches = automaton.intersect(db_.allterms_begin(fixed_prefix), db_.allterms_end(fixed_prefix), fixed_prefix);
+
+	if (matches.size() > FUZZY_MAX_EXPANSIONS) {
+		std::sort(matches.begin(), matches.end(), [](const LevenshteinAutomaton::Match& a, const LevenshteinAutomaton::Match& b) {
+			return a.edits < b.edits || (a.edits == b.edits && a.termfreq > b.termfreq);
+		});
+		matches.resize(FUZZY_MAX_EXPANSIONS);
+	}
+
+	for (const auto& match : matches) {
+		candidates.push_back({ db_.postlist_begin(match.term), db_.postlist_end(match.term), 1.0 - static_cast<double>(match.edits) / (max_edits + 1) });
+		termfreq_min = std::max(termfreq_min, match.termfreq);
+		termfreq_est += match.termfreq;
+	}
+	termfreq_est = std::min(termfreq_est, db_.get_doccount());
+
+	set_maxweight(1.0);
+}
+
+
+std::string
+FuzzyTerm::get_description() const
+{
+	return "FuzzyTerm " + term + "~" + std::to_string(max_edits);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <string>      // for string
+#include <vector>      // for vector
+#include <xapian.h>    // for Database, docid, PostingIterator, PostingSource, Query
+
+
+struct required_spc_t;
+
+
+#define FUZZY_MAX_EDITS       2   /* Largest edit distance allowed */
+#define FUZZY_MAX_EXPANSIONS  50  /* Closest terms a fuzzy term expands to */
+
+
+/*
+ * Levenshtein automaton (with transpositions) for a word, run one character
+ * at a time over candidate terms. A state is the row of edit distances
+ * between the prefix of the candidate read so far and every prefix of the
+ * word.
+ */
+class LevenshteinAutomaton {
+	std::vector<uint32_t> word;
+	unsigned max_edits;
+
+public:
+	using State = std::vector<unsigned>;
+
+	struct Match {
+		std::string term;
+		unsigned edits;
+		Xapian::doccount termfreq;
+	};
+
+	LevenshteinAutomaton(const std::string& word_, unsigned max_edits_);
+
+	State start() const;
+	State step(const State& state, const State* prev_state, uint32_t c, uint32_t prev_c) const;
+
+	// Whether some continuation of the candidate can still match.
+	bool can_match(const State& state) const;
+
+	// Edits of the candidate read so far, or more than max_edits.
+	unsigned distance(const State& state) const {
+		return state.back();
+	}
+
+	/*
+	 * Returns the terms in the sorted range [it, it_end) within max_edits of
+	 * word, all of them starting with prefix. Subtrees of the dictionary that
+	 * can't match are jumped over with skip_to().
+	 */
+	std::vector<Match> intersect(Xapian::TermIterator it, const Xapian::TermIterator& it_end, const std::string& prefix) const;
+};
+
+
+/*
+ * Matches the documents with terms of a field within an edit distance of a
+ * word. The term dictionary of each database is intersected with a
+ * Levenshtein automaton at init(), keeping the FUZZY_MAX_EXPANSIONS closest
+ * (and then most frequent) terms, whose posting lists are merged. Closer
+ * terms weigh more.
+ */
+class FuzzyTerm : public Xapian::PostingSource {
+	// Field prefix and ctype of the terms.
+	std::string prefix;
+	std::string term;
+	unsigned max_edits;
+	unsigned prefix_length;
+
+	struct Candidate {
+		Xapian::PostingIterator it;
+		Xapian::PostingIterator it_end;
+		double weight;
+	};
+
+	std::vector<Candidate> candidates;
+	Xapian::doccount termfreq_min;
+	Xapian::doccount termfreq_est;
+	Xapian::docid did;
+	double weight;
+	bool started;
+
+	void update();
+
+public:
+	template <typename T, typename = std::enable_if_t<std::is_same<std::string, std::decay_t<T>>::value>>
+	FuzzyTerm(T&& prefix_, T&& term_, unsigned max_edits_, unsigned prefix_length_);
+
+	Xapian::doccount get_termfreq_min() const override;
+	Xapian::doccount get_termfreq_est() const override;
+	Xapian::doccount get_termfreq_max() const override;
+	void next(double min_wt) override;
+	void skip_to(Xapian::docid min_docid, double min_wt) override;
+	bool at_end() const override;
+	Xapian::docid get_docid() const override;
+	double get_weight() const override;
+	FuzzyTerm* clone() const override;
+	std::string name() const override;
+	std::string serialise() const override;
+	FuzzyTerm* unserialise_with_registry(const std::string& serialised, const Xapian::Registry&) const override;
+	void init(const Xapian::Database& db_) override;
+	std::string get_description() const override;
+
+	// Edits allowed by default for the given term.
+	static unsigned auto_edits(const std::string& term);
+
+	// Call this function for create a new Query for the fuzzy term.
+	static Xapian::Query getQuery(const required_spc_t& field_spc, const std::string& term, unsigned max_edits, unsigned prefix_length, Xapian::termcount wqf);
+};
@@ -26,6 +26,7 @@
 #include <utility>             // for pair
 
 #include "generate_terms.h"    // for GeneratTerms::geo
+#include "manager.h"           // for XapiandManager
 #include "schema.h"            // for required_spc_t
 #include "serialise_list.h"    // for StringList, RangeList
 
@@ -35,15 +36,15 @@ GeoSpatialRange::getQuery(const required_spc_t& field_spc, const MsgPack& obj)
 {
 	GeoSpatial geo(obj);
 
-	auto ranges = geo.getGeometry()->getRanges(field_spc.flags.partials, field_spc.error);
+	const auto ranges = XapiandManager::manager->cover_cache.get(*geo.getGeometry(), field_spc.flags.partials, field_spc.error);
 
-	if (ranges.empty()) {
+	if (ranges->empty()) {
 		return Xapian::Query::MatchNothing;
 	}
 
-	auto query = GenerateTerms::geo(ranges, field_spc.accuracy, field_spc.acc_prefix);
+	auto query = GenerateTerms::geo(*ranges, field_spc.accuracy, field_spc.acc_prefix);
 
-	auto gsr = new GeoSpatialRange(field_spc.slot, std::move(ranges));
+	auto gsr = new GeoSpatialRange(field_spc.slot, *ranges);
 	auto geoQ = Xapian::Query(gsr->release());
 
 	if (query.empty()) {
@@ -66,7 +66,7 @@ const std::unordered_map<std::string, dispatch_str_metric> map_dispatch_str_metr
 std::string
 SerialiseKey::findSmallest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MAX_STR_CMPVALUE;
 	}
@@ -80,12 +80,12 @@ SerialiseKey::findSmallest(const Xapian::Document& doc) const
 std::string
 SerialiseKey::findBiggest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MIN_STR_CMPVALUE;
 	}
 
-	StringList values(doc.get_value(_slot));
+	StringList values(DocValues::get_value(doc, _slot));
 
 	return values.back();
 }
@@ -94,7 +94,7 @@ SerialiseKey::findBiggest(const Xapian::Document& doc) const
 std::string
 FloatKey::findSmallest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MAX_CMPVALUE;
 	}
@@ -127,7 +127,7 @@ FloatKey::findSmallest(const Xapian::Document& doc) const
 std::string
 FloatKey::findBiggest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MIN_CMPVALUE;
 	}
@@ -160,7 +160,7 @@ FloatKey::findBiggest(const Xapian::Document& doc) const
 std::string
 IntegerKey::findSmallest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MAX_CMPVALUE;
 	}
@@ -193,7 +193,7 @@ IntegerKey::findSmallest(const Xapian::Document& doc) const
 std::string
 IntegerKey::findBiggest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MIN_CMPVALUE;
 	}
@@ -226,7 +226,7 @@ IntegerKey::findBiggest(const Xapian::Document& doc) const
 std::string
 PositiveKey::findSmallest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MAX_CMPVALUE;
 	}
@@ -263,7 +263,7 @@ PositiveKey::findSmallest(const Xapian::Document& doc) const
 std::string
 PositiveKey::findBiggest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MIN_CMPVALUE;
 	}
@@ -301,7 +301,7 @@ PositiveKey::findBiggest(const Xapian::Document& doc) const
 std::string
 BoolKey::findSmallest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MAX_CMPVALUE;
 	}
@@ -319,7 +319,7 @@ BoolKey::findSmallest(const Xapian::Document& doc) const
 std::string
 BoolKey::findBiggest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MIN_CMPVALUE;
 	}
@@ -337,7 +337,7 @@ BoolKey::findBiggest(const Xapian::Document& doc) const
 std::string
 GeoKey::findSmallest(const Xapian::Document& doc) const
 {
-	auto multiValues = doc.get_value(_slot);
+	auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MAX_CMPVALUE;
 	}
@@ -365,7 +365,7 @@ GeoKey::findSmallest(const Xapian::Document& doc) const
 std::string
 GeoKey::findBiggest(const Xapian::Document& doc) const
 {
-	const auto multiValues = doc.get_value(_slot);
+	const auto multiValues = DocValues::get_value(doc, _slot);
 	if (multiValues.empty()) {
 		return MIN_CMPVALUE;
 	}
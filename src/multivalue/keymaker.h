@@ -35,6 +35,7 @@
 
 #include "database_utils.h"               // for query_field_t
 #include "datetime.h"                     // for timestamp
+#include "doc_values.h"                   // for DocValues
 #include "phonetic.h"                     // for SoundexEnglish, SoundexFrench...
 #include "schema.h"                       // for required_spc_t, required_sp...
 #include "serialise_list.h"               // for StringList, ...
@@ -186,7 +187,7 @@ public:
 		  _metric(value, icase) { }
 
 	std::string findSmallest(const Xapian::Document& doc) const override {
-		const auto multiValues = doc.get_value(_slot);
+		const auto multiValues = DocValues::get_value(doc, _slot);
 		if (multiValues.empty()) {
 			return MAX_CMPVALUE;
 		}
@@ -208,7 +209,7 @@ public:
 	}
 
 	std::string findBiggest(const Xapian::Document& doc) const override {
-		const auto multiValues = doc.get_value(_slot);
+		const auto multiValues = DocValues::get_value(doc, _slot);
 		if (multiValues.empty()) {
 			return MIN_CMPVALUE;
 		}
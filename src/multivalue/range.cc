@@ -189,11 +189,15 @@ MultipleValueRange::getQuery(const required_spc_t& field_spc, const MsgPack& obj
 
 template <typename T, typename>
 MultipleValueRange::MultipleValueRange(Xapian::valueno slot_, T&& start_, T&& end_)
-	: Xapian::ValuePostingSource(slot_),
+	: DocValuesPostingSource(slot_),
 	  start(std::forward<T>(start_)),
 	  end(std::forward<T>(end_)) { }
 
 
+// Used for the prototypes in QueryCache::registry().
+template MultipleValueRange::MultipleValueRange(Xapian::valueno, std::string&&, std::string&&);
+
+
 bool
 MultipleValueRange::insideRange() const noexcept
 {
@@ -213,32 +217,52 @@ MultipleValueRange::insideRange() const noexcept
 }
 
 
+bool
+MultipleValueRange::insideZone(const std::string& min, const std::string& max) const noexcept
+{
+	return !(end < min || start > max);
+}
+
+
 void
-MultipleValueRange::next(double min_wt)
+MultipleValueRange::advance(double min_wt)
 {
-	Xapian::ValuePostingSource::next(min_wt);
 	while (!at_end()) {
-		if (insideRange()) break;
-		Xapian::ValuePostingSource::next(min_wt);
+		auto did = get_docid();
+		auto next_did = zone_map.skip(did, [this](const std::string& min, const std::string& max) {
+			return insideZone(min, max);
+		});
+		if (next_did != did) {
+			DocValuesPostingSource::skip_to(next_did, min_wt);
+		} else if (insideRange()) {
+			break;
+		} else {
+			DocValuesPostingSource::next(min_wt);
+		}
 	}
 }
 
 
+void
+MultipleValueRange::next(double min_wt)
+{
+	DocValuesPostingSource::next(min_wt);
+	advance(min_wt);
+}
+
+
 void
 MultipleValueRange::skip_to(Xapian::docid min_docid, double min_wt)
 {
-	Xapian::ValuePostingSource::skip_to(min_docid, min_wt);
-	while (!at_end()) {
-		if (insideRange()) break;
-		Xapian::ValuePostingSource::next(min_wt);
-	}
+	DocValuesPostingSource::skip_to(min_docid, min_wt);
+	advance(min_wt);
 }
 
 
 bool
 MultipleValueRange::check(Xapian::docid min_docid, double min_wt)
 {
-	if (!Xapian::ValuePostingSource::check(min_docid, min_wt)) {
+	if (!DocValuesPostingSource::check(min_docid, min_wt)) {
 		// check returned false, so we know the document is not in the source.
 		return false;
 	}
@@ -248,7 +272,12 @@ MultipleValueRange::check(Xapian::docid min_docid, double min_wt)
 		return true;
 	}
 
-	return insideRange();
+	auto did = get_docid();
+	auto next_did = zone_map.skip(did, [this](const std::string& min, const std::string& max) {
+		return insideZone(min, max);
+	});
+
+	return next_did == did && insideRange();
 }
 
 
@@ -288,13 +317,16 @@ MultipleValueRange::unserialise_with_registry(const std::string& s, const Xapian
 		StringList data(s);
 
 		if (data.size() != 3) {
-			throw Xapian::NetworkError("Bad serialised GeoSpatialRange");
+			throw Xapian::NetworkError("Bad serialised MultipleValueRange");
 		}
 
 		auto it = data.begin();
-		return new MultipleValueRange(unserialise_length(*it), std::move(*(++it)), std::move(*(++it)));
+		const auto slot_ = static_cast<Xapian::valueno>(unserialise_length(*it));
+		auto start_ = std::move(*(++it));
+		auto end_ = std::move(*(++it));
+		return new MultipleValueRange(slot_, std::move(start_), std::move(end_));
 	} catch (const SerialisationError& er) {
-		throw Xapian::NetworkError("Bad serialised AggregationMatchSpy");
+		throw Xapian::NetworkError("Bad serialised MultipleValueRange");
 	}
 }
 
@@ -302,10 +334,12 @@ MultipleValueRange::unserialise_with_registry(const std::string& s, const Xapian
 void
 MultipleValueRange::init(const Xapian::Database& db_)
 {
-	Xapian::ValuePostingSource::init(db_);
+	DocValuesPostingSource::init(db_);
 
 	// Possible that no documents are in range.
 	set_termfreq_min(0);
+
+	zone_map = ZoneMap::load(db_, get_slot());
 }
 
 
@@ -321,10 +355,14 @@ MultipleValueRange::get_description() const
 
 template <typename T, typename>
 MultipleValueGE::MultipleValueGE(Xapian::valueno slot_, T&& start_)
-	: Xapian::ValuePostingSource(slot_),
+	: DocValuesPostingSource(slot_),
 	  start(std::forward<T>(start_)) { }
 
 
+// Used for the prototypes in QueryCache::registry().
+template MultipleValueGE::MultipleValueGE(Xapian::valueno, std::string&&);
+
+
 bool
 MultipleValueGE::insideRange() const noexcept
 {
@@ -338,32 +376,53 @@ MultipleValueGE::insideRange() const noexcept
 }
 
 
+bool
+MultipleValueGE::insideZone(const std::string& min, const std::string& max) const noexcept
+{
+	(void)min;
+	return max >= start;
+}
+
+
 void
-MultipleValueGE::next(double min_wt)
+MultipleValueGE::advance(double min_wt)
 {
-	Xapian::ValuePostingSource::next(min_wt);
 	while (!at_end()) {
-		if (insideRange()) break;
-		Xapian::ValuePostingSource::next(min_wt);
+		auto did = get_docid();
+		auto next_did = zone_map.skip(did, [this](const std::string& min, const std::string& max) {
+			return insideZone(min, max);
+		});
+		if (next_did != did) {
+			DocValuesPostingSource::skip_to(next_did, min_wt);
+		} else if (insideRange()) {
+			break;
+		} else {
+			DocValuesPostingSource::next(min_wt);
+		}
 	}
 }
 
 
+void
+MultipleValueGE::next(double min_wt)
+{
+	DocValuesPostingSource::next(min_wt);
+	advance(min_wt);
+}
+
+
 void
 MultipleValueGE::skip_to(Xapian::docid min_docid, double min_wt)
 {
-	Xapian::ValuePostingSource::skip_to(min_docid, min_wt);
-	while (!at_end()) {
-		if (insideRange()) break;
-		Xapian::ValuePostingSource::next(min_wt);
-	}
+	DocValuesPostingSource::skip_to(min_docid, min_wt);
+	advance(min_wt);
 }
 
 
 bool
 MultipleValueGE::check(Xapian::docid min_docid, double min_wt)
 {
-	if (!Xapian::ValuePostingSource::check(min_docid, min_wt)) {
+	if (!DocValuesPostingSource::check(min_docid, min_wt)) {
 		// check returned false, so we know the document is not in the source.
 		return false;
 	}
@@ -373,7 +432,12 @@ MultipleValueGE::check(Xapian::docid min_docid, double min_wt)
 		return true;
 	}
 
-	return insideRange();
+	auto did = get_docid();
+	auto next_did = zone_map.skip(did, [this](const std::string& min, const std::string& max) {
+		return insideZone(min, max);
+	});
+
+	return next_did == did && insideRange();
 }
 
 
@@ -413,13 +477,15 @@ MultipleValueGE::unserialise_with_registry(const std::string& s, const Xapian::R
 		StringList data(s);
 
 		if (data.size() != 2) {
-			throw Xapian::NetworkError("Bad serialised GeoSpatialRange");
+			throw Xapian::NetworkError("Bad serialised MultipleValueGE");
 		}
 
 		auto it = data.begin();
-		return new MultipleValueGE(unserialise_length(*it), std::move(*(++it)));
+		const auto slot_ = static_cast<Xapian::valueno>(unserialise_length(*it));
+		auto start_ = std::move(*(++it));
+		return new MultipleValueGE(slot_, std::move(start_));
 	} catch (const SerialisationError& er) {
-		throw Xapian::NetworkError("Bad serialised AggregationMatchSpy");
+		throw Xapian::NetworkError("Bad serialised MultipleValueGE");
 	}
 }
 
@@ -427,10 +493,12 @@ MultipleValueGE::unserialise_with_registry(const std::string& s, const Xapian::R
 void
 MultipleValueGE::init(const Xapian::Database& db_)
 {
-	Xapian::ValuePostingSource::init(db_);
+	DocValuesPostingSource::init(db_);
 
 	// Possible that no documents are in range.
 	set_termfreq_min(0);
+
+	zone_map = ZoneMap::load(db_, get_slot());
 }
 
 
@@ -445,10 +513,14 @@ MultipleValueGE::get_description() const
 
 template <typename T, typename>
 MultipleValueLE::MultipleValueLE(Xapian::valueno slot_, T&& end_)
-	: Xapian::ValuePostingSource(slot_),
+	: DocValuesPostingSource(slot_),
 	  end(std::forward<T>(end_)) { }
 
 
+// Used for the prototypes in QueryCache::registry().
+template MultipleValueLE::MultipleValueLE(Xapian::valueno, std::string&&);
+
+
 bool
 MultipleValueLE::insideRange() const noexcept
 {
@@ -462,32 +534,53 @@ MultipleValueLE::insideRange() const noexcept
 }
 
 
+bool
+MultipleValueLE::insideZone(const std::string& min, const std::string& max) const noexcept
+{
+	(void)max;
+	return min <= end;
+}
+
+
 void
-MultipleValueLE::next(double min_wt)
+MultipleValueLE::advance(double min_wt)
 {
-	Xapian::ValuePostingSource::next(min_wt);
 	while (!at_end()) {
-		if (insideRange()) break;
-		Xapian::ValuePostingSource::next(min_wt);
+		auto did = get_docid();
+		auto next_did = zone_map.skip(did, [this](const std::string& min, const std::string& max) {
+			return insideZone(min, max);
+		});
+		if (next_did != did) {
+			DocValuesPostingSource::skip_to(next_did, min_wt);
+		} else if (insideRange()) {
+			break;
+		} else {
+			DocValuesPostingSource::next(min_wt);
+		}
 	}
 }
 
 
+void
+MultipleValueLE::next(double min_wt)
+{
+	DocValuesPostingSource::next(min_wt);
+	advance(min_wt);
+}
+
+
 void
 MultipleValueLE::skip_to(Xapian::docid min_docid, double min_wt)
 {
-	Xapian::ValuePostingSource::skip_to(min_docid, min_wt);
-	while (!at_end()) {
-		if (insideRange()) break;
-		Xapian::ValuePostingSource::next(min_wt);
-	}
+	DocValuesPostingSource::skip_to(min_docid, min_wt);
+	advance(min_wt);
 }
 
 
 bool
 MultipleValueLE::check(Xapian::docid min_docid, double min_wt)
 {
-	if (!Xapian::ValuePostingSource::check(min_docid, min_wt)) {
+	if (!DocValuesPostingSource::check(min_docid, min_wt)) {
 		// check returned false, so we know the document is not in the source.
 		return false;
 	}
@@ -497,7 +590,12 @@ MultipleValueLE::check(Xapian::docid min_docid, double min_wt)
 		return true;
 	}
 
-	return insideRange();
+	auto did = get_docid();
+	auto next_did = zone_map.skip(did, [this](const std::string& min, const std::string& max) {
+		return insideZone(min, max);
+	});
+
+	return next_did == did && insideRange();
 }
 
 
@@ -537,13 +635,15 @@ MultipleValueLE::unserialise_with_registry(const std::string& s, const Xapian::R
 		StringList data(s);
 
 		if (data.size() != 2) {
-			throw Xapian::NetworkError("Bad serialised GeoSpatialRange");
+			throw Xapian::NetworkError("Bad serialised MultipleValueLE");
 		}
 
 		auto it = data.begin();
-		return new MultipleValueLE(unserialise_length(*it), std::move(*(++it)));
+		const auto slot_ = static_cast<Xapian::valueno>(unserialise_length(*it));
+		auto end_ = std::move(*(++it));
+		return new MultipleValueLE(slot_, std::move(end_));
 	} catch (const SerialisationError& er) {
-		throw Xapian::NetworkError("Bad serialised AggregationMatchSpy");
+		throw Xapian::NetworkError("Bad serialised MultipleValueLE");
 	}
 }
 
@@ -551,10 +651,12 @@ MultipleValueLE::unserialise_with_registry(const std::string& s, const Xapian::R
 void
 MultipleValueLE::init(const Xapian::Database& db_)
 {
-	Xapian::ValuePostingSource::init(db_);
+	DocValuesPostingSource::init(db_);
 
 	// Possible that no documents are in range.
 	set_termfreq_min(0);
+
+	zone_map = ZoneMap::load(db_, get_slot());
 }
 
 
@@ -25,22 +25,33 @@
 #include "xapiand.h"
 
 #include <string>           // for string
-#include <xapian.h>         // for docid, ValuePostingSource, valueno, Query
+#include <xapian.h>         // for docid, valueno, Query
 
+#include "doc_values.h"     // for DocValuesPostingSource
 #include "msgpack.h"        // for MsgPack
+#include "zone_map.h"       // for ZoneMap
 
 
 struct required_spc_t;
 
 
 // New Match Decider for multiple value range.
-class MultipleValueRange : public Xapian::ValuePostingSource {
+class MultipleValueRange : public DocValuesPostingSource {
 	// Range [start, end] for the search.
 	std::string start, end;
 
 	// Calculate if some their values is inside range.
 	bool insideRange() const noexcept;
 
+	// Min/max of the slot values by block of documents.
+	ZoneMap zone_map;
+
+	// Calculate if a block with values in [min, max] could be inside range.
+	bool insideZone(const std::string& min, const std::string& max) const noexcept;
+
+	// Skip from the current document to the next one inside range.
+	void advance(double min_wt);
+
 	// Get the geospatial query
 	static Xapian::Query query_geo(const std::string& str, const required_spc_t& field_spc);
 
@@ -72,13 +83,22 @@ public:
 
 
 // New Match Decider for multiple value GE.
-class MultipleValueGE : public Xapian::ValuePostingSource {
+class MultipleValueGE : public DocValuesPostingSource {
 	// Range [start, ..] for the search.
 	std::string start;
 
 	// Calculate if some their values is inside range.
 	bool insideRange() const noexcept;
 
+	// Min/max of the slot values by block of documents.
+	ZoneMap zone_map;
+
+	// Calculate if a block with values in [min, max] could be inside range.
+	bool insideZone(const std::string& min, const std::string& max) const noexcept;
+
+	// Skip from the current document to the next one inside range.
+	void advance(double min_wt);
+
 public:
 	/* Construct a new match decider which returns only documents with a
 	 *  some of their values inside of [start, ..].
@@ -103,13 +123,22 @@ public:
 
 
 // New Match Decider for multiple value LE.
-class MultipleValueLE : public Xapian::ValuePostingSource {
+class MultipleValueLE : public DocValuesPostingSource {
 	// Range [.., end] for the search.
 	std::string end;
 
 	// Calculate if some their values is inside range.
 	bool insideRange() const noexcept;
 
+	// Min/max of the slot values by block of documents.
+	ZoneMap zone_map;
+
+	// Calculate if a block with values in [min, max] could be inside range.
+	bool insideZone(const std::string& min, const std::string& max) const noexcept;
+
+	// Skip from the current document to the next one inside range.
+	void advance(double min_wt);
+
 public:
 	/* Construct a new match decider which returns only documents with a
 	 *  some of their values inside of [.., end].
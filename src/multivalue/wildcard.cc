@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "wildcard.h"
+
+#include <algorithm>          // for reverse
+#include <set>                // for set
+#include <vector>             // for vector
+
+#include "database_utils.h"   // for prefixed
+#include "exception.h"        // for SerialisationError
+#include "schema.h"           // for required_spc_t
+#include "serialise_list.h"   // for StringList
+#include "utils.h"            // for startswith
+
+
+template <typename T, typename>
+TermWildcard::TermWildcard(T&& prefix_, T&& pattern_)
+	: prefix(std::forward<T>(prefix_)),
+	  pattern(std::forward<T>(pattern_)),
+	  doccount(0),
+	  started(false) { }
+
+
+// Used for the prototypes in QueryCache::registry().
+template TermWildcard::TermWildcard(std::string&&, std::string&&);
+
+
+bool
+TermWildcard::match(const std::string& pattern, const std::string& str)
+{
+	size_t p = 0, s = 0;
+	size_t star = std::string::npos, star_s = 0;
+	while (s < str.size()) {
+		if (p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			star_s = s;
+		} else if (p < pattern.size() && pattern[p] == str[s]) {
+			++p;
+			++s;
+		} else if (star != std::string::npos) {
+			// Let the last '*' take one more byte.
+			p = star + 1;
+			s = ++star_s;
+		} else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+	return p == pattern.size();
+}
+
+
+bool
+TermWildcard::is_infix(const std::string& pattern)
+{
+	const auto pos = pattern.find('*');
+	return pos != std::string::npos && pos != pattern.size() - 1;
+}
+
+
+void
+TermWildcard::index(Xapian::Document& doc, const std::string& term, const required_spc_t& field_spc)
+{
+	std::string reversed(term.rbegin(), term.rend());
+	doc.add_boolean_term(prefixed(reversed, field_spc.prefix, WILDCARD_REVERSED_CTYPE));
+	if (term.size() >= WILDCARD_NGRAM_SIZE) {
+		for (size_t i = 0; i <= term.size() - WILDCARD_NGRAM_SIZE; ++i) {
+			doc.add_boolean_term(prefixed(term.substr(i, WILDCARD_NGRAM_SIZE), field_spc.prefix, WILDCARD_NGRAM_CTYPE));
+		}
+	}
+}
+
+
+Xapian::Query
+TermWildcard::getQuery(const required_spc_t& field_spc, const std::string& pattern, Xapian::termcount wqf)
+{
+	std::vector<std::string> pieces;
+	size_t start = 0;
+	for (auto pos = pattern.find('*'); pos != std::string::npos; pos = pattern.find('*', start)) {
+		pieces.push_back(pattern.substr(start, pos - start));
+		start = pos + 1;
+	}
+	pieces.push_back(pattern.substr(start));
+
+	const auto& first = pieces.front();
+	const auto& last = pieces.back();
+
+	std::vector<Xapian::Query> queries;
+	if (!first.empty()) {
+		queries.emplace_back(Xapian::Query::OP_WILDCARD, prefixed(first, field_spc.prefix, field_spc.get_ctype()), wqf);
+	}
+	if (!last.empty()) {
+		std::string reversed(last.rbegin(), last.rend());
+		queries.emplace_back(Xapian::Query::OP_WILDCARD, prefixed(reversed, field_spc.prefix, WILDCARD_REVERSED_CTYPE), wqf);
+	}
+	if (queries.size() == 1 && pieces.size() == 2 && first.empty()) {
+		// A plain suffix ("*abc") needs no verification.
+		return queries.front();
+	}
+
+	std::set<std::string> ngrams;
+	for (size_t i = 1; i < pieces.size() - 1; ++i) {
+		const auto& piece = pieces[i];
+		if (piece.size() >= WILDCARD_NGRAM_SIZE) {
+			for (size_t j = 0; j <= piece.size() - WILDCARD_NGRAM_SIZE; ++j) {
+				ngrams.insert(prefixed(piece.substr(j, WILDCARD_NGRAM_SIZE), field_spc.prefix, WILDCARD_NGRAM_CTYPE));
+			}
+		}
+	}
+	if (!ngrams.empty()) {
+		queries.emplace_back(Xapian::Query::OP_AND, ngrams.begin(), ngrams.end());
+	}
+
+	auto tw = new TermWildcard(field_spc.prefix + field_spc.get_ctype(), std::string(pattern));
+	if (queries.empty()) {
+		// Nothing to narrow the search, every document is verified.
+		return Xapian::Query(tw->release());
+	}
+	return Xapian::Query(Xapian::Query::OP_FILTER, Xapian::Query(Xapian::Query::OP_AND, queries.begin(), queries.end()), Xapian::Query(tw->release()));
+}
+
+
+bool
+TermWildcard::matches(Xapian::docid did) const
+{
+	const auto t_end = db.termlist_end(did);
+	auto t = db.termlist_begin(did);
+	for (t.skip_to(prefix); t != t_end; ++t) {
+		const auto term = *t;
+		if (!startswith(term, prefix)) {
+			break;
+		}
+		if (match(pattern, term.substr(prefix.size()))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void
+TermWildcard::advance()
+{
+	while (it != it_end && !matches(*it)) {
+		++it;
+	}
+}
+
+
+Xapian::doccount
+TermWildcard::get_termfreq_min() const
+{
+	// Possible that no documents match.
+	return 0;
+}
+
+
+Xapian::doccount
+TermWildcard::get_termfreq_est() const
+{
+	// Verification is expensive, estimate high so other subqueries lead.
+	return doccount;
+}
+
+
+Xapian::doccount
+TermWildcard::get_termfreq_max() const
+{
+	return doccount;
+}
+
+
+void
+TermWildcard::next(double)
+{
+	if (started) {
+		++it;
+	} else {
+		started = true;
+	}
+	advance();
+}
+
+
+void
+TermWildcard::skip_to(Xapian::docid min_docid, double)
+{
+	started = true;
+	it.skip_to(min_docid);
+	advance();
+}
+
+
+bool
+TermWildcard::check(Xapian::docid min_docid, double)
+{
+	started = true;
+	it.skip_to(min_docid);
+
+	if (it == it_end) {
+		// return true, since we're definitely at the end of the list.
+		return true;
+	}
+
+	return *it == min_docid && matches(min_docid);
+}
+
+
+bool
+TermWildcard::at_end() const
+{
+	return started && it == it_end;
+}
+
+
+Xapian::docid
+TermWildcard::get_docid() const
+{
+	return *it;
+}
+
+
+double
+TermWildcard::get_weight() const
+{
+	return 0.0;
+}
+
+
+TermWildcard*
+TermWildcard::clone() const
+{
+	return new TermWildcard(prefix, pattern);
+}
+
+
+std::string
+TermWildcard::name() const
+{
+	return "TermWildcard";
+}
+
+
+std::string
+TermWildcard::serialise() const
+{
+	std::vector<std::string> data = { prefix, pattern };
+	return StringList::serialise(data.begin(), data.end());
+}
+
+
+TermWildcard*
+TermWildcard::unserialise_with_registry(const std::string& s, const Xapian::Registry&) const
+{
+	try {
+		StringList data(s);
+
+		if (data.size() != 2) {
+			throw Xapian::NetworkError("Bad serialised TermWildcard");
+		}
+
+		auto it = data.begin();
+		auto prefix_ = std::move(*it);
+		auto pattern_ = std::move(*(++it));
+		return new TermWildcard(std::move(prefix_), std::move(pattern_));
+	} catch (const SerialisationError& er) {
+		throw Xapian::NetworkError("Bad serialised TermWildcard");
+	}
+}
+
+
+void
+TermWildcard::init(const Xapian::Database& db_)
+{
+	db = db_;
+	it = db.postlist_begin("");
+	it_end = db.postlist_end("");
+	doccount = db.get_doccount();
+	started = false;
+
+	set_maxweight(0.0);
+}
+
+
+std::string
+TermWildcard::get_description() const
+{
+	return "TermWildcard " + pattern;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <string>      // for string
+#include <xapian.h>    // for Database, docid, PostingIterator, PostingSource, Query
+
+
+struct required_spc_t;
+
+
+#define WILDCARD_REVERSED_CTYPE  'r'  /* Used instead of the field's ctype for reversed terms */
+#define WILDCARD_NGRAM_CTYPE     'n'  /* Used instead of the field's ctype for n-gram terms */
+#define WILDCARD_NGRAM_SIZE      3
+
+
+/*
+ * Suffix and infix wildcards for TERM and STRING fields with RESERVED_INFIX.
+ *
+ * Those fields also index each term reversed and its n-grams, so a pattern
+ * like "*@example.com" becomes a prefix wildcard over reversed terms and
+ * "*abc*" a conjunction of n-grams. Unless the rewrite is exact, candidate
+ * documents are verified against the field terms in their termlist.
+ */
+class TermWildcard : public Xapian::PostingSource {
+	// Field prefix and ctype of the terms to verify.
+	std::string prefix;
+	std::string pattern;
+
+	Xapian::Database db;
+	Xapian::PostingIterator it;
+	Xapian::PostingIterator it_end;
+	Xapian::doccount doccount;
+	bool started;
+
+	// Calculate if some field term of the document matches the pattern.
+	bool matches(Xapian::docid did) const;
+
+	void advance();
+
+public:
+	template <typename T, typename = std::enable_if_t<std::is_same<std::string, std::decay_t<T>>::value>>
+	TermWildcard(T&& prefix_, T&& pattern_);
+
+	Xapian::doccount get_termfreq_min() const override;
+	Xapian::doccount get_termfreq_est() const override;
+	Xapian::doccount get_termfreq_max() const override;
+	void next(double min_wt) override;
+	void skip_to(Xapian::docid min_docid, double min_wt) override;
+	bool check(Xapian::docid min_docid, double min_wt) override;
+	bool at_end() const override;
+	Xapian::docid get_docid() const override;
+	double get_weight() const override;
+	TermWildcard* clone() const override;
+	std::string name() const override;
+	std::string serialise() const override;
+	TermWildcard* unserialise_with_registry(const std::string& serialised, const Xapian::Registry&) const override;
+	void init(const Xapian::Database& db_) override;
+	std::string get_description() const override;
+
+	// Matches str against pattern, where '*' stands for any sequence of bytes.
+	static bool match(const std::string& pattern, const std::string& str);
+
+	// Whether pattern needs this (it has a '*' other than a trailing one).
+	static bool is_infix(const std::string& pattern);
+
+	// Indexes the reversed term and its n-grams.
+	static void index(Xapian::Document& doc, const std::string& term, const required_spc_t& field_spc);
+
+	// Call this function for create a new Query for the wildcard pattern.
+	static Xapian::Query getQuery(const required_spc_t& field_spc, const std::string& pattern, Xapian::termcount wqf);
+};
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "zone_map.h"
+
+#include "database_utils.h"   // for DB_META_ZONE_MAP
+#include "exception.h"        // for SerialisationError
+#include "length.h"           // for serialise_length, serialise_string
+#include "log.h"              // for L_WARNING
+#include "serialise_list.h"   // for StringList
+
+
+// Value of the metadata key marking a zone map as built (in chunks)
+#define ZONE_MAP_BUILT "\x02"
+
+
+std::string
+ZoneMap::key(Xapian::valueno slot_)
+{
+	return DB_META_ZONE_MAP + serialise_length(slot_);
+}
+
+
+std::string
+ZoneMap::key(Xapian::valueno slot_, Xapian::docid chunk_)
+{
+	return key(slot_) + serialise_length(chunk_);
+}
+
+
+void
+ZoneMap::update(Xapian::docid did, const std::string& min, const std::string& max)
+{
+	auto it = zones.find(block(did));
+	if (it == zones.end()) {
+		zones.emplace(block(did), Zone{ min, max });
+	} else {
+		if (min < it->second.min) {
+			it->second.min = min;
+		}
+		if (max > it->second.max) {
+			it->second.max = max;
+		}
+	}
+}
+
+
+void
+ZoneMap::update(std::map<Xapian::valueno, ZoneMap>& zone_maps, Xapian::docid did, const Xapian::Document& doc)
+{
+	const auto it_e = doc.values_end();
+	for (auto it = doc.values_begin(); it != it_e; ++it) {
+		try {
+			// Values are kept sorted.
+			StringList values(*it);
+			if (!values.empty()) {
+				zone_maps[it.get_valueno()].update(did, values.front(), values.back());
+			}
+		} catch (const SerialisationError&) { }
+	}
+}
+
+
+void
+ZoneMap::merge(const ZoneMap& other)
+{
+	for (const auto& zone : other.zones) {
+		update(zone.first * ZONE_MAP_BLOCK_SIZE + 1, zone.second.min, zone.second.max);
+	}
+}
+
+
+std::string
+ZoneMap::serialise() const
+{
+	std::string serialised;
+	for (const auto& zone : zones) {
+		serialised.append(serialise_length(zone.first));
+		serialised.append(serialise_string(zone.second.min));
+		serialised.append(serialise_string(zone.second.max));
+	}
+	return serialised;
+}
+
+
+ZoneMap
+ZoneMap::unserialise(const std::string& serialised)
+{
+	ZoneMap zone_map;
+	const char* p = serialised.data();
+	const char* p_end = p + serialised.size();
+	while (p != p_end) {
+		auto b = unserialise_length(&p, p_end);
+		auto min = unserialise_string(&p, p_end);
+		auto max = unserialise_string(&p, p_end);
+		zone_map.zones.emplace_hint(zone_map.zones.end(), b, Zone{ std::move(min), std::move(max) });
+	}
+	return zone_map;
+}
+
+
+ZoneMap
+ZoneMap::build(const Xapian::Database& db, Xapian::valueno slot)
+{
+	ZoneMap zone_map;
+	const auto it_e = db.valuestream_end(slot);
+	for (auto it = db.valuestream_begin(slot); it != it_e; ++it) {
+		try {
+			StringList values(*it);
+			if (!values.empty()) {
+				zone_map.update(it.get_docid(), values.front(), values.back());
+			}
+		} catch (const SerialisationError&) { }
+	}
+	return zone_map;
+}
+
+
+std::map<Xapian::docid, ZoneMap>
+ZoneMap::split() const
+{
+	std::map<Xapian::docid, ZoneMap> chunks_;
+	for (const auto& zone : zones) {
+		auto& zone_map = chunks_[chunk(zone.first)];
+		zone_map.zones.emplace_hint(zone_map.zones.end(), zone);
+	}
+	return chunks_;
+}
+
+
+void
+ZoneMap::commit(Xapian::WritableDatabase& wdb, const std::map<Xapian::valueno, ZoneMap>& zone_maps)
+{
+	for (const auto& pending : zone_maps) {
+		const auto slot_ = pending.first;
+		auto chunks_ = pending.second.split();
+		if (wdb.get_metadata(key(slot_)) == ZONE_MAP_BUILT) {
+			// Only the chunks with changed blocks are written again.
+			bool valid = true;
+			for (auto& chunk_ : chunks_) {
+				try {
+					chunk_.second.merge(unserialise(wdb.get_metadata(key(slot_, chunk_.first))));
+				} catch (const Xapian::SerialisationError&) {
+					valid = false;
+					break;
+				}
+			}
+			if (valid) {
+				for (const auto& chunk_ : chunks_) {
+					wdb.set_metadata(key(slot_, chunk_.first), chunk_.second.serialise());
+				}
+				continue;
+			}
+			L_WARNING(nullptr, "Rebuilding invalid zone map of slot %u", slot_);
+		}
+
+		// The blocks may have documents from before the slot had a zone map.
+		auto zone_map = build(wdb, slot_);
+		zone_map.merge(pending.second);
+		for (const auto& chunk_ : zone_map.split()) {
+			wdb.set_metadata(key(slot_, chunk_.first), chunk_.second.serialise());
+		}
+		wdb.set_metadata(key(slot_), ZONE_MAP_BUILT);
+	}
+}
+
+
+ZoneMap
+ZoneMap::load(const Xapian::Database& db, Xapian::valueno slot)
+{
+	ZoneMap zone_map;
+	// Docids of combined databases are interleaved, the zone maps of each shard don't apply.
+	if (db.size() == 1 && db.get_metadata(key(slot)) == ZONE_MAP_BUILT) {
+		zone_map.db = db;
+		zone_map.slot = slot;
+		zone_map.stored = true;
+	}
+	return zone_map;
+}
+
+
+void
+ZoneMap::load_chunk(Xapian::docid chunk_)
+{
+	if (!stored || !chunks.insert(chunk_).second) {
+		return;
+	}
+	try {
+		merge(unserialise(db.get_metadata(key(slot, chunk_))));
+	} catch (const Xapian::SerialisationError&) {
+		// Blocks without a zone are never skipped.
+	}
+}
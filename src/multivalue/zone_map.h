@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <limits>     // for numeric_limits
+#include <map>        // for map
+#include <set>        // for set
+#include <string>     // for string
+#include <xapian.h>   // for docid, valueno, Database, Document, WritableDatabase
+
+
+#define ZONE_MAP_BLOCK_SIZE  1024  /* Documents per zone map block */
+#define ZONE_MAP_CHUNK_SIZE  256   /* Blocks per metadata entry */
+
+
+/*
+ * Block-level min/max of the serialised values stored in a slot.
+ *
+ * Documents are grouped in blocks of ZONE_MAP_BLOCK_SIZE consecutive
+ * docids and, for each block, the smallest and largest value found in
+ * the slot is kept in the index's metadata. Zones only ever grow (deleted
+ * documents are not subtracted), so a block whose zone can't match a
+ * range certainly has no matching documents. The first time a slot's zone
+ * map is committed it is built from the slot's value stream, so documents
+ * indexed before zone maps existed are covered too. Blocks without a zone
+ * are never skipped.
+ *
+ * Zones are stored in chunks of ZONE_MAP_CHUNK_SIZE blocks, each in its
+ * own metadata entry: commits only rewrite the chunks they touch and
+ * loaded zone maps read the chunks lazily, as skip() reaches them.
+ */
+class ZoneMap {
+	struct Zone {
+		std::string min;
+		std::string max;
+	};
+
+	std::map<Xapian::docid, Zone> zones;
+
+	// Database the chunks are read from (if loaded), and the chunks read.
+	Xapian::Database db;
+	Xapian::valueno slot;
+	bool stored;
+	std::set<Xapian::docid> chunks;
+
+	// Last block found to be a candidate by skip()
+	Xapian::docid candidate;
+
+	// Reads the zones of chunk (if stored and not read yet)
+	void load_chunk(Xapian::docid chunk_);
+
+	// Zones by chunk
+	std::map<Xapian::docid, ZoneMap> split() const;
+
+public:
+	ZoneMap()
+		: slot(Xapian::BAD_VALUENO),
+		  stored(false),
+		  candidate(std::numeric_limits<Xapian::docid>::max()) { }
+
+	static Xapian::docid block(Xapian::docid did) {
+		return (did - 1) / ZONE_MAP_BLOCK_SIZE;
+	}
+
+	static Xapian::docid chunk(Xapian::docid block_) {
+		return block_ / ZONE_MAP_CHUNK_SIZE;
+	}
+
+	// Metadata key marking the zone map of slot as built
+	static std::string key(Xapian::valueno slot_);
+
+	// Metadata key for a chunk of the zone map of slot
+	static std::string key(Xapian::valueno slot_, Xapian::docid chunk_);
+
+	bool empty() const {
+		return zones.empty() && !stored;
+	}
+
+	// Widens the zone of the block of did to include [min, max]
+	void update(Xapian::docid did, const std::string& min, const std::string& max);
+
+	// Widens the zones of every slot in doc, added as did
+	static void update(std::map<Xapian::valueno, ZoneMap>& zone_maps, Xapian::docid did, const Xapian::Document& doc);
+
+	void merge(const ZoneMap& other);
+
+	std::string serialise() const;
+	static ZoneMap unserialise(const std::string& serialised);
+
+	// Builds the zone map of slot from every value stored in it
+	static ZoneMap build(const Xapian::Database& db, Xapian::valueno slot);
+
+	// Merges zone_maps into the ones stored in wdb, building those missing or invalid
+	static void commit(Xapian::WritableDatabase& wdb, const std::map<Xapian::valueno, ZoneMap>& zone_maps);
+
+	// Loads the zone map of slot, an empty one if it's missing (chunks are read by skip())
+	static ZoneMap load(const Xapian::Database& db, Xapian::valueno slot);
+
+	/*
+	 * Returns did if its block may have values for which may_match(min, max)
+	 * is true, otherwise the first docid of the next block that may.
+	 */
+	template <typename F>
+	Xapian::docid skip(Xapian::docid did, F&& may_match) {
+		auto b = block(did);
+		if (b == candidate) {
+			return did;
+		}
+		while (b <= block(std::numeric_limits<Xapian::docid>::max())) {
+			load_chunk(chunk(b));
+			auto it = zones.find(b);
+			if (it == zones.end() || may_match(it->second.min, it->second.max)) {
+				break;
+			}
+			++b;
+		}
+		candidate = b;
+		if (b == block(did)) {
+			return did;
+		}
+		if (b > block(std::numeric_limits<Xapian::docid>::max())) {
+			return std::numeric_limits<Xapian::docid>::max();
+		}
+		return b * ZONE_MAP_BLOCK_SIZE + 1;
+	}
+};
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "query_cache.h"
+
+#include <cstdint>                       // for uintptr_t
+#include <vector>                        // for vector
+
+#include "multivalue/fuzzy.h"            // for FuzzyTerm
+#include "multivalue/geospatialrange.h"  // for GeoSpatialRange
+#include "multivalue/range.h"            // for MultipleValueRange, MultipleValueGE
+#include "multivalue/wildcard.h"         // for TermWildcard
+
+
+std::string
+QueryCache::key(const std::shared_ptr<const MsgPack>& schema, const MsgPack& obj)
+{
+	// The schema address keeps queries of different indexes apart.
+	auto ptr = reinterpret_cast<uintptr_t>(schema.get());
+	std::string key(reinterpret_cast<const char*>(&ptr), sizeof(ptr));
+	key.append(obj.serialise());
+	return key;
+}
+
+
+const Xapian::Registry&
+QueryCache::registry()
+{
+	// Registries aren't thread safe, every thread has its own.
+	static thread_local Xapian::Registry registry = []() {
+		Xapian::Registry registry;
+		registry.register_posting_source(MultipleValueRange(0, std::string(), std::string()));
+		registry.register_posting_source(MultipleValueGE(0, std::string()));
+		registry.register_posting_source(MultipleValueLE(0, std::string()));
+		registry.register_posting_source(GeoSpatialRange(0, std::vector<range_t>()));
+		registry.register_posting_source(TermWildcard(std::string(), std::string()));
+		registry.register_posting_source(FuzzyTerm(std::string(), std::string(), 0, 0));
+		return registry;
+	}();
+	return registry;
+}
+
+
+bool
+QueryCache::get(const std::shared_ptr<const MsgPack>& schema, const MsgPack& obj, Xapian::Query& query)
+{
+	std::shared_ptr<const QueryCacheEntry> entry;
+	if (!find(key(schema, obj), entry) || entry->schema.lock() != schema) {
+		return false;
+	}
+
+	try {
+		query = Xapian::Query::unserialise(entry->serialised, registry());
+		return true;
+	} catch (const Xapian::Error&) {
+		return false;
+	}
+}
+
+
+void
+QueryCache::set(const std::shared_ptr<const MsgPack>& schema, const MsgPack& obj, const Xapian::Query& query)
+{
+	auto entry = std::make_shared<QueryCacheEntry>();
+	entry->schema = schema;
+	try {
+		entry->serialised = query.serialise();
+	} catch (const Xapian::Error&) {
+		// Queries using posting sources which can't be serialised are not cached
+		return;
+	}
+	insert(key(schema, obj), std::shared_ptr<const QueryCacheEntry>(std::move(entry)));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <memory>             // for shared_ptr, weak_ptr
+#include <string>             // for string
+#include <xapian.h>           // for Query, Registry
+
+#include "concurrent_lru.h"   // for ConcurrentLRU
+#include "msgpack.h"          // for MsgPack
+
+
+#define QUERY_CACHE_SIZE  (32 * 1024 * 1024)  /* Bytes of keys and queries kept */
+
+
+struct QueryCacheEntry {
+	// Schema the query was compiled with
+	std::weak_ptr<const MsgPack> schema;
+	std::string serialised;
+};
+
+
+struct QueryCacheWeight {
+	size_t operator()(const std::string& key, const std::shared_ptr<const QueryCacheEntry>& entry) const noexcept {
+		return key.size() + (entry ? entry->serialised.size() : 0);
+	}
+};
+
+
+/*
+ * Queries compiled by QueryDSL, serialised and keyed by the schema and the
+ * query DSL (as MessagePack) they were compiled from. Entries only hit for
+ * the very schema they were compiled with, so schema changes invalidate
+ * them. Queries are unserialised with a registry holding our posting
+ * sources.
+ */
+class QueryCache : public lru::ConcurrentLRU<std::string, std::shared_ptr<const QueryCacheEntry>, std::hash<std::string>, QueryCacheWeight> {
+	static std::string key(const std::shared_ptr<const MsgPack>& schema, const MsgPack& obj);
+
+public:
+	QueryCache(ssize_t max_size=-1)
+		: ConcurrentLRU(max_size) { }
+
+	// Registry with the posting sources used in our queries.
+	static const Xapian::Registry& registry();
+
+	bool get(const std::shared_ptr<const MsgPack>& schema, const MsgPack& obj, Xapian::Query& query);
+	void set(const std::shared_ptr<const MsgPack>& schema, const MsgPack& obj, const Xapian::Query& query);
+};
@@ -22,6 +22,7 @@
 
 #include "query_dsl.h"
 
+#include "analyser.h"                          // for Analyser
 #include "booleanParser/BooleanParser.h"       // for BooleanTree
 #include "booleanParser/LexicalException.h"    // for LexicalException
 #include "booleanParser/SyntacticException.h"  // for SyntacticException
@@ -30,9 +31,13 @@
 #include "exception.h"                         // for THROW, QueryDslError
 #include "field_parser.h"                      // for FieldParser
 #include "log.h"                               // for Log, L_CALL, L
+#include "manager.h"                           // for XapiandManager
+#include "multivalue/fuzzy.h"                  // for FuzzyTerm
 #include "multivalue/generate_terms.h"         // for GenerateTerms
 #include "multivalue/geospatialrange.h"        // for GeoSpatial, GeoSpatialRange
 #include "multivalue/range.h"                  // for MultipleValueRange
+#include "multivalue/wildcard.h"               // for TermWildcard
+#include "query_cache.h"                       // for QueryCache
 #include "serialise.h"                         // for MsgPack, get_range_type...
 #include "utils.h"                             // for repr, startswith
 
@@ -45,6 +50,7 @@
 
 const std::unordered_map<std::string, QueryDSL::dispatch_func> QueryDSL::map_dispatch({
 	// Leaf query clauses.
+	{ QUERYDSL_FUZZY,                 &QueryDSL::process_fuzzy         },
 	{ QUERYDSL_IN,                    &QueryDSL::process_in            },
 	{ QUERYDSL_RANGE,                 &QueryDSL::process_range         },
 	{ QUERYDSL_RAW,                   &QueryDSL::process_raw           },
@@ -198,6 +204,66 @@ QueryDSL::process_in(const std::string&, Xapian::Query::op op, const std::string
 }
 
 
+Xapian::Query
+QueryDSL::process_fuzzy(const std::string& word, Xapian::Query::op, const std::string& parent, const MsgPack& obj, Xapian::termcount wqf, int, bool, bool, bool)
+{
+	L_CALL(this, "QueryDSL::process_fuzzy(...)");
+
+	const MsgPack* value = &obj;
+	int max_edits = -1;
+	unsigned prefix_length = 0;
+	if (obj.is_map()) {
+		auto it = obj.find(RESERVED_VALUE);
+		if (it == obj.end()) {
+			THROW(QueryDslError, "%s must contain %s [%s]", word.c_str(), RESERVED_VALUE, repr(obj.to_string()).c_str());
+		}
+		value = &it.value();
+		try {
+			it = obj.find(QUERYDSL_MAX_EDITS);
+			if (it != obj.end()) {
+				max_edits = static_cast<int>(it.value().as_u64());
+				if (max_edits > FUZZY_MAX_EDITS) {
+					THROW(QueryDslError, "%s must be between 0 and %d", QUERYDSL_MAX_EDITS, FUZZY_MAX_EDITS);
+				}
+			}
+			it = obj.find(QUERYDSL_PREFIX_LENGTH);
+			if (it != obj.end()) {
+				prefix_length = static_cast<unsigned>(it.value().as_u64());
+			}
+		} catch (const msgpack::type_error&) {
+			THROW(QueryDslError, "%s and %s must be positive integers", QUERYDSL_MAX_EDITS, QUERYDSL_PREFIX_LENGTH);
+		}
+	}
+
+	if (!value->is_string()) {
+		THROW(QueryDslError, "%s must be a string [%s]", word.c_str(), repr(value->to_string()).c_str());
+	}
+
+	if (parent.empty()) {
+		THROW(QueryDslError, "%s must be applied to a field", word.c_str());
+	}
+
+	const auto field_spc = schema->get_data_field(parent).first;
+	auto term = value->as_string();
+	switch (field_spc.get_type()) {
+		case FieldType::TERM:
+			if (field_spc.flags.bool_term) {
+				break;
+			}
+		case FieldType::TEXT:
+		case FieldType::STRING:
+			to_lower(term);
+			break;
+		case FieldType::EMPTY:
+			return Xapian::Query::MatchNothing;
+		default:
+			THROW(QueryDslError, "%s is only supported for term, text or string fields [%s]", word.c_str(), repr(parent).c_str());
+	}
+
+	return FuzzyTerm::getQuery(field_spc, term, max_edits < 0 ? FuzzyTerm::auto_edits(term) : max_edits, prefix_length, wqf);
+}
+
+
 Xapian::Query
 QueryDSL::process_range(const std::string& word, Xapian::Query::op, const std::string& parent, const MsgPack& obj, Xapian::termcount wqf, int q_flags, bool is_raw, bool is_in, bool is_wildcard)
 {
@@ -546,8 +612,8 @@ QueryDSL::get_acc_geo_query(const required_spc_t& field_spc, const std::string&
 		try {
 			auto nivel = stox(std::stoull, field_accuracy.substr(4));
 			GeoSpatial geo(obj);
-			const auto ranges = geo.getGeometry()->getRanges(default_spc.flags.partials, default_spc.error);
-			return GenerateTerms::geo(ranges, { nivel }, { field_spc.prefix }, wqf);
+			const auto ranges = XapiandManager::manager->cover_cache.get(*geo.getGeometry(), default_spc.flags.partials, default_spc.error);
+			return GenerateTerms::geo(*ranges, { nivel }, { field_spc.prefix }, wqf);
 		} catch (const InvalidArgument&) {
 			THROW(QueryDslError, "Invalid field name: %s", field_accuracy.c_str());
 		} catch (const OutOfRange&) {
@@ -672,26 +738,16 @@ QueryDSL::get_term_query(const required_spc_t& field_spc, std::string& serialise
 
 	switch (field_spc.get_type()) {
 		case FieldType::TEXT: {
-			Xapian::QueryParser parser;
-			if (field_spc.flags.bool_term) {
-				parser.add_boolean_prefix("_", field_spc.prefix + field_spc.get_ctype());
-			} else {
-				parser.add_prefix("_", field_spc.prefix + field_spc.get_ctype());
-			}
-			const auto& stopper = getStopper(field_spc.language);
-			parser.set_stopper(stopper.get());
-			parser.set_stemming_strategy(getQueryParserStemStrategy(field_spc.stem_strategy));
-			parser.set_stemmer(Xapian::Stem(field_spc.stem_language));
+			auto& parser = Analyser::text_parser(field_spc.prefix + field_spc.get_ctype(), field_spc.flags.bool_term, field_spc.language, field_spc.stem_language, field_spc.stem_strategy);
 			return parser.parse_query("_:" + serialised_term, q_flags);
 		}
 
 		case FieldType::STRING: {
-			Xapian::QueryParser parser;
-			if (field_spc.flags.bool_term) {
-				parser.add_boolean_prefix("_", field_spc.prefix + field_spc.get_ctype());
-			} else {
-				parser.add_prefix("_", field_spc.prefix + field_spc.get_ctype());
+			if (field_spc.flags.infix && TermWildcard::is_infix(serialised_term) && serialised_term.find(' ') == std::string::npos) {
+				to_lower(serialised_term);
+				return TermWildcard::getQuery(field_spc, serialised_term, wqf);
 			}
+			auto& parser = Analyser::string_parser(field_spc.prefix + field_spc.get_ctype(), field_spc.flags.bool_term);
 			return parser.parse_query("_:" + serialised_term, q_flags);
 		}
 
@@ -699,7 +755,9 @@ QueryDSL::get_term_query(const required_spc_t& field_spc, std::string& serialise
 			if (!field_spc.flags.bool_term) {
 				to_lower(serialised_term);
 			}
-			if (endswith(serialised_term, '*')) {
+			if (field_spc.flags.infix && TermWildcard::is_infix(serialised_term)) {
+				return TermWildcard::getQuery(field_spc, serialised_term, wqf);
+			} else if (endswith(serialised_term, '*')) {
 				serialised_term.pop_back();
 				return Xapian::Query(Xapian::Query::OP_WILDCARD, prefixed(serialised_term, field_spc.prefix, field_spc.get_ctype()), wqf);
 			} else if (is_wildcard) {
@@ -890,8 +948,17 @@ QueryDSL::get_query(const MsgPack& obj)
 		return Xapian::Query::MatchAll;
 	}
 
-	auto query = process(Xapian::Query::OP_AND, std::string(), obj, 1, Xapian::QueryParser::FLAG_DEFAULT | Xapian::QueryParser::FLAG_WILDCARD, false, false, false);
+	// Query shapes repeat, reuse the ones compiled with the same schema.
+	auto& query_cache = XapiandManager::manager->query_cache;
+	const auto schema_ptr = schema->get_const_schema();
+	Xapian::Query query;
+	if (query_cache.get(schema_ptr, obj, query)) {
+		return query;
+	}
+
+	query = process(Xapian::Query::OP_AND, std::string(), obj, 1, Xapian::QueryParser::FLAG_DEFAULT | Xapian::QueryParser::FLAG_WILDCARD, false, false, false);
 	L_QUERY(this, "query = " CYAN "%s" NO_COL "\n" DARK_GREY "%s" NO_COL, query.get_description().c_str(), repr(query.serialise()).c_str());
+	query_cache.set(schema_ptr, obj, query);
 	return query;
 }
 
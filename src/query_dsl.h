@@ -35,12 +35,15 @@
 #include "utils.h"
 
 
-constexpr const char QUERYDSL_FROM[]   = "_from";
-constexpr const char QUERYDSL_IN[]     = "_in";
-constexpr const char QUERYDSL_QUERY[]  = "_query";
-constexpr const char QUERYDSL_RANGE[]  = "_range";
-constexpr const char QUERYDSL_RAW[]    = "_raw";
-constexpr const char QUERYDSL_TO[]     = "_to";
+constexpr const char QUERYDSL_FROM[]          = "_from";
+constexpr const char QUERYDSL_FUZZY[]         = "_fuzzy";
+constexpr const char QUERYDSL_IN[]            = "_in";
+constexpr const char QUERYDSL_MAX_EDITS[]     = "_max_edits";
+constexpr const char QUERYDSL_PREFIX_LENGTH[] = "_prefix_length";
+constexpr const char QUERYDSL_QUERY[]         = "_query";
+constexpr const char QUERYDSL_RANGE[]         = "_range";
+constexpr const char QUERYDSL_RAW[]           = "_raw";
+constexpr const char QUERYDSL_TO[]            = "_to";
 
 
 /* A domain-specific language (DSL) for query */
@@ -63,6 +66,7 @@ class QueryDSL {
 	 * Dispatch functions.
 	 */
 
+	Xapian::Query process_fuzzy(const std::string& word, Xapian::Query::op op, const std::string& parent, const MsgPack& obj, Xapian::termcount wqf, int q_flags, bool is_raw, bool is_in, bool is_wildcard);
 	Xapian::Query process_in(const std::string& word, Xapian::Query::op op, const std::string& parent, const MsgPack& obj, Xapian::termcount wqf, int q_flags, bool is_raw, bool is_in, bool is_wildcard);
 	Xapian::Query process_range(const std::string& word, Xapian::Query::op op, const std::string& parent, const MsgPack& obj, Xapian::termcount wqf, int q_flags, bool is_raw, bool is_in, bool is_wildcard);
 	Xapian::Query process_raw(const std::string& word, Xapian::Query::op op, const std::string& parent, const MsgPack& obj, Xapian::termcount wqf, int q_flags, bool is_raw, bool is_in, bool is_wildcard);
@@ -24,7 +24,11 @@
 
 #ifdef XAPIAND_CLUSTERING
 
+#include <chrono>                // for system_clock, duration
+#include <unordered_map>         // for unordered_map
+
 #include "servers/discovery.h"
+#include "servers/udp_base.h"     // for UDP_MAX_MESSAGE_SIZE
 
 
 XapiandReplicator::XapiandReplicator(const std::shared_ptr<XapiandManager>& manager_, ev::loop_ref* ev_loop_, unsigned int ev_flags_)
@@ -75,11 +79,31 @@ XapiandReplicator::run()
 {
 	L_CALL(this, "XapiandReplicator::run()");
 
+	auto& updated_databases = XapiandManager::manager->database_pool.updated_databases;
+
 	// Function that retrieves a task from a queue, runs it and deletes it
 	Endpoint endpoint;
-	while (XapiandManager::manager->database_pool.updated_databases.pop(endpoint)) {
-		L_DEBUG(this, "Replicator was informed database was updated: %s", repr(endpoint.to_string()).c_str());
-		on_commit(endpoint);
+	while (updated_databases.pop(endpoint)) {
+		// Gather all databases updated during the batch window, a database
+		// committed several times in the meantime is notified only once
+		// (with its latest mastery level).
+		std::vector<Endpoint> endpoints;
+		std::unordered_map<std::string, size_t> positions;
+		auto batch_ends = std::chrono::system_clock::now() + std::chrono::duration<double>(REPLICATOR_BATCH_DELAY);
+		double timeout;
+		do {
+			L_DEBUG(this, "Replicator was informed database was updated: %s", repr(endpoint.to_string()).c_str());
+			auto it = positions.find(endpoint.path);
+			if (it == positions.end()) {
+				positions.emplace(endpoint.path, endpoints.size());
+				endpoints.push_back(endpoint);
+			} else {
+				endpoints[it->second] = endpoint;
+			}
+			timeout = std::chrono::duration<double>(batch_ends - std::chrono::system_clock::now()).count();
+		} while (timeout > 0 && updated_databases.pop(endpoint, timeout));
+
+		on_commit(endpoints);
 	}
 
 	detach();
@@ -91,14 +115,42 @@ XapiandReplicator::on_commit(const Endpoint &endpoint)
 {
 	L_CALL(this, "XapiandReplicator::on_commit(%s)", repr(endpoint.to_string()).c_str());
 
+	on_commit(std::vector<Endpoint>{ endpoint });
+}
+
+
+void
+XapiandReplicator::on_commit(const std::vector<Endpoint>& endpoints)
+{
+	L_CALL(this, "XapiandReplicator::on_commit(<%zu endpoints>)", endpoints.size());
+
 	if (auto discovery = XapiandManager::manager->weak_discovery.lock()) {
 		auto local_node_ = local_node.load();
-		discovery->send_message(
-			Discovery::Message::DB_UPDATED,
-			serialise_length(endpoint.mastery_level) +  // The mastery level of the database
-			serialise_string(endpoint.path) +  // The path of the index
-			local_node_->serialise()   // The node where the index is at
-		);
+		auto node = local_node_->serialise();
+
+		// Room left in a datagram after the header send_message() adds (type, version and cluster name)
+		auto max_size = UDP_MAX_MESSAGE_SIZE - 1 - sizeof(uint16_t) - serialise_string(XapiandManager::manager->cluster_name).size();
+
+		// The first database goes first followed by the node, just as with
+		// single updates; the rest are appended after the node, so older
+		// nodes still understand (the first update of) each message.
+		std::string message;
+		for (const auto& endpoint : endpoints) {
+			auto update = serialise_length(endpoint.mastery_level) +  // The mastery level of the database
+				serialise_string(endpoint.path);  // The path of the index
+			if (!message.empty() && message.size() + update.size() > max_size) {
+				discovery->send_message(Discovery::Message::DB_UPDATED, message);
+				message.clear();
+			}
+			if (message.empty()) {
+				message = update + node;  // The node where the indexes are at
+			} else {
+				message.append(update);
+			}
+		}
+		if (!message.empty()) {
+			discovery->send_message(Discovery::Message::DB_UPDATED, message);
+		}
 	}
 }
 
@@ -35,6 +35,9 @@
 #include "worker.h"
 
 
+#define REPLICATOR_BATCH_DELAY 0.3  // Seconds updates are gathered before notifying them (coalescing)
+
+
 class XapiandReplicator : public Task<>, public Worker {
 	friend Worker;
 
@@ -43,6 +46,7 @@ class XapiandReplicator : public Task<>, public Worker {
 	void run() override;
 
 	void on_commit(const Endpoint &endpoint);
+	void on_commit(const std::vector<Endpoint>& endpoints);
 
 	void destroyer();
 
@@ -231,7 +231,7 @@ Scheduler::run_one(TaskType& task)
 			L_SCHEDULER(this, "Scheduler::" CYAN "RUNNING" NO_COL " - now:%llu, wakeup_time:%llu", time_point_to_ullong(std::chrono::system_clock::now()), task->wakeup_time);
 			if (thread_pool) {
 				try {
-					thread_pool->enqueue(task);
+					thread_pool->post(task);
 				} catch (const std::logic_error&) { }
 			} else {
 				task->run();
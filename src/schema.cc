@@ -28,13 +28,13 @@
 #include <cstring>                         // for size_t, strlen
 #include <ctype.h>                         // for tolower
 #include <functional>                      // for ref, reference_wrapper
-#include <mutex>                           // for mutex
 #include <ostream>                         // for operator<<, basic_ostream
 #include <set>                             // for __tree_const_iterator, set
 #include <stdexcept>                       // for out_of_range
 #include <type_traits>                     // for remove_reference<>::type
 #include <unordered_set>                   // for unordered_set
 
+#include "analyser.h"                      // for Analyser
 #include "cast.h"                          // for Cast
 #include "datetime.h"                      // for isDate, tm_t
 #include "exception.h"                     // for ClientError
@@ -42,8 +42,10 @@
 #include "log.h"                           // for L_CALL
 #include "manager.h"                       // for XapiandManager, XapiandMan...
 #include "multivalue/generate_terms.h"     // for integer, geo, date, positive
+#include "multivalue/wildcard.h"           // for TermWildcard
 #include "serialise_list.h"                // for StringList
 #include "split.h"                         // for Split
+#include "suggester.h"                     // for Suggester
 
 
 #ifndef L_SCHEMA
@@ -417,6 +419,8 @@ const std::unordered_map<std::string, Schema::dispatch_process_reserved> Schema:
 	{ RESERVED_BOOL_TERM,          &Schema::process_bool_term       },
 	{ RESERVED_ACCURACY,           &Schema::process_accuracy        },
 	{ RESERVED_PARTIALS,           &Schema::process_partials        },
+	{ RESERVED_INFIX,              &Schema::process_infix           },
+	{ RESERVED_COMPLETION,         &Schema::process_completion      },
 	{ RESERVED_ERROR,              &Schema::process_error           },
 });
 
@@ -463,6 +467,8 @@ const std::unordered_map<std::string, Schema::dispatch_process_reserved> Schema:
 	{ RESERVED_BOOL_TERM,          &Schema::consistency_bool_term       },
 	{ RESERVED_ACCURACY,           &Schema::consistency_accuracy        },
 	{ RESERVED_PARTIALS,           &Schema::consistency_partials        },
+	{ RESERVED_INFIX,              &Schema::consistency_infix           },
+	{ RESERVED_COMPLETION,         &Schema::consistency_completion      },
 	{ RESERVED_ERROR,              &Schema::consistency_error           },
 	{ RESERVED_DYNAMIC,            &Schema::consistency_dynamic         },
 	{ RESERVED_STRICT,             &Schema::consistency_strict          },
@@ -509,6 +515,8 @@ const std::unordered_map<std::string, Schema::dispatch_update_reserved> Schema::
 	{ RESERVED_STEM_STRATEGY,   &Schema::update_stem_strategy    },
 	{ RESERVED_STEM_LANGUAGE,   &Schema::update_stem_language    },
 	{ RESERVED_PARTIALS,        &Schema::update_partials         },
+	{ RESERVED_INFIX,           &Schema::update_infix            },
+	{ RESERVED_COMPLETION,      &Schema::update_completion       },
 	{ RESERVED_ERROR,           &Schema::update_error            },
 	{ RESERVED_NAMESPACE,       &Schema::update_namespace        },
 	{ RESERVED_PARTIAL_PATHS,   &Schema::update_partial_paths    },
@@ -546,13 +554,14 @@ const std::unordered_map<std::string, std::pair<bool, std::string>> map_stem_lan
 });
 
 
-const std::unique_ptr<Xapian::SimpleStopper>& getStopper(const std::string& language) {
-	static std::mutex mtx;
-	static std::string path_stopwords(getenv("XAPIAN_PATH_STOPWORDS") ? getenv("XAPIAN_PATH_STOPWORDS") : PATH_STOPWORDS);
-	static std::unordered_map<std::string, std::unique_ptr<Xapian::SimpleStopper>> stoppers;
-	std::lock_guard<std::mutex> lk(mtx);
-	auto it = stoppers.find(language);
-	if (it == stoppers.end()) {
+static std::unordered_map<std::string, std::unique_ptr<Xapian::SimpleStopper>> load_stoppers() {
+	std::string path_stopwords(getenv("XAPIAN_PATH_STOPWORDS") ? getenv("XAPIAN_PATH_STOPWORDS") : PATH_STOPWORDS);
+	std::unordered_map<std::string, std::unique_ptr<Xapian::SimpleStopper>> stoppers;
+	for (const auto& stem_language : map_stem_language) {
+		const auto& language = stem_language.second.second;
+		if (stoppers.find(language) != stoppers.end()) {
+			continue;
+		}
 		auto path = path_stopwords + "/" + language + ".txt";
 		std::ifstream words;
 		words.open(path);
@@ -562,16 +571,28 @@ const std::unique_ptr<Xapian::SimpleStopper>& getStopper(const std::string& lang
 		} else {
 			L_WARNING(nullptr, "Cannot open stop words file: %s", path.c_str());
 		}
-		return stopper;
-	} else {
-		return it->second;
 	}
+	return stoppers;
+}
+
+
+const std::unique_ptr<Xapian::SimpleStopper>& getStopper(const std::string& language) {
+	// All stop words are loaded once, lookups afterwards need no locking.
+	static const auto stoppers = load_stoppers();
+	static const std::unique_ptr<Xapian::SimpleStopper> no_stopper;
+	auto it = stoppers.find(language);
+	if (it == stoppers.end()) {
+		return no_stopper;
+	}
+	return it->second;
 }
 
 
 required_spc_t::flags_t::flags_t()
 	: bool_term(DEFAULT_BOOL_TERM),
 	  partials(DEFAULT_GEO_PARTIALS),
+	  infix(DEFAULT_INFIX),
+	  completion(DEFAULT_COMPLETION),
 	  store(true),
 	  parent_store(true),
 	  is_recurse(true),
@@ -938,6 +959,8 @@ specification_t::to_string() const
 	str << "\t" << RESERVED_ERROR             << ": " << error                          << "\n";
 
 	str << "\t" << RESERVED_PARTIALS          << ": " << (flags.partials          ? "true" : "false") << "\n";
+	str << "\t" << RESERVED_INFIX             << ": " << (flags.infix             ? "true" : "false") << "\n";
+	str << "\t" << RESERVED_COMPLETION        << ": " << (flags.completion        ? "true" : "false") << "\n";
 	str << "\t" << RESERVED_STORE             << ": " << (flags.store             ? "true" : "false") << "\n";
 	str << "\t" << "parent_store"             << ": " << (flags.parent_store      ? "true" : "false") << "\n";
 	str << "\t" << RESERVED_RECURSE           << ": " << (flags.is_recurse        ? "true" : "false") << "\n";
@@ -1046,6 +1069,8 @@ Schema::restart_specification()
 
 	specification.flags.partials             = default_spc.flags.partials;
 	specification.error                      = default_spc.error;
+	specification.flags.infix                = default_spc.flags.infix;
+	specification.flags.completion           = default_spc.flags.completion;
 
 	specification.language                   = default_spc.language;
 	specification.stop_strategy              = default_spc.stop_strategy;
@@ -1611,6 +1636,10 @@ Schema::_validate_required_data(MsgPack& mut_properties)
 			if (specification.aux_lan.empty() && !specification.aux_stem_lan.empty()) {
 				specification.language = specification.aux_stem_lan;
 			}
+
+			if (specification.flags.completion) {
+				mut_properties[RESERVED_COMPLETION] = true;
+			}
 			break;
 		}
 		case FieldType::STRING: {
@@ -1622,6 +1651,14 @@ Schema::_validate_required_data(MsgPack& mut_properties)
 				}
 				specification.flags.has_index = true;
 			}
+
+			if (specification.flags.infix) {
+				mut_properties[RESERVED_INFIX] = true;
+			}
+
+			if (specification.flags.completion) {
+				mut_properties[RESERVED_COMPLETION] = true;
+			}
 			break;
 		}
 		case FieldType::TERM: {
@@ -1641,6 +1678,14 @@ Schema::_validate_required_data(MsgPack& mut_properties)
 				specification.flags.has_bool_term = true;
 			}
 			mut_properties[RESERVED_BOOL_TERM] = static_cast<bool>(specification.flags.bool_term);
+
+			if (specification.flags.infix) {
+				mut_properties[RESERVED_INFIX] = true;
+			}
+
+			if (specification.flags.completion) {
+				mut_properties[RESERVED_COMPLETION] = true;
+			}
 			break;
 		}
 		case FieldType::BOOLEAN:
@@ -2178,13 +2223,7 @@ Schema::index_term(Xapian::Document& doc, std::string serialise_val, const speci
 
 	switch (field_spc.sep_types[2]) {
 		case FieldType::TEXT: {
-			Xapian::TermGenerator term_generator;
-			term_generator.set_document(doc);
-			const auto& stopper = getStopper(field_spc.language);
-			term_generator.set_stopper(stopper.get());
-			term_generator.set_stopper_strategy(getGeneratorStopStrategy(field_spc.stop_strategy));
-			term_generator.set_stemmer(Xapian::Stem(field_spc.stem_language));
-			term_generator.set_stemming_strategy(getGeneratorStemStrategy(field_spc.stem_strategy));
+			auto& term_generator = Analyser::text_generator(field_spc.language, field_spc.stem_language, field_spc.stop_strategy, field_spc.stem_strategy);
 			// Xapian::WritableDatabase *wdb = nullptr;
 			// bool spelling = field_spc.spelling[getPos(pos, field_spc.spelling.size())];
 			// if (spelling) {
@@ -2193,24 +2232,33 @@ Schema::index_term(Xapian::Document& doc, std::string serialise_val, const speci
 			// 	term_generator.set_flags(Xapian::TermGenerator::FLAG_SPELLING);
 			// }
 			const bool positions = field_spc.positions[getPos(pos, field_spc.positions.size())];
-			if (positions) {
-				term_generator.index_text(serialise_val, field_spc.weight[getPos(pos, field_spc.weight.size())], field_spc.prefix + field_spc.get_ctype());
-			} else {
-				term_generator.index_text_without_positions(serialise_val, field_spc.weight[getPos(pos, field_spc.weight.size())], field_spc.prefix + field_spc.get_ctype());
+			Analyser::index_text(term_generator, doc, serialise_val, field_spc.weight[getPos(pos, field_spc.weight.size())], field_spc.prefix + field_spc.get_ctype(), positions);
+			if (field_spc.flags.completion) {
+				Suggester::index(doc, lower_string(serialise_val), field_spc);
 			}
 			L_INDEX(nullptr, "Field Text to Index [%d] => %s:%s [Positions: %s]", pos, field_spc.prefix.c_str(), serialise_val.c_str(), positions ? "true" : "false");
 			break;
 		}
 
 		case FieldType::STRING: {
-			Xapian::TermGenerator term_generator;
-			term_generator.set_document(doc);
+			auto& term_generator = Analyser::string_generator();
 			const auto position = field_spc.position[getPos(pos, field_spc.position.size())]; // String uses position (not positions) which is off by default
+			Analyser::index_text(term_generator, doc, serialise_val, field_spc.weight[getPos(pos, field_spc.weight.size())], field_spc.prefix + field_spc.get_ctype(), position);
+			if (field_spc.flags.infix) {
+				// Tokenize the same way to index each word for wildcards.
+				Xapian::Document words;
+				Analyser::index_text(term_generator, words, serialise_val, 1, "", false);
+				const auto it_e = words.termlist_end();
+				for (auto it = words.termlist_begin(); it != it_e; ++it) {
+					TermWildcard::index(doc, *it, field_spc);
+				}
+			}
+			if (field_spc.flags.completion) {
+				Suggester::index(doc, lower_string(serialise_val), field_spc);
+			}
 			if (position) {
-				term_generator.index_text(serialise_val, field_spc.weight[getPos(pos, field_spc.weight.size())], field_spc.prefix + field_spc.get_ctype());
 				L_INDEX(nullptr, "Field String to Index [%d] => %s:%s [Positions: %s]", pos, field_spc.prefix.c_str(), serialise_val.c_str(), position ? "true" : "false");
 			} else {
-				term_generator.index_text_without_positions(serialise_val, field_spc.weight[getPos(pos, field_spc.weight.size())], field_spc.prefix + field_spc.get_ctype());
 				L_INDEX(nullptr, "Field String to Index [%d] => %s:%s", pos, field_spc.prefix.c_str(), serialise_val.c_str());
 			}
 			break;
@@ -2220,6 +2268,12 @@ Schema::index_term(Xapian::Document& doc, std::string serialise_val, const speci
 			if (!field_spc.flags.bool_term) {
 				to_lower(serialise_val);
 			}
+			if (field_spc.flags.infix) {
+				TermWildcard::index(doc, serialise_val, field_spc);
+			}
+			if (field_spc.flags.completion) {
+				Suggester::index(doc, serialise_val, field_spc);
+			}
 
 		default: {
 			serialise_val = prefixed(serialise_val, field_spc.prefix, field_spc.get_ctype());
@@ -3521,6 +3575,24 @@ Schema::update_partials(const MsgPack& prop_partials)
 }
 
 
+void
+Schema::update_infix(const MsgPack& prop_infix)
+{
+	L_CALL(this, "Schema::update_infix(%s)", repr(prop_infix.to_string()).c_str());
+
+	specification.flags.infix = prop_infix.as_bool();
+}
+
+
+void
+Schema::update_completion(const MsgPack& prop_completion)
+{
+	L_CALL(this, "Schema::update_completion(%s)", repr(prop_completion.to_string()).c_str());
+
+	specification.flags.completion = prop_completion.as_bool();
+}
+
+
 void
 Schema::update_error(const MsgPack& prop_error)
 {
@@ -3998,6 +4070,34 @@ Schema::process_partials(const std::string& prop_name, const MsgPack& doc_partia
 }
 
 
+void
+Schema::process_infix(const std::string& prop_name, const MsgPack& doc_infix)
+{
+	// RESERVED_INFIX isn't heritable and can't change once fixed.
+	L_CALL(this, "Schema::process_infix(%s)", repr(doc_infix.to_string()).c_str());
+
+	try {
+		specification.flags.infix = doc_infix.as_bool();
+	} catch (const msgpack::type_error&) {
+		THROW(ClientError, "Data inconsistency, %s must be boolean", prop_name.c_str());
+	}
+}
+
+
+void
+Schema::process_completion(const std::string& prop_name, const MsgPack& doc_completion)
+{
+	// RESERVED_COMPLETION isn't heritable and can't change once fixed.
+	L_CALL(this, "Schema::process_completion(%s)", repr(doc_completion.to_string()).c_str());
+
+	try {
+		specification.flags.completion = doc_completion.as_bool();
+	} catch (const msgpack::type_error&) {
+		THROW(ClientError, "Data inconsistency, %s must be boolean", prop_name.c_str());
+	}
+}
+
+
 void
 Schema::process_error(const std::string& prop_name, const MsgPack& doc_error)
 {
@@ -4416,6 +4516,48 @@ Schema::consistency_partials(const std::string& prop_name, const MsgPack& doc_pa
 }
 
 
+void
+Schema::consistency_infix(const std::string& prop_name, const MsgPack& doc_infix)
+{
+	// RESERVED_INFIX isn't heritable and can't change once fixed.
+	L_CALL(this, "Schema::consistency_infix(%s)", repr(doc_infix.to_string()).c_str());
+
+	try {
+		if (specification.sep_types[2] == FieldType::TERM || specification.sep_types[2] == FieldType::STRING) {
+			const auto _infix = doc_infix.as_bool();
+			if (specification.flags.infix != _infix) {
+				THROW(ClientError, "It is not allowed to change %s [%s  ->  %s]", prop_name.c_str(), specification.flags.infix ? "true" : "false", _infix ? "true" : "false");
+			}
+		} else {
+			THROW(ClientError, "%s only is allowed in term or string type fields", prop_name.c_str());
+		}
+	} catch (const msgpack::type_error&) {
+		THROW(ClientError, "Data inconsistency, %s must be boolean", prop_name.c_str());
+	}
+}
+
+
+void
+Schema::consistency_completion(const std::string& prop_name, const MsgPack& doc_completion)
+{
+	// RESERVED_COMPLETION isn't heritable and can't change once fixed.
+	L_CALL(this, "Schema::consistency_completion(%s)", repr(doc_completion.to_string()).c_str());
+
+	try {
+		if (specification.sep_types[2] == FieldType::TERM || specification.sep_types[2] == FieldType::STRING || specification.sep_types[2] == FieldType::TEXT) {
+			const auto _completion = doc_completion.as_bool();
+			if (specification.flags.completion != _completion) {
+				THROW(ClientError, "It is not allowed to change %s [%s  ->  %s]", prop_name.c_str(), specification.flags.completion ? "true" : "false", _completion ? "true" : "false");
+			}
+		} else {
+			THROW(ClientError, "%s only is allowed in term, string or text type fields", prop_name.c_str());
+		}
+	} catch (const msgpack::type_error&) {
+		THROW(ClientError, "Data inconsistency, %s must be boolean", prop_name.c_str());
+	}
+}
+
+
 void
 Schema::consistency_error(const std::string& prop_name, const MsgPack& doc_error)
 {
@@ -5158,15 +5300,25 @@ Schema::get_data_field(const std::string& field_name, bool is_range) const
 						res.flags.partials = properties.at(RESERVED_PARTIALS).as_bool();
 						res.error = properties.at(RESERVED_ERROR).as_f64();
 						break;
-					case FieldType::TEXT:
+					case FieldType::TEXT: {
 						res.language = properties.at(RESERVED_LANGUAGE).as_string();
 						res.stop_strategy = (StopStrategy)properties.at(RESERVED_STOP_STRATEGY).as_u64();
 						res.stem_strategy = (StemStrategy)properties.at(RESERVED_STEM_STRATEGY).as_u64();
 						res.stem_language = properties.at(RESERVED_STEM_LANGUAGE).as_string();
+						const auto it_c = properties.find(RESERVED_COMPLETION);
+						res.flags.completion = it_c != properties.end() && it_c.value().as_bool();
 						break;
+					}
 					case FieldType::TERM:
 						res.flags.bool_term = properties.at(RESERVED_BOOL_TERM).as_bool();
+						// fallthrough
+					case FieldType::STRING: {
+						const auto it = properties.find(RESERVED_INFIX);
+						res.flags.infix = it != properties.end() && it.value().as_bool();
+						const auto it_c = properties.find(RESERVED_COMPLETION);
+						res.flags.completion = it_c != properties.end() && it_c.value().as_bool();
 						break;
+					}
 					default:
 						break;
 				}
@@ -5209,6 +5361,7 @@ Schema::get_slot_field(const std::string& field_name) const
 			const auto& properties = std::get<0>(info);
 
 			const auto& sep_types = properties.at(RESERVED_TYPE);
+			res.sep_types[1] = (FieldType)sep_types.at(1).as_u64();
 			res.sep_types[2] = (FieldType)sep_types.at(2).as_u64();
 
 			if (std::get<1>(info)) {
@@ -50,6 +50,8 @@
 #define DEFAULT_POSITIONS      true
 #define DEFAULT_SPELLING       false
 #define DEFAULT_BOOL_TERM      false
+#define DEFAULT_INFIX          false
+#define DEFAULT_COMPLETION     false
 #define DEFAULT_INDEX          TypeIndex::ALL
 
 
@@ -250,6 +252,8 @@ struct required_spc_t {
 	struct flags_t {
 		bool bool_term:1;
 		bool partials:1;
+		bool infix:1;                // Index reversed terms and n-grams for suffix and infix wildcards
+		bool completion:1;           // Index whole values as inputs for the completion suggester
 
 		bool store:1;
 		bool parent_store:1;
@@ -576,6 +580,8 @@ class Schema {
 	void update_u_detection(const MsgPack& prop_u_detection);
 	void update_bool_term(const MsgPack& prop_bool_term);
 	void update_partials(const MsgPack& prop_partials);
+	void update_infix(const MsgPack& prop_infix);
+	void update_completion(const MsgPack& prop_completion);
 	void update_error(const MsgPack& prop_error);
 	void update_namespace(const MsgPack& prop_namespace);
 	void update_partial_paths(const MsgPack& prop_partial_paths);
@@ -629,6 +635,8 @@ class Schema {
 	void process_partial_paths(const std::string& prop_name, const MsgPack& doc_partial_paths);
 	void process_bool_term(const std::string& prop_name, const MsgPack& doc_bool_term);
 	void process_partials(const std::string& prop_name, const MsgPack& doc_partials);
+	void process_infix(const std::string& prop_name, const MsgPack& doc_infix);
+	void process_completion(const std::string& prop_name, const MsgPack& doc_completion);
 	void process_error(const std::string& prop_name, const MsgPack& doc_error);
 	void process_value(const std::string& prop_name, const MsgPack& doc_value);
 	void process_cast_object(const std::string& prop_name, const MsgPack& doc_cast_object);
@@ -641,6 +649,8 @@ class Schema {
 	void consistency_bool_term(const std::string& prop_name, const MsgPack& doc_bool_term);
 	void consistency_accuracy(const std::string& prop_name, const MsgPack& doc_accuracy);
 	void consistency_partials(const std::string& prop_name, const MsgPack& doc_partials);
+	void consistency_infix(const std::string& prop_name, const MsgPack& doc_infix);
+	void consistency_completion(const std::string& prop_name, const MsgPack& doc_completion);
 	void consistency_error(const std::string& prop_name, const MsgPack& doc_error);
 	void consistency_dynamic(const std::string& prop_name, const MsgPack& doc_dynamic);
 	void consistency_strict(const std::string& prop_name, const MsgPack& doc_strict);
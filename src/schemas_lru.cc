@@ -27,7 +27,7 @@
 #include "schema.h"
 
 
-std::tuple<bool, atomic_shared_ptr<const MsgPack>*, std::string, std::string>
+std::tuple<bool, std::shared_ptr<atomic_shared_ptr<const MsgPack>>, std::string, std::string>
 SchemasLRU::get_local(DatabaseHandler* db_handler, const MsgPack* obj)
 {
 	L_CALL(this, "SchemasLRU::get_local(<db_handler>, <obj>)");
@@ -35,11 +35,7 @@ SchemasLRU::get_local(DatabaseHandler* db_handler, const MsgPack* obj)
 	bool created = false;
 	const auto local_schema_hash = db_handler->endpoints.hash();
 
-	atomic_shared_ptr<const MsgPack>* atom_local_schema;
-	{
-		std::lock_guard<std::mutex> lk(smtx);
-		atom_local_schema = &(*this)[local_schema_hash];
-	}
+	auto atom_local_schema = get_atom(local_schema_hash);
 	auto local_schema_ptr = atom_local_schema->load();
 
 	std::string schema_path_str, schema_id;
@@ -157,11 +153,7 @@ SchemasLRU::get(DatabaseHandler* db_handler, const MsgPack* obj)
 	} else {
 		const auto& schema_id = std::get<3>(info_local_schema);
 		const auto shared_schema_hash = std::hash<std::string>{}(schema_path + schema_id);
-		atomic_shared_ptr<const MsgPack>* atom_shared_schema;
-		{
-			std::lock_guard<std::mutex> lk(smtx);
-			atom_shared_schema = &(*this)[shared_schema_hash];
-		}
+		auto atom_shared_schema = get_atom(shared_schema_hash);
 		auto shared_schema_ptr = atom_shared_schema->load();
 		std::shared_ptr<const MsgPack> schema_ptr;
 		if (shared_schema_ptr) {
@@ -201,11 +193,7 @@ SchemasLRU::set(DatabaseHandler* db_handler, std::shared_ptr<const MsgPack>& old
 	} else {
 		const auto& schema_id = std::get<3>(info_local_schema);
 		const auto shared_schema_hash = std::hash<std::string>{}(schema_path + schema_id);
-		atomic_shared_ptr<const MsgPack>* atom_shared_schema;
-		{
-			std::lock_guard<std::mutex> lk(smtx);
-			atom_shared_schema = &(*this)[shared_schema_hash];
-		}
+		auto atom_shared_schema = get_atom(shared_schema_hash);
 		std::shared_ptr<const MsgPack> aux_schema;
 		if (atom_shared_schema->load()) {
 			aux_schema = old_schema;
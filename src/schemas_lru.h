@@ -22,26 +22,30 @@
 
 #pragma once
 
-#include <mutex>
+#include <memory>
 
 #include "atomic_shared_ptr.h"
+#include "concurrent_lru.h"
 #include "endpoint.h"
-#include "lru.h"
 #include "msgpack.h"
 
 
 class DatabaseHandler;
 
 
-class SchemasLRU : public lru::LRU<size_t, atomic_shared_ptr<const MsgPack>> {
+class SchemasLRU : public lru::ConcurrentLRU<size_t, std::shared_ptr<atomic_shared_ptr<const MsgPack>>> {
 	MsgPack get_shared(const Endpoint& endpoint, const std::string& id);
-	std::tuple<bool, atomic_shared_ptr<const MsgPack>*, std::string, std::string> get_local(DatabaseHandler* db_handler, const MsgPack* obj=nullptr);
+	std::tuple<bool, std::shared_ptr<atomic_shared_ptr<const MsgPack>>, std::string, std::string> get_local(DatabaseHandler* db_handler, const MsgPack* obj=nullptr);
 
-	std::mutex smtx;
+	std::shared_ptr<atomic_shared_ptr<const MsgPack>> get_atom(size_t hash) {
+		return ConcurrentLRU::get(hash, []() {
+			return std::make_shared<atomic_shared_ptr<const MsgPack>>();
+		});
+	}
 
 public:
 	SchemasLRU(ssize_t max_size=-1)
-		: LRU(max_size) { }
+		: ConcurrentLRU(max_size) { }
 
 	std::shared_ptr<const MsgPack> get(DatabaseHandler* db_handler, const MsgPack* obj);
 	bool set(DatabaseHandler* db_handler, std::shared_ptr<const MsgPack>& old_schema, const std::shared_ptr<const MsgPack>& new_schema);
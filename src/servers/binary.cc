@@ -24,6 +24,7 @@
 
 #ifdef XAPIAND_CLUSTERING
 
+#include "manager.h"          // for XapiandManager
 #include "remote_protocol.h"
 
 #include <netinet/tcp.h> /* for TCP_NODELAY */
@@ -118,8 +119,13 @@ Binary::signal_send_async()
 std::future<bool>
 Binary::trigger_replication(const Endpoint& src_endpoint, const Endpoint& dst_endpoint)
 {
-	auto future = tasks.enqueue([src_endpoint, dst_endpoint] (const std::shared_ptr<BinaryServer>& server) {
-		return server->trigger_replication(src_endpoint, dst_endpoint);
+	// If the task never runs, the guard clears the manager's in-flight entry
+	auto guard = std::make_shared<XapiandManager::ReplicationGuard>(dst_endpoint);
+	auto future = tasks.enqueue([src_endpoint, dst_endpoint, guard] (const std::shared_ptr<BinaryServer>& server) {
+		auto ret = server->trigger_replication(src_endpoint, dst_endpoint);
+		// From here on the replication client (or its failure path) owns the entry
+		guard->release();
+		return ret;
 	});
 
 	signal_send_async();
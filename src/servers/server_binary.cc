@@ -108,6 +108,7 @@ BinaryServer::trigger_replication(const Endpoint& src_endpoint, const Endpoint&
 {
 	int client_sock = binary->connection_socket();
 	if (client_sock < 0) {
+		XapiandManager::manager->replication_done(dst_endpoint);
 		return false;
 	}
 
@@ -344,41 +344,56 @@ DiscoveryServer::db_updated(const std::string& message)
 		return;
 	}
 
-	char inet_addr[INET_ADDRSTRLEN];
-
 	const char *p = message.data();
 	const char *p_end = p + message.size();
 
+	// The first update comes before the node, any other (coalesced)
+	// updates from the same node follow it.
+	std::vector<std::pair<long long, std::string>> updates;
 	long long remote_mastery_level = unserialise_length(&p, p_end);
-	std::string index_path = unserialise_string(&p, p_end);
+	updates.emplace_back(remote_mastery_level, unserialise_string(&p, p_end));
 
-	DatabaseHandler db_handler(Endpoint(index_path), DB_OPEN);
-	long long mastery_level = db_handler.get_mastery_level();
-	if (mastery_level == -1) {
-		return;
-	}
+	std::shared_ptr<const Node> remote_node = std::make_shared<Node>(Node::unserialise(&p, p_end));
 
-	if (mastery_level > remote_mastery_level) {
-		L_DISCOVERY(this, "Mastery of remote's %s wins! (local:%llx > remote:%llx) - Updating!", index_path.c_str(), mastery_level, remote_mastery_level);
+	while (p != p_end) {
+		remote_mastery_level = unserialise_length(&p, p_end);
+		updates.emplace_back(remote_mastery_level, unserialise_string(&p, p_end));
+	}
 
-		std::shared_ptr<const Node> remote_node = std::make_shared<Node>(Node::unserialise(&p, p_end));
+	bool joined = false;
+	for (const auto& update : updates) {
+		remote_mastery_level = update.first;
+		const auto& index_path = update.second;
 
-		if (XapiandManager::manager->put_node(remote_node)) {
-			L_INFO(this, "Node %s joined the party on ip:%s, tcp:%d (http), tcp:%d (xapian)! (4)", remote_node->name.c_str(), inet_ntop(AF_INET, &remote_node->addr.sin_addr, inet_addr, sizeof(inet_addr)), remote_node->http_port, remote_node->binary_port);
+		DatabaseHandler db_handler(Endpoint(index_path), DB_OPEN);
+		long long mastery_level = db_handler.get_mastery_level();
+		if (mastery_level == -1) {
+			continue;
 		}
 
-		Endpoint local_endpoint(index_path);
-		Endpoint remote_endpoint(index_path, remote_node.get());
+		if (mastery_level > remote_mastery_level) {
+			L_DISCOVERY(this, "Mastery of remote's %s wins! (local:%llx > remote:%llx) - Updating!", index_path.c_str(), mastery_level, remote_mastery_level);
+
+			if (!joined) {
+				joined = true;
+				if (XapiandManager::manager->put_node(remote_node)) {
+					char inet_addr[INET_ADDRSTRLEN];
+					L_INFO(this, "Node %s joined the party on ip:%s, tcp:%d (http), tcp:%d (xapian)! (4)", remote_node->name.c_str(), inet_ntop(AF_INET, &remote_node->addr.sin_addr, inet_addr, sizeof(inet_addr)), remote_node->http_port, remote_node->binary_port);
+				}
+			}
+
+			Endpoint local_endpoint(index_path);
+			Endpoint remote_endpoint(index_path, remote_node.get());
 #ifdef XAPIAND_CLUSTERING
-		// Replicate database from the other node
-		L_INFO(this, "Request syncing database from %s...", remote_node->name.c_str());
-		auto ret = XapiandManager::manager->trigger_replication(remote_endpoint, local_endpoint);
-		if (ret.get()) {
-			L_INFO(this, "Replication triggered!");
-		}
+			// Replicate database from the other node, the manager merges
+			// this with any replication of the database already going on,
+			// so there's no need to wait for it here.
+			L_INFO(this, "Request syncing database from %s...", remote_node->name.c_str());
+			XapiandManager::manager->trigger_replication(remote_endpoint, local_endpoint);
 #endif
-	} else if (mastery_level != remote_mastery_level) {
-		L_DISCOVERY(this, "Mastery of local's %s wins! (local:%llx <= remote:%llx) - Ignoring update!", index_path.c_str(), mastery_level, remote_mastery_level);
+		} else if (mastery_level != remote_mastery_level) {
+			L_DISCOVERY(this, "Mastery of local's %s wins! (local:%llx <= remote:%llx) - Ignoring update!", index_path.c_str(), mastery_level, remote_mastery_level);
+		}
 	}
 }
 
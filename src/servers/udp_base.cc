@@ -197,7 +197,7 @@ BaseUDP::send_message(char type, const std::string& content)
 char
 BaseUDP::get_message(std::string& result, char max_type)
 {
-	char buf[1024];
+	char buf[UDP_MAX_MESSAGE_SIZE];
 	struct sockaddr_in addr;
 	socklen_t addrlen = sizeof(addr);
 	ssize_t received = ::recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&addr, &addrlen);
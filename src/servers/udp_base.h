@@ -35,6 +35,9 @@
 class XapiandManager;
 
 
+#define UDP_MAX_MESSAGE_SIZE 1024  // Largest datagram get_message() can receive
+
+
 // Base class for UDP messages configuration
 class BaseUDP : public Worker {
 protected:
@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "suggester.h"
+
+#include <algorithm>          // for min
+#include <exception>          // for current_exception
+#include <iterator>           // for inserter
+#include <queue>              // for priority_queue
+
+#include "database.h"         // for Database
+#include "database_utils.h"   // for prefixed, DB_RETRIES, DB_SLOT_COMPLETION
+#include "length.h"           // for serialise_length
+#include "exception.h"        // for TimeOutError, Error
+#include "log.h"              // for L_CALL
+#include "manager.h"          // for XapiandManager
+#include "schema.h"           // for required_spc_t
+#include "serialise_list.h"   // for StringList
+#include "utils.h"            // for normalize_path, startswith
+
+
+Suggester::Suggester(const Xapian::Database& db, const std::string& prefix, uint32_t revision_)
+	: revision(revision_),
+	  base_revision(0)
+{
+	offsets.push_back(0);
+	const auto it_e = db.allterms_end(prefix);
+	for (auto it = db.allterms_begin(prefix); it != it_e; ++it) {
+		const auto& term = *it;
+		add(term.data() + prefix.size(), term.size() - prefix.size(), it.get_termfreq());
+	}
+	build();
+}
+
+
+Suggester::Suggester(const Suggester& previous, const Xapian::Database& db, const std::string& prefix, const std::set<std::string>& changed, uint32_t revision_)
+	: revision(revision_),
+	  base_revision(previous.revision)
+{
+	// Changed inputs of the field with their current weights, in order.
+	std::vector<std::pair<std::string, Xapian::doccount>> updates;
+	for (auto it = changed.lower_bound(prefix); it != changed.end() && startswith(*it, prefix); ++it) {
+		updates.emplace_back(it->substr(prefix.size()), db.get_termfreq(*it));
+	}
+
+	inputs.reserve(previous.inputs.size());
+	offsets.reserve(previous.offsets.size());
+	weights.reserve(previous.weights.size());
+	offsets.push_back(0);
+
+	// Merge both sorted lists, changed inputs take their new weight (or go away).
+	const uint32_t n = previous.weights.size();
+	uint32_t i = 0;
+	auto u = updates.begin();
+	const auto u_e = updates.end();
+	while (i < n || u != u_e) {
+		int cmp;
+		if (i == n) {
+			cmp = 1;
+		} else if (u == u_e) {
+			cmp = -1;
+		} else {
+			cmp = previous.inputs.compare(previous.offsets[i], previous.offsets[i + 1] - previous.offsets[i], u->first);
+		}
+		if (cmp < 0) {
+			add(previous.inputs.data() + previous.offsets[i], previous.offsets[i + 1] - previous.offsets[i], previous.weights[i]);
+			++i;
+		} else {
+			if (u->second) {
+				add(u->first.data(), u->first.size(), u->second);
+			}
+			if (cmp == 0) {
+				++i;
+			}
+			++u;
+		}
+	}
+	build();
+}
+
+
+void
+Suggester::add(const char* input, size_t size, Xapian::doccount weight)
+{
+	inputs.append(input, size);
+	offsets.push_back(inputs.size());
+	weights.push_back(weight);
+}
+
+
+void
+Suggester::build()
+{
+	const auto n = weights.size();
+	tree.resize(2 * n);
+	for (uint32_t i = 0; i < n; ++i) {
+		tree[n + i] = i;
+	}
+	for (auto i = n; i > 1; --i) {
+		tree[i - 1] = heavier(tree[2 * i - 2], tree[2 * i - 1]);
+	}
+}
+
+
+std::string
+Suggester::input(uint32_t i) const
+{
+	return inputs.substr(offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+
+uint32_t
+Suggester::heavier(uint32_t a, uint32_t b) const noexcept
+{
+	// On ties the alphabetically first input wins.
+	if (weights[a] > weights[b] || (weights[a] == weights[b] && a < b)) {
+		return a;
+	}
+	return b;
+}
+
+
+uint32_t
+Suggester::heaviest(uint32_t lo, uint32_t hi) const noexcept
+{
+	const uint32_t n = weights.size();
+	uint32_t best = lo;
+	for (lo += n, hi += n; lo < hi; lo >>= 1, hi >>= 1) {
+		if (lo & 1) {
+			best = heavier(best, tree[lo++]);
+		}
+		if (hi & 1) {
+			best = heavier(best, tree[--hi]);
+		}
+	}
+	return best;
+}
+
+
+std::pair<uint32_t, uint32_t>
+Suggester::range(const std::string& prefix) const
+{
+	const auto cmp = [&](uint32_t i) {
+		return inputs.compare(offsets[i], std::min<size_t>(offsets[i + 1] - offsets[i], prefix.size()), prefix);
+	};
+
+	// First input not less than prefix.
+	uint32_t lo = 0, hi = weights.size();
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (inputs.compare(offsets[mid], offsets[mid + 1] - offsets[mid], prefix) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	// First input after those starting with prefix.
+	const auto first = lo;
+	hi = weights.size();
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		if (cmp(mid) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return std::make_pair(first, lo);
+}
+
+
+std::vector<std::pair<std::string, Xapian::doccount>>
+Suggester::suggest(const std::string& prefix, size_t limit) const
+{
+	L_CALL(this, "Suggester::suggest(%s, %zu)", repr(prefix).c_str(), limit);
+
+	std::vector<std::pair<std::string, Xapian::doccount>> suggestions;
+
+	const auto r = range(prefix);
+	if (r.first == r.second || !limit) {
+		return suggestions;
+	}
+
+	// Best first over disjoint ranges, each keyed by its heaviest input.
+	struct Range {
+		uint32_t best;
+		uint32_t lo;
+		uint32_t hi;
+	};
+	const auto lighter = [this](const Range& a, const Range& b) {
+		return heavier(a.best, b.best) == b.best;
+	};
+	std::priority_queue<Range, std::vector<Range>, decltype(lighter)> heap(lighter);
+	heap.push({ heaviest(r.first, r.second), r.first, r.second });
+
+	limit = std::min<size_t>(limit, SUGGESTER_MAX_LIMIT);
+	while (!heap.empty() && suggestions.size() < limit) {
+		const auto top = heap.top();
+		heap.pop();
+		suggestions.emplace_back(input(top.best), weights[top.best]);
+		if (top.lo < top.best) {
+			heap.push({ heaviest(top.lo, top.best), top.lo, top.best });
+		}
+		if (top.best + 1 < top.hi) {
+			heap.push({ heaviest(top.best + 1, top.hi), top.best + 1, top.hi });
+		}
+	}
+
+	return suggestions;
+}
+
+
+// Key of the suggesters of database in the cache, along with its revision.
+// Returns an empty key if they can't be cached (revisions are unknown).
+static std::string
+cache_path(Database* database, uint32_t& revision)
+{
+	std::string path;
+#if HAVE_XAPIAN_DATABASE_GET_REVISION
+	if (database->endpoints.size() == 1) {
+		// Local indexes are kept by path, the same their commits are remembered by.
+		if (database->endpoints[0].is_local()) {
+			path = normalize_path(database->endpoints[0].path, true);
+		} else {
+			path = database->endpoints.to_string();
+		}
+		revision = database->get_revision();
+	} else {
+		// Shards together have no revision, they're kept by the revision of each.
+		try {
+			path = database->endpoints.to_string();
+			for (const auto& shard : database->shards) {
+				path.push_back('\0');
+				path.append(serialise_length(shard.get_revision()));
+			}
+			revision = 0;
+		} catch (const Xapian::InvalidOperationError&) {
+			path.clear();
+		}
+	}
+#else
+	(void)database;
+	(void)revision;
+#endif
+	return path;
+}
+
+
+std::shared_ptr<const Suggester>
+Suggester::get(Database* database, const std::string& field_prefix)
+{
+	L_CALL(database, "Suggester::get(%s, %s)", repr(database->to_string()).c_str(), repr(field_prefix).c_str());
+
+	const auto prefix = field_prefix + COMPLETION_CTYPE;
+	for (int t = DB_RETRIES; t >= 0; --t) {
+		try {
+			uint32_t revision;
+			const auto path = cache_path(database, revision);
+			if (path.empty()) {
+				return std::make_shared<const Suggester>(*database->db, prefix, 0);
+			}
+			return XapiandManager::manager->suggesters.get(path, *database->db, prefix, revision);
+		} catch (const Xapian::DatabaseModifiedError& exc) {
+			if (!t) THROW(TimeOutError, "Database was modified, try again (%s)", exc.get_msg().c_str());
+		} catch (const Xapian::Error& exc) {
+			THROW(Error, exc.get_msg().c_str());
+		}
+		database->reopen();
+	}
+
+	return nullptr;
+}
+
+
+void
+Suggester::index(Xapian::Document& doc, const std::string& value, const required_spc_t& field_spc)
+{
+	if (value.empty()) {
+		return;
+	}
+
+	auto len = std::min<size_t>(value.size(), SUGGESTER_MAX_INPUT_LENGTH);
+	if (len < value.size()) {
+		// Don't cut a UTF-8 character in half.
+		while (len && (static_cast<unsigned char>(value[len]) & 0xc0) == 0x80) {
+			--len;
+		}
+	}
+	auto term = prefixed(value.substr(0, len), field_spc.prefix, COMPLETION_CTYPE);
+
+	// The inputs of the document are also kept in a slot, so commits know
+	// which inputs they change when the document is replaced or deleted.
+	std::set<std::string> terms;
+	document_inputs(doc, terms);
+	if (terms.insert(term).second) {
+		doc.add_value(DB_SLOT_COMPLETION, StringList::serialise(terms.begin(), terms.end()));
+	}
+	doc.add_boolean_term(term);
+}
+
+
+void
+Suggester::document_inputs(const Xapian::Document& doc, std::set<std::string>& changed)
+{
+	StringList::unserialise(doc.get_value(DB_SLOT_COMPLETION), std::inserter(changed, changed.end()));
+}
+
+
+std::shared_ptr<const Suggester>
+SuggesterCache::get(const std::string& path, const Xapian::Database& db, const std::string& prefix, uint32_t revision)
+{
+	L_CALL(this, "SuggesterCache::get(%s, <db>, %s, %u)", repr(path).c_str(), repr(prefix).c_str(), revision);
+
+	auto key = path;
+	key.push_back('\0');
+	key.append(prefix);
+
+	std::shared_ptr<const Suggester> current;
+	if (find(key, current) && current && current->revision == revision) {
+		return current;
+	}
+
+	std::promise<std::shared_ptr<const Suggester>> promise;
+	{
+		std::unique_lock<std::mutex> lk(mtx);
+		auto it = building.find(key);
+		if (it != building.end()) {
+			if (current) {
+				// The stale one keeps answering while it's being built
+				return current;
+			}
+			auto future = it->second;
+			lk.unlock();
+			return future.get();
+		}
+		building.emplace(key, promise.get_future().share());
+	}
+
+	std::shared_ptr<const Suggester> suggester;
+	try {
+		std::set<std::string> changed;
+		if (current && changes(path, current->revision, revision, changed)) {
+			suggester = std::make_shared<const Suggester>(*current, db, prefix, changed, revision);
+			++_updates;
+		} else {
+			suggester = std::make_shared<const Suggester>(db, prefix, revision);
+			++_builds;
+		}
+		insert(key, suggester);
+	} catch (...) {
+		std::lock_guard<std::mutex> lk(mtx);
+		promise.set_exception(std::current_exception());
+		building.erase(key);
+		throw;
+	}
+
+	L_DEBUG(this, "Completion suggester for %s %s with %zu inputs (revision %u)", repr(prefix).c_str(), suggester->base_revision ? "updated" : "built", suggester->size(), suggester->revision);
+
+	std::lock_guard<std::mutex> lk(mtx);
+	promise.set_value(suggester);
+	building.erase(key);
+	return suggester;
+}
+
+
+bool
+SuggesterCache::changes(const std::string& path, uint32_t from, uint32_t to, std::set<std::string>& changed)
+{
+	std::lock_guard<std::mutex> lk(mtx);
+
+	auto it = deltas.find(path);
+	if (it == deltas.end()) {
+		return false;
+	}
+
+	// Deltas are in commit order, follow them from one revision to the next.
+	for (const auto& delta : it->second) {
+		if (from == to) {
+			break;
+		}
+		if (delta.from == from) {
+			changed.insert(delta.changed.begin(), delta.changed.end());
+			from = delta.to;
+		}
+	}
+	return from == to;
+}
+
+
+void
+SuggesterCache::commit(const std::string& path, uint32_t from, uint32_t to, std::set<std::string>&& changed)
+{
+	L_CALL(this, "SuggesterCache::commit(%s, %u, %u, <changed>)", repr(path).c_str(), from, to);
+
+	std::lock_guard<std::mutex> lk(mtx);
+
+	auto& path_deltas = deltas[path];
+	if (changed.size() > SUGGESTER_MAX_CHANGED) {
+		// Too many changes to remember, suggesters will be rebuilt
+		path_deltas.clear();
+		return;
+	}
+	path_deltas.push_back({ from, to, std::move(changed) });
+	if (path_deltas.size() > SUGGESTER_MAX_DELTAS) {
+		path_deltas.pop_front();
+	}
+}
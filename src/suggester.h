@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "xapiand.h"
+
+#include <atomic>             // for atomic_size_t
+#include <deque>              // for deque
+#include <future>             // for shared_future
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <set>                // for set
+#include <string>             // for string
+#include <unordered_map>      // for unordered_map
+#include <utility>            // for pair
+#include <vector>             // for vector
+#include <xapian.h>           // for Database, Document, doccount
+
+#include "concurrent_lru.h"   // for ConcurrentLRU
+
+
+class Database;
+struct required_spc_t;
+
+
+#define COMPLETION_CTYPE              'c'  /* Used instead of the field's ctype for completion inputs */
+#define SUGGESTER_MAX_INPUT_LENGTH    128  /* Longer inputs are truncated (at a character boundary) */
+#define SUGGESTER_MAX_LIMIT           100  /* Suggestions returned at most by a single request */
+#define SUGGESTER_CACHE_SIZE          (64 * 1024 * 1024)  /* Bytes of inputs kept by the suggesters cache */
+#define SUGGESTER_MAX_DELTAS          32   /* Commits remembered by index for updating suggesters */
+#define SUGGESTER_MAX_CHANGED         100000  /* Changed inputs above which a commit forces rebuilding */
+
+
+/*
+ * In-memory completion suggester for fields with RESERVED_COMPLETION.
+ *
+ * Those fields also index their whole (lowercased) values as inputs, under
+ * COMPLETION_CTYPE. The suggester keeps the inputs of a field sorted in a
+ * single buffer with their weight (the number of documents having them)
+ * and a segment tree over the weights, so the top-k completions of a prefix
+ * are found by a binary search and k range maximum lookups, without
+ * touching posting lists.
+ *
+ * Suggesters are built from the term dictionary, kept in the SuggesterCache
+ * and shared by every client. After a commit, a suggester is updated from
+ * the previous one with the weights of just the inputs that commit changed.
+ */
+class Suggester {
+	// Inputs, sorted and concatenated; input i is [offsets[i], offsets[i + 1]).
+	std::string inputs;
+	std::vector<uint32_t> offsets;
+	std::vector<Xapian::doccount> weights;
+
+	// Bottom-up segment tree, holds the heaviest input of each node's range.
+	std::vector<uint32_t> tree;
+
+	void add(const char* input, size_t size, Xapian::doccount weight);
+	void build();
+
+	std::string input(uint32_t i) const;
+
+	uint32_t heavier(uint32_t a, uint32_t b) const noexcept;
+	uint32_t heaviest(uint32_t lo, uint32_t hi) const noexcept;
+
+	// Range of inputs starting with prefix.
+	std::pair<uint32_t, uint32_t> range(const std::string& prefix) const;
+
+public:
+	const uint32_t revision;
+	const uint32_t base_revision;  // Revision of the suggester it was updated from (0 if built)
+
+	// Builds the suggester from the inputs under prefix in the term dictionary.
+	Suggester(const Xapian::Database& db, const std::string& prefix, uint32_t revision_);
+
+	// Updates previous with the current weights of the changed inputs.
+	Suggester(const Suggester& previous, const Xapian::Database& db, const std::string& prefix, const std::set<std::string>& changed, uint32_t revision_);
+
+	size_t size() const noexcept {
+		return weights.size();
+	}
+
+	size_t bytes() const noexcept {
+		return sizeof(Suggester) + inputs.capacity() + offsets.capacity() * sizeof(uint32_t) + weights.capacity() * sizeof(Xapian::doccount) + tree.capacity() * sizeof(uint32_t);
+	}
+
+	// Heaviest inputs starting with prefix, by weight (and then alphabetically).
+	std::vector<std::pair<std::string, Xapian::doccount>> suggest(const std::string& prefix, size_t limit) const;
+
+	// Gets the suggester of the field for the current revision of database.
+	static std::shared_ptr<const Suggester> get(Database* database, const std::string& field_prefix);
+
+	// Adds value as a completion input of the field to doc.
+	static void index(Xapian::Document& doc, const std::string& value, const required_spc_t& field_spc);
+
+	// Adds the completion inputs (terms) of doc to changed.
+	static void document_inputs(const Xapian::Document& doc, std::set<std::string>& changed);
+};
+
+
+struct SuggesterCacheWeight {
+	size_t operator()(const std::string& key, const std::shared_ptr<const Suggester>& suggester) const noexcept {
+		return key.size() + (suggester ? suggester->bytes() : 0);
+	}
+};
+
+
+/*
+ * Suggesters by index path and field, sized by bytes. Commits of local
+ * indexes are remembered (the completion inputs each one changed, from one
+ * revision to the next) so suggesters are updated instead of rebuilt. Only
+ * one suggester is built at a time for the same index and field; meanwhile
+ * the stale one keeps answering, or the build is waited for.
+ */
+class SuggesterCache : public lru::ConcurrentLRU<std::string, std::shared_ptr<const Suggester>, std::hash<std::string>, SuggesterCacheWeight> {
+	struct Delta {
+		uint32_t from;
+		uint32_t to;
+		std::set<std::string> changed;
+	};
+
+	std::mutex mtx;
+	std::unordered_map<std::string, std::deque<Delta>> deltas;
+	std::unordered_map<std::string, std::shared_future<std::shared_ptr<const Suggester>>> building;
+
+	std::atomic_size_t _builds;
+	std::atomic_size_t _updates;
+
+	// Inputs changed by the commits from revision from to revision to (false if any is unknown).
+	bool changes(const std::string& path, uint32_t from, uint32_t to, std::set<std::string>& changed);
+
+public:
+	SuggesterCache(ssize_t max_size=-1)
+		: ConcurrentLRU(max_size),
+		  _builds(0),
+		  _updates(0) { }
+
+	// Gets the suggester of the inputs under prefix for revision of the index in path.
+	std::shared_ptr<const Suggester> get(const std::string& path, const Xapian::Database& db, const std::string& prefix, uint32_t revision);
+
+	// Remembers the completion inputs changed by a commit of the index in path.
+	void commit(const std::string& path, uint32_t from, uint32_t to, std::set<std::string>&& changed);
+
+	size_t builds() const noexcept {
+		return _builds;
+	}
+
+	size_t updates() const noexcept {
+		return _updates;
+	}
+};
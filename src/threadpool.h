@@ -24,18 +24,28 @@
 
 #include "xapiand.h"
 
-#include <cassert>       // for assert
-#include <future>        // for future
-#include <stdexcept>     // for logic_error
-#include <string>        // for string
-#include <thread>        // for thread
-#include <tuple>         // for tuple_size, tuple_cat
-#include <vector>        // for vector
-
-#include "exception.h"   // for Exception
-#include "logger_fwd.h"  // for L_DEBUG, L_EXC, L_NOTHING
-#include "queue.h"       // for Queue
-#include "utils.h"       // for set_thread_name
+#include <atomic>              // for atomic_size_t, atomic_bool
+#include <cassert>             // for assert
+#include <condition_variable>  // for condition_variable
+#include <deque>               // for deque
+#include <future>              // for future
+#include <memory>              // for unique_ptr
+#include <mutex>               // for mutex, lock_guard, unique_lock
+#include <stdexcept>           // for logic_error
+#include <string>              // for string
+#include <thread>              // for thread
+#include <tuple>               // for tuple_size, tuple_cat
+#include <vector>              // for vector
+
+#include "exception.h"         // for Exception
+#include "lockfree_queue.h"    // for BoundedQueue, StealingDeque
+#include "logger_fwd.h"        // for L_DEBUG, L_EXC, L_NOTHING
+#include "queue.h"             // for Queue
+#include "utils.h"             // for set_thread_name
+
+
+#define THREADPOOL_QUEUE_SIZE    16384  /* Size of the thread pool's injection queue */
+#define THREADPOOL_DEQUE_SIZE    256    /* Size of each worker's work stealing deque */
 
 
 #ifndef L_THREADPOOL
@@ -208,8 +218,68 @@ public:
 };
 
 
+/*
+ *   Tasks wrapping any function (and its future, if any), so thread pool
+ *   tasks need only a single allocation.
+ */
+
+template<typename Fun, typename... Params>
+class FunctionTask : public Task<Params...> {
+	Fun fun;
+
+public:
+	FunctionTask(Fun&& fun_) : fun(std::move(fun_)) { }
+
+	void run(Params... params) override {
+		fun(std::move(params)...);
+	}
+};
+
+
+template<typename Fun, typename R, typename... Params>
+class FutureTask : public Task<Params...> {
+	Fun fun;
+	R r;
+
+public:
+	FutureTask(Fun&& fun_, R res) : fun(std::move(fun_)), r(std::move(res)) { }
+
+	void run(Params... params) override {
+		fun(std::move(params)...);
+		r.get();  // Raise any exception the task had
+	}
+};
+
+
+/*
+ *   Work stealing thread pool.
+ *
+ *   Tasks enqueued from outside the pool go to a bounded lock-free MPMC
+ *   injection queue, tasks enqueued from one of the pool's workers go to
+ *   the worker's own lock-free deque. When those are full tasks go to an
+ *   unbounded overflow queue, so enqueuing never fails or blocks. Idle
+ *   workers pop from their deque, then from the injection and overflow
+ *   queues, then steal from other workers and, if there's nothing to do,
+ *   sleep until a new task is enqueued.
+ */
+
 template<typename... Params>
-class ThreadPool : public TaskQueue<Params...> {
+class ThreadPool {
+	using task_ptr = Task<Params...>*;
+
+	struct Worker {
+		queue::StealingDeque<task_ptr> deque;
+
+		Worker() : deque(THREADPOOL_DEQUE_SIZE) { }
+	};
+
+	struct CurrentWorker {
+		const ThreadPool* pool;
+		size_t idx;
+	};
+
+	static thread_local CurrentWorker current_worker;
+
 	std::function<void(size_t)> worker;
 	std::atomic_size_t running_tasks;
 	std::atomic_bool full_pool;
@@ -217,20 +287,111 @@ class ThreadPool : public TaskQueue<Params...> {
 	std::vector<std::thread> threads;
 	std::mutex mtx;
 
-	// Function that retrieves a task from a fifo queue, runs it and deletes it
+	std::atomic_bool ending;
+	std::atomic_bool finished;
+
+	queue::BoundedQueue<task_ptr> injection;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic_size_t spawned;
+
+	std::mutex overflow_mtx;
+	std::deque<task_ptr> overflow;
+	std::atomic_size_t overflowed;
+
+	std::mutex park_mtx;
+	std::condition_variable park_cond;
+	std::atomic_size_t sleeping;
+	std::atomic_size_t wakeups;
+
+	bool _pop_overflow(task_ptr& task) {
+		if (!overflowed.load()) {
+			return false;
+		}
+		std::lock_guard<std::mutex> lk(overflow_mtx);
+		if (overflow.empty()) {
+			return false;
+		}
+		task = overflow.front();
+		overflow.pop_front();
+		--overflowed;
+		return true;
+	}
+
+	bool _steal(size_t idx, task_ptr& task) {
+		auto num_workers = spawned.load();
+		for (size_t i = 1; i <= num_workers; ++i) {
+			auto victim = (idx + i) % num_workers;
+			if (victim != idx && workers[victim]->deque.steal(task)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool _next(size_t idx, task_ptr& task) {
+		return workers[idx]->deque.pop(task) || injection.pop(task) || _pop_overflow(task) || _steal(idx, task);
+	}
+
+	// Workers count themselves as sleeping before checking wakeups, and
+	// producers count a wakeup before checking for sleeping workers, so
+	// either the worker sees the new task or the producer notifies it.
+	void _wakeup(bool all=false) {
+		++wakeups;
+		if (all || sleeping.load()) {
+			std::lock_guard<std::mutex> lk(park_mtx);
+			if (all) {
+				park_cond.notify_all();
+			} else {
+				park_cond.notify_one();
+			}
+		}
+	}
+
+	void _push(task_ptr task) {
+		if (finished || ending) {
+			delete task;
+			throw std::logic_error("Unable to enqueue task");
+		}
+		auto& current = current_worker;
+		if ((current.pool != this || !workers[current.idx]->deque.push(task)) && !injection.push(task)) {
+			// Both queues are full, the overflow queue grows as needed
+			std::lock_guard<std::mutex> lk(overflow_mtx);
+			overflow.push_back(task);
+			++overflowed;
+		}
+		_wakeup();
+		spawn_workers();
+	}
+
+	// Function that retrieves tasks from the queues, runs them and deletes them
 	template<typename... Params_>
 	void _worker(size_t idx, Params_&&... params) {
 		char name[100];
 		snprintf(name, sizeof(name), format.c_str(), idx);
 		set_thread_name(std::string(name));
-		std::unique_ptr<function_mo<void(Params...)>> task;
+
+		current_worker = CurrentWorker{ this, idx };
 
 		L_THREADPOOL(this, "Worker %s started! (size: %lu, capacity: %lu)", name, threadpool_size(), threadpool_capacity());
-		while (TaskQueue<Params...>::tasks.pop(task)) {
+		while (!finished) {
+			task_ptr ptr;
+			auto seen = wakeups.load();
+			if (!_next(idx, ptr)) {
+				if (ending) {
+					break;
+				}
+				std::unique_lock<std::mutex> lk(park_mtx);
+				++sleeping;
+				park_cond.wait(lk, [&]() {
+					return finished || ending || wakeups.load() != seen;
+				});
+				--sleeping;
+				continue;
+			}
+			std::unique_ptr<Task<Params...>> task(ptr);
 			++running_tasks;
 			try {
-				(*task)(std::forward<Params_>(params)...);
-				task->get();
+				task->run(std::forward<Params_>(params)...);
 			} catch (const BaseException& exc) {
 				auto exc_context = exc.get_context();
 				L_EXC(this, "Task died with an unhandled exception: %s", *exc_context ? exc_context : "Unkown Exception!");
@@ -246,17 +407,20 @@ class ThreadPool : public TaskQueue<Params...> {
 			}
 			--running_tasks;
 		}
+		current_worker = CurrentWorker{ nullptr, 0 };
 		L_THREADPOOL(this, "Worker %s ended.", name);
 	}
 
 	bool spawn_workers() {
 		if (full_pool) return false;
-		auto enqueued = TaskQueue<Params...>::size();
+		auto enqueued = size();
 		if (enqueued) {
 			std::lock_guard<std::mutex> lk(mtx);
 			auto threads_capacity = threads.capacity();
 			auto threads_size = threads.size();
 			while (enqueued-- > (threads_size - running_tasks) * 2 / 3 && threads_size < threads_capacity) {
+				// Worker's deque must be visible to thieves before the worker starts
+				++spawned;
 				threads.emplace_back(worker, threads.size());
 				threads_size = threads.size();
 			}
@@ -267,6 +431,22 @@ class ThreadPool : public TaskQueue<Params...> {
 		return false;
 	}
 
+	void _clear() {
+		task_ptr task;
+		while (injection.pop(task)) {
+			delete task;
+		}
+		while (_pop_overflow(task)) {
+			delete task;
+		}
+		auto num_workers = spawned.load();
+		for (size_t i = 0; i < num_workers; ++i) {
+			while (workers[i]->deque.steal(task)) {
+				delete task;
+			}
+		}
+	}
+
 public:
 	// Allocate a thread pool and set them to work trying to get tasks
 	template<typename... Params_>
@@ -280,20 +460,91 @@ public:
 		}, format, std::placeholders::_1, std::forward<Params_>(params)...)),*/
 		running_tasks(0),
 		full_pool(false),
-		format(format_) {
+		format(format_),
+		ending(false),
+		finished(false),
+		injection(THREADPOOL_QUEUE_SIZE),
+		spawned(0),
+		overflowed(0),
+		sleeping(0),
+		wakeups(0) {
 		threads.reserve(num_threads);
+		workers.reserve(num_threads);
+		for (size_t i = 0; i < num_threads; ++i) {
+			workers.push_back(std::make_unique<Worker>());
+		}
 	}
 
 	// Wait for the threads to finish
 	~ThreadPool() {
+		finish();
 		join();
+		_clear();
 	}
 
-	template<typename... Args>
-	auto enqueue(Args&&... args) {
-		auto ret = TaskQueue<Params...>::enqueue(std::forward<Args>(args)...);
-		spawn_workers();
-		return ret;
+	// Enqueues any function to be executed, returns a future for its result
+	template<typename F, typename... Args>
+	auto enqueue(F&& f, Args&&... args) -> std::shared_future<std::result_of_t<F(Params..., Args...)>> {
+		auto packed_task = std::packaged_task<std::result_of_t<F(Params..., Args...)>(Params...)>
+		(
+			[f = std::forward<F>(f), t = std::make_tuple(std::forward<Args>(args)...)] (Params... params) mutable {
+				return apply(std::move(f), std::tuple_cat(std::make_tuple(std::move(params)...), std::move(t)));
+			}
+		);
+		auto res = packed_task.get_future().share();
+		_push(new FutureTask<decltype(packed_task), decltype(res), Params...>(std::move(packed_task), res));
+		return res;
+	}
+
+	// Enqueues a Task object to be executed
+	auto enqueue(std::shared_ptr<Task<Params...>> nt) {
+		return enqueue([nt = std::move(nt)](Params... params) mutable {
+			nt->run(std::move(params)...);
+			nt.reset();
+		});
+	}
+
+	// Enqueues any function to be executed, fire and forget (no future is created)
+	template<typename F, typename... Args>
+	auto post(F&& f, Args&&... args) -> std::conditional_t<true, void, std::result_of_t<F(Params..., Args...)>> {
+		auto fun = [f = std::forward<F>(f), t = std::make_tuple(std::forward<Args>(args)...)] (Params... params) mutable {
+			apply(std::move(f), std::tuple_cat(std::make_tuple(std::move(params)...), std::move(t)));
+		};
+		_push(new FunctionTask<decltype(fun), Params...>(std::move(fun)));
+	}
+
+	// Enqueues a Task object to be executed, fire and forget (no future is created)
+	void post(std::shared_ptr<Task<Params...>> nt) {
+		post([nt = std::move(nt)](Params... params) mutable {
+			nt->run(std::move(params)...);
+			nt.reset();
+		});
+	}
+
+	void clear() {
+		_clear();
+	}
+
+	// Tell the tasks to finish so all threads exit as soon as possible
+	void finish() {
+		finished = true;
+		_wakeup(true);
+	}
+
+	// Flag the pool as ending, so all threads exit as soon as all queued tasks end
+	void end() {
+		ending = true;
+		_wakeup(true);
+	}
+
+	// Return size of the tasks queues
+	size_t size() {
+		auto enqueued = injection.size() + overflowed.load();
+		auto num_workers = spawned.load();
+		for (size_t i = 0; i < num_workers; ++i) {
+			enqueued += workers[i]->deque.size();
+		}
+		return enqueued;
 	}
 
 	// Wait for all threads
@@ -325,6 +576,10 @@ public:
 };
 
 
+template<typename... Params>
+thread_local typename ThreadPool<Params...>::CurrentWorker ThreadPool<Params...>::current_worker{ nullptr, 0 };
+
+
 #ifdef L_THREADPOOL_DEFINED
 #undef L_THREADPOOL_DEFINED
 #undef L_THREADPOOL
@@ -83,7 +83,12 @@ static std::random_device rd;  // Random device engine, usually based on /dev/ra
 static std::mt19937_64 rng(rd()); // Initialize Mersennes' twister using rd to generate the seed
 
 
+// Names are cached, getting them from the system is slow (and done for every log line)
+static thread_local std::string local_thread_name;
+
+
 void set_thread_name(const std::string& name) {
+	local_thread_name = name;
 #if defined(HAVE_PTHREAD_SETNAME_NP_1)
 	pthread_setname_np(name.c_str());
 #elif defined(HAVE_PTHREAD_SETNAME_NP_2)
@@ -97,6 +102,9 @@ void set_thread_name(const std::string& name) {
 
 
 std::string get_thread_name() {
+	if (!local_thread_name.empty()) {
+		return local_thread_name;
+	}
 	char name[100] = {0};
 #if defined(HAVE_PTHREAD_GETNAME_NP_3)
 	pthread_getname_np(pthread_self(), name, sizeof(name));
@@ -108,7 +116,8 @@ std::string get_thread_name() {
 	static std::hash<std::thread::id> thread_hasher;
 	snprintf(name, sizeof(name), "%zx", thread_hasher(std::this_thread::get_id()));
 #endif
-	return std::string(name);
+	local_thread_name = name;
+	return local_thread_name;
 }
 
 
@@ -508,6 +508,7 @@ void parseOptions(int argc, char** argv, opts_t &opts) {
 		SwitchArg solo("", "solo", "Run solo indexer. (no replication or discovery)", cmd, false);
 		SwitchArg strict_arg("", "strict", "Force the user to define the type for each field", cmd, false);
 		SwitchArg optimal_arg("", "optimal", "Force the configuration for indexing documents to optimal", cmd, false);
+		SwitchArg doc_values_arg("", "doc-values", "Keep memory mapped columns of the values for sorting, aggregations and ranges", cmd, false);
 
 		ValueArg<std::string> database("D", "database", "Path to the root of the node.", false, ".", "path", cmd);
 		ValueArg<std::string> cluster_name("", "cluster", "Cluster name to join.", false, XAPIAND_CLUSTER_NAME, "cluster", cmd);
@@ -535,6 +536,7 @@ void parseOptions(int argc, char** argv, opts_t &opts) {
 		ValueArg<size_t> dbpool_size("", "dbpool", "Maximum number of databases in database pool.", false, DBPOOL_SIZE, "size", cmd);
 		ValueArg<size_t> num_replicators("", "replicators", "Number of replicators.", false, NUM_REPLICATORS, "replicators", cmd);
 		ValueArg<size_t> num_committers("", "committers", "Number of committers.", false, NUM_COMMITTERS, "committers", cmd);
+		ValueArg<size_t> num_recoverers("", "recoverers", "Number of threads replaying write-ahead logs at startup.", false, NUM_RECOVERERS, "recoverers", cmd);
 		ValueArg<size_t> max_clients("", "maxclients", "Max number of clients.", false, CONFIG_DEFAULT_MAX_CLIENTS, "maxclients", cmd);
 
 		std::vector<std::string> args;
@@ -583,6 +585,7 @@ void parseOptions(int argc, char** argv, opts_t &opts) {
 		opts.solo = solo.getValue();
 		opts.strict = strict_arg.getValue();
 		opts.optimal = optimal_arg.getValue();
+		opts.doc_values = doc_values_arg.getValue();
 
 		opts.database = database.getValue();
 		opts.cluster_name = cluster_name.getValue();
@@ -601,6 +604,7 @@ void parseOptions(int argc, char** argv, opts_t &opts) {
 		opts.dbpool_size = dbpool_size.getValue();
 		opts.num_replicators = opts.solo ? 0 : num_replicators.getValue();
 		opts.num_committers = num_committers.getValue();
+		opts.num_recoverers = num_recoverers.getValue();
 		opts.max_clients = max_clients.getValue();
 		opts.threadpool_size = THEADPOOL_SIZE;
 		opts.endpoints_list_size = ENDPOINT_LIST_SIZE;
@@ -869,6 +873,10 @@ int main(int argc, char **argv) {
 		default_spc.flags.optimal = true;
 	}
 
+	if (opts.doc_values) {
+		L_INFO(nullptr, "Using doc values columns.");
+	}
+
 	// Flush threshold increased
 	int flush_threshold = 10000;  // Default is 10000 (if no set)
 	const char *p = getenv("XAPIAN_FLUSH_THRESHOLD");
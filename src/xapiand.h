@@ -41,8 +41,10 @@
 #define XAPIAND_LOG_FILE             "xapiand.log"
 
 #define DBPOOL_SIZE          1000    /* Maximum number of database endpoints in database pool */
+#define DBPOOL_SHARDS        16      /* Number of lock shards in database pool */
 #define NUM_REPLICATORS      10      /* Number of replicators */
 #define NUM_COMMITTERS       10      /* Number of threads handling the commits*/
+#define NUM_RECOVERERS       4       /* Number of threads replaying WALs at startup */
 #define THEADPOOL_SIZE       100     /* Threadpool's size */
 #define SERVERS_MULTIPLIER   4       /* Server workers multiplier (by number of CPUs) */
 #define ENDPOINT_LIST_SIZE   10      /* Endpoints List's size */
@@ -85,6 +85,11 @@ TEST(testIntersection, GeoIntersection) {
 }
 
 
+TEST(testCoverCache, GeoCoverCache) {
+	EXPECT_EQ(testCoverCache(), 0);
+}
+
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -33,6 +33,13 @@ TEST(LRUTest, Working) {
 }
 
 
+TEST(ConcurrentLRUTest, Working) {
+	EXPECT_EQ(test_concurrent_lru(), 0);
+	EXPECT_EQ(test_concurrent_lru_weight(), 0);
+	EXPECT_EQ(test_concurrent_lru_threads(), 0);
+}
+
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -41,6 +41,8 @@ TEST(MsgPackTest, Working) {
 	EXPECT_EQ(test_msgpack_change_keys(), 0);
 	EXPECT_EQ(test_msgpack_map(), 0);
 	EXPECT_EQ(test_msgpack_array(), 0);
+	EXPECT_EQ(test_msgpack_json_decoder(), 0);
+	EXPECT_EQ(test_msgpack_transcoder(), 0);
 }
 
 
@@ -35,6 +35,11 @@ TEST(QueryTest, Partials_search) {
 }
 
 
+TEST(QueryTest, Slot_projection) {
+	EXPECT_EQ(test_slot_projection(), 0);
+}
+
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -60,6 +60,11 @@ TEST(SortQueryTest, Geo) {
 }
 
 
+TEST(SortQueryTest, Cursor) {
+	EXPECT_EQ(sort_test_cursor(), 0);
+}
+
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -31,6 +31,10 @@ TEST(ThreadpoolTest, Working) {
 	EXPECT_EQ(test_pool_func(), 0);
 	EXPECT_EQ(test_pool_func_shared(), 0);
 	EXPECT_EQ(test_pool_func_unique(), 0);
+	EXPECT_EQ(test_pool_post(), 0);
+	EXPECT_EQ(test_pool_steal(), 0);
+	EXPECT_EQ(test_pool_overflow(), 0);
+	EXPECT_EQ(test_pool_wakeup(), 0);
 }
 
 
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_aggregation.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/geo/geospatial.h"
+#include "../src/geo/htm.h"
+#include "../src/multivalue/aggregation.h"
+#include "../src/multivalue/aggregation_bucket.h"
+#include "../src/multivalue/exception.h"
+#include "../src/schema.h"
+#include "utils.h"
+
+
+const std::string aggregation_db = ".db_aggregation.db";
+
+const std::string rapid_city = "POINT (43.992814500489914 -103.18359375)";
+const std::string rapid_city_near = "POINT (43.993 -103.184)";
+const std::string sydney = "POINT (-33.8688 151.2093)";
+const std::string north_dakota = "POLYGON ((48.574789910928864 -103.53515625, 48.864714761802794 -97.2509765625, 45.89000815866182 -96.6357421875, 45.89000815866182 -103.974609375, 48.574789910928864 -103.53515625))";
+
+
+static void aggregation_index(DB_Test& db, const std::vector<std::string>& locations) {
+	size_t id = 0;
+	for (const auto& location : locations) {
+		MsgPack obj = {
+			{ "location", location },
+		};
+		db.db_handler.index(std::to_string(++id), false, obj, true, JSON_CONTENT_TYPE);
+	}
+}
+
+
+// The geo grid buckets of all the documents.
+static MsgPack geo_grid(DB_Test& db, const MsgPack& geo_grid_conf) {
+	MsgPack aggs = {
+		{ AGGREGATION_AGGS, {
+			{ "grid", {{ AGGREGATION_GEO_GRID, geo_grid_conf }} },
+		}},
+	};
+	query_field_t query;
+	query.query.push_back("*");
+	query.offset = 0;
+	query.limit = 10;
+	query.check_at_least = 100;
+	query.spelling = false;
+	query.synonyms = false;
+	std::vector<std::string> suggestions;
+	AggregationMatchSpy spy(aggs, db.db_handler.get_schema());
+	db.db_handler.get_mset(query, nullptr, &spy, suggestions);
+	return spy.get_aggregation().at(AGGREGATION_AGGS).at("grid");
+}
+
+
+// Cells at level covered by a geometry, the way it's indexed.
+static std::vector<std::string> geo_grid_cells(const std::string& location, size_t level) {
+	GeoSpatial geo{MsgPack(location)};
+	const auto shift = 2 * (HTM_MAX_LEVEL - level);
+	std::vector<std::string> cells;
+	for (const auto& range : geo.getGeometry()->getRanges(DEFAULT_GEO_PARTIALS, DEFAULT_GEO_ERROR)) {
+		for (auto cell = range.start >> shift; cell <= range.end >> shift; ++cell) {
+			auto name = HTM::getTrixelName(cell);
+			if (cells.empty() || cells.back() != name) {
+				cells.push_back(std::move(name));
+			}
+		}
+	}
+	std::sort(cells.begin(), cells.end());
+	cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+	return cells;
+}
+
+
+// Checks every bucket holds the expected number of documents, and nothing else.
+static int geo_grid_check(const MsgPack& grid, const std::map<std::string, size_t>& expected) {
+	int cont = 0;
+	std::map<std::string, size_t> obtained;
+	for (const auto& cell : grid) {
+		const auto name = cell.as_string();
+		obtained[name] = grid.at(name).at(AGGREGATION_DOC_COUNT).as_u64();
+	}
+	for (const auto& cell : expected) {
+		const auto it = obtained.find(cell.first);
+		if (it == obtained.end()) {
+			L_ERR(nullptr, "ERROR: Cell %s is missing", cell.first.c_str());
+			++cont;
+		} else if (it->second != cell.second) {
+			L_ERR(nullptr, "ERROR: Cell %s has %zu documents instead of %zu", cell.first.c_str(), it->second, cell.second);
+			++cont;
+		}
+	}
+	for (const auto& cell : obtained) {
+		if (expected.find(cell.first) == expected.end()) {
+			L_ERR(nullptr, "ERROR: Cell %s should not be there", cell.first.c_str());
+			++cont;
+		}
+	}
+	return cont;
+}
+
+
+int test_geo_grid_level() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		DB_Test db(aggregation_db, std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+		aggregation_index(db, { rapid_city, rapid_city_near, sydney });
+
+		for (size_t level : { 0, 3, 8 }) {
+			const auto rapid_city_cells = geo_grid_cells(rapid_city, level);
+			const auto sydney_cells = geo_grid_cells(sydney, level);
+			if (rapid_city_cells.size() != 1 || sydney_cells.size() != 1 || geo_grid_cells(rapid_city_near, level) != rapid_city_cells) {
+				L_ERR(nullptr, "ERROR: Points close to each other should be in one cell at level %zu", level);
+				++cont;
+				continue;
+			}
+			if (rapid_city_cells.front().size() != level + 2) {
+				L_ERR(nullptr, "ERROR: Cell %s is not at level %zu", rapid_city_cells.front().c_str(), level);
+				++cont;
+			}
+			cont += geo_grid_check(geo_grid(db, {
+				{ AGGREGATION_FIELD, "location" },
+				{ AGGREGATION_LEVEL, level },
+			}), {
+				{ rapid_city_cells.front(), 2 },
+				{ sydney_cells.front(), 1 },
+			});
+		}
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test GeoGridAggregation cells at a level is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_geo_grid_overlapping() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		DB_Test db(aggregation_db, std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+		// Many ranges of the polygon end up in the same cells.
+		aggregation_index(db, { north_dakota });
+
+		for (size_t level : { 2, 5 }) {
+			std::map<std::string, size_t> expected;
+			for (const auto& cell : geo_grid_cells(north_dakota, level)) {
+				expected[cell] = 1;
+			}
+			cont += geo_grid_check(geo_grid(db, {
+				{ AGGREGATION_FIELD, "location" },
+				{ AGGREGATION_LEVEL, level },
+			}), expected);
+		}
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test GeoGridAggregation with overlapping ranges is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_geo_grid_bounds() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		DB_Test db(aggregation_db, std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+		aggregation_index(db, { rapid_city, rapid_city_near, sydney, north_dakota });
+
+		// North Dakota and Sydney are far from the bounds.
+		cont += geo_grid_check(geo_grid(db, {
+			{ AGGREGATION_FIELD, "location" },
+			{ AGGREGATION_LEVEL, 8 },
+			{ AGGREGATION_BOUNDS, "CIRCLE (43.992814500489914 -103.18359375, 10000)" },
+		}), {
+			{ geo_grid_cells(rapid_city, 8).front(), 2 },
+		});
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test GeoGridAggregation with bounds is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_geo_grid_errors() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		DB_Test db(aggregation_db, std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+		aggregation_index(db, { north_dakota });
+
+		// The polygon covers way too many cells at the deepest level.
+		try {
+			geo_grid(db, {
+				{ AGGREGATION_FIELD, "location" },
+				{ AGGREGATION_LEVEL, HTM_MAX_LEVEL },
+			});
+			L_ERR(nullptr, "ERROR: Aggregating more than %d cells per document should fail", AGGREGATION_GEO_GRID_MAX_CELLS);
+			++cont;
+		} catch (const AggregationError&) { }
+
+		for (const auto& level : { MsgPack(HTM_MAX_LEVEL + 1), MsgPack("eight") }) {
+			try {
+				geo_grid(db, {
+					{ AGGREGATION_FIELD, "location" },
+					{ AGGREGATION_LEVEL, level },
+				});
+				L_ERR(nullptr, "ERROR: Level %s should fail", level.to_string().c_str());
+				++cont;
+			} catch (const AggregationError&) { }
+		}
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test GeoGridAggregation errors is correct!");
+	}
+
+	RETURN(cont);
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_client_http.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "../src/io_utils.h"
+#include "../src/servers/http.h"
+#include "../src/servers/server.h"
+#include "../src/servers/server_http.h"
+#include "utils.h"
+
+
+const std::string client_http_db = ".db_client_http.db";
+
+const std::string pipeline_request = "OPTIONS / HTTP/1.1\r\nHost: " TEST_LOCAL_HOST "\r\n\r\n";
+constexpr size_t pipeline_requests = 8;
+
+
+/*
+ * Sends the requests back to back (pipelined) in one go to an HTTP server
+ * running in its own loop, closing the client's half of the connection
+ * right after them if half_close. Returns everything received.
+ */
+static std::string pipeline(size_t requests, bool half_close) {
+	DB_Test db(client_http_db, std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+
+	ev::dynamic_loop server_loop(TEST_EV_FLAG);
+	auto http = Worker::make_shared<Http>(XapiandManager::manager, nullptr, TEST_EV_FLAG, XAPIAND_HTTP_SERVERPORT);
+	auto server = Worker::make_shared<XapiandServer>(XapiandManager::manager, &server_loop, TEST_EV_FLAG);
+	Worker::make_shared<HttpServer>(server, &server_loop, TEST_EV_FLAG, http);
+	std::thread server_thread([server]() {
+		server->run();
+	});
+
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	::getsockname(http->get_socket(), (struct sockaddr *)&addr, &addrlen);
+	addr.sin_addr.s_addr = inet_addr(TEST_LOCAL_HOST);
+
+	std::string received;
+	int sock = ::socket(PF_INET, SOCK_STREAM, 0);
+	if (::connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		std::string buffer;
+		for (size_t i = 0; i < requests; ++i) {
+			buffer.append(pipeline_request);
+		}
+		io::write(sock, buffer.data(), buffer.size());
+		if (half_close) {
+			::shutdown(sock, SHUT_WR);
+		}
+
+		// Read until the server closes the connection, or nothing comes in a while
+		struct timeval timeout = { 5, 0 };
+		::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		char buf[4096];
+		ssize_t r;
+		while ((r = io::read(sock, buf, sizeof(buf))) > 0) {
+			received.append(buf, r);
+			if (!half_close && received.size() >= requests * 12) {
+				size_t responses = 0;
+				for (auto pos = received.find("HTTP/1.1 "); pos != std::string::npos; pos = received.find("HTTP/1.1 ", pos + 1)) {
+					++responses;
+				}
+				if (responses == requests) {
+					break;
+				}
+			}
+		}
+	} else {
+		L_ERR(nullptr, "ERROR: Can not connect to the HTTP server: %s", strerror(errno));
+	}
+	io::close(sock);
+
+	server->break_loop();
+	server_thread.join();
+	http->detach();
+
+	return received;
+}
+
+
+static int pipeline_check(size_t requests, bool half_close) {
+	int cont = 0;
+	const auto received = pipeline(requests, half_close);
+	size_t responses = 0;
+	for (auto pos = received.find("HTTP/1.1 200"); pos != std::string::npos; pos = received.find("HTTP/1.1 200", pos + 1)) {
+		++responses;
+	}
+	if (responses != requests) {
+		L_ERR(nullptr, "ERROR: %zu pipelined requests got %zu responses", requests, responses);
+		++cont;
+	}
+	return cont;
+}
+
+
+int test_pipeline() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		cont += pipeline_check(1, false);
+		cont += pipeline_check(pipeline_requests, false);
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test pipelined requests is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_pipeline_half_close() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		// The peer closes its half while the first requests are still
+		// being processed, every response must be written anyway.
+		cont += pipeline_check(1, true);
+		cont += pipeline_check(pipeline_requests, true);
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test pipelined requests with a half-closed connection is correct!");
+	}
+
+	RETURN(cont);
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_data_dictionary.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/data_dictionary.h"
+#include "../src/database_utils.h"
+#include "../src/length.h"
+#include "../src/msgpack.h"
+#include "utils.h"
+
+
+const std::string data_dictionary_db = ".db_data_dictionary.db";
+
+
+static std::string data_dictionary_obj(unsigned n) {
+	MsgPack obj = {
+		{ "name", "User " + std::to_string(n) },
+		{ "email", "user" + std::to_string(n) + "@example.com" },
+		{ "address", {
+			{ "city", n % 2 ? "Guadalajara" : "Monterrey" },
+			{ "country", "Mexico" },
+		}},
+		{ "tags", { "customer", n % 3 ? "active" : "inactive", "newsletter" } },
+		{ "balance", n * 10 },
+	};
+	return obj.serialise();
+}
+
+
+static std::vector<std::string> data_dictionary_samples(unsigned first, unsigned last) {
+	std::vector<std::string> samples;
+	for (unsigned n = first; n <= last; ++n) {
+		samples.push_back(data_dictionary_obj(n));
+	}
+	return samples;
+}
+
+
+// Compressed objects and their uncompressed versions must match.
+static int data_dictionary_round_trips(const DataDictionary& data_dictionary, unsigned first, unsigned last) {
+	int cont = 0;
+	for (unsigned n = first; n <= last; ++n) {
+		const auto obj = data_dictionary_obj(n);
+		auto compressed = data_dictionary.compress(obj);
+		if (compressed.empty() || compressed.size() >= obj.size()) {
+			L_ERR(nullptr, "ERROR: Object %u was not compressed by the dictionary (%zu of %zu bytes)", n, compressed.size(), obj.size());
+			++cont;
+			continue;
+		}
+		if (!DataDictionary::is_compressed(compressed)) {
+			L_ERR(nullptr, "ERROR: Compressed object %u is not recognised", n);
+			++cont;
+		}
+		const auto uncompressed = DataDictionary::uncompress(std::move(compressed));
+		if (uncompressed != obj) {
+			L_ERR(nullptr, "ERROR: Object %u changed in the round trip", n);
+			++cont;
+		}
+	}
+	return cont;
+}
+
+
+int test_data_dictionary_train() {
+	INIT_LOG
+	int cont = 0;
+
+	try {
+		const auto samples = data_dictionary_samples(1, 1000);
+		auto dictionary = DataDictionary::train(samples);
+		if (dictionary.empty() || dictionary.size() > DATA_DICTIONARY_SIZE) {
+			L_ERR(nullptr, "ERROR: Trained dictionary has %zu bytes", dictionary.size());
+			RETURN(1);
+		}
+
+		// The same dictionary is registered only once.
+		const auto data_dictionary = DataDictionary::add(std::string(dictionary));
+		if (DataDictionary::add(std::move(dictionary)) != data_dictionary || DataDictionary::get(data_dictionary->id) != data_dictionary) {
+			L_ERR(nullptr, "ERROR: Data dictionary was registered twice");
+			++cont;
+		}
+
+		// Objects in and out of the samples.
+		cont += data_dictionary_round_trips(*data_dictionary, 1, 100);
+		cont += data_dictionary_round_trips(*data_dictionary, 5000, 5100);
+
+		// Too small a sample trains nothing.
+		if (!DataDictionary::train(std::vector<std::string>{ "x" }).empty()) {
+			L_ERR(nullptr, "ERROR: A dictionary was trained without common substrings");
+			++cont;
+		}
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test DataDictionary training and round trips is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_data_dictionary_missing() {
+	INIT_LOG
+	int cont = 0;
+
+	const auto obj = data_dictionary_obj(1);
+
+	// A dictionary which is never registered, like one of another index.
+	DataDictionary unregistered(DataDictionary::train(data_dictionary_samples(2000, 2500)) + "unregistered");
+	auto compressed = unregistered.compress(obj);
+	if (compressed.empty()) {
+		L_ERR(nullptr, "ERROR: Object was not compressed by the dictionary");
+		RETURN(1);
+	}
+	try {
+		DataDictionary::uncompress(std::string(compressed));
+		L_ERR(nullptr, "ERROR: Object was uncompressed with an unknown dictionary");
+		++cont;
+	} catch (const SerialisationError&) {
+		L_ERR(nullptr, "ERROR: Unknown dictionary reported as a corrupt object");
+		++cont;
+	} catch (const Error&) { }
+
+	// Once registered, the wrong checksum of a changed object is noticed.
+	const auto data_dictionary = DataDictionary::add(DataDictionary::train(data_dictionary_samples(2000, 2500)) + "unregistered");
+	if (data_dictionary->id != unregistered.id) {
+		L_ERR(nullptr, "ERROR: Same dictionary got a different id");
+		RETURN(cont + 1);
+	}
+	if (DataDictionary::uncompress(std::string(compressed)) != obj) {
+		L_ERR(nullptr, "ERROR: Object changed in the round trip");
+		++cont;
+	}
+
+	const char* p = compressed.data() + 1;
+	const char* p_end = compressed.data() + compressed.size();
+	const auto id = unserialise_length(&p, p_end);
+	const auto size = unserialise_length(&p, p_end);
+	const auto checksum = unserialise_length(&p, p_end);
+	std::string corrupt(1, DATA_COMPRESSED_MAGIC);
+	corrupt.append(serialise_length(id));
+	corrupt.append(serialise_length(size));
+	corrupt.append(serialise_length(checksum ^ 1));
+	corrupt.append(p, p_end);
+	try {
+		DataDictionary::uncompress(std::move(corrupt));
+		L_ERR(nullptr, "ERROR: Object with a wrong checksum was uncompressed");
+		++cont;
+	} catch (const SerialisationError&) { }
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test DataDictionary with missing dictionaries and corrupt objects is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_data_dictionary_old_documents() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(data_dictionary_db);
+
+	try {
+		Xapian::WritableDatabase wdb(data_dictionary_db, Xapian::DB_CREATE_OR_OVERWRITE);
+
+		// Documents written before there was a dictionary are not compressed.
+		for (unsigned n = 1; n <= DATA_DICTIONARY_MIN_DOCUMENTS; ++n) {
+			Xapian::Document doc;
+			doc.set_data(join_data(false, "", data_dictionary_obj(n), ""));
+			wdb.add_document(doc);
+		}
+		if (DataDictionary::commit(wdb, data_dictionary_db)) {
+			L_ERR(nullptr, "ERROR: Data dictionary was trained before the documents were committed");
+			++cont;
+		}
+		wdb.commit();
+
+		// Training happens in the background, its result is stored by a later commit.
+		std::shared_ptr<const DataDictionary> data_dictionary;
+		for (int t = 0; t < 100 && !data_dictionary; ++t) {
+			data_dictionary = DataDictionary::commit(wdb, data_dictionary_db);
+			if (!data_dictionary) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+		}
+		if (!data_dictionary) {
+			L_ERR(nullptr, "ERROR: Data dictionary was never trained");
+			RETURN(cont + 1);
+		}
+
+		// New documents are compressed with it.
+		for (unsigned n = DATA_DICTIONARY_MIN_DOCUMENTS + 1; n <= 2 * DATA_DICTIONARY_MIN_DOCUMENTS; ++n) {
+			auto compressed = data_dictionary->compress(data_dictionary_obj(n));
+			if (compressed.empty()) {
+				L_ERR(nullptr, "ERROR: Object %u was not compressed by the dictionary", n);
+				++cont;
+				compressed = data_dictionary_obj(n);
+			}
+			Xapian::Document doc;
+			doc.set_data(join_data(false, "", compressed, ""));
+			wdb.add_document(doc);
+		}
+		wdb.commit();
+
+		Xapian::Database db(data_dictionary_db);
+		const auto loaded = DataDictionary::load(db);
+		if (!loaded || loaded->id != data_dictionary->id) {
+			L_ERR(nullptr, "ERROR: Stored data dictionary was not loaded");
+			++cont;
+		}
+		if (DataDictionary::due(db)) {
+			L_ERR(nullptr, "ERROR: A new data dictionary is due right after training one");
+			++cont;
+		}
+
+		// Both old and new documents read back the same objects.
+		for (unsigned n = 1; n <= 2 * DATA_DICTIONARY_MIN_DOCUMENTS; ++n) {
+			auto obj = split_data_obj(db.get_document(n).get_data());
+			if (DataDictionary::is_compressed(obj) != (n > DATA_DICTIONARY_MIN_DOCUMENTS)) {
+				L_ERR(nullptr, "ERROR: Document %u should%s be compressed", n, n > DATA_DICTIONARY_MIN_DOCUMENTS ? "" : " not");
+				++cont;
+			}
+			if (DataDictionary::uncompress(std::move(obj)) != data_dictionary_obj(n)) {
+				L_ERR(nullptr, "ERROR: Document %u changed when read", n);
+				++cont;
+			}
+		}
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	} catch (const BaseException& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_context());
+		++cont;
+	}
+
+	delete_files(data_dictionary_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test DataDictionary with documents written before training is correct!");
+	}
+
+	RETURN(cont);
+}
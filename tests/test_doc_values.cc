@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_doc_values.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/multivalue/doc_values.h"
+#include "utils.h"
+
+
+constexpr Xapian::valueno DOC_VALUES_SLOT = 10;
+const std::string doc_values_db = ".db_doc_values.db";
+const std::string doc_values_path = doc_values_db + "/";
+
+// Documents spread over the first, second and fourth segments (the third has none).
+const std::vector<std::pair<Xapian::docid, Xapian::docid>> doc_values_docids = {
+	{ 1, 500 },
+	{ DOC_VALUES_SEGMENT_SIZE + 4464, DOC_VALUES_SEGMENT_SIZE + 4564 },
+	{ 3 * DOC_VALUES_SEGMENT_SIZE + 3392, 3 * DOC_VALUES_SEGMENT_SIZE + 3392 },
+};
+
+
+static std::string doc_values_value(Xapian::docid did, unsigned version) {
+	char buf[32];
+	if (did % 97 == 0) {
+		// Doesn't fit in a cell
+		snprintf(buf, sizeof(buf), "overflowing-%08u-%u", did, version);
+	} else {
+		snprintf(buf, sizeof(buf), "%08u-%u", did, version);
+	}
+	return buf;
+}
+
+
+static Xapian::Document doc_values_doc(Xapian::docid did, unsigned version, bool overflows) {
+	Xapian::Document doc;
+	doc.add_term("Q" + std::to_string(did));
+	// Some documents have no value in the slot.
+	if (did % 7 != 0 && (overflows || did % 97 != 0)) {
+		doc.add_value(DOC_VALUES_SLOT, doc_values_value(did, version));
+	}
+	return doc;
+}
+
+
+static void doc_values_create(bool overflows) {
+	delete_files(doc_values_db);
+	Xapian::WritableDatabase wdb(doc_values_db, Xapian::DB_CREATE_OR_OVERWRITE);
+	for (const auto& range : doc_values_docids) {
+		for (auto did = range.first; did <= range.second; ++did) {
+			wdb.replace_document(did, doc_values_doc(did, 0, overflows));
+		}
+	}
+	wdb.commit();
+}
+
+
+// Checks the column of the database agrees with its value stream.
+static int doc_values_check(const Xapian::Database& db) {
+	int cont = 0;
+	DocValuesColumn column(doc_values_path + DOC_VALUES_PATH + std::to_string(DOC_VALUES_SLOT));
+	if (!column.valid()) {
+		L_ERR(nullptr, "ERROR: Doc values column is not valid");
+		return 1;
+	}
+	if (column.revision() != db.get_revision()) {
+		L_ERR(nullptr, "ERROR: Doc values column is at revision %u instead of %u", column.revision(), db.get_revision());
+		++cont;
+	}
+	if (column.last_docid() != db.get_lastdocid()) {
+		L_ERR(nullptr, "ERROR: Doc values column ends at %u instead of %u", column.last_docid(), db.get_lastdocid());
+		++cont;
+	}
+
+	std::map<Xapian::docid, std::string> expected;
+	uint32_t overflows = 0;
+	const auto it_e = db.valuestream_end(DOC_VALUES_SLOT);
+	for (auto it = db.valuestream_begin(DOC_VALUES_SLOT); it != it_e; ++it) {
+		expected[it.get_docid()] = *it;
+		if ((*it).size() >= DOC_VALUES_CELL_SIZE) {
+			++overflows;
+		}
+	}
+	if (column.overflows() != overflows) {
+		L_ERR(nullptr, "ERROR: Doc values column has %u overflows instead of %u", column.overflows(), overflows);
+		++cont;
+	}
+
+	std::string value;
+	if (column.get(0, value)) {
+		L_ERR(nullptr, "ERROR: Doc values column has a value for docid 0");
+		++cont;
+	}
+	for (Xapian::docid did = 1; did <= db.get_lastdocid() + 10; ++did) {
+		const auto it = expected.find(did);
+		const auto expected_value = it == expected.end() ? std::string() : it->second;
+		if (!column.get(did, value)) {
+			if (expected_value.size() < DOC_VALUES_CELL_SIZE) {
+				L_ERR(nullptr, "ERROR: Doc values column has no value for docid %u", did);
+				++cont;
+			}
+		} else if (value != expected_value) {
+			L_ERR(nullptr, "ERROR: Doc values column has %s for docid %u instead of %s", repr(value).c_str(), did, repr(expected_value).c_str());
+			++cont;
+		}
+	}
+	return cont;
+}
+
+
+int test_doc_values_get() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		doc_values_create(true);
+		if (!DocValuesColumn::build(doc_values_path, DOC_VALUES_SLOT)) {
+			L_ERR(nullptr, "ERROR: Doc values column can not be built");
+			++cont;
+		}
+		cont += doc_values_check(Xapian::Database(doc_values_db));
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+	delete_files(doc_values_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test DocValuesColumn::get is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+// Changes some documents the way Database does, returns the revision before the commit.
+static uint32_t doc_values_change(Xapian::WritableDatabase& wdb, std::map<Xapian::docid, Xapian::Document>& changed, unsigned version) {
+	auto previous_revision = wdb.get_revision();
+	changed.clear();
+	for (Xapian::docid did = 100; did <= 110; ++did) {
+		changed[did] = doc_values_doc(did, version, true);
+		wdb.replace_document(did, changed[did]);
+	}
+	const auto second = doc_values_docids[1].first;
+	changed[second] = doc_values_doc(second, version, true);
+	wdb.replace_document(second, changed[second]);
+	wdb.delete_document(second + 1);
+	changed[second + 1] = Xapian::Document();
+	const auto last = 5 * DOC_VALUES_SEGMENT_SIZE + version;
+	changed[last] = doc_values_doc(last, version, true);
+	wdb.replace_document(last, changed[last]);
+	wdb.commit();
+	return previous_revision;
+}
+
+
+int test_doc_values_update() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		doc_values_create(true);
+		DocValuesColumn::build(doc_values_path, DOC_VALUES_SLOT);
+		const auto filename = doc_values_path + DOC_VALUES_PATH + std::to_string(DOC_VALUES_SLOT);
+		const auto built_revision = Xapian::Database(doc_values_db).get_revision();
+
+		Xapian::WritableDatabase wdb(doc_values_db, Xapian::DB_OPEN);
+		std::map<Xapian::docid, Xapian::Document> changed;
+
+		// Only the segments with changed cells are written again.
+		auto previous_revision = doc_values_change(wdb, changed, 1);
+		DocValuesColumn::update(doc_values_path, DOC_VALUES_SLOT, changed, previous_revision, wdb.get_revision());
+		cont += doc_values_check(Xapian::Database(doc_values_db));
+		const auto untouched = filename + "." + std::to_string(3) + "." + std::to_string(built_revision);
+		if (!exists(untouched)) {
+			L_ERR(nullptr, "ERROR: Unchanged doc values segment %s was written again", untouched.c_str());
+			++cont;
+		}
+
+		// A commit the column missed gets it rebuilt in the background.
+		doc_values_change(wdb, changed, 2);
+		previous_revision = doc_values_change(wdb, changed, 3);
+		DocValuesColumn::update(doc_values_path, DOC_VALUES_SLOT, changed, previous_revision, wdb.get_revision());
+		for (int i = 0; i < 100; ++i) {
+			DocValuesColumn column(filename);
+			if (column.valid() && column.revision() == wdb.get_revision()) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		cont += doc_values_check(Xapian::Database(doc_values_db));
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+	delete_files(doc_values_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test DocValuesColumn::update is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+// Compares the positions of both posting sources.
+static int doc_values_compare(const Xapian::Database& db, const char* op, Xapian::docid did, Xapian::ValuePostingSource& expected, DocValuesPostingSource& source) {
+	if (expected.at_end() != source.at_end()) {
+		L_ERR(nullptr, "ERROR: %s(%u): DocValuesPostingSource is%s at the end", op, did, source.at_end() ? "" : " not");
+		return 1;
+	}
+	if (!expected.at_end()) {
+		const auto expected_value = db.get_document(expected.get_docid()).get_value(DOC_VALUES_SLOT);
+		if (expected.get_docid() != source.get_docid() || expected_value != source.get_value()) {
+			L_ERR(nullptr, "ERROR: %s(%u): DocValuesPostingSource is at %u (%s) instead of %u (%s)", op, did,
+				source.get_docid(), repr(source.get_value()).c_str(), expected.get_docid(), repr(expected_value).c_str());
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+int test_doc_values_posting_source() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		// Sources only read columns without overflows.
+		doc_values_create(false);
+		DocValuesColumn::build(doc_values_path, DOC_VALUES_SLOT);
+		Xapian::Database db(doc_values_db);
+		auto doc_values = std::make_shared<const DocValues>(doc_values_path, db.get_revision());
+		if (!doc_values->column(DOC_VALUES_SLOT)) {
+			L_ERR(nullptr, "ERROR: Doc values column is missing");
+			++cont;
+		}
+		DocValues::Scope scope(doc_values);
+
+		Xapian::ValuePostingSource expected(DOC_VALUES_SLOT);
+		DocValuesPostingSource source(DOC_VALUES_SLOT);
+
+		// next
+		expected.init(db);
+		source.init(db);
+		do {
+			expected.next(0);
+			source.next(0);
+			cont += doc_values_compare(db, "next", 0, expected, source);
+		} while (!expected.at_end() && !source.at_end());
+
+		// skip_to
+		std::vector<Xapian::docid> targets = { 1, 2, 7, 98, 499, 500, 501, DOC_VALUES_SEGMENT_SIZE - 1, DOC_VALUES_SEGMENT_SIZE, 2 * DOC_VALUES_SEGMENT_SIZE };
+		for (const auto& range : doc_values_docids) {
+			targets.push_back(range.first);
+			targets.push_back(range.second);
+			targets.push_back(range.second + 1);
+		}
+		std::sort(targets.begin(), targets.end());
+		expected.init(db);
+		source.init(db);
+		for (auto did : targets) {
+			expected.skip_to(did, 0);
+			source.skip_to(did, 0);
+			cont += doc_values_compare(db, "skip_to", did, expected, source);
+			if (expected.at_end() || source.at_end()) {
+				break;
+			}
+		}
+
+		// check, matching the documents the way the matcher does
+		expected.init(db);
+		source.init(db);
+		for (const auto& range : doc_values_docids) {
+			for (auto did = range.first > 10 ? range.first - 10 : 1; did <= range.second + 10; ++did) {
+				const bool expected_match = expected.check(did, 0) && !expected.at_end() && expected.get_docid() == did;
+				const bool match = source.check(did, 0) && !source.at_end() && source.get_docid() == did;
+				if (expected_match != match) {
+					L_ERR(nullptr, "ERROR: check(%u): DocValuesPostingSource does%s match", did, match ? "" : " not");
+					++cont;
+				} else if (match && source.get_value() != db.get_document(did).get_value(DOC_VALUES_SLOT)) {
+					L_ERR(nullptr, "ERROR: check(%u): DocValuesPostingSource has %s", did, repr(source.get_value()).c_str());
+					++cont;
+				}
+			}
+		}
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+	delete_files(doc_values_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test DocValuesPostingSource is correct!");
+	}
+
+	RETURN(cont);
+}
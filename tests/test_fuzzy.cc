@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_fuzzy.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../src/multivalue/fuzzy.h"
+#include "utils.h"
+
+
+struct test_fuzzy_t {
+	std::string word;
+	std::string candidate;
+	unsigned expected;
+};
+
+
+// Distances are capped at FUZZY_MAX_EDITS + 1.
+const test_fuzzy_t test_distances[] {
+	// Distance 0.
+	{ "hello",   "hello",    0 },
+	{ "",        "",         0 },
+	{ "ñandú",   "ñandú",    0 },
+	// Distance 1.
+	{ "hello",   "hallo",    1 },
+	{ "hello",   "hell",     1 },
+	{ "hello",   "helloo",   1 },
+	{ "hello",   "ello",     1 },
+	{ "ñandú",   "nandú",    1 },
+	// Distance 2.
+	{ "hello",   "hxllx",    2 },
+	{ "hello",   "help",     2 },
+	{ "",        "ab",       2 },
+	{ "abc",     "cba",      2 },
+	// Transpositions.
+	{ "ab",      "ba",       1 },
+	{ "hello",   "hlelo",    1 },
+	{ "hello",   "ehlol",    2 },
+	{ "abcd",    "badc",     2 },
+	// Beyond the maximum.
+	{ "hello",   "world",    3 },
+	{ "hello",   "he",       3 },
+	{ "abc",     "",         3 },
+	{ "abcdef",  "badcfe",   3 },
+};
+
+
+// Feeds candidate through the automaton one character at a time, the way intersect() does.
+static std::vector<LevenshteinAutomaton::State> run(const LevenshteinAutomaton& automaton, const std::u32string& candidate) {
+	std::vector<LevenshteinAutomaton::State> states{ automaton.start() };
+	uint32_t prev_c = 0;
+	for (const auto c : candidate) {
+		const LevenshteinAutomaton::State* prev_state = states.size() > 1 ? &states[states.size() - 2] : nullptr;
+		states.push_back(automaton.step(states.back(), prev_state, c, prev_c));
+		prev_c = c;
+	}
+	return states;
+}
+
+
+static std::u32string to_u32(const std::string& str) {
+	std::u32string u32;
+	for (size_t pos = 0; pos < str.size(); ) {
+		const auto c = static_cast<unsigned char>(str[pos]);
+		const size_t extra = c < 0xc0 ? 0 : c < 0xe0 ? 1 : c < 0xf0 ? 2 : 3;
+		char32_t ch = extra ? c & (0x3f >> extra) : c;
+		for (size_t i = 1; i <= extra && pos + i < str.size(); ++i) {
+			ch = (ch << 6) | (static_cast<unsigned char>(str[pos + i]) & 0x3f);
+		}
+		u32.push_back(ch);
+		pos += extra + 1;
+	}
+	return u32;
+}
+
+
+int test_fuzzy_distance() {
+	INIT_LOG
+	int cont = 0;
+	for (const auto& test : test_distances) {
+		LevenshteinAutomaton automaton(test.word, FUZZY_MAX_EDITS);
+		const auto distance = automaton.distance(run(automaton, to_u32(test.candidate)).back());
+		if (distance != test.expected) {
+			L_ERR(nullptr, "ERROR: LevenshteinAutomaton distance(%s, %s) is %u, should be %u", test.word.c_str(), test.candidate.c_str(), distance, test.expected);
+			++cont;
+		}
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test LevenshteinAutomaton distance is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_fuzzy_can_match() {
+	INIT_LOG
+	int cont = 0;
+
+	// Every prefix of a candidate within reach keeps the automaton alive.
+	LevenshteinAutomaton automaton("hello", 1);
+	for (const auto& state : run(automaton, U"hallo")) {
+		if (!automaton.can_match(state)) {
+			L_ERR(nullptr, "ERROR: LevenshteinAutomaton(hello, 1) pruned a prefix of hallo");
+			++cont;
+			break;
+		}
+	}
+
+	// Two leading substitutions can never be undone with one edit.
+	const auto states = run(automaton, U"xyllo");
+	if (!automaton.can_match(states[1])) {
+		L_ERR(nullptr, "ERROR: LevenshteinAutomaton(hello, 1) pruned x");
+		++cont;
+	}
+	if (automaton.can_match(states[2])) {
+		L_ERR(nullptr, "ERROR: LevenshteinAutomaton(hello, 1) did not prune xy");
+		++cont;
+	}
+
+	// A candidate too long is pruned as soon as it passes the word.
+	const auto longer = run(automaton, U"hellooo");
+	if (!automaton.can_match(longer[6]) || automaton.can_match(longer[7])) {
+		L_ERR(nullptr, "ERROR: LevenshteinAutomaton(hello, 1) should prune hellooo only at its end");
+		++cont;
+	}
+
+	// With no edits allowed only the word itself survives.
+	LevenshteinAutomaton exact("abc", 0);
+	if (!exact.can_match(run(exact, U"ab").back()) || exact.can_match(run(exact, U"ac").back())) {
+		L_ERR(nullptr, "ERROR: LevenshteinAutomaton(abc, 0) pruning is wrong");
+		++cont;
+	}
+
+	if (FuzzyTerm::auto_edits("ab") != 0 || FuzzyTerm::auto_edits("hello") != 1 || FuzzyTerm::auto_edits("ñandúes") != 2) {
+		L_ERR(nullptr, "ERROR: FuzzyTerm::auto_edits is wrong");
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test LevenshteinAutomaton can_match is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+static std::set<std::string> matching_terms(const Xapian::Database& db, const std::string& prefix, const std::string& word, unsigned max_edits) {
+	std::set<std::string> terms;
+	LevenshteinAutomaton automaton(word, max_edits);
+	for (const auto& match : automaton.intersect(db.allterms_begin(prefix), db.allterms_end(prefix), prefix)) {
+		terms.insert(match.term.substr(prefix.size()));
+	}
+	return terms;
+}
+
+
+static Xapian::doccount matching_docs(const Xapian::Database& db, const std::string& prefix, const std::string& word, unsigned max_edits, unsigned prefix_length) {
+	FuzzyTerm fuzzy(std::string(prefix), std::string(word), max_edits, prefix_length);
+	fuzzy.init(db);
+	Xapian::doccount count = 0;
+	for (fuzzy.next(0.0); !fuzzy.at_end(); fuzzy.next(0.0)) {
+		++count;
+	}
+	return count;
+}
+
+
+int test_fuzzy_prefix_length() {
+	INIT_LOG
+	int cont = 0;
+
+	const std::string path = ".db_fuzzy.db";
+	delete_files(path);
+
+	const std::string prefix = "XAT";
+	try {
+		Xapian::WritableDatabase wdb(path, Xapian::DB_CREATE_OR_OVERWRITE);
+		for (const auto& term : { "hello", "hallo", "jello", "help", "hell", "world", "yellow" }) {
+			Xapian::Document doc;
+			doc.add_term(prefix + term);
+			doc.add_term(std::string("XBT") + term);
+			wdb.add_document(doc);
+		}
+		wdb.commit();
+
+		Xapian::Database db(path);
+
+		// Terms of other fields never match.
+		const std::set<std::string> expected = { "hello", "hallo", "jello", "hell" };
+		const auto terms = matching_terms(db, prefix, "hello", 1);
+		if (terms != expected) {
+			L_ERR(nullptr, "ERROR: LevenshteinAutomaton::intersect(hello, 1) matched %zu terms, should be %zu", terms.size(), expected.size());
+			++cont;
+		}
+
+		const std::vector<std::pair<unsigned, Xapian::doccount>> prefix_lengths = {
+			{ 0, 4 },  // hello, hallo, jello, hell
+			{ 1, 3 },  // hello, hallo, hell
+			{ 2, 2 },  // hello, hell
+			{ 9, 1 },  // Longer than the word: an exact match.
+		};
+		for (const auto& test : prefix_lengths) {
+			const auto count = matching_docs(db, prefix, "hello", 1, test.first);
+			if (count != test.second) {
+				L_ERR(nullptr, "ERROR: FuzzyTerm(hello, 1, prefix_length=%u) matched %u documents, should be %u", test.first, count, test.second);
+				++cont;
+			}
+		}
+
+		// With two edits yellow and help come in.
+		if (matching_docs(db, prefix, "hello", 2, 0) != 6) {
+			L_ERR(nullptr, "ERROR: FuzzyTerm(hello, 2) should match 6 documents");
+			++cont;
+		}
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(path);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test FuzzyTerm prefix length is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_fuzzy_serialise() {
+	INIT_LOG
+	int cont = 0;
+
+	FuzzyTerm fuzzy(std::string("XAT"), std::string("hello"), 2, 3);
+	const auto serialised = fuzzy.serialise();
+
+	Xapian::Registry registry;
+	std::unique_ptr<FuzzyTerm> unserialised(fuzzy.unserialise_with_registry(serialised, registry));
+	if (unserialised->serialise() != serialised) {
+		L_ERR(nullptr, "ERROR: FuzzyTerm serialise round trip is wrong: %s", repr(unserialised->serialise()).c_str());
+		++cont;
+	}
+	if (unserialised->get_description() != fuzzy.get_description()) {
+		L_ERR(nullptr, "ERROR: FuzzyTerm unserialised as %s", unserialised->get_description().c_str());
+		++cont;
+	}
+
+	try {
+		std::unique_ptr<FuzzyTerm> bad(fuzzy.unserialise_with_registry("bad", registry));
+		L_ERR(nullptr, "ERROR: FuzzyTerm unserialised a bad string");
+		++cont;
+	} catch (const Xapian::NetworkError&) { }
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test FuzzyTerm serialise is correct!");
+	}
+
+	RETURN(cont);
+}
@@ -22,6 +22,7 @@
 
 #include "test_geospatial.h"
 
+#include "../src/cover_cache.h"
 #include "../src/geo/ewkt.h"
 #include "../src/log.h"
 #include "utils.h"
@@ -447,6 +448,35 @@ inline int verify_trixels_ranges(const std::shared_ptr<Geometry>& geometry, cons
 }
 
 
+/*
+ * The expected ranges were captured from the recursive decomposition over
+ * trixel names, so any change in how geometries are covered shows up here.
+ */
+inline int verify_expected_ranges(const std::string& test, const std::vector<range_t>& ranges) {
+	int cont = 0;
+
+	std::string expected_file = path_test_geospatial + "ranges/" + test + "_expect_ranges.txt";
+	std::ifstream expected(expected_file);
+	if (!expected.is_open()) {
+		L_ERR(nullptr, "ERROR: File %s not found.", expected_file.c_str());
+		return 1;
+	}
+
+	std::vector<range_t> expected_ranges;
+	uint64_t start, end;
+	while (expected >> start >> end) {
+		expected_ranges.emplace_back(start, end);
+	}
+
+	if (expected_ranges != ranges) {
+		L_ERR(nullptr, "ERROR: %s ranges are different from the expected ones [%zu %zu]", test.c_str(), expected_ranges.size(), ranges.size());
+		++cont;
+	}
+
+	return cont;
+}
+
+
 int testPoint() {
 	// Catedral Morelia
 	auto point = std::make_shared<Point>(getPoint());
@@ -454,7 +484,7 @@ int testPoint() {
 	auto ranges = point->getRanges(partials, error);
 	HTM::writePython3D(python_geospatial + "Point3D.py", point, trixels);
 	HTM::writeGoogleMap(python_geospatial + "PointGM.py", "PointGM.html", point, trixels, path_test_geospatial);
-	RETURN(verify_trixels_ranges(point, trixels, ranges));
+	RETURN(verify_trixels_ranges(point, trixels, ranges) + verify_expected_ranges("Point", ranges));
 }
 
 
@@ -477,7 +507,7 @@ int testCircle() {
 	auto ranges = circle->getRanges(partials, error);
 	HTM::writePython3D(python_geospatial + "Circle3D.py", circle, trixels);
 	HTM::writeGoogleMap(python_geospatial + "CircleGM.py", "CircleGM.html", circle, trixels, path_test_geospatial);
-	RETURN(verify_trixels_ranges(circle, trixels, ranges));
+	RETURN(verify_trixels_ranges(circle, trixels, ranges) + verify_expected_ranges("Circle", ranges));
 }
 
 
@@ -501,7 +531,7 @@ int testPolygon() {
 	auto ranges = polygon->getRanges(partials, error);
 	HTM::writePython3D(python_geospatial + "Polygon3D.py", polygon, trixels);
 	HTM::writeGoogleMap(python_geospatial + "PolygonGM.py", "PolygonGM.html", polygon, trixels, path_test_geospatial);
-	RETURN(verify_trixels_ranges(polygon, trixels, ranges));
+	RETURN(verify_trixels_ranges(polygon, trixels, ranges) + verify_expected_ranges("Polygon", ranges));
 }
 
 
@@ -537,7 +567,7 @@ int testMultiPolygon() {
 	auto ranges = multipolygon->getRanges(partials, error);
 	HTM::writePython3D(python_geospatial + "MultiPolygon3D.py", multipolygon, trixels);
 	HTM::writeGoogleMap(python_geospatial + "MultiPolygonGM.py", "MultiPolygonGM.html", multipolygon, trixels, path_test_geospatial);
-	RETURN(verify_trixels_ranges(multipolygon, trixels, ranges));
+	RETURN(verify_trixels_ranges(multipolygon, trixels, ranges) + verify_expected_ranges("MultiPolygon", ranges));
 }
 
 
@@ -563,3 +593,62 @@ int testIntersection() {
 	HTM::writeGoogleMap(python_geospatial + "IntersectionGM.py", "IntersectionGM.html", intersection, trixels, path_test_geospatial);
 	RETURN(verify_trixels_ranges(intersection, trixels, ranges));
 }
+
+
+int testCoverCache() {
+	int cont = 0;
+
+	CoverCache cover_cache;
+
+	// Equal geometries built apart, or parsed back from their EWKT, share one cover.
+	auto circle = getCircle();
+	auto ranges = cover_cache.get(circle, partials, error);
+	if (*ranges != circle.getRanges(partials, error)) {
+		L_ERR(nullptr, "ERROR: CoverCache ranges are different from Circle::getRanges");
+		++cont;
+	}
+
+	auto same_circle = getCircle();
+	if (cover_cache.get(same_circle, partials, error) != ranges) {
+		L_ERR(nullptr, "ERROR: CoverCache missed an equal Circle");
+		++cont;
+	}
+
+	EWKT ewkt(circle.toEWKT());
+	if (cover_cache.get(*ewkt.getGeometry(), partials, error) != ranges) {
+		L_ERR(nullptr, "ERROR: CoverCache missed a Circle parsed from %s", circle.toEWKT().c_str());
+		++cont;
+	}
+
+	auto polygon = getPolygon();
+	polygon.simplify();
+	auto polygon_ranges = cover_cache.get(polygon, partials, error);
+	auto same_polygon = getPolygon();
+	same_polygon.simplify();
+	if (cover_cache.get(same_polygon, partials, error) != polygon_ranges || *polygon_ranges != polygon.getRanges(partials, error)) {
+		L_ERR(nullptr, "ERROR: CoverCache is wrong for equal Polygons");
+		++cont;
+	}
+
+	// Different geometries, partials or error are different covers.
+	if (cover_cache.get(getPoint(), partials, error) == ranges) {
+		L_ERR(nullptr, "ERROR: CoverCache returned the Circle cover for a Point");
+		++cont;
+	}
+	if (cover_cache.get(circle, !partials, error) == ranges || cover_cache.get(circle, partials, HTM_MAX_ERROR) == ranges) {
+		L_ERR(nullptr, "ERROR: CoverCache ignores partials or error");
+		++cont;
+	}
+
+	const auto stats = cover_cache.stats();
+	if (stats.hits != 3 || stats.misses != 5) {
+		L_ERR(nullptr, "ERROR: CoverCache should have 3 hits and 5 misses [%zu %zu]", stats.hits, stats.misses);
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Testing CoverCache is correct!");
+	}
+
+	RETURN(cont);
+}
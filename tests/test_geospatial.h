@@ -39,3 +39,4 @@ int testMultiConvex();
 int testMultiPolygon();
 int testCollection();
 int testIntersection();
+int testCoverCache();
@@ -22,6 +22,12 @@
 
 #include "test_lru.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/concurrent_lru.h"
 #include "../src/lru.h"
 #include "utils.h"
 
@@ -156,3 +162,114 @@ int test_lru_mutate() {
 
 	RETURN(0);
 }
+
+
+int test_concurrent_lru() {
+	INIT_LOG
+	ConcurrentLRU<std::string, int> lru(3, 1);
+	lru.insert("test1", 111);
+	lru.insert("test2", 222);
+	lru.insert("test3", 333);
+
+	int value;
+	if (!lru.find("test1", value) || value != 111) {  // this gives 'test1' a second chance
+		L_ERR(nullptr, "ERROR: ConcurrentLRU::find is not working");
+		RETURN(1);
+	}
+
+	lru.insert("test4", 444);  // this pushes 'test2' out of the lru
+
+	if (lru.exists("test2") || !lru.exists("test1") || !lru.exists("test3") || !lru.exists("test4")) {
+		L_ERR(nullptr, "ERROR: ConcurrentLRU::insert with limit is not working");
+		RETURN(1);
+	}
+
+	if (lru.get("test5", []() { return 555; }) != 555 || lru.size() != 3) {
+		L_ERR(nullptr, "ERROR: ConcurrentLRU::get is not working");
+		RETURN(1);
+	}
+
+	lru.insert_and([](int&){ return std::make_pair(InsertAction::front, DropAction::leave); }, "test6", 666);  // this DOES NOT push anything out of the lru
+
+	if (lru.size() != 4) {
+		L_ERR(nullptr, "ERROR: ConcurrentLRU::insert_and is not working");
+		RETURN(1);
+	}
+
+	if (lru.erase("test6") != 1 || lru.exists("test6")) {
+		L_ERR(nullptr, "ERROR: ConcurrentLRU::erase is not working");
+		RETURN(1);
+	}
+
+	L_ERR(nullptr, "Test ConcurrentLRU is correct!");
+
+	RETURN(0);
+}
+
+
+struct StringWeight {
+	size_t operator()(const std::string& key, const std::string& value) const noexcept {
+		return key.size() + value.size();
+	}
+};
+
+
+int test_concurrent_lru_weight() {
+	INIT_LOG
+	ConcurrentLRU<std::string, std::string, std::hash<std::string>, StringWeight> lru(20, 1);
+	lru.insert("test1", std::string("11111"));
+	lru.insert("test2", std::string("22222"));
+	lru.insert("test3", std::string("33333"));  // this pushes 'test1' out of the lru (weight 30 > 20)
+
+	if (lru.weight() != 20 || lru.exists("test1") || !lru.exists("test2") || !lru.exists("test3")) {
+		L_ERR(nullptr, "ERROR: ConcurrentLRU with weights is not working");
+		RETURN(1);
+	}
+
+	L_ERR(nullptr, "Test ConcurrentLRU with weights is correct!");
+
+	RETURN(0);
+}
+
+
+int test_concurrent_lru_threads() {
+	INIT_LOG
+	const size_t keys = 1000;
+	const size_t lookups = 200000;
+
+	ConcurrentLRU<size_t, std::shared_ptr<size_t>> lru(keys * 2);
+	for (size_t i = 0; i < keys; ++i) {
+		lru.insert(i, std::make_shared<size_t>(i));
+	}
+
+	std::atomic_size_t errors(0);
+	for (size_t num_threads = 1; num_threads <= 8; num_threads *= 2) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < num_threads; ++t) {
+			threads.emplace_back([&lru, &errors, t]() {
+				std::shared_ptr<size_t> value;
+				for (size_t i = 0; i < lookups; ++i) {
+					auto key = (i * 7 + t) % keys;
+					if (!lru.find(key, value) || *value != key) {
+						++errors;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		L_INFO(nullptr, "ConcurrentLRU hits with %zu threads: %.0f hits/s", num_threads, num_threads * lookups / elapsed);
+	}
+
+	if (errors) {
+		L_ERR(nullptr, "ERROR: ConcurrentLRU::find is not working with multiple threads (%zu errors)", errors.load());
+		RETURN(1);
+	}
+
+	L_ERR(nullptr, "Test ConcurrentLRU with threads is correct!");
+
+	RETURN(0);
+}
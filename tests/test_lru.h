@@ -29,3 +29,6 @@ int test_lru();
 int test_lru_emplace();
 int test_lru_actions();
 int test_lru_mutate();
+int test_concurrent_lru();
+int test_concurrent_lru_weight();
+int test_concurrent_lru_threads();
@@ -22,7 +22,9 @@
 
 #include "test_msgpack.h"
 
+#include "../src/json_decoder.h"
 #include "../src/msgpack.h"
+#include "../src/msgpack_transcoder.h"
 #include "../src/split.h"
 #include "utils.h"
 
@@ -862,3 +864,134 @@ int test_msgpack_array() {
 
 	return 0;
 }
+
+
+int test_msgpack_json_decoder() {
+	INIT_LOG
+	std::vector<std::string> documents = {
+		"{\"one\": 1, \"two\": [true, false, null, -5, 3.25, 1e3, \"Jos\\u00e9 \\ud83d\\ude00\\n\"], \"three\": {}, \"four\": []}",
+		"{\"max\": 18446744073709551615, \"min\": -9223372036854775808, \"big\": 99999999999999999999}",
+		"[[[]], {\"key\": [{}]}]",
+		"  42  ",
+		"\"str_value\"",
+	};
+
+	int cont = 0;
+	for (const auto& document : documents) {
+		rapidjson::Document rdoc;
+		rdoc.Parse(document.data());
+		auto expected = MsgPack(rdoc).to_string();
+		// The decoder must give the same result however the data is split
+		for (size_t split = 0; split <= document.size(); ++split) {
+			JsonDecoder decoder;
+			decoder.feed(document.data(), split);
+			decoder.feed(document.data() + split, document.size() - split);
+			auto result = decoder.decode().to_string();
+			if (result != expected) {
+				L_ERR(nullptr, "JsonDecoder is not working (split at %zu). Result: %s\nExpected: %s\n", split, result.c_str(), expected.c_str());
+				++cont;
+				break;
+			}
+		}
+	}
+
+	std::vector<std::string> invalid = { "", "[1,]", "{\"one\" 1}", "01", "[1 2]", "{\"one\":1}x", "\"\\ud800x\"", "tru" };
+	for (const auto& document : invalid) {
+		JsonDecoder decoder;
+		decoder.feed(document.data(), document.size());
+		try {
+			decoder.decode();
+			L_ERR(nullptr, "JsonDecoder accepted invalid JSON: %s\n", repr(document).c_str());
+			++cont;
+		} catch (const ClientError&) { }
+	}
+
+	RETURN(cont);
+}
+
+
+int test_msgpack_transcoder() {
+	INIT_LOG
+	MsgPack big(MsgPack::Type::MAP);
+	for (int i = 0; i < 20; ++i) {
+		big["key" + std::to_string(i)] = i;
+	}
+	std::vector<MsgPack> documents = {
+		MsgPack({
+			{ "name", "Jos\u00e9 \"quoted\"\n" },
+			{ "_rank", 99 },
+			{ "negative", -5 },
+			{ "float", 3.25 },
+			{ "max", 18446744073709551615ULL },
+			{ "array", { 1, true, nullptr, MsgPack({ { "decimal", 0.1 } }) } },
+		}),
+		MsgPack(MsgPack::Type::MAP),
+		big,
+	};
+
+	std::vector<MsgPackTranscoder::Field> fields = {
+		{ "_id", "ID", false },
+		{ "_rank", 3 },
+		{ "_weight", 1.5 },
+	};
+
+	int cont = 0;
+	for (const auto& document : documents) {
+		// The transcoder must give the same result as modifying and serialising the MsgPack
+		auto expected = document;
+		if (expected.find("_id") == expected.end()) {
+			expected["_id"] = "ID";
+		}
+		expected["_rank"] = 3;
+		expected["_weight"] = 1.5;
+
+		auto serialised = document.serialise();
+		MsgPackTranscoder transcoder(serialised, fields);
+		for (bool pretty : { false, true }) {
+			auto result = transcoder.to_json(pretty);
+			if (result != expected.to_string(pretty)) {
+				L_ERR(nullptr, "MsgPackTranscoder::to_json is not working. Result: %s\nExpected: %s\n", result.c_str(), expected.to_string(pretty).c_str());
+				++cont;
+			}
+		}
+		if (transcoder.to_msgpack() != expected.serialise()) {
+			L_ERR(nullptr, "MsgPackTranscoder::to_msgpack is not working. Result: %s\nExpected: %s\n", MsgPack::unserialise(transcoder.to_msgpack()).to_string().c_str(), expected.to_string().c_str());
+			++cont;
+		}
+	}
+
+	// Projections
+	MsgPack user({
+		{ "name", "John" },
+		{ "user", { { "first", "John" }, { "last", "Doe" }, { "age", 30 } } },
+		{ "created_at", 1 },
+		{ "updated_at", 2 },
+	});
+	std::vector<std::pair<std::vector<std::string>, std::string>> projections = {
+		{ { "name" }, "{\"name\":\"John\",\"_id\":\"ID\",\"_rank\":3,\"_weight\":1.5}" },
+		{ { "user.first", "*_at" }, "{\"user\":{\"first\":\"John\"},\"created_at\":1,\"updated_at\":2,\"_id\":\"ID\",\"_rank\":3,\"_weight\":1.5}" },
+		{ { "user.*", "name.first" }, "{\"user\":{\"first\":\"John\",\"last\":\"Doe\",\"age\":30},\"_id\":\"ID\",\"_rank\":3,\"_weight\":1.5}" },
+		{ { "missing" }, "{\"_id\":\"ID\",\"_rank\":3,\"_weight\":1.5}" },
+	};
+	auto user_serialised = user.serialise();
+	for (const auto& projection : projections) {
+		MsgPackTranscoder::Projection selector(projection.first);
+		MsgPackTranscoder transcoder(user_serialised, fields, &selector);
+		auto result = transcoder.to_json();
+		auto result_msgpack = MsgPack::unserialise(transcoder.to_msgpack()).to_string();
+		if (result != projection.second || result_msgpack != projection.second) {
+			L_ERR(nullptr, "MsgPackTranscoder::Projection is not working. Result: %s (%s)\nExpected: %s\n", result.c_str(), result_msgpack.c_str(), projection.second.c_str());
+			++cont;
+		}
+	}
+
+	auto truncated = big.serialise();
+	truncated.pop_back();
+	try {
+		MsgPackTranscoder(truncated, fields).to_json();
+		L_ERR(nullptr, "MsgPackTranscoder accepted truncated data\n");
+		++cont;
+	} catch (const SerialisationError&) { }
+
+	RETURN(cont);
+}
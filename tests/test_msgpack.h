@@ -40,3 +40,5 @@ int test_msgpack_keys();
 int test_msgpack_change_keys();
 int test_msgpack_map();
 int test_msgpack_array();
+int test_msgpack_json_decoder();
+int test_msgpack_transcoder();
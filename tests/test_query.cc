@@ -262,3 +262,57 @@ int test_partials_search() {
 		RETURN(1);
 	}
 }
+
+
+/*
+ * Searches selecting fields answer from the value slots only when the
+ * slots keep the shape the fields have in the data.
+ */
+int test_slot_projection() {
+	INIT_LOG
+	int cont = 0;
+	try {
+		DB_Test db_slots(".db_slots.db", std::vector<std::string>(), DB_WRITABLE | DB_SPAWN | DB_NOWAL);
+		db_slots.db_handler.index("1", false, db_slots.get_body("{ \"name\": \"Hello\", \"tags\": [ \"one\" ], \"price\": 2.5, \"count\": 3 }", JSON_CONTENT_TYPE).second, true, JSON_CONTENT_TYPE);
+		db_slots.db_handler.index("2", false, db_slots.get_body("{ \"name\": \"World\", \"tags\": [ \"one\", \"two\" ], \"price\": 2, \"count\": \"4\" }", JSON_CONTENT_TYPE).second, true, JSON_CONTENT_TYPE);
+
+		// Strings are kept verbatim in their slots.
+		auto slot_fields = db_slots.db_handler.get_slot_fields({ { "name" } });
+		if (slot_fields.size() != 1) {
+			++cont;
+			L_ERR(nullptr, "ERROR: String field should be read from its slot");
+		} else {
+			auto document = db_slots.db_handler.get_document(std::string("1"));
+			auto obj = MsgPack::unserialise(document.get_slot_object(slot_fields));
+			if (obj.to_string() != "{\"name\":\"Hello\"}") {
+				++cont;
+				L_ERR(nullptr, "ERROR: Slot object is not correct. Obtained %s. Expected: %s", obj.to_string().c_str(), "{\"name\":\"Hello\"}");
+			}
+		}
+
+		// One element arrays, integers in float fields and numbers given as
+		// strings would change their shape, they must be read from the data.
+		for (const auto& field : { "tags", "price", "count" }) {
+			if (!db_slots.db_handler.get_slot_fields({ { field } }).empty()) {
+				++cont;
+				L_ERR(nullptr, "ERROR: Field %s should be read from the data", field);
+			}
+		}
+
+		if (!db_slots.db_handler.get_slot_fields({ { "name" }, { "tags" } }).empty()) {
+			++cont;
+			L_ERR(nullptr, "ERROR: Selections with any field not in slots should be read from the data");
+		}
+	} catch (const std::exception& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.what());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Testing slot projection is correct!");
+	} else {
+		L_ERR(nullptr, "ERROR: Testing slot projection has mistakes.");
+	}
+
+	RETURN(cont);
+}
@@ -35,3 +35,4 @@ struct test_query_t {
 
 int test_query_search();
 int test_partials_search();
+int test_slot_projection();
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "test_query_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/multivalue/fuzzy.h"
+#include "../src/multivalue/geospatialrange.h"
+#include "../src/multivalue/range.h"
+#include "../src/multivalue/wildcard.h"
+#include "../src/query_cache.h"
+#include "utils.h"
+
+
+// Every posting source registered in QueryCache::registry().
+static std::vector<Xapian::PostingSource*> posting_sources() {
+	return {
+		new MultipleValueRange(10, std::string("start"), std::string("end")),
+		new MultipleValueGE(11, std::string("start")),
+		new MultipleValueLE(12, std::string("end")),
+		new GeoSpatialRange(13, std::vector<range_t>({ range_t(8, 9), range_t(20, 30) })),
+		new TermWildcard(std::string("XAT"), std::string("*bar*")),
+		new FuzzyTerm(std::string("XAT"), std::string("term"), 2, 1),
+	};
+}
+
+
+int test_posting_sources_serialise() {
+	INIT_LOG
+	int cont = 0;
+	for (auto ps : posting_sources()) {
+		const auto serialised = ps->serialise();
+		const auto description = ps->get_description();
+
+		// Unserialise the posting source several times, the fields must always come back in order.
+		for (int i = 0; i < 3; ++i) {
+			std::unique_ptr<Xapian::PostingSource> unserialised(ps->unserialise_with_registry(serialised, QueryCache::registry()));
+			if (unserialised->serialise() != serialised || unserialised->get_description() != description) {
+				L_ERR(nullptr, "ERROR: %s serialise round trip is wrong: %s", ps->name().c_str(), unserialised->get_description().c_str());
+				++cont;
+			}
+		}
+
+		// And as part of a query, through the registry.
+		Xapian::Query query(ps->release());
+		const auto serialised_query = query.serialise();
+		const auto unserialised_query = Xapian::Query::unserialise(serialised_query, QueryCache::registry());
+		if (unserialised_query.serialise() != serialised_query) {
+			L_ERR(nullptr, "ERROR: Query serialise round trip is wrong: %s", unserialised_query.get_description().c_str());
+			++cont;
+		}
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test posting sources serialise is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+static Xapian::Query range_query(const std::string& start, const std::string& end) {
+	return Xapian::Query(Xapian::Query::OP_AND, Xapian::Query("Tterm"), Xapian::Query((new MultipleValueRange(10, std::string(start), std::string(end)))->release()));
+}
+
+
+int test_query_cache_hit() {
+	INIT_LOG
+	int cont = 0;
+
+	QueryCache query_cache(QUERY_CACHE_SIZE);
+	auto schema = std::make_shared<const MsgPack>(MsgPack({ { "field", "schema" } }));
+	MsgPack obj = { { "field", { { "_range", { { "_from", 1 }, { "_to", 10 } } } } } };
+
+	Xapian::Query query;
+	if (query_cache.get(schema, obj, query)) {
+		L_ERR(nullptr, "ERROR: QueryCache::get hit on an empty cache");
+		++cont;
+	}
+
+	const auto compiled = range_query("1", "10");
+	query_cache.set(schema, obj, compiled);
+
+	// Hit more than once, every hit unserialises the query again.
+	for (int i = 0; i < 3; ++i) {
+		if (!query_cache.get(schema, obj, query)) {
+			L_ERR(nullptr, "ERROR: QueryCache::get missed a cached query");
+			++cont;
+		} else if (query.serialise() != compiled.serialise()) {
+			L_ERR(nullptr, "ERROR: QueryCache::get returned a different query: %s", query.get_description().c_str());
+			++cont;
+		}
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test QueryCache hit is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_query_cache_schema() {
+	INIT_LOG
+	int cont = 0;
+
+	QueryCache query_cache(QUERY_CACHE_SIZE);
+	auto schema = std::make_shared<const MsgPack>(MsgPack({ { "field", "schema" } }));
+	MsgPack obj = { { "field", "value" } };
+	query_cache.set(schema, obj, Xapian::Query("Tvalue"));
+
+	Xapian::Query query;
+
+	// A changed schema is a new object, queries compiled with the old one don't hit.
+	auto new_schema = std::make_shared<const MsgPack>(MsgPack({ { "field", "new schema" } }));
+	if (query_cache.get(new_schema, obj, query)) {
+		L_ERR(nullptr, "ERROR: QueryCache::get hit with a different schema");
+		++cont;
+	}
+
+	// Not even if the new schema happens to live where the old one was.
+	schema.reset();
+	schema = std::make_shared<const MsgPack>(MsgPack({ { "field", "schema" } }));
+	if (query_cache.get(schema, obj, query)) {
+		L_ERR(nullptr, "ERROR: QueryCache::get hit with a released schema");
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test QueryCache schema invalidation is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_query_cache_values() {
+	INIT_LOG
+	int cont = 0;
+
+	QueryCache query_cache(QUERY_CACHE_SIZE);
+	auto schema = std::make_shared<const MsgPack>(MsgPack({ { "field", "schema" } }));
+	MsgPack obj1 = { { "field", { { "_range", { { "_from", 1 }, { "_to", 10 } } } } } };
+	MsgPack obj2 = { { "field", { { "_range", { { "_from", 1 }, { "_to", 20 } } } } } };
+
+	const auto query1 = range_query("1", "10");
+	const auto query2 = range_query("1", "20");
+	query_cache.set(schema, obj1, query1);
+
+	Xapian::Query query;
+	if (query_cache.get(schema, obj2, query)) {
+		L_ERR(nullptr, "ERROR: QueryCache::get hit for the same shape with different values");
+		++cont;
+	}
+
+	query_cache.set(schema, obj2, query2);
+	if (!query_cache.get(schema, obj1, query) || query.serialise() != query1.serialise()) {
+		L_ERR(nullptr, "ERROR: QueryCache::get returned the wrong query for the first values");
+		++cont;
+	}
+	if (!query_cache.get(schema, obj2, query) || query.serialise() != query2.serialise()) {
+		L_ERR(nullptr, "ERROR: QueryCache::get returned the wrong query for the second values");
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test QueryCache values are correct!");
+	}
+
+	RETURN(cont);
+}
@@ -955,3 +955,86 @@ int sort_test_geo() {
 		RETURN(1);
 	}
 }
+
+
+const sort_t cursor_tests[] {
+	// Without sort, cursors walk the documents by docid.
+	{ "*", { },                                            { "1", "2", "3", "4", "5", "6", "7", "8", "9", "10" } },
+	{ "*", { "location:CIRCLE(10 10,200000)", "-_id" },   { "6", "5", "8", "10", "1", "7", "4", "3", "9", "2" } },
+	{ "*", { "-location:CIRCLE(10 10,200000)", "-_id" },  { "3", "9", "2", "7", "4", "10", "1", "8", "6", "5" } }
+};
+
+
+// Same as make_search, but getting the results in pages of `limit` documents using cursors.
+static int make_cursor_search(const sort_t _tests[], int len, unsigned limit) {
+	int cont = 0;
+	query_field_t query;
+	query.limit = limit;
+	query.spelling = false;
+	query.synonyms = false;
+	query.is_cursor = true;
+	// Exact totals, so the matches remaining after each cursor can be checked.
+	query.check_at_least = 100;
+
+	for (int i = 0; i < len; ++i) {
+		sort_t p = _tests[i];
+		query.query.clear();
+		query.sort.clear();
+		query.cursor.clear();
+		query.query.push_back(p.query);
+
+		for (const auto& _sort : p.sort) {
+			query.sort.push_back(_sort);
+		}
+
+		std::vector<std::string> results;
+		std::vector<std::string> suggestions;
+
+		try {
+			while (true) {
+				auto mset = db_sort.db_handler.get_mset(query, nullptr, nullptr, suggestions);
+				auto remaining = p.expect_result.size() > results.size() ? p.expect_result.size() - results.size() : 0;
+				if (mset.get_matches_estimated() != remaining) {
+					++cont;
+					L_ERR(nullptr, "ERROR: Cursor page matches estimated should be the %zu matches remaining, obtained %u.", remaining, mset.get_matches_estimated());
+				}
+				for (auto m = mset.begin(); m != mset.end(); ++m) {
+					results.push_back(Unserialise::MsgPack(FieldType::INTEGER, m.get_document().get_value(0)).to_string());
+				}
+				if (mset.size() < limit || results.size() > p.expect_result.size()) {
+					break;
+				}
+				query.cursor = DatabaseHandler::get_cursor(mset);
+			}
+			if (results != p.expect_result) {
+				++cont;
+				L_ERR(nullptr, "ERROR: Different results using cursors. Obtained [%s]. Expected: [%s].", join_string(results, ", ").c_str(), join_string(p.expect_result, ", ").c_str());
+			}
+		} catch (const std::exception& exc) {
+			L_EXC(nullptr, "ERROR: %s\n", exc.what());
+			++cont;
+		}
+	}
+
+	return cont;
+}
+
+
+int sort_test_cursor() {
+	INIT_LOG
+	try {
+		int cont = make_cursor_search(cursor_tests, arraySize(cursor_tests), 3);
+		if (cont == 0) {
+			L_DEBUG(nullptr, "Testing sort with cursors is correct!");
+		} else {
+			L_ERR(nullptr, "ERROR: Testing sort with cursors has mistakes.");
+		}
+		RETURN(cont);
+	} catch (const Xapian::Error &exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		RETURN(1);
+	} catch (const std::exception &exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.what());
+		RETURN(1);
+	}
+}
@@ -52,3 +52,4 @@ int sort_test_numerical();
 int sort_test_date();
 int sort_test_boolean();
 int sort_test_geo();
+int sort_test_cursor();
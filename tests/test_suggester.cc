@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_suggester.h"
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/schema.h"
+#include "../src/suggester.h"
+#include "utils.h"
+
+
+const std::string suggester_db = ".db_suggester.db";
+
+
+static std::string suggester_prefix() {
+	return std::string("X") + COMPLETION_CTYPE;
+}
+
+
+static Xapian::Document suggester_doc(const std::vector<std::string>& values) {
+	required_spc_t field_spc;
+	field_spc.prefix = "X";
+	Xapian::Document doc;
+	for (const auto& value : values) {
+		Suggester::index(doc, value, field_spc);
+	}
+	return doc;
+}
+
+
+// Changes documents the way Database does, tracking the inputs they change.
+static Xapian::docid suggester_add(Xapian::WritableDatabase& wdb, const std::vector<std::string>& values, std::set<std::string>& changed) {
+	const auto doc = suggester_doc(values);
+	Suggester::document_inputs(doc, changed);
+	return wdb.add_document(doc);
+}
+
+
+static void suggester_replace(Xapian::WritableDatabase& wdb, Xapian::docid did, const std::vector<std::string>& values, std::set<std::string>& changed) {
+	Suggester::document_inputs(wdb.get_document(did), changed);
+	const auto doc = suggester_doc(values);
+	Suggester::document_inputs(doc, changed);
+	wdb.replace_document(did, doc);
+}
+
+
+static void suggester_delete(Xapian::WritableDatabase& wdb, Xapian::docid did, std::set<std::string>& changed) {
+	Suggester::document_inputs(wdb.get_document(did), changed);
+	wdb.delete_document(did);
+}
+
+
+static std::string suggester_str(const std::vector<std::pair<std::string, Xapian::doccount>>& suggestions) {
+	std::string str;
+	for (const auto& suggestion : suggestions) {
+		if (!str.empty()) {
+			str.append(", ");
+		}
+		str.append(suggestion.first).append(":").append(std::to_string(suggestion.second));
+	}
+	return str;
+}
+
+
+static int suggester_check(const Suggester& suggester, const std::string& prefix, size_t limit, const std::string& expected) {
+	const auto obtained = suggester_str(suggester.suggest(prefix, limit));
+	if (obtained != expected) {
+		L_ERR(nullptr, "ERROR: Suggestions for %s (limit %zu) should be [%s], obtained [%s]", repr(prefix).c_str(), limit, expected.c_str(), obtained.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+
+// An updated suggester must suggest the same as one built from scratch.
+static int suggester_check_built(const Suggester& suggester, const Xapian::Database& db) {
+	const Suggester built(db, suggester_prefix(), suggester.revision);
+	return suggester_check(suggester, "", SUGGESTER_MAX_LIMIT, suggester_str(built.suggest("", SUGGESTER_MAX_LIMIT)));
+}
+
+
+int test_suggester_suggest() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(suggester_db);
+
+	try {
+		Xapian::WritableDatabase wdb(suggester_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::set<std::string> changed;
+		suggester_add(wdb, { "apple", "banana" }, changed);
+		suggester_add(wdb, { "apple" }, changed);
+		suggester_add(wdb, { "apple", "apex" }, changed);
+		suggester_add(wdb, { "apricot" }, changed);
+		suggester_add(wdb, { "apricot", "apex" }, changed);
+		suggester_add(wdb, { "ap" }, changed);
+		wdb.commit();
+
+		// The document keeps its inputs in the completion slot.
+		std::set<std::string> inputs;
+		Suggester::document_inputs(wdb.get_document(1), inputs);
+		if (inputs != std::set<std::string>({ suggester_prefix() + "apple", suggester_prefix() + "banana" })) {
+			L_ERR(nullptr, "ERROR: Document should have the inputs apple and banana");
+			++cont;
+		}
+
+		Xapian::Database db(suggester_db);
+		const Suggester suggester(db, suggester_prefix(), 1);
+		if (suggester.size() != 5) {
+			L_ERR(nullptr, "ERROR: Suggester should have 5 inputs, not %zu", suggester.size());
+			++cont;
+		}
+
+		// Heaviest first, ties alphabetically.
+		cont += suggester_check(suggester, "ap", 3, "apple:3, apex:2, apricot:2");
+		cont += suggester_check(suggester, "ap", 10, "apple:3, apex:2, apricot:2, ap:1");
+		cont += suggester_check(suggester, "apr", 10, "apricot:2");
+		cont += suggester_check(suggester, "", 2, "apple:3, apex:2");
+		cont += suggester_check(suggester, "b", 10, "banana:1");
+		cont += suggester_check(suggester, "bananas", 10, "");
+		cont += suggester_check(suggester, "c", 10, "");
+		cont += suggester_check(suggester, "ap", 0, "");
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(suggester_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test Suggester suggestions is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_suggester_invalidation() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(suggester_db);
+
+	try {
+		SuggesterCache cache(SUGGESTER_CACHE_SIZE);
+		Xapian::WritableDatabase wdb(suggester_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::set<std::string> changed;
+		const auto apple = suggester_add(wdb, { "apple" }, changed);
+		suggester_add(wdb, { "apple" }, changed);
+		const auto banana = suggester_add(wdb, { "banana" }, changed);
+		suggester_add(wdb, { "apricot" }, changed);
+		wdb.commit();
+		changed.clear();
+
+		Xapian::Database db(suggester_db);
+		const auto s1 = cache.get(suggester_db, db, suggester_prefix(), 1);
+		cont += suggester_check(*s1, "", 10, "apple:2, apricot:1, banana:1");
+
+		// Same revision, same suggester.
+		if (cache.get(suggester_db, db, suggester_prefix(), 1) != s1 || cache.builds() != 1) {
+			L_ERR(nullptr, "ERROR: Suggester for the same revision should come from the cache");
+			++cont;
+		}
+		if (cache.weight() < s1->bytes()) {
+			L_ERR(nullptr, "ERROR: Suggesters cache should be sized by the bytes of the suggesters");
+			++cont;
+		}
+
+		// A remembered commit updates the suggester with the inputs it changed.
+		suggester_replace(wdb, apple, { "apricot", "avocado" }, changed);
+		suggester_delete(wdb, banana, changed);
+		suggester_add(wdb, { "avocado" }, changed);
+		wdb.commit();
+		cache.commit(suggester_db, 1, 2, std::move(changed));
+		changed.clear();
+
+		db.reopen();
+		const auto s2 = cache.get(suggester_db, db, suggester_prefix(), 2);
+		if (cache.updates() != 1 || cache.builds() != 1 || s2->base_revision != 1) {
+			L_ERR(nullptr, "ERROR: Suggester should be updated from the previous revision (updates: %zu, builds: %zu)", cache.updates(), cache.builds());
+			++cont;
+		}
+		cont += suggester_check(*s2, "", 10, "apricot:2, avocado:2, apple:1");
+		cont += suggester_check_built(*s2, db);
+
+		// Suggesters already handed out don't change.
+		cont += suggester_check(*s1, "", 10, "apple:2, apricot:1, banana:1");
+
+		// A commit not remembered (a gap) rebuilds it.
+		suggester_add(wdb, { "banana" }, changed);
+		wdb.commit();
+		changed.clear();
+
+		db.reopen();
+		const auto s3 = cache.get(suggester_db, db, suggester_prefix(), 3);
+		if (cache.builds() != 2 || s3->base_revision != 0) {
+			L_ERR(nullptr, "ERROR: Suggester should be rebuilt after a gap in the commits (builds: %zu)", cache.builds());
+			++cont;
+		}
+		cont += suggester_check(*s3, "", 10, "apricot:2, avocado:2, apple:1, banana:1");
+
+		// Commits changing nothing still chain the revisions.
+		cache.commit(suggester_db, 3, 4, std::set<std::string>());
+		suggester_replace(wdb, 2, { "apple", "banana" }, changed);
+		wdb.commit();
+		cache.commit(suggester_db, 4, 5, std::move(changed));
+		changed.clear();
+
+		db.reopen();
+		const auto s5 = cache.get(suggester_db, db, suggester_prefix(), 5);
+		if (cache.updates() != 2 || s5->base_revision != 3) {
+			L_ERR(nullptr, "ERROR: Suggester should be updated over several commits (updates: %zu)", cache.updates());
+			++cont;
+		}
+		cont += suggester_check(*s5, "", 10, "apricot:2, avocado:2, banana:2, apple:1");
+		cont += suggester_check_built(*s5, db);
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(suggester_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test Suggester invalidation is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_suggester_concurrent_builds() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(suggester_db);
+
+	try {
+		SuggesterCache cache(SUGGESTER_CACHE_SIZE);
+		Xapian::WritableDatabase wdb(suggester_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::set<std::string> changed;
+		for (int i = 0; i < 10000; ++i) {
+			suggester_add(wdb, { "input " + std::to_string(i % 1000) }, changed);
+		}
+		wdb.commit();
+
+		// Every thread gets the suggester built by just one of them.
+		std::vector<std::shared_ptr<const Suggester>> suggesters(8);
+		std::vector<std::thread> threads;
+		for (auto& suggester : suggesters) {
+			threads.emplace_back([&cache, &suggester]() {
+				Xapian::Database db(suggester_db);
+				suggester = cache.get(suggester_db, db, suggester_prefix(), 1);
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		if (cache.builds() != 1) {
+			L_ERR(nullptr, "ERROR: Suggester should be built once, not %zu times", cache.builds());
+			++cont;
+		}
+		for (const auto& suggester : suggesters) {
+			if (suggester != suggesters.front()) {
+				L_ERR(nullptr, "ERROR: Every thread should get the same suggester");
+				++cont;
+				break;
+			}
+		}
+		if (suggesters.front() && suggesters.front()->size() != 1000) {
+			L_ERR(nullptr, "ERROR: Suggester should have 1000 inputs, not %zu", suggesters.front()->size());
+			++cont;
+		}
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(suggester_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test Suggester concurrent builds is correct!");
+	}
+
+	RETURN(cont);
+}
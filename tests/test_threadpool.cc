@@ -214,3 +214,117 @@ int test_pool_func_unique() {
 
 	RETURN(0);
 }
+
+
+int test_pool_post() {
+	INIT_LOG
+	ThreadPool<> pool("W%zu", 4);
+	std::atomic_int total(0);
+
+	// Fire and forget functions (no futures created)
+	for (int i = 1; i <= 1000; ++i) {
+		pool.post([&total](int i) {
+			total += i;
+		}, i);
+	}
+
+	// Fire and forget Task objects
+	std::string results;
+	pool.post(std::make_shared<TestTask>("1", 0.01, results));
+
+	pool.end();
+	pool.join();
+
+	if (total != 500500 || results != "<11>") {
+		L_ERR(nullptr, "ThreadPool::post is not working correctly. Result: %d %s  Expected: 500500 <11>", total.load(), results.c_str());
+		RETURN(1);
+	}
+
+	RETURN(0);
+}
+
+
+int test_pool_steal() {
+	INIT_LOG
+	ThreadPool<> pool("W%zu", 4);
+	std::atomic_int total(0);
+
+	// Tasks enqueued from inside the workers go to the worker's own deque,
+	// idle workers must steal them.
+	std::vector<std::shared_future<void>> results;
+	for (int i = 0; i < 10; ++i) {
+		results.emplace_back(pool.enqueue([&pool, &total]() {
+			for (int j = 0; j < 100; ++j) {
+				pool.post([&total]() {
+					std::this_thread::sleep_for(std::chrono::microseconds(10));
+					++total;
+				});
+			}
+		}));
+	}
+	for (auto& result: results) {
+		result.get();
+	}
+
+	pool.end();
+	pool.join();
+
+	if (total != 1000) {
+		L_ERR(nullptr, "ThreadPool work stealing is not working correctly. Result: %d  Expected: 1000", total.load());
+		RETURN(1);
+	}
+
+	RETURN(0);
+}
+
+
+int test_pool_overflow() {
+	INIT_LOG
+	ThreadPool<> pool("W%zu", 1);
+	std::atomic_int total(0);
+
+	// A worker enqueuing more tasks than its deque and the injection queue
+	// can hold, the rest must go to the overflow queue.
+	const int tasks = THREADPOOL_DEQUE_SIZE + THREADPOOL_QUEUE_SIZE + 1000;
+	pool.enqueue([&pool, &total, tasks]() {
+		for (int i = 0; i < tasks; ++i) {
+			pool.post([&total]() {
+				++total;
+			});
+		}
+	}).get();
+
+	pool.end();
+	pool.join();
+
+	if (total != tasks) {
+		L_ERR(nullptr, "ThreadPool overflow is not working correctly. Result: %d  Expected: %d", total.load(), tasks);
+		RETURN(1);
+	}
+
+	RETURN(0);
+}
+
+
+int test_pool_wakeup() {
+	INIT_LOG
+	ThreadPool<> pool("W%zu", 2);
+
+	// Each task is enqueued right as the workers go idle, a lost wakeup
+	// would leave it waiting until some other task is enqueued.
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 1000; ++i) {
+		pool.enqueue([]() { }).get();
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	pool.end();
+	pool.join();
+
+	if (elapsed > std::chrono::seconds(5)) {
+		L_ERR(nullptr, "ThreadPool wakeups are not working correctly. Took %lld ms", static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+		RETURN(1);
+	}
+
+	RETURN(0);
+}
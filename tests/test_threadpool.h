@@ -24,6 +24,7 @@
 
 #include "../src/threadpool.h"
 
+#include <atomic>
 #include <memory>
 #include <chrono>
 #include <iostream>
@@ -94,3 +95,7 @@ int test_pool_limit();
 int test_pool_func();
 int test_pool_func_shared();
 int test_pool_func_unique();
+int test_pool_post();
+int test_pool_steal();
+int test_pool_overflow();
+int test_pool_wakeup();
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "test_wildcard.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/database_utils.h"
+#include "../src/multivalue/wildcard.h"
+#include "../src/schema.h"
+#include "utils.h"
+
+
+struct test_wildcard_t {
+	std::string pattern;
+	std::string str;
+	bool expected;
+};
+
+
+const test_wildcard_t test_match[] {
+	{ "abc",       "abc",            true  },
+	{ "abc",       "abcd",           false },
+	{ "*",         "",               true  },
+	{ "*",         "anything",       true  },
+	{ "abc*",      "abcdef",         true  },
+	{ "abc*",      "xabc",           false },
+	{ "*@foo.com", "john@foo.com",   true  },
+	{ "*@foo.com", "john@foo.co",    false },
+	{ "*bar*",     "foobarbaz",      true  },
+	{ "*bar*",     "foobaz",         false },
+	{ "a*b*c",     "aXXbYYc",        true  },
+	{ "a*b*c",     "aXXcYYb",        false },
+	{ "a*aab",     "aaaab",          true  },
+	{ "**a**",     "a",              true  },
+	{ "a*",        "",               false },
+};
+
+
+int test_wildcard_match() {
+	INIT_LOG
+	int cont = 0;
+	for (const auto& test : test_match) {
+		if (TermWildcard::match(test.pattern, test.str) != test.expected) {
+			L_ERR(nullptr, "ERROR: TermWildcard::match(%s, %s) should be %s", test.pattern.c_str(), test.str.c_str(), test.expected ? "true" : "false");
+			++cont;
+		}
+	}
+
+	const std::vector<std::pair<std::string, bool>> infixes = {
+		{ "abc*", false }, { "abc", false }, { "*abc", true }, { "a*c", true }, { "*abc*", true },
+	};
+	for (const auto& infix : infixes) {
+		if (TermWildcard::is_infix(infix.first) != infix.second) {
+			L_ERR(nullptr, "ERROR: TermWildcard::is_infix(%s) should be %s", infix.first.c_str(), infix.second ? "true" : "false");
+			++cont;
+		}
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test TermWildcard::match is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+static bool contains(const std::string& description, const std::string& str) {
+	return description.find(str) != std::string::npos;
+}
+
+
+int test_wildcard_query() {
+	INIT_LOG
+	int cont = 0;
+
+	required_spc_t spc;
+	spc.prefix = "XA";
+	spc.sep_types[2] = FieldType::TERM;
+
+	// A plain suffix is a prefix wildcard over reversed terms, without verification.
+	auto description = TermWildcard::getQuery(spc, "*@foo.com", 1).get_description();
+	if (!contains(description, prefixed("moc.oof@", spc.prefix, WILDCARD_REVERSED_CTYPE)) || contains(description, "TermWildcard")) {
+		L_ERR(nullptr, "ERROR: TermWildcard::getQuery suffix rewrite is wrong: %s", description.c_str());
+		++cont;
+	}
+
+	// An infix uses the first piece, the reversed last piece and n-grams of the middle pieces, and is verified.
+	description = TermWildcard::getQuery(spc, "ab*cdef*gh", 1).get_description();
+	const std::vector<std::string> expected = {
+		prefixed("ab", spc.prefix, spc.get_ctype()),
+		prefixed("hg", spc.prefix, WILDCARD_REVERSED_CTYPE),
+		prefixed("cde", spc.prefix, WILDCARD_NGRAM_CTYPE),
+		prefixed("def", spc.prefix, WILDCARD_NGRAM_CTYPE),
+		"TermWildcard ab*cdef*gh",
+	};
+	for (const auto& str : expected) {
+		if (!contains(description, str)) {
+			L_ERR(nullptr, "ERROR: TermWildcard::getQuery infix rewrite is missing %s: %s", repr(str).c_str(), description.c_str());
+			++cont;
+		}
+	}
+
+	// Pieces shorter than an n-gram narrow nothing, every document is verified.
+	description = TermWildcard::getQuery(spc, "*a*", 1).get_description();
+	if (!contains(description, "TermWildcard *a*") || contains(description, prefixed("a", spc.prefix, WILDCARD_NGRAM_CTYPE))) {
+		L_ERR(nullptr, "ERROR: TermWildcard::getQuery without n-grams is wrong: %s", description.c_str());
+		++cont;
+	}
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test TermWildcard::getQuery is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_wildcard_serialise() {
+	INIT_LOG
+	int cont = 0;
+
+	TermWildcard wildcard(std::string("XAT"), std::string("*bar*"));
+	const auto serialised = wildcard.serialise();
+
+	Xapian::Registry registry;
+	std::unique_ptr<TermWildcard> unserialised(wildcard.unserialise_with_registry(serialised, registry));
+	if (unserialised->serialise() != serialised) {
+		L_ERR(nullptr, "ERROR: TermWildcard serialise round trip is wrong: %s", repr(unserialised->serialise()).c_str());
+		++cont;
+	}
+	if (unserialised->get_description() != wildcard.get_description()) {
+		L_ERR(nullptr, "ERROR: TermWildcard unserialised as %s", unserialised->get_description().c_str());
+		++cont;
+	}
+
+	try {
+		std::unique_ptr<TermWildcard> bad(wildcard.unserialise_with_registry("bad", registry));
+		L_ERR(nullptr, "ERROR: TermWildcard unserialised a bad string");
+		++cont;
+	} catch (const Xapian::NetworkError&) { }
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test TermWildcard serialise is correct!");
+	}
+
+	RETURN(cont);
+}
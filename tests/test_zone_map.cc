@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2017 deipi.com LLC and contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "test_zone_map.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/length.h"
+#include "../src/multivalue/range.h"
+#include "../src/multivalue/zone_map.h"
+#include "../src/serialise_list.h"
+#include "utils.h"
+
+
+constexpr Xapian::valueno ZONE_MAP_SLOT = 10;
+const std::string zone_map_db = ".db_zone_map.db";
+
+
+static std::string zone_map_value(unsigned n) {
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%08u", n);
+	return buf;
+}
+
+
+static Xapian::Document zone_map_doc(unsigned n) {
+	std::vector<std::string> values = { zone_map_value(n), zone_map_value(n) + "~" };
+	Xapian::Document doc;
+	doc.add_value(ZONE_MAP_SLOT, StringList::serialise(values.begin(), values.end()));
+	if (n % 3 == 0) {
+		doc.add_term("M");
+	}
+	return doc;
+}
+
+
+// Adds documents the way Database does, tracking the zone maps only when pending is given.
+static void zone_map_add(Xapian::WritableDatabase& wdb, std::map<Xapian::valueno, ZoneMap>* pending, unsigned first, unsigned last) {
+	for (unsigned n = first; n <= last; ++n) {
+		const auto doc = zone_map_doc(n);
+		const auto did = wdb.add_document(doc);
+		if (pending) {
+			ZoneMap::update(*pending, did, doc);
+		}
+	}
+}
+
+
+static void zone_map_commit(Xapian::WritableDatabase& wdb, std::map<Xapian::valueno, ZoneMap>& pending) {
+	ZoneMap::commit(wdb, pending);
+	wdb.commit();
+	pending.clear();
+}
+
+
+// Documents with a value in [start, end], reading every one or skipping blocks with the zone map.
+static Xapian::doccount zone_map_count(const Xapian::Database& db, const std::string& start, const std::string& end, bool skip) {
+	auto zone_map = ZoneMap::load(db, ZONE_MAP_SLOT);
+	auto may_match = [&](const std::string& min, const std::string& max) {
+		return max >= start && min <= end;
+	};
+
+	Xapian::doccount count = 0;
+	auto it = db.valuestream_begin(ZONE_MAP_SLOT);
+	const auto it_e = db.valuestream_end(ZONE_MAP_SLOT);
+	while (it != it_e) {
+		if (skip) {
+			const auto did = it.get_docid();
+			const auto next_did = zone_map.skip(did, may_match);
+			if (next_did != did) {
+				it.skip_to(next_did);
+				continue;
+			}
+		}
+		StringList values(*it);
+		for (const auto& value : values) {
+			if (value >= start && value <= end) {
+				++count;
+				break;
+			}
+		}
+		++it;
+	}
+	return count;
+}
+
+
+static int zone_map_check(const Xapian::Database& db, const std::vector<std::pair<unsigned, unsigned>>& ranges) {
+	int cont = 0;
+	for (const auto& range : ranges) {
+		const auto start = zone_map_value(range.first);
+		const auto end = zone_map_value(range.second);
+		const auto expected = zone_map_count(db, start, end, false);
+		const auto count = zone_map_count(db, start, end, true);
+		if (count != expected) {
+			L_ERR(nullptr, "ERROR: Zone map skipped documents in [%s, %s]: %u instead of %u", start.c_str(), end.c_str(), count, expected);
+			++cont;
+		}
+	}
+	return cont;
+}
+
+
+int test_zone_map_mixed_blocks() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(zone_map_db);
+
+	try {
+		Xapian::WritableDatabase wdb(zone_map_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::map<Xapian::valueno, ZoneMap> pending;
+
+		// Documents indexed before zone maps existed fill block 0 and half of block 1.
+		zone_map_add(wdb, nullptr, 1, 1500);
+		wdb.commit();
+
+		// New documents fill the rest of block 1 and block 2.
+		zone_map_add(wdb, &pending, 1501, 3000);
+		zone_map_commit(wdb, pending);
+
+		Xapian::Database db(zone_map_db);
+		cont += zone_map_check(db, {
+			{ 10, 20 }, { 1100, 1200 }, { 1490, 1510 }, { 2100, 2200 }, { 2900, 3000 }, { 4000, 5000 },
+		});
+
+		// Blocks out of the range are still skipped.
+		auto zone_map = ZoneMap::load(db, ZONE_MAP_SLOT);
+		const auto start = zone_map_value(2100);
+		const auto end = zone_map_value(2200);
+		const auto next_did = zone_map.skip(1, [&](const std::string& min, const std::string& max) {
+			return max >= start && min <= end;
+		});
+		if (next_did != 2 * ZONE_MAP_BLOCK_SIZE + 1) {
+			L_ERR(nullptr, "ERROR: Zone map should skip to %u, not %u", 2 * ZONE_MAP_BLOCK_SIZE + 1, next_did);
+			++cont;
+		}
+
+		// An invalid zone map is rebuilt too.
+		wdb.set_metadata(ZoneMap::key(ZONE_MAP_SLOT), serialise_length(0) + serialise_length(100) + "x");
+		wdb.commit();
+		zone_map_add(wdb, &pending, 3001, 3010);
+		zone_map_commit(wdb, pending);
+
+		db.reopen();
+		cont += zone_map_check(db, {
+			{ 10, 20 }, { 1100, 1200 }, { 3005, 3010 },
+		});
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(zone_map_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test ZoneMap with old and new documents in a block is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_zone_map_deletes() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(zone_map_db);
+
+	try {
+		Xapian::WritableDatabase wdb(zone_map_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::map<Xapian::valueno, ZoneMap> pending;
+
+		zone_map_add(wdb, &pending, 1, 3000);
+		zone_map_commit(wdb, pending);
+
+		// The smallest and largest documents of block 0 and all of block 1 are gone.
+		for (Xapian::docid did = 1; did <= 100; ++did) {
+			wdb.delete_document(did);
+		}
+		wdb.delete_document(ZONE_MAP_BLOCK_SIZE);
+		for (Xapian::docid did = ZONE_MAP_BLOCK_SIZE + 1; did <= 2 * ZONE_MAP_BLOCK_SIZE; ++did) {
+			wdb.delete_document(did);
+		}
+		zone_map_add(wdb, &pending, 3001, 3100);
+		zone_map_commit(wdb, pending);
+
+		Xapian::Database db(zone_map_db);
+		cont += zone_map_check(db, {
+			{ 1, 100 }, { 50, 150 }, { 1000, 1030 }, { 1100, 1200 }, { 2040, 2060 }, { 3050, 3100 },
+		});
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(zone_map_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test ZoneMap with deleted documents is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+int test_zone_map_replaces() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(zone_map_db);
+
+	try {
+		Xapian::WritableDatabase wdb(zone_map_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::map<Xapian::valueno, ZoneMap> pending;
+
+		zone_map_add(wdb, nullptr, 1, 1000);
+		wdb.commit();
+		zone_map_add(wdb, &pending, 1001, 3000);
+		zone_map_commit(wdb, pending);
+
+		// Values move out of their block's zone, both up and down.
+		const std::vector<std::pair<Xapian::docid, unsigned>> replaces = {
+			{ 10, 5000 }, { 2000, 1 }, { 2500, 2501 }, { 500, 9000 },
+		};
+		for (const auto& replace : replaces) {
+			const auto doc = zone_map_doc(replace.second);
+			wdb.replace_document(replace.first, doc);
+			ZoneMap::update(pending, replace.first, doc);
+		}
+		zone_map_commit(wdb, pending);
+
+		Xapian::Database db(zone_map_db);
+		cont += zone_map_check(db, {
+			{ 1, 1 }, { 5, 15 }, { 4990, 5010 }, { 8999, 9001 }, { 2500, 2501 }, { 1990, 2010 },
+		});
+
+		if (zone_map_count(db, zone_map_value(1), zone_map_value(1), true) != 2) {
+			L_ERR(nullptr, "ERROR: Zone map lost a replaced document");
+			++cont;
+		}
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(zone_map_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test ZoneMap with replaced documents is correct!");
+	}
+
+	RETURN(cont);
+}
+
+
+// Documents matched by query, in docid order.
+static std::vector<Xapian::docid> zone_map_matches(const Xapian::Database& db, const Xapian::Query& query) {
+	Xapian::Enquire enquire(db);
+	enquire.set_query(query);
+	enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+	enquire.set_weighting_scheme(Xapian::BoolWeight());
+	std::vector<Xapian::docid> matches;
+	const auto mset = enquire.get_mset(0, db.get_doccount());
+	for (auto it = mset.begin(); it != mset.end(); ++it) {
+		matches.push_back(*it);
+	}
+	return matches;
+}
+
+
+// Documents with a value in [start, end] (and the term, if any), reading every one.
+// An empty start or end leaves the range open on that side.
+static std::vector<Xapian::docid> zone_map_expected(const Xapian::Database& db, const std::string& start, const std::string& end, const std::string& term) {
+	std::vector<Xapian::docid> expected;
+	const auto it_e = db.valuestream_end(ZONE_MAP_SLOT);
+	for (auto it = db.valuestream_begin(ZONE_MAP_SLOT); it != it_e; ++it) {
+		StringList values(*it);
+		for (const auto& value : values) {
+			if ((start.empty() || value >= start) && (end.empty() || value <= end)) {
+				expected.push_back(it.get_docid());
+				break;
+			}
+		}
+	}
+	if (!term.empty()) {
+		// Keep only the documents with the term.
+		std::vector<Xapian::docid> filtered;
+		for (auto did : expected) {
+			auto pl = db.postlist_begin(term);
+			pl.skip_to(did);
+			if (pl != db.postlist_end(term) && *pl == did) {
+				filtered.push_back(did);
+			}
+		}
+		expected.swap(filtered);
+	}
+	return expected;
+}
+
+
+int test_zone_map_posting_sources() {
+	INIT_LOG
+	int cont = 0;
+	delete_files(zone_map_db);
+
+	try {
+		Xapian::WritableDatabase wdb(zone_map_db, Xapian::DB_CREATE_OR_OVERWRITE);
+		std::map<Xapian::valueno, ZoneMap> pending;
+
+		// Documents in the first two chunks of the zone map, some of them
+		// indexed before it existed.
+		const Xapian::docid second_chunk = ZONE_MAP_CHUNK_SIZE * ZONE_MAP_BLOCK_SIZE + 1;
+		zone_map_add(wdb, nullptr, 1, 1000);
+		wdb.commit();
+		zone_map_add(wdb, &pending, 1001, 3000);
+		for (Xapian::docid did = second_chunk; did < second_chunk + 3000; ++did) {
+			const auto doc = zone_map_doc(did);
+			wdb.replace_document(did, doc);
+			ZoneMap::update(pending, did, doc);
+		}
+		zone_map_commit(wdb, pending);
+
+		Xapian::Database db(zone_map_db);
+		const std::vector<std::pair<Xapian::docid, Xapian::docid>> ranges = {
+			{ 10, 20 }, { 900, 1100 }, { 2990, second_chunk + 10 }, { second_chunk + 2000, second_chunk + 2100 }, { 5000, 6000 },
+		};
+		for (const auto& term : { std::string(), std::string("M") }) {
+			for (const auto& range : ranges) {
+				const auto start = zone_map_value(range.first);
+				const auto end = zone_map_value(range.second);
+				struct {
+					const char* name;
+					std::unique_ptr<Xapian::PostingSource> source;
+					std::vector<Xapian::docid> expected;
+				} sources[] = {
+					{ "MultipleValueRange", std::make_unique<MultipleValueRange>(ZONE_MAP_SLOT, std::string(start), std::string(end)), zone_map_expected(db, start, end, term) },
+					{ "MultipleValueGE", std::make_unique<MultipleValueGE>(ZONE_MAP_SLOT, std::string(start)), zone_map_expected(db, start, "", term) },
+					{ "MultipleValueLE", std::make_unique<MultipleValueLE>(ZONE_MAP_SLOT, std::string(end)), zone_map_expected(db, "", end, term) },
+				};
+				for (auto& source : sources) {
+					Xapian::Query query(source.source.get());
+					if (!term.empty()) {
+						// The matcher calls check() on the source for the documents with the term.
+						query = Xapian::Query(Xapian::Query::OP_FILTER, Xapian::Query(term), query);
+					}
+					const auto matches = zone_map_matches(db, query);
+					if (matches != source.expected) {
+						L_ERR(nullptr, "ERROR: %s [%s, %s]%s matched %zu documents instead of %zu", source.name, start.c_str(), end.c_str(), term.empty() ? "" : " filtered", matches.size(), source.expected.size());
+						++cont;
+					}
+				}
+			}
+		}
+	} catch (const Xapian::Error& exc) {
+		L_EXC(nullptr, "ERROR: %s", exc.get_msg().c_str());
+		++cont;
+	}
+
+	delete_files(zone_map_db);
+
+	if (cont == 0) {
+		L_DEBUG(nullptr, "Test ZoneMap in the range posting sources is correct!");
+	}
+
+	RETURN(cont);
+}
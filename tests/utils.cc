@@ -89,12 +89,12 @@ DB_Test::create_manager()
 {
 	if (!XapiandManager::manager) {
 		opts_t opts = {
-			TEST_VERBOSITY, TEST_DETACH, TEST_CHERT, TEST_SOLO, TEST_REQUIRED_TYPE, TEST_OPTIMAL, TEST_DATABASE,
+			TEST_VERBOSITY, TEST_DETACH, TEST_CHERT, TEST_SOLO, TEST_REQUIRED_TYPE, TEST_OPTIMAL, TEST_DOC_VALUES, TEST_DATABASE,
 			TEST_CLUSTER_NAME, TEST_NODE_NAME, XAPIAND_HTTP_SERVERPORT, XAPIAND_BINARY_SERVERPORT,
 			XAPIAND_DISCOVERY_SERVERPORT, XAPIAND_RAFT_SERVERPORT, TEST_PIDFILE,
 			TEST_LOGFILE, TEST_UID, TEST_GID, TEST_DISCOVERY_GROUP, TEST_RAFT_GROUP,
 			TEST_NUM_SERVERS, TEST_DBPOOL_SIZE, TEST_NUM_REPLICATORS, TEST_THREADPOOL_SIZE,
-			TEST_ENDPOINT_LIST_SIZE, TEST_NUM_COMMITERS, CONFIG_DEFAULT_MAX_CLIENTS, TEST_EV_FLAG
+			TEST_ENDPOINT_LIST_SIZE, TEST_NUM_COMMITERS, TEST_NUM_RECOVERERS, CONFIG_DEFAULT_MAX_CLIENTS, TEST_EV_FLAG
 		};
 
 		ev::default_loop default_loop(opts.ev_flags);
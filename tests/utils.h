@@ -46,6 +46,7 @@
 #define TEST_SOLO true
 #define TEST_REQUIRED_TYPE false
 #define TEST_OPTIMAL false
+#define TEST_DOC_VALUES false
 #define TEST_DATABASE ""
 #define TEST_CLUSTER_NAME "cluster_test"
 #define TEST_NODE_NAME "node_test"
@@ -61,6 +62,7 @@
 #define TEST_THREADPOOL_SIZE 1
 #define TEST_ENDPOINT_LIST_SIZE 1
 #define TEST_NUM_COMMITERS 1
+#define TEST_NUM_RECOVERERS 1
 #define TEST_EV_FLAG 0
 #define TEST_LOCAL_HOST "127.0.0.1"
 